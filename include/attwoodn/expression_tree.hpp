@@ -1,57 +1,467 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
 #include <memory>
 #include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 namespace attwoodn {
 namespace expression_tree {
 
+    /**
+     * @brief A non-owning reference to a sequence of characters, such as a string literal, a std::string, or a C string.
+     *        Leaf nodes that compare a std::string member (or a char* member read as a C string) with a string_ref compare
+     *        the characters in place, so no std::string is constructed when the leaf node is made or evaluated. The
+     *        referenced characters must outlive every leaf node that refers to them.
+     *
+     *        A string_ref made from a null pointer is null. The comparison operators of string_ref treat a null string_ref
+     *        as an empty string, while the built-in logical operators treat it as they treat a null pointer.
+    */
+    class string_ref {
+        public:
+            string_ref() = default;
+
+            string_ref(const char* str)
+                : data_(str),
+                  size_(str ? std::strlen(str) : 0) {}
+
+            string_ref(const char* data, std::size_t size)
+                : data_(data),
+                  size_(size) {}
+
+            string_ref(const std::string& str)
+                : data_(str.data()),
+                  size_(str.size()) {}
+
+#if __cplusplus >= 201703L
+            string_ref(std::string_view str)
+                : data_(str.data()),
+                  size_(str.size()) {}
+#endif
+
+            const char* data() const {
+                return data_;
+            }
+
+            std::size_t size() const {
+                return size_;
+            }
+
+            bool is_null() const {
+                return data_ == nullptr;
+            }
+
+            /**
+             * @brief Compares the characters of two strings using memcmp, as std::string::compare does.
+             * 
+             * @returns A negative number, zero, or a positive number if this string is respectively less than, equal to, or
+             *          greater than the other string
+            */
+            int compare(const string_ref& other) const {
+                const std::size_t common = size_ < other.size_ ? size_ : other.size_;
+                const int result = common ? std::memcmp(data_, other.data_, common) : 0;
+                if(result != 0) return result;
+                if(size_ < other.size_) return -1;
+                return size_ > other.size_ ? 1 : 0;
+            }
+
+            friend bool operator==(const string_ref& a, const string_ref& b) {
+                return a.size_ == b.size_ && a.compare(b) == 0;
+            }
+
+            friend bool operator!=(const string_ref& a, const string_ref& b) {
+                return !(a == b);
+            }
+
+            friend bool operator<(const string_ref& a, const string_ref& b) {
+                return a.compare(b) < 0;
+            }
+
+            friend bool operator>(const string_ref& a, const string_ref& b) {
+                return a.compare(b) > 0;
+            }
+
+        private:
+            const char* data_ = nullptr;
+            std::size_t size_ = 0;
+    };
+
+    /**
+     * The built-in logical operators. Each operator is an empty function object, so leaf nodes that use one store no
+     * operator state and the comparison is inlined into the leaf's evaluate function. Each operator is overloaded to permit 
+     * comparing values of type const T&, or of type T*. Pointers are dereferenced prior to comparison. Each operator also 
+     * compares strings of different types (std::string, string_ref, and C strings) by converting both to string_ref, 
+     * without constructing a std::string.
+    */
     namespace op {
-        
+
+        struct less_than_t {
+            template<typename T>
+            bool operator()(const T& a, const T& b) const {
+                return a < b;
+            }
+
+            template<typename T>
+            bool operator()(T* a, T* b) const {
+                if(a == nullptr || b == nullptr) return false;
+                return *a < *b;
+            }
+
+            bool operator()(const string_ref& a, const string_ref& b) const {
+                if(a.is_null() || b.is_null()) return false;
+                return a < b;
+            }
+        };
+
+        struct greater_than_t {
+            template<typename T>
+            bool operator()(const T& a, const T& b) const {
+                return a > b;
+            }
+
+            template<typename T>
+            bool operator()(T* a, T* b) const {
+                if(a == nullptr || b == nullptr) return false;
+                return *a > *b;
+            }
+
+            bool operator()(const string_ref& a, const string_ref& b) const {
+                if(a.is_null() || b.is_null()) return false;
+                return a > b;
+            }
+        };
+
+        struct equals_t {
+            template<typename T>
+            bool operator()(const T& a, const T& b) const {
+                return a == b;
+            }
+
+            template<typename T>
+            bool operator()(T* a, T* b) const {
+                if(a == nullptr && b == nullptr) return true;
+                if(a == nullptr || b == nullptr) return false;
+                return *a == *b;
+            }
+
+            bool operator()(const string_ref& a, const string_ref& b) const {
+                if(a.is_null() && b.is_null()) return true;
+                if(a.is_null() || b.is_null()) return false;
+                return a == b;
+            }
+        };
+
+        struct not_equals_t {
+            template<typename T>
+            bool operator()(const T& a, const T& b) const {
+                return a != b;
+            }
+
+            template<typename T>
+            bool operator()(T* a, T* b) const {
+                if(a == nullptr && b == nullptr) return false;
+                if(a == nullptr || b == nullptr) return true;
+                return *a != *b;
+            }
+
+            bool operator()(const string_ref& a, const string_ref& b) const {
+                if(a.is_null() && b.is_null()) return false;
+                if(a.is_null() || b.is_null()) return true;
+                return a != b;
+            }
+        };
+
+        constexpr less_than_t less_than {};
+        constexpr greater_than_t greater_than {};
+        constexpr equals_t equals {};
+        constexpr not_equals_t not_equals {};
+    }
+
+    /**
+     * @brief Identifies the built-in logical operators of the op namespace. Leaf nodes created with any other 
+     *        operator (e.g. a user-defined lambda) report comparator::custom.
+    */
+    enum class comparator {
+        custom,
+        equals,
+        not_equals,
+        less_than,
+        greater_than
+    };
+
+    /**
+     * @brief A type-erased identity for the member variable or const member function referenced by a leaf node. 
+     *        Two leaf nodes read the same value from an object if, and only if, their accessor_ids compare equal.
+    */
+    class accessor_id {
+        public:
+            enum class kind {
+                member_variable,
+                member_function
+            };
+
+            template<typename Ptr>
+            accessor_id(kind k, Ptr ptr)
+                : kind_(k),
+                  type_(&typeid(Ptr)) {
+                static_assert(sizeof(Ptr) <= sizeof(bytes_), "member pointer is too large for accessor_id");
+                std::memcpy(bytes_, &ptr, sizeof(Ptr));
+            }
+
+            kind get_kind() const {
+                return kind_;
+            }
+
+            /**
+             * @brief Copies the referenced member pointer into out, if out has exactly the type of the referenced member pointer.
+             * 
+             * @returns True if the member pointer was copied
+            */
+            template<typename Ptr>
+            bool get(Ptr& out) const {
+                if(typeid(Ptr) != *type_) {
+                    return false;
+                }
+                std::memcpy(&out, bytes_, sizeof(Ptr));
+                return true;
+            }
+
+            const std::type_info& type() const {
+                return *type_;
+            }
+
+            bool operator==(const accessor_id& other) const {
+                return kind_ == other.kind_ && *type_ == *other.type_ && std::memcmp(bytes_, other.bytes_, sizeof(bytes_)) == 0;
+            }
+
+            bool operator!=(const accessor_id& other) const {
+                return !(*this == other);
+            }
+
+            bool operator<(const accessor_id& other) const {
+                if(kind_ != other.kind_) return kind_ < other.kind_;
+                if(*type_ != *other.type_) return type_->before(*other.type_);
+                return std::memcmp(bytes_, other.bytes_, sizeof(bytes_)) < 0;
+            }
+
+            /**
+             * @brief Returns a hash of this accessor_id. Equal accessor_ids have equal hashes.
+            */
+            std::size_t hash() const {
+                std::size_t h = type_->hash_code() ^ static_cast<std::size_t>(kind_);
+                for(unsigned char byte : bytes_) {
+                    h = h * 1099511628211u ^ byte;
+                }
+                return h;
+            }
+
+        private:
+            kind kind_;
+            const std::type_info* type_;
+            unsigned char bytes_[4 * sizeof(void*)] = {};
+    };
+
+    /**
+     * @brief Returns the accessor_id of a member variable, matching the accessor_id reported by leaf nodes that read it.
+    */
+    template<typename Obj, typename T>
+    accessor_id accessor_of(T Obj::* member_var) {
+        return accessor_id(accessor_id::kind::member_variable, static_cast<const T Obj::*>(member_var));
+    }
+
+    /**
+     * @brief Returns the accessor_id of a const member function, matching the accessor_id reported by leaf nodes that call it.
+    */
+    template<typename Obj, typename T>
+    accessor_id accessor_of(T (Obj::* member_func)() const) {
+        return accessor_id(accessor_id::kind::member_function, member_func);
+    }
+
+    namespace detail {
+
+        template<typename... Ts>
+        struct make_void {
+            using type = void;
+        };
+
+        template<typename... Ts>
+        using void_t = typename make_void<Ts...>::type;
+
+        /**
+         * Comparison values are only considered ordered when operator< is available and they are not pointers, since 
+         * the op functions dereference pointers before comparing them.
+        */
+        template<typename T, typename = void>
+        struct is_ordered : std::false_type {};
+
         template<typename T>
-        inline bool less_than(const T a, const T b) {
-            return a < b;
-        }
+        struct is_ordered<T, void_t<decltype(std::declval<const T&>() < std::declval<const T&>())>>
+            : std::integral_constant<bool, !std::is_pointer<T>::value> {};
 
+        /**
+         * True if the given floating-point value is NaN, which is not ordered against any value.
+        */
         template<typename T>
-        inline bool less_than(T* a, T* b) {
-            if(a == nullptr || b == nullptr) return false;
-            return *a < *b;
+        bool is_unordered_value(const T& value, std::true_type) {
+            return value != value;
         }
 
         template<typename T>
-        inline bool greater_than(const T a, const T b) {
-            return a > b;
+        bool is_unordered_value(const T&, std::false_type) {
+            return false;
         }
 
         template<typename T>
-        inline bool greater_than(T* a, T* b) {
-            if(a == nullptr || b == nullptr) return false;
-            return *a > *b;
+        int compare_values(const T& a, const T& b, std::true_type) {
+            if(a < b) return -1;
+            if(b < a) return 1;
+            return 0;
         }
 
         template<typename T>
-        inline bool equals(const T a, const T b) {
-            return a == b;
+        int compare_values(const T&, const T&, std::false_type) {
+            throw std::logic_error("attempted to order comparison values of a type that has no operator<");
         }
 
+        template<typename T, typename = void>
+        struct is_hashable : std::false_type {};
+
         template<typename T>
-        inline bool equals(T* a, T* b) {
-            if(a == nullptr && b == nullptr) return true;
-            if(a == nullptr || b == nullptr) return false;
-            return *a == *b;
-        }
+        struct is_hashable<T, void_t<decltype(std::hash<T>()(std::declval<const T&>()))>> : std::true_type {};
 
+        /**
+         * Comparison values that have no std::hash specialization all hash to zero, so that equivalent values always have
+         * equal hashes.
+        */
         template<typename T>
-        inline bool not_equals(const T a, const T b) {
-            return a != b;
+        std::size_t hash_value(const T& value, std::true_type) {
+            return std::hash<T>()(value);
         }
-        
+
         template<typename T>
-        inline bool not_equals(T* a, T* b) {
-            if(a == nullptr && b == nullptr) return false;
-            if(a == nullptr || b == nullptr) return true;
-            return *a != *b;
+        std::size_t hash_value(const T&, std::false_type) {
+            return 0;
+        }
+
+        template<typename Op>
+        struct comparator_traits : std::integral_constant<comparator, comparator::custom> {};
+
+        template<>
+        struct comparator_traits<op::equals_t> : std::integral_constant<comparator, comparator::equals> {};
+
+        template<>
+        struct comparator_traits<op::not_equals_t> : std::integral_constant<comparator, comparator::not_equals> {};
+
+        template<>
+        struct comparator_traits<op::less_than_t> : std::integral_constant<comparator, comparator::less_than> {};
+
+        template<>
+        struct comparator_traits<op::greater_than_t> : std::integral_constant<comparator, comparator::greater_than> {};
+
+        /**
+         * Maps the operator passed to make_expr to the operator stored in a leaf node. A pointer to one of the built-in 
+         * operators (e.g. &op::equals) is stored as the operator itself, so that it takes no space and can be inlined.
+        */
+        template<typename Op>
+        struct stored_op {
+            using type = Op;
+
+            static Op get(Op op) {
+                return op;
+            }
+        };
+
+        template<typename Op>
+        struct stored_op<const Op*> {
+            using type = typename std::conditional<comparator_traits<Op>::value == comparator::custom, const Op*, Op>::type;
+
+            static type get(const Op* op) {
+                return get(op, std::integral_constant<bool, comparator_traits<Op>::value != comparator::custom>{});
+            }
+
+            static const Op* get(const Op* op, std::false_type) {
+                return op;
+            }
+
+            static Op get(const Op* op, std::true_type) {
+                return *op;
+            }
+        };
+
+        /**
+         * Holds a leaf node's operator. Empty operators (such as the built-in operators and captureless lambdas) are held
+         * as a base class, which takes no space.
+        */
+        template<typename Op, bool = std::is_class<Op>::value && std::is_empty<Op>::value && !std::is_final<Op>::value>
+        class op_holder : private Op {
+            public:
+                explicit op_holder(Op op)
+                    : Op(std::move(op)) {}
+
+                const Op& get_op() const {
+                    return *this;
+                }
+        };
+
+        template<typename Op>
+        class op_holder<Op, false> {
+            public:
+                explicit op_holder(Op op)
+                    : op_(std::move(op)) {}
+
+                const Op& get_op() const {
+                    return op_;
+                }
+
+            private:
+                Op op_;
+        };
+
+        template<typename Obj, typename T>
+        const T& read_accessor(const Obj& obj, const T Obj::* member_var) {
+            return obj.*member_var;
+        }
+
+        template<typename Obj, typename T>
+        T read_accessor(const Obj& obj, T (Obj::* member_func)() const) {
+            return (obj.*member_func)();
+        }
+
+        /**
+         * Leaf nodes may also read values using a custom accessor: a class with a read(const Obj&) const member function that
+         * returns the value, and an id() const member function that returns the accessor's accessor_id.
+        */
+        template<typename Obj, typename Accessor>
+        auto read_accessor(const Obj& obj, const Accessor& accessor) -> decltype(accessor.read(obj)) {
+            return accessor.read(obj);
+        }
+
+        template<typename Obj, typename T>
+        accessor_id accessor_id_of(const T Obj::* member_var) {
+            return accessor_id(accessor_id::kind::member_variable, member_var);
+        }
+
+        template<typename Obj, typename T>
+        accessor_id accessor_id_of(T (Obj::* member_func)() const) {
+            return accessor_id(accessor_id::kind::member_function, member_func);
+        }
+
+        template<typename Accessor>
+        auto accessor_id_of(const Accessor& accessor) -> decltype(accessor.id()) {
+            return accessor.id();
         }
     }
 
@@ -65,9 +475,12 @@ namespace expression_tree {
         template<typename Obj, typename LeftChild, typename RightChild>
         class expression_tree_op_node;
 
-        template<typename Obj, typename Op, typename CompValue>
+        template<typename Obj, typename Op, typename CompValue, typename Accessor>
         class expression_tree_leaf_node;
 
+        template<typename Obj>
+        class expression_tree_threshold_node;
+
         /**
          * @brief The base class representing all expression tree nodes.
         */
@@ -99,212 +512,489 @@ namespace expression_tree {
         };
 
         /**
-         * @brief Represents inner boolean operation nodes of the tree. These nodes contain references to a left and right 
-         *        child node, as well as the boolean operation to be performed (e.g. left child AND right child, or left child OR right child).
+         * @brief The interface shared by all expression_tree_op_node instantiations, regardless of their child types. 
+         *        Allows an expression tree to be inspected without knowing the static types of its nodes.
         */
-        template<typename Obj, typename LeftChild, typename RightChild>
-        class expression_tree_op_node : public expression_tree_node<Obj> {
+        template<typename Obj>
+        class expression_tree_op_node_base : public expression_tree_node<Obj> {
             public:
-                using this_type = expression_tree_op_node<Obj, LeftChild, RightChild>;
+                virtual boolean_op get_bool_op() const = 0;
+                virtual const expression_tree_node<Obj>* get_left() const = 0;
+                virtual const expression_tree_node<Obj>* get_right() const = 0;
 
-                expression_tree_op_node() = delete;
-                expression_tree_op_node(expression_tree_op_node&& other) = delete;
-                expression_tree_op_node& operator=(const expression_tree_op_node& other) = delete;
-                expression_tree_op_node& operator=(expression_tree_op_node&& other) = delete;
+                /**
+                 * @brief Releases ownership of this node's children, appending the non-null children to the given list.
+                 *        Used to destroy deep trees without recursing once per level.
+                */
+                virtual void release_children(std::vector<expression_tree_node<Obj>*>& out) = 0;
 
-                expression_tree_op_node(boolean_op bool_op)
-                    : bool_op_(bool_op) {}
+            protected:
+                /**
+                 * @brief Makes a heap-allocated copy of this node that performs the same boolean operation and has no children.
+                */
+                virtual expression_tree_op_node_base<Obj>* clone_without_children() const = 0;
 
-                expression_tree_op_node(const expression_tree_op_node& other) {
-                    bool_op_ = other.bool_op_;
-                    delete left_;
-                    delete right_;
-                    left_ = new LeftChild(*other.left_);
-                    right_ = new RightChild(*other.right_);
-                }
+                /**
+                 * @brief Takes ownership of the given heap-allocated nodes and makes them the children of this node, which has 
+                 *        none. The nodes must be copies of the children of a node of the same type as this node.
+                */
+                virtual void adopt_children(expression_tree_node<Obj>* left, expression_tree_node<Obj>* right) = 0;
 
-                ~expression_tree_op_node() override {
-                    delete left_;
-                    delete right_;
-                }
+                /**
+                 * Copies the children of other into this node, which has none. Op nodes are copied using an explicit stack
+                 * rather than by recursing once per level, so that deep trees can be copied. If a copy throws, the children
+                 * copied so far are owned by this node.
+                */
+                void copy_children(const expression_tree_op_node_base<Obj>& other) {
+                    using pending_type = std::vector<std::pair<const expression_tree_op_node_base<Obj>*, expression_tree_op_node_base<Obj>*>>;
+                    pending_type pending { { &other, this } };
 
-                void set_right(RightChild* r) {
-                    delete right_;
-                    right_ = new RightChild(*r);
-                    delete r;
-                }
+                    auto copy_child = [&pending](const expression_tree_node<Obj>* child) -> std::unique_ptr<expression_tree_node<Obj>> {
+                        if(!child) {
+                            return nullptr;
+                        }
+                        if(auto* op_node = dynamic_cast<const expression_tree_op_node_base<Obj>*>(child)) {
+                            std::unique_ptr<expression_tree_op_node_base<Obj>> copy(op_node->clone_without_children());
+                            pending.emplace_back(op_node, copy.get());
+                            return std::unique_ptr<expression_tree_node<Obj>>(copy.release());
+                        }
+                        return child->clone();
+                    };
 
-                void set_left(LeftChild* l) {
-                    delete left_;
-                    left_ = new LeftChild(*l);
-                    delete l;
-                }
+                    while(!pending.empty()) {
+                        const auto next = pending.back();
+                        pending.pop_back();
 
-                bool evaluate(const Obj& obj) const override {
-                    if(!left_ || !right_) {
-                        throw std::runtime_error("expression_tree_op_node has a missing child node");
+                        auto left = copy_child(next.first->get_left());
+                        auto right = copy_child(next.first->get_right());
+                        next.second->adopt_children(left.release(), right.release());
                     }
+                }
 
-                    switch(bool_op_) {
-                        case boolean_op::AND: {
-                            return left_->evaluate(obj) && right_->evaluate(obj);
-                        }
-
-                        case boolean_op::OR: {
-                            return left_->evaluate(obj) || right_->evaluate(obj);
-                        }
-
-                        default: {
-                            throw std::runtime_error("expression_tree_op_node contained a non-implemented boolean expression");
+                /**
+                 * Destroys the children of this node, and their descendants, without recursing once per level.
+                */
+                void delete_children() {
+                    std::vector<expression_tree_node<Obj>*> pending;
+                    release_children(pending);
+
+                    while(!pending.empty()) {
+                        expression_tree_node<Obj>* n = pending.back();
+                        pending.pop_back();
+                        if(auto* op_node = dynamic_cast<expression_tree_op_node_base<Obj>*>(n)) {
+                            op_node->release_children(pending);
                         }
+                        delete n;
                     }
-
-                    return false;
                 }
+        };
 
+        /**
+         * @brief The interface shared by all expression_tree_leaf_node instantiations, regardless of their operator and 
+         *        comparison value types. Allows an expression tree to be inspected without knowing the static types of its nodes.
+        */
+        template<typename Obj>
+        class expression_tree_leaf_node_base : public expression_tree_node<Obj> {
+            public:
                 /**
-                 * Performs an AND operation with an expression_tree_leaf_node to create a heap-allocated pointer
-                 * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
-                 * and the other node that was AND'ed with this node. This node becomes the left child. The other node becomes
-                 * the right child.
+                 * @brief Returns the identity of the member variable or const member function read by this leaf.
                 */
-                template<typename OtherOp, typename OtherCompValue>
-                auto* AND (expression_tree_leaf_node<Obj, OtherOp, OtherCompValue>* other) {
-                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_leaf_node<Obj, OtherOp, OtherCompValue>>;
-                    ret* op_node = new ret(boolean_op::AND);
-                    op_node->set_left(this);
-                    op_node->set_right(other);
-                    return op_node;
-                }
+                virtual accessor_id get_accessor() const = 0;
 
                 /**
-                 * Performs an OR operation with an expression_tree_leaf_node to create a heap-allocated pointer
-                 * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
-                 * and the other node that was OR'ed with this node. This node becomes the left child. The other node becomes
-                 * the right child.
+                 * @brief Returns which built-in op function this leaf compares with, or comparator::custom.
                 */
-                template<typename OtherOp, typename OtherCompValue>
-                auto* OR (expression_tree_leaf_node<Obj, OtherOp, OtherCompValue>* other) {
-                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_leaf_node<Obj, OtherOp, OtherCompValue>>;
-                    ret* op_node = new ret(boolean_op::OR);
-                    op_node->set_left(this);
-                    op_node->set_right(other);
-                    return op_node;
-                }
+                virtual comparator get_comparator() const = 0;
+
+                virtual const std::type_info& comp_value_type() const = 0;
 
                 /**
-                 * Performs an AND operation with another expression_tree_op_node to create a heap-allocated pointer
-                 * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
-                 * and the other node that was AND'ed with this node. This node becomes the left child. The other node becomes
-                 * the right child.
+                 * @brief Returns a pointer to this leaf's comparison value, whose type is given by comp_value_type.
                 */
-                template<typename OtherLeftChild, typename OtherRightChild>
-                auto* AND (expression_tree_op_node<Obj, OtherLeftChild, OtherRightChild>* other) {
-                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_op_node<Obj, OtherLeftChild, OtherRightChild>>;
-                    ret* op_node = new ret(boolean_op::AND);
-                    op_node->set_left(this);
-                    op_node->set_right(other);
-                    return op_node;
+                virtual const void* comp_value_ptr() const = 0;
+
+                /**
+                 * @brief True if the comparison value of this leaf can be ordered against those of leaves with the same 
+                 *        comp_value_type using compare_comp_value. A NaN comparison value cannot, since it is neither less 
+                 *        than, greater than, nor equal to any value.
+                */
+                virtual bool is_comp_value_ordered() const = 0;
+
+                /**
+                 * @brief True if the values read by this leaf may be null pointers, such as a char* member compared as a
+                 *        C string. A null value satisfies not_equals and no other comparison, whatever the comparison value,
+                 *        so the values read by such a leaf are not totally ordered against its comparison value.
+                */
+                virtual bool reads_nullable_value() const = 0;
+
+                /**
+                 * @brief True if the values read by this leaf may be NaN, i.e. if they are floating-point values. Like a null
+                 *        value, NaN satisfies not_equals and no other comparison, whatever the comparison value.
+                */
+                virtual bool reads_unordered_value() const = 0;
+
+                /**
+                 * @brief Orders the comparison value of this leaf against that of another leaf with the same comp_value_type.
+                 * 
+                 * @returns A negative number, zero, or a positive number if this leaf's comparison value is respectively
+                 *          less than, equivalent to, or greater than the other leaf's comparison value.
+                */
+                virtual int compare_comp_value(const expression_tree_leaf_node_base<Obj>& other) const = 0;
+
+                /**
+                 * @brief Returns a hash of this leaf's comparison value. Leaves whose comparison values are equivalent 
+                 *        according to compare_comp_value have equal hashes.
+                */
+                virtual std::size_t hash_comp_value() const = 0;
+        };
+
+        /**
+         * @brief Represents a node that always evaluates to the same boolean value. Constant nodes are produced by 
+         *        passes that prove a subexpression is a tautology or a contradiction.
+        */
+        template<typename Obj>
+        class expression_tree_constant_node : public expression_tree_node<Obj> {
+            public:
+                explicit expression_tree_constant_node(bool value)
+                    : value_(value) {}
+
+                bool evaluate(const Obj&) const override {
+                    return value_;
+                }
+
+                bool get_value() const {
+                    return value_;
+                }
+
+            private:
+                bool value_;
+
+            protected:
+                expression_tree_constant_node<Obj>* clone_impl() const override { 
+                    return new expression_tree_constant_node<Obj>(*this); 
+                }
+        };
+
+        /**
+         * @brief Represents a node that is true if at least k of its children are true (a k-of-n node), or more generally if
+         *        the sum of the weights of its true children reaches a threshold. Unlike an equivalent tree of AND and OR op 
+         *        nodes, whose size grows combinatorially with n, a threshold node holds each child once.
+         * 
+         *        Children are evaluated in order, and evaluation stops as soon as the threshold is reached, or as soon as the 
+         *        threshold can no longer be reached by the children that remain. Cheap or decisive children should therefore 
+         *        come first.
+        */
+        template<typename Obj>
+        class expression_tree_threshold_node : public expression_tree_node<Obj> {
+            public:
+                using this_type = expression_tree_threshold_node<Obj>;
+
+                expression_tree_threshold_node() = delete;
+                expression_tree_threshold_node(expression_tree_threshold_node&& other) = delete;
+                expression_tree_threshold_node& operator=(const expression_tree_threshold_node& other) = delete;
+                expression_tree_threshold_node& operator=(expression_tree_threshold_node&& other) = delete;
+
+                /**
+                 * @brief Takes ownership of the given heap-allocated children. The node is true if at least k of them are true.
+                */
+                expression_tree_threshold_node(std::size_t k, std::vector<expression_tree_node<Obj>*> children)
+                    : threshold_(static_cast<double>(k)),
+                      children_(std::move(children)),
+                      weights_(children_.size(), 1.0) {
+                    check_children();
                 }
 
                 /**
-                 * Performs an OR operation with another expression_tree_op_node to create a heap-allocated pointer
+                 * @brief Takes ownership of the given heap-allocated children. The node is true if the sum of the weights of its
+                 *        true children is at least threshold. Weights must not be negative.
+                */
+                expression_tree_threshold_node(double threshold, std::vector<expression_tree_node<Obj>*> children, 
+                        std::vector<double> weights)
+                    : threshold_(threshold),
+                      children_(std::move(children)),
+                      weights_(std::move(weights)) {
+                    check_children();
+                }
+
+                expression_tree_threshold_node(const expression_tree_threshold_node& other)
+                    : threshold_(other.threshold_),
+                      weights_(other.weights_),
+                      total_weight_(other.total_weight_) {
+                    children_.reserve(other.children_.size());
+                    try {
+                        for(auto* child : other.children_) {
+                            children_.push_back(child->clone().release());
+                        }
+                    } catch(...) {
+                        delete_children();
+                        throw;
+                    }
+                }
+
+                ~expression_tree_threshold_node() override {
+                    delete_children();
+                }
+
+                bool evaluate(const Obj& obj) const override {
+                    return evaluate(obj, [](const expression_tree_node<Obj>& child, const Obj& o) { 
+                        return child.evaluate(o); 
+                    });
+                }
+
+                /**
+                 * @brief Evaluates this node using test(child, obj) as the result of each child, stopping as soon as the result
+                 *        is known.
+                */
+                template<typename Test>
+                bool evaluate(const Obj& obj, Test test) const {
+                    double reached = 0;
+                    double remaining = total_weight_;
+                    for(std::size_t i = 0; i < children_.size(); ++i) {
+                        if(reached >= threshold_) {
+                            return true;
+                        }
+                        if(reached + remaining < threshold_) {
+                            return false;
+                        }
+
+                        remaining -= weights_[i];
+                        if(test(*children_[i], obj)) {
+                            reached += weights_[i];
+                        }
+                    }
+                    return reached >= threshold_;
+                }
+
+                double get_threshold() const {
+                    return threshold_;
+                }
+
+                std::size_t child_count() const {
+                    return children_.size();
+                }
+
+                const expression_tree_node<Obj>* get_child(std::size_t index) const {
+                    if(index >= children_.size()) {
+                        throw std::out_of_range("expression_tree_threshold_node has no child at the given index");
+                    }
+                    return children_[index];
+                }
+
+                double get_weight(std::size_t index) const {
+                    if(index >= weights_.size()) {
+                        throw std::out_of_range("expression_tree_threshold_node has no child at the given index");
+                    }
+                    return weights_[index];
+                }
+
+                /**
+                 * Performs an AND operation with an expression_tree_leaf_node to create a heap-allocated pointer
+                 * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
+                 * and the other node that was AND'ed with this node. This node becomes the left child. The other node becomes
+                 * the right child.
+                */
+                template<typename OtherOp, typename OtherCompValue, typename OtherAccessor>
+                auto* AND (expression_tree_leaf_node<Obj, OtherOp, OtherCompValue, OtherAccessor>* other) {
+                    return combine(boolean_op::AND, other);
+                }
+
+                /**
+                 * Performs an OR operation with an expression_tree_leaf_node to create a heap-allocated pointer
+                 * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
+                 * and the other node that was OR'ed with this node. This node becomes the left child. The other node becomes
+                 * the right child.
+                */
+                template<typename OtherOp, typename OtherCompValue, typename OtherAccessor>
+                auto* OR (expression_tree_leaf_node<Obj, OtherOp, OtherCompValue, OtherAccessor>* other) {
+                    return combine(boolean_op::OR, other);
+                }
+
+                /**
+                 * Performs an AND operation with an expression_tree_op_node to create a heap-allocated pointer
+                 * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
+                 * and the other node that was AND'ed with this node. This node becomes the left child. The other node becomes
+                 * the right child.
+                */
+                template<typename OtherLeftChild, typename OtherRightChild>
+                auto* AND (expression_tree_op_node<Obj, OtherLeftChild, OtherRightChild>* other) {
+                    return combine(boolean_op::AND, other);
+                }
+
+                /**
+                 * Performs an OR operation with an expression_tree_op_node to create a heap-allocated pointer
                  * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
                  * and the other node that was OR'ed with this node. This node becomes the left child. The other node becomes
                  * the right child.
                 */
                 template<typename OtherLeftChild, typename OtherRightChild>
                 auto* OR (expression_tree_op_node<Obj, OtherLeftChild, OtherRightChild>* other) {
-                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_op_node<Obj, OtherLeftChild, OtherRightChild>>;
-                    ret* op_node = new ret(boolean_op::OR);
+                    return combine(boolean_op::OR, other);
+                }
+
+                /**
+                 * Performs an AND operation with another expression_tree_threshold_node to create a heap-allocated pointer
+                 * to a new expression_tree_op_node. This node becomes the left child. The other node becomes the right child.
+                */
+                auto* AND (this_type* other) {
+                    return combine(boolean_op::AND, other);
+                }
+
+                /**
+                 * Performs an OR operation with another expression_tree_threshold_node to create a heap-allocated pointer
+                 * to a new expression_tree_op_node. This node becomes the left child. The other node becomes the right child.
+                */
+                auto* OR (this_type* other) {
+                    return combine(boolean_op::OR, other);
+                }
+
+            private:
+                double threshold_;
+                std::vector<expression_tree_node<Obj>*> children_;
+                std::vector<double> weights_;
+                double total_weight_ = 0;
+
+                template<typename Other>
+                expression_tree_op_node<Obj, this_type, Other>* combine(boolean_op bool_op, Other* other) {
+                    auto* op_node = new expression_tree_op_node<Obj, this_type, Other>(bool_op);
                     op_node->set_left(this);
                     op_node->set_right(other);
                     return op_node;
                 }
 
-            private:
-                boolean_op bool_op_;
-                LeftChild* left_ { nullptr };
-                RightChild* right_ { nullptr };
+                /**
+                 * Validates the children and weights given to a constructor. The children are owned by this node as soon as
+                 * it is constructed, so they are deleted if they are invalid.
+                */
+                void check_children() {
+                    const char* error = nullptr;
+                    if(weights_.size() != children_.size()) {
+                        error = "expression_tree_threshold_node requires one weight for each child node";
+                    }
+                    for(std::size_t i = 0; !error && i < children_.size(); ++i) {
+                        if(!children_[i]) {
+                            error = "expression_tree_threshold_node has a null child node";
+                        } else if(!(weights_[i] >= 0)) {
+                            error = "expression_tree_threshold_node requires weights that are not negative";
+                        }
+                        total_weight_ += weights_[i];
+                    }
+
+                    if(error) {
+                        delete_children();
+                        throw std::invalid_argument(error);
+                    }
+                }
+
+                void delete_children() {
+                    for(auto* child : children_) {
+                        delete child;
+                    }
+                    children_.clear();
+                }
 
             protected:
-                expression_tree_op_node<Obj, LeftChild, RightChild>* clone_impl() const override { 
-                    return new expression_tree_op_node<Obj, LeftChild, RightChild>(*this); 
+                this_type* clone_impl() const override { 
+                    return new this_type(*this); 
                 }
         };
-        
+
         /**
-         * @brief Represents leaf nodes of the tree. These nodes contain: a reference to a member variable or member function of the
-         *        given Obj type; the requested logical operation to be performed (e.g. equals, greater_than, etc.); and the
-         *        value to compare to the given member variable or member function of an Obj instance.
+         * @brief Represents inner boolean operation nodes of the tree. These nodes contain references to a left and right 
+         *        child node, as well as the boolean operation to be performed (e.g. left child AND right child, or left child OR right child).
         */
-        template<typename Obj, typename Op, typename CompValue>
-        class expression_tree_leaf_node : public expression_tree_node<Obj> {
+        template<typename Obj, typename LeftChild, typename RightChild>
+        class expression_tree_op_node : public expression_tree_op_node_base<Obj> {
             public:
-                using this_type = expression_tree_leaf_node<Obj, Op, CompValue>;
+                using this_type = expression_tree_op_node<Obj, LeftChild, RightChild>;
 
-                expression_tree_leaf_node() = delete;
-                
-                expression_tree_leaf_node(const expression_tree_leaf_node& other) = default;
-                expression_tree_leaf_node(expression_tree_leaf_node&& other) noexcept = default;
-                expression_tree_leaf_node& operator=(const expression_tree_leaf_node& other) = default;
-                expression_tree_leaf_node& operator=(expression_tree_leaf_node&& other) noexcept = default;
+                expression_tree_op_node() = delete;
+                expression_tree_op_node(expression_tree_op_node&& other) = delete;
+                expression_tree_op_node& operator=(const expression_tree_op_node& other) = delete;
+                expression_tree_op_node& operator=(expression_tree_op_node&& other) = delete;
+
+                expression_tree_op_node(boolean_op bool_op)
+                    : bool_op_(bool_op) {}
+
+                expression_tree_op_node(const expression_tree_op_node& other)
+                    : bool_op_(other.bool_op_) {
+                    try {
+                        this->copy_children(other);
+                    } catch(...) {
+                        this->delete_children();
+                        throw;
+                    }
+                }
+
+                ~expression_tree_op_node() override {
+                    this->delete_children();
+                }
 
                 /**
-                 * @brief Constructor that accepts a reference to a member variable of Obj
+                 * @brief Takes ownership of the given heap-allocated node and makes it the right child of this node.
                 */
-                expression_tree_leaf_node(const CompValue Obj::* obj_mem_var, Op op, CompValue comp_value)
-                    : member_var_(obj_mem_var),
-                      logical_op_(op),
-                      comp_value_(comp_value) {}
+                void set_right(RightChild* r) {
+                    delete right_;
+                    right_ = r;
+                }
 
                 /**
-                 * @brief Constructor that accepts a reference to a const member function of Obj
+                 * @brief Takes ownership of the given heap-allocated node and makes it the left child of this node.
                 */
-                expression_tree_leaf_node(CompValue (Obj::* obj_mem_func)() const, Op op, CompValue comp_value)
-                    : member_func_(obj_mem_func),
-                      logical_op_(op),
-                      comp_value_(comp_value) {}
+                void set_left(LeftChild* l) {
+                    delete left_;
+                    left_ = l;
+                }
 
-                ~expression_tree_leaf_node() override = default;
+                boolean_op get_bool_op() const override {
+                    return bool_op_;
+                }
+
+                const expression_tree_node<Obj>* get_left() const override {
+                    return left_;
+                }
+
+                const expression_tree_node<Obj>* get_right() const override {
+                    return right_;
+                }
+
+                void release_children(std::vector<expression_tree_node<Obj>*>& out) override {
+                    if(left_) out.push_back(left_);
+                    if(right_) out.push_back(right_);
+                    left_ = nullptr;
+                    right_ = nullptr;
+                }
 
                 bool evaluate(const Obj& obj) const override {
-                    if (member_func_ && member_var_) {
-                        throw std::runtime_error("expression_tree_leaf_node has both a member function reference " + 
-                            std::string("and member variable reference. Only one is permitted"));
+                    if(!left_ || !right_) {
+                        throw std::runtime_error("expression_tree_op_node has a missing child node");
                     }
 
-                    else if (!member_func_ && !member_var_) {
-                        throw std::runtime_error("expression_tree_leaf_node has a nullptr for both member function reference " + 
-                            std::string("and member variable reference. At least one is required"));
-                    }
+                    switch(bool_op_) {
+                        case boolean_op::AND: {
+                            return left_->evaluate(obj) && right_->evaluate(obj);
+                        }
 
-                    CompValue actual_value;
+                        case boolean_op::OR: {
+                            return left_->evaluate(obj) || right_->evaluate(obj);
+                        }
 
-                    if (member_func_) {
-                        // invoke member function and store the result
-                        actual_value = (obj.*member_func_)();
-                    } 
-                    
-                    else if (member_var_) {
-                        // get value from obj's data member
-                        actual_value = obj.*member_var_;
+                        default: {
+                            throw std::runtime_error("expression_tree_op_node contained a non-implemented boolean expression");
+                        }
                     }
 
-                    else return false;
-
-                    return logical_op_(actual_value, comp_value_);
+                    return false;
                 }
 
                 /**
-                 * Performs an AND operation with another expression_tree_leaf_node to create a heap-allocated pointer
+                 * Performs an AND operation with an expression_tree_leaf_node to create a heap-allocated pointer
                  * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
                  * and the other node that was AND'ed with this node. This node becomes the left child. The other node becomes
                  * the right child.
                 */
-                template<typename OtherOp, typename OtherCompValue>
-                auto* AND (expression_tree_leaf_node<Obj, OtherOp, OtherCompValue>* other) {
-                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_leaf_node<Obj, OtherOp, OtherCompValue>>;
+                template<typename OtherOp, typename OtherCompValue, typename OtherAccessor>
+                auto* AND (expression_tree_leaf_node<Obj, OtherOp, OtherCompValue, OtherAccessor>* other) {
+                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_leaf_node<Obj, OtherOp, OtherCompValue, OtherAccessor>>;
                     ret* op_node = new ret(boolean_op::AND);
                     op_node->set_left(this);
                     op_node->set_right(other);
@@ -312,14 +1002,14 @@ namespace expression_tree {
                 }
 
                 /**
-                 * Performs an OR operation with another expression_tree_leaf_node to create a heap-allocated pointer
+                 * Performs an OR operation with an expression_tree_leaf_node to create a heap-allocated pointer
                  * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
                  * and the other node that was OR'ed with this node. This node becomes the left child. The other node becomes
                  * the right child.
                 */
-                template<typename OtherOp, typename OtherCompValue>
-                auto* OR (expression_tree_leaf_node<Obj, OtherOp, OtherCompValue>* other) {
-                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_leaf_node<Obj, OtherOp, OtherCompValue>>;
+                template<typename OtherOp, typename OtherCompValue, typename OtherAccessor>
+                auto* OR (expression_tree_leaf_node<Obj, OtherOp, OtherCompValue, OtherAccessor>* other) {
+                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_leaf_node<Obj, OtherOp, OtherCompValue, OtherAccessor>>;
                     ret* op_node = new ret(boolean_op::OR);
                     op_node->set_left(this);
                     op_node->set_right(other);
@@ -327,7 +1017,7 @@ namespace expression_tree {
                 }
 
                 /**
-                 * Performs an AND operation with an expression_tree_op_node to create a heap-allocated pointer
+                 * Performs an AND operation with another expression_tree_op_node to create a heap-allocated pointer
                  * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
                  * and the other node that was AND'ed with this node. This node becomes the left child. The other node becomes
                  * the right child.
@@ -342,7 +1032,7 @@ namespace expression_tree {
                 }
 
                 /**
-                 * Performs an OR operation with an expression_tree_op_node to create a heap-allocated pointer
+                 * Performs an OR operation with another expression_tree_op_node to create a heap-allocated pointer
                  * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
                  * and the other node that was OR'ed with this node. This node becomes the left child. The other node becomes
                  * the right child.
@@ -356,47 +1046,707 @@ namespace expression_tree {
                     return op_node;
                 }
 
+                /**
+                 * Performs an AND operation with an expression_tree_threshold_node to create a heap-allocated pointer
+                 * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
+                 * and the other node that was AND'ed with this node. This node becomes the left child. The other node becomes
+                 * the right child.
+                */
+                auto* AND (expression_tree_threshold_node<Obj>* other) {
+                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_threshold_node<Obj>>;
+                    ret* op_node = new ret(boolean_op::AND);
+                    op_node->set_left(this);
+                    op_node->set_right(other);
+                    return op_node;
+                }
+
+                /**
+                 * Performs an OR operation with an expression_tree_threshold_node to create a heap-allocated pointer
+                 * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
+                 * and the other node that was OR'ed with this node. This node becomes the left child. The other node becomes
+                 * the right child.
+                */
+                auto* OR (expression_tree_threshold_node<Obj>* other) {
+                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_threshold_node<Obj>>;
+                    ret* op_node = new ret(boolean_op::OR);
+                    op_node->set_left(this);
+                    op_node->set_right(other);
+                    return op_node;
+                }
+
             private:
-                CompValue (Obj::* member_func_)() const = nullptr;
-                const CompValue Obj::* member_var_ = nullptr;
-                Op logical_op_;
-                CompValue comp_value_;
+                boolean_op bool_op_;
+                LeftChild* left_ { nullptr };
+                RightChild* right_ { nullptr };
 
             protected:
-                expression_tree_leaf_node<Obj, Op, CompValue>* clone_impl() const override { 
-                    return new expression_tree_leaf_node<Obj, Op, CompValue>(*this); 
+                expression_tree_op_node<Obj, LeftChild, RightChild>* clone_impl() const override { 
+                    return new expression_tree_op_node<Obj, LeftChild, RightChild>(*this); 
                 }
-        };
 
-    }
+                expression_tree_op_node_base<Obj>* clone_without_children() const override {
+                    return new this_type(bool_op_);
+                }
 
-    template<class T> struct type_id{using type = T;}; 
+                void adopt_children(expression_tree_node<Obj>* left, expression_tree_node<Obj>* right) override {
+                    left_ = static_cast<LeftChild*>(left);
+                    right_ = static_cast<RightChild*>(right);
+                }
+        };
+        
+        /**
+         * @brief Represents leaf nodes of the tree. These nodes contain: a reference to a member variable or member function of the
+         *        given Obj type; the requested logical operation to be performed (e.g. equals, greater_than, etc.); and the
+         *        value to compare to the given member variable or member function of an Obj instance.
+         * 
+         *        The Accessor type is either a pointer to a member variable of Obj (const CompValue Obj::*) or a pointer to a 
+         *        const member function of Obj (CompValue (Obj::*)() const), so each leaf only stores the kind of reference it uses.
+         *        It may also be a custom accessor class, such as the record_field of record.hpp (see detail::read_accessor).
+         *        Empty operators, such as the built-in op functions, take no space in the leaf.
+        */
+        template<typename Obj, typename Op, typename CompValue, typename Accessor>
+        class expression_tree_leaf_node : public expression_tree_leaf_node_base<Obj>, private detail::op_holder<Op> {
+            public:
+                using this_type = expression_tree_leaf_node<Obj, Op, CompValue, Accessor>;
+                using read_type = typename std::decay<
+                    decltype(detail::read_accessor(std::declval<const Obj&>(), std::declval<const Accessor&>()))>::type;
 
-    /**
-     * Makes an expression tree leaf node for comparing pointer-type member variables of a class/struct
-    */
-    template<typename Obj, typename CompValue, typename Op = typename type_id<bool (*)(CompValue*, CompValue*)>::type,
-        typename std::enable_if<std::is_convertible<CompValue, CompValue*>::value, int>::type = 0>
-    node::expression_tree_leaf_node<Obj, Op, CompValue>* make_expr( CompValue Obj::* member_var, Op op, CompValue comp_value ) {
-        return new node::expression_tree_leaf_node<Obj, Op, CompValue>( member_var, op, comp_value );
-    }
+                expression_tree_leaf_node() = delete;
+                
+                expression_tree_leaf_node(const expression_tree_leaf_node& other) = default;
+                expression_tree_leaf_node(expression_tree_leaf_node&& other) noexcept = default;
+                expression_tree_leaf_node& operator=(const expression_tree_leaf_node& other) = default;
+                expression_tree_leaf_node& operator=(expression_tree_leaf_node&& other) noexcept = default;
 
-    /**
-     * Makes an expression tree leaf node for comparing value-type member variables of a class/struct
+                /**
+                 * @brief Constructor that accepts a reference to a member variable or a const member function of Obj
+                */
+                expression_tree_leaf_node(Accessor accessor, Op op, const CompValue& comp_value)
+                    : detail::op_holder<Op>(std::move(op)),
+                      accessor_(accessor),
+                      comp_value_(comp_value) {
+                    check_accessor();
+                }
+
+                /**
+                 * @brief Constructor that accepts a reference to a member variable or a const member function of Obj, 
+                 *        and moves the given comparison value into the leaf node
+                */
+                expression_tree_leaf_node(Accessor accessor, Op op, CompValue&& comp_value)
+                    : detail::op_holder<Op>(std::move(op)),
+                      accessor_(accessor),
+                      comp_value_(std::move(comp_value)) {
+                    check_accessor();
+                }
+
+                ~expression_tree_leaf_node() override = default;
+
+                bool evaluate(const Obj& obj) const override {
+                    return this->get_op()(detail::read_accessor(obj, accessor_), comp_value_);
+                }
+
+                accessor_id get_accessor() const override {
+                    return detail::accessor_id_of(accessor_);
+                }
+
+                comparator get_comparator() const override {
+                    return detail::comparator_traits<Op>::value;
+                }
+
+                const std::type_info& comp_value_type() const override {
+                    return typeid(CompValue);
+                }
+
+                bool is_comp_value_ordered() const override {
+                    return detail::is_ordered<CompValue>::value 
+                        && !detail::is_unordered_value(comp_value_, std::is_floating_point<CompValue>{});
+                }
+
+                bool reads_nullable_value() const override {
+                    return std::is_pointer<read_type>::value;
+                }
+
+                bool reads_unordered_value() const override {
+                    return std::is_floating_point<read_type>::value;
+                }
+
+                int compare_comp_value(const expression_tree_leaf_node_base<Obj>& other) const override {
+                    if (other.comp_value_type() != typeid(CompValue)) {
+                        throw std::logic_error("attempted to order comparison values of different types");
+                    }
+                    return detail::compare_values(comp_value_, *static_cast<const CompValue*>(other.comp_value_ptr()), 
+                        detail::is_ordered<CompValue>{});
+                }
+
+                const void* comp_value_ptr() const override {
+                    return &comp_value_;
+                }
+
+                std::size_t hash_comp_value() const override {
+                    return detail::hash_value(comp_value_, 
+                        std::integral_constant<bool, detail::is_ordered<CompValue>::value && detail::is_hashable<CompValue>::value>{});
+                }
+
+                /**
+                 * Performs an AND operation with another expression_tree_leaf_node to create a heap-allocated pointer
+                 * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
+                 * and the other node that was AND'ed with this node. This node becomes the left child. The other node becomes
+                 * the right child.
+                */
+                template<typename OtherOp, typename OtherCompValue, typename OtherAccessor>
+                auto* AND (expression_tree_leaf_node<Obj, OtherOp, OtherCompValue, OtherAccessor>* other) {
+                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_leaf_node<Obj, OtherOp, OtherCompValue, OtherAccessor>>;
+                    ret* op_node = new ret(boolean_op::AND);
+                    op_node->set_left(this);
+                    op_node->set_right(other);
+                    return op_node;
+                }
+
+                /**
+                 * Performs an OR operation with another expression_tree_leaf_node to create a heap-allocated pointer
+                 * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
+                 * and the other node that was OR'ed with this node. This node becomes the left child. The other node becomes
+                 * the right child.
+                */
+                template<typename OtherOp, typename OtherCompValue, typename OtherAccessor>
+                auto* OR (expression_tree_leaf_node<Obj, OtherOp, OtherCompValue, OtherAccessor>* other) {
+                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_leaf_node<Obj, OtherOp, OtherCompValue, OtherAccessor>>;
+                    ret* op_node = new ret(boolean_op::OR);
+                    op_node->set_left(this);
+                    op_node->set_right(other);
+                    return op_node;
+                }
+
+                /**
+                 * Performs an AND operation with an expression_tree_op_node to create a heap-allocated pointer
+                 * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
+                 * and the other node that was AND'ed with this node. This node becomes the left child. The other node becomes
+                 * the right child.
+                */
+                template<typename OtherLeftChild, typename OtherRightChild>
+                auto* AND (expression_tree_op_node<Obj, OtherLeftChild, OtherRightChild>* other) {
+                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_op_node<Obj, OtherLeftChild, OtherRightChild>>;
+                    ret* op_node = new ret(boolean_op::AND);
+                    op_node->set_left(this);
+                    op_node->set_right(other);
+                    return op_node;
+                }
+
+                /**
+                 * Performs an OR operation with an expression_tree_op_node to create a heap-allocated pointer
+                 * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
+                 * and the other node that was OR'ed with this node. This node becomes the left child. The other node becomes
+                 * the right child.
+                */
+                template<typename OtherLeftChild, typename OtherRightChild>
+                auto* OR (expression_tree_op_node<Obj, OtherLeftChild, OtherRightChild>* other) {
+                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_op_node<Obj, OtherLeftChild, OtherRightChild>>;
+                    ret* op_node = new ret(boolean_op::OR);
+                    op_node->set_left(this);
+                    op_node->set_right(other);
+                    return op_node;
+                }
+
+                /**
+                 * Performs an AND operation with an expression_tree_threshold_node to create a heap-allocated pointer
+                 * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
+                 * and the other node that was AND'ed with this node. This node becomes the left child. The other node becomes
+                 * the right child.
+                */
+                auto* AND (expression_tree_threshold_node<Obj>* other) {
+                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_threshold_node<Obj>>;
+                    ret* op_node = new ret(boolean_op::AND);
+                    op_node->set_left(this);
+                    op_node->set_right(other);
+                    return op_node;
+                }
+
+                /**
+                 * Performs an OR operation with an expression_tree_threshold_node to create a heap-allocated pointer
+                 * to a new expression_tree_op_node. The returned expression_tree_op_node becomes the parent of both this node
+                 * and the other node that was OR'ed with this node. This node becomes the left child. The other node becomes
+                 * the right child.
+                */
+                auto* OR (expression_tree_threshold_node<Obj>* other) {
+                    using ret = expression_tree_op_node<Obj, this_type, expression_tree_threshold_node<Obj>>;
+                    ret* op_node = new ret(boolean_op::OR);
+                    op_node->set_left(this);
+                    op_node->set_right(other);
+                    return op_node;
+                }
+
+            private:
+                Accessor accessor_;
+                CompValue comp_value_;
+
+                void check_accessor() const {
+                    if(!accessor_) {
+                        throw std::runtime_error("expression_tree_leaf_node has a nullptr member reference. A member function "
+                            "reference or member variable reference is required");
+                    }
+                }
+
+            protected:
+                this_type* clone_impl() const override { 
+                    return new this_type(*this); 
+                }
+        };
+
+        /**
+         * @brief An op node whose children may be any kind of expression tree node. Used when trees are assembled at 
+         *        runtime, where the static types of the child nodes are not known.
+        */
+        template<typename Obj>
+        using expression_tree_dynamic_op_node = expression_tree_op_node<Obj, expression_tree_node<Obj>, expression_tree_node<Obj>>;
+
+    }
+
+    template<class T> struct type_id{using type = T;}; 
+
+    /**
+     * Makes an expression tree leaf node for comparing pointer-type member variables of a class/struct
+    */
+    template<typename Obj, typename CompValue, typename Op = typename type_id<bool (*)(CompValue*, CompValue*)>::type,
+        typename std::enable_if<std::is_convertible<CompValue, CompValue*>::value, int>::type = 0>
+    auto* make_expr( CompValue Obj::* member_var, Op op, CompValue comp_value ) {
+        using stored = detail::stored_op<Op>;
+        return new node::expression_tree_leaf_node<Obj, typename stored::type, CompValue, const CompValue Obj::*>( 
+            member_var, stored::get(std::move(op)), comp_value );
+    }
+
+    /**
+     * Makes an expression tree leaf node for comparing value-type member variables of a class/struct
+    */
+    template<typename Obj, typename CompValue, typename Op = typename type_id<bool (*)(CompValue, CompValue)>::type>
+    auto* make_expr( const CompValue Obj::* member_var, Op op, const typename type_id<CompValue>::type& comp_value ) {
+        using stored = detail::stored_op<Op>;
+        return new node::expression_tree_leaf_node<Obj, typename stored::type, CompValue, const CompValue Obj::*>( 
+            member_var, stored::get(std::move(op)), comp_value );
+    }
+
+    /**
+     * Makes an expression tree leaf node for comparing value-type member variables of a class/struct. 
+     * The comparison value is moved into the leaf node.
     */
     template<typename Obj, typename CompValue, typename Op = typename type_id<bool (*)(CompValue, CompValue)>::type>
-    node::expression_tree_leaf_node<Obj, Op, CompValue>* make_expr( const CompValue Obj::* member_var, Op op, const CompValue comp_value ) {
-        return new node::expression_tree_leaf_node<Obj, Op, CompValue>( member_var, op, comp_value );
+    auto* make_expr( const CompValue Obj::* member_var, Op op, typename type_id<CompValue>::type&& comp_value ) {
+        using stored = detail::stored_op<Op>;
+        return new node::expression_tree_leaf_node<Obj, typename stored::type, CompValue, const CompValue Obj::*>( 
+            member_var, stored::get(std::move(op)), std::move(comp_value) );
     }
 
     /**
      * Makes an expression tree leaf node for comparing the return value from a class/struct's const member function
     */
     template<typename Obj, typename CompValue, typename Op = typename type_id<bool (*)(CompValue, CompValue)>::type>
-    node::expression_tree_leaf_node<Obj, Op, CompValue>* make_expr( CompValue (Obj::* member_func)() const, Op op, const CompValue comp_value ) {
-        return new node::expression_tree_leaf_node<Obj, Op, CompValue>( member_func, op, comp_value );
+    auto* make_expr( CompValue (Obj::* member_func)() const, Op op, const typename type_id<CompValue>::type& comp_value ) {
+        using stored = detail::stored_op<Op>;
+        return new node::expression_tree_leaf_node<Obj, typename stored::type, CompValue, CompValue (Obj::*)() const>( 
+            member_func, stored::get(std::move(op)), comp_value );
+    }
+
+    /**
+     * Makes an expression tree leaf node for comparing the return value from a class/struct's const member function. 
+     * The comparison value is moved into the leaf node.
+    */
+    template<typename Obj, typename CompValue, typename Op = typename type_id<bool (*)(CompValue, CompValue)>::type>
+    auto* make_expr( CompValue (Obj::* member_func)() const, Op op, typename type_id<CompValue>::type&& comp_value ) {
+        using stored = detail::stored_op<Op>;
+        return new node::expression_tree_leaf_node<Obj, typename stored::type, CompValue, CompValue (Obj::*)() const>( 
+            member_func, stored::get(std::move(op)), std::move(comp_value) );
+    }
+
+    /**
+     * Makes an expression tree leaf node for comparing std::string member variables of a class/struct with a string_ref, 
+     * without copying the string. The characters of the comparison value must outlive the leaf node. To store a copy of 
+     * the comparison value in the leaf node, pass a std::string instead.
+    */
+    template<typename Obj, typename Op>
+    auto* make_expr( const std::string Obj::* member_var, Op op, string_ref comp_value ) {
+        using stored = detail::stored_op<Op>;
+        return new node::expression_tree_leaf_node<Obj, typename stored::type, string_ref, const std::string Obj::*>( 
+            member_var, stored::get(std::move(op)), comp_value );
+    }
+
+    /**
+     * Makes an expression tree leaf node for comparing std::string member variables of a class/struct with a C string, 
+     * such as a string literal, without copying the string. The characters of the comparison value must outlive the leaf node.
+    */
+    template<typename Obj, typename Op>
+    auto* make_expr( const std::string Obj::* member_var, Op op, const char* comp_value ) {
+        return make_expr(member_var, std::move(op), string_ref(comp_value));
+    }
+
+    /**
+     * Makes an expression tree leaf node for comparing the std::string returned from a class/struct's const member function 
+     * with a string_ref, without copying the string. The characters of the comparison value must outlive the leaf node.
+    */
+    template<typename Obj, typename CompValue, typename Op,
+        typename std::enable_if<std::is_same<typename std::decay<CompValue>::type, std::string>::value, int>::type = 0>
+    auto* make_expr( CompValue (Obj::* member_func)() const, Op op, string_ref comp_value ) {
+        using stored = detail::stored_op<Op>;
+        return new node::expression_tree_leaf_node<Obj, typename stored::type, string_ref, CompValue (Obj::*)() const>( 
+            member_func, stored::get(std::move(op)), comp_value );
+    }
+
+    /**
+     * Makes an expression tree leaf node for comparing the std::string returned from a class/struct's const member function 
+     * with a C string, such as a string literal, without copying the string. The characters of the comparison value must 
+     * outlive the leaf node.
+    */
+    template<typename Obj, typename CompValue, typename Op,
+        typename std::enable_if<std::is_same<typename std::decay<CompValue>::type, std::string>::value, int>::type = 0>
+    auto* make_expr( CompValue (Obj::* member_func)() const, Op op, const char* comp_value ) {
+        return make_expr(member_func, std::move(op), string_ref(comp_value));
+    }
+
+    /**
+     * Makes an expression tree leaf node for comparing char* member variables of a class/struct as null-terminated C strings.
+     * Unlike comparisons with a char* comparison value, which only compare the first characters, every character is compared.
+     * The characters of the comparison value must outlive the leaf node.
+    */
+    template<typename Obj, typename Char, typename Op,
+        typename std::enable_if<std::is_same<typename std::remove_const<Char>::type, char>::value, int>::type = 0>
+    auto* make_expr( Char* const Obj::* member_var, Op op, string_ref comp_value ) {
+        using stored = detail::stored_op<Op>;
+        return new node::expression_tree_leaf_node<Obj, typename stored::type, string_ref, Char* const Obj::*>( 
+            member_var, stored::get(std::move(op)), comp_value );
+    }
+
+    /**
+     * Makes an expression tree threshold node that is true if at least k of the given heap-allocated nodes are true.
+     * The threshold node takes ownership of the given nodes.
+    */
+    template<typename Obj, typename... Children>
+    auto* make_threshold( std::size_t k, node::expression_tree_node<Obj>* first, Children*... rest ) {
+        return new node::expression_tree_threshold_node<Obj>( 
+            k, std::vector<node::expression_tree_node<Obj>*> { first, rest... } );
+    }
+
+    /**
+     * Makes an expression tree threshold node that is true if at least k of the given heap-allocated nodes are true.
+     * The threshold node takes ownership of the given nodes.
+    */
+    template<typename Obj>
+    auto* make_threshold( std::size_t k, std::vector<node::expression_tree_node<Obj>*> children ) {
+        return new node::expression_tree_threshold_node<Obj>( k, std::move(children) );
+    }
+
+    /**
+     * Makes an expression tree threshold node that is true if the sum of the weights of the given heap-allocated nodes 
+     * that are true is at least threshold. The threshold node takes ownership of the given nodes.
+    */
+    template<typename Obj>
+    auto* make_threshold( double threshold, std::vector<node::expression_tree_node<Obj>*> children, std::vector<double> weights ) {
+        return new node::expression_tree_threshold_node<Obj>( threshold, std::move(children), std::move(weights) );
+    }
+
+    namespace detail {
+
+    constexpr std::int32_t branch_accept = -1;
+    constexpr std::int32_t branch_reject = -2;
+
+    /**
+     * A single test of a branching program. If the test node evaluates to true, evaluation continues at on_true,
+     * otherwise it continues at on_false. Targets are indices of later branches, or branch_accept / branch_reject.
+    */
+    template<typename Obj>
+    struct branch {
+        const node::expression_tree_node<Obj>* test;
+        std::int32_t on_true;
+        std::int32_t on_false;
+    };
+
+    /**
+     * An expression tree flattened into a sequence of tests with short-circuit jump targets. The tests appear in
+     * the same left to right order as the leaves of the tree, and every jump moves forward, so evaluating a branching
+     * program is a single loop that needs no stack, regardless of the depth of the tree it was compiled from.
+    */
+    template<typename Obj>
+    struct branching_program {
+        std::vector<branch<Obj>> branches;
+        std::int32_t entry = branch_reject;
+
+        bool evaluate(const Obj& obj) const {
+            std::int32_t pc = entry;
+            while(pc >= 0) {
+                const branch<Obj>& b = branches[pc];
+                pc = b.test->evaluate(obj) ? b.on_true : b.on_false;
+            }
+            return pc == branch_accept;
+        }
+
+        /**
+         * Evaluates the program using the given function to evaluate each test node, instead of the node itself.
+        */
+        template<typename Test>
+        bool evaluate(const Obj& obj, Test test) const {
+            std::int32_t pc = entry;
+            while(pc >= 0) {
+                const branch<Obj>& b = branches[pc];
+                pc = test(*b.test, obj) ? b.on_true : b.on_false;
+            }
+            return pc == branch_accept;
+        }
+    };
+
+    /**
+     * Compiles the tree under the given root into a branching program. Op nodes are compiled into jump targets,
+     * constant nodes are folded into the jumps that lead to them, and every other node becomes a test. An op node with
+     * a missing child also becomes a test, so that evaluating it throws just as evaluating the tree recursively would. The returned
+     * program refers to the nodes of the given tree, which must outlive it.
+     * 
+     * An op node for which is_test returns true is also compiled into a single test, instead of being compiled into jumps.
+    */
+    template<typename Obj, typename IsTest>
+    branching_program<Obj> compile_branches(const node::expression_tree_node<Obj>& root, IsTest is_test) {
+        struct frame {
+            const node::expression_tree_node<Obj>* n;
+            std::int32_t on_true;
+            std::int32_t on_false;
+            int stage;
+        };
+
+        // branches are emitted right to left, so that the entry point of a right subtree is known before its
+        // left sibling is compiled. The order is reversed once compilation is complete.
+        branching_program<Obj> program;
+        std::vector<frame> pending { frame { &root, branch_accept, branch_reject, 0 } };
+        std::int32_t last_entry = branch_reject;
+
+        while(!pending.empty()) {
+            frame current = pending.back();
+
+            auto* op_node = dynamic_cast<const node::expression_tree_op_node_base<Obj>*>(current.n);
+            if(op_node && op_node->get_left() && op_node->get_right() && !is_test(*op_node)) {
+                if(current.stage == 0) {
+                    pending.back().stage = 1;
+                    pending.push_back(frame { op_node->get_right(), current.on_true, current.on_false, 0 });
+                } else if(current.stage == 1) {
+                    pending.back().stage = 2;
+                    if(op_node->get_bool_op() == node::boolean_op::AND) {
+                        pending.push_back(frame { op_node->get_left(), last_entry, current.on_false, 0 });
+                    } else {
+                        pending.push_back(frame { op_node->get_left(), current.on_true, last_entry, 0 });
+                    }
+                } else {
+                    // the entry point of this op node is the entry point of its left child
+                    pending.pop_back();
+                }
+                continue;
+            }
+
+            pending.pop_back();
+            if(auto* constant = dynamic_cast<const node::expression_tree_constant_node<Obj>*>(current.n)) {
+                last_entry = constant->get_value() ? current.on_true : current.on_false;
+            } else {
+                last_entry = static_cast<std::int32_t>(program.branches.size());
+                program.branches.push_back(branch<Obj> { current.n, current.on_true, current.on_false });
+            }
+        }
+
+        const std::int32_t last = static_cast<std::int32_t>(program.branches.size()) - 1;
+        auto flip = [last](std::int32_t target) {
+            return target < 0 ? target : last - target;
+        };
+
+        std::vector<branch<Obj>> ordered(program.branches.rbegin(), program.branches.rend());
+        for(auto& b : ordered) {
+            b.on_true = flip(b.on_true);
+            b.on_false = flip(b.on_false);
+        }
+        program.branches.swap(ordered);
+        program.entry = flip(last_entry);
+        return program;
+    }
+
+    template<typename Obj>
+    branching_program<Obj> compile_branches(const node::expression_tree_node<Obj>& root) {
+        return compile_branches(root, [](const node::expression_tree_op_node_base<Obj>&) { return false; });
+    }
+
+    /**
+     * The branching programs of the children of a program's threshold nodes (including threshold nodes nested in those 
+     * children), compiled once so that evaluating the children with a custom test, as evaluate_partial does, does not 
+     * compile them (and allocate) for every object. The programs refer to the nodes of the tree, which must outlive them.
+    */
+    template<typename Obj>
+    class threshold_programs {
+        public:
+            threshold_programs() = default;
+
+            explicit threshold_programs(const branching_program<Obj>& program) {
+                std::vector<const node::expression_tree_node<Obj>*> tests;
+                for(auto& b : program.branches) {
+                    tests.push_back(b.test);
+                }
+
+                while(!tests.empty()) {
+                    auto* threshold = dynamic_cast<const node::expression_tree_threshold_node<Obj>*>(tests.back());
+                    tests.pop_back();
+                    if(!threshold) {
+                        continue;
+                    }
+
+                    for(std::size_t i = 0; i < threshold->child_count(); ++i) {
+                        const node::expression_tree_node<Obj>* child = threshold->get_child(i);
+                        auto inserted = programs_.emplace(child, compile_branches(*child));
+                        if(inserted.second) {
+                            for(auto& b : inserted.first->second.branches) {
+                                tests.push_back(b.test);
+                            }
+                        }
+                    }
+                }
+            }
+
+            /**
+             * Returns the program of the given child of a threshold node.
+             *
+             * @throws std::logic_error if the node is not the child of a threshold node of the program
+            */
+            const branching_program<Obj>& of(const node::expression_tree_node<Obj>& child) const {
+                auto it = programs_.find(&child);
+                if(it == programs_.end()) {
+                    throw std::logic_error("threshold node child was not compiled");
+                }
+                return it->second;
+            }
+
+        private:
+            std::unordered_map<const node::expression_tree_node<Obj>*, branching_program<Obj>> programs_;
+    };
+
+    /**
+     * The test used by expression_tree::evaluate_partial. Leaf nodes that read a member which is not in known_fields 
+     * evaluate to unknown_value. The children of threshold nodes are evaluated using the same test.
+    */
+    template<typename Obj>
+    struct assume_unknown {
+        const std::vector<accessor_id>& known_fields;
+        const threshold_programs<Obj>& thresholds;
+        bool unknown_value;
+
+        bool operator()(const node::expression_tree_node<Obj>& test, const Obj& obj) const {
+            if(auto* threshold = dynamic_cast<const node::expression_tree_threshold_node<Obj>*>(&test)) {
+                return threshold->evaluate(obj, [this](const node::expression_tree_node<Obj>& child, const Obj& o) {
+                    return thresholds.of(child).evaluate(o, *this);
+                });
+            }
+
+            auto* leaf = dynamic_cast<const node::expression_tree_leaf_node_base<Obj>*>(&test);
+            if(!leaf || std::find(known_fields.begin(), known_fields.end(), leaf->get_accessor()) == known_fields.end()) {
+                return unknown_value;
+            }
+            return test.evaluate(obj);
+        }
+    };
+
+    /**
+     * Returns the given node as a leaf node if it can be merged with equivalent leaf nodes, i.e. if it compares using a
+     * built-in operator and an ordered comparison value (not NaN). Otherwise, returns nullptr.
+    */
+    template<typename Obj>
+    const node::expression_tree_leaf_node_base<Obj>* as_mergeable_leaf(const node::expression_tree_node<Obj>* n) {
+        auto* leaf = dynamic_cast<const node::expression_tree_leaf_node_base<Obj>*>(n);
+        if(!leaf || leaf->get_comparator() == comparator::custom || !leaf->is_comp_value_ordered()) {
+            return nullptr;
+        }
+        return leaf;
     }
 
+    /**
+     * Orders mergeable leaf nodes. Two mergeable leaf nodes are equivalent if they read the same accessor using the same
+     * operator, and have equivalent comparison values of the same type.
+    */
+    template<typename Obj>
+    struct mergeable_leaf_less {
+        bool operator()(const node::expression_tree_leaf_node_base<Obj>* a, const node::expression_tree_leaf_node_base<Obj>* b) const {
+            if(a->get_accessor() != b->get_accessor()) return a->get_accessor() < b->get_accessor();
+            if(a->get_comparator() != b->get_comparator()) return a->get_comparator() < b->get_comparator();
+            if(a->comp_value_type() != b->comp_value_type()) return a->comp_value_type().before(b->comp_value_type());
+            return a->compare_comp_value(*b) < 0;
+        }
+    };
+
+    }
+
+    /**
+     * @brief The set of member variables and const member functions that the leaf nodes of an expression tree read. 
+     *        Created by expression_tree::accessed_members.
+     * 
+     *        A member variable can be skipped (e.g. left undecoded) when no leaf node reads it. Since the members read by a 
+     *        const member function cannot be known, no member variable can be skipped if any leaf node calls a const member
+     *        function, or if the tree contains a node that is neither a leaf node, an op node, nor a constant node.
+    */
+    class member_access {
+        public:
+            /**
+             * @brief The distinct accessors referenced by the tree's leaf nodes, in ascending order.
+            */
+            const std::vector<accessor_id>& accessors() const {
+                return accessors_;
+            }
+
+            /**
+             * @brief True if at least one leaf node reads the given member variable or calls the given const member function.
+            */
+            bool reads(const accessor_id& accessor) const {
+                return std::binary_search(accessors_.begin(), accessors_.end(), accessor);
+            }
+
+            template<typename Member>
+            bool reads(Member member) const {
+                return reads(accessor_of(member));
+            }
+
+            /**
+             * @brief True if at least one leaf node calls a const member function.
+            */
+            bool calls_member_functions() const {
+                return calls_member_functions_;
+            }
+
+            /**
+             * @brief True if the tree contains nodes whose accessed members cannot be inspected, i.e. user-defined node types.
+            */
+            bool has_opaque_nodes() const {
+                return has_opaque_nodes_;
+            }
+
+            /**
+             * @brief True if evaluating the tree never reads the given member variable, so that it need not be populated
+             *        before evaluation.
+            */
+            bool can_skip(const accessor_id& accessor) const {
+                return !calls_member_functions_ && !has_opaque_nodes_ && !reads(accessor);
+            }
+
+            template<typename Member>
+            bool can_skip(Member member) const {
+                return can_skip(accessor_of(member));
+            }
+
+        private:
+            template<typename Obj>
+            friend class expression_tree;
+
+            std::vector<accessor_id> accessors_;
+            bool calls_member_functions_ = false;
+            bool has_opaque_nodes_ = false;
+    };
+
+    /**
+     * @brief The result of evaluating an object whose members are only partially known. See expression_tree::evaluate_partial.
+    */
+    enum class partial_result {
+        false_value,
+        true_value,
+        unknown
+    };
+
+    template<typename Obj, typename Iterator, typename Enable = void>
+    class filter_range;
+
     template<typename Obj>
     class expression_tree { 
         public:
@@ -406,8 +1756,8 @@ namespace expression_tree {
                 if(!expr) {
                     throw std::runtime_error("Attempted to construct an expression_tree using a null expression");
                 }
-                expr_ = expr->clone().release();
-                delete expr;
+                expr_ = expr;
+                compile();
             }
 
             expression_tree(std::unique_ptr<node::expression_tree_node<Obj>> expr)
@@ -419,9 +1769,12 @@ namespace expression_tree {
                         std::string("from an expression_tree with a null expression"));
                 }
                 expr_ = other.expr_->clone().release();
+                compile();
             }
 
-            expression_tree(expression_tree&& other) noexcept {
+            expression_tree(expression_tree&& other) noexcept 
+                    : program_(std::move(other.program_)),
+                      thresholds_(std::move(other.thresholds_)) {
                 expr_ = other.expr_;
                 other.expr_ = nullptr;
             }
@@ -431,8 +1784,11 @@ namespace expression_tree {
                     delete expr_;
                     if(other.expr_) {
                         expr_ = other.expr_->clone().release();
+                        compile();
                     } else {
                         expr_ = nullptr;
+                        program_ = detail::branching_program<Obj>();
+                        thresholds_ = detail::threshold_programs<Obj>();
                     }
                 }
                 return *this;
@@ -442,6 +1798,8 @@ namespace expression_tree {
                 if(this != &other) {
                     delete expr_;
                     expr_ = other.expr_;
+                    program_ = std::move(other.program_);
+                    thresholds_ = std::move(other.thresholds_);
                     other.expr_ = nullptr;
                 }
                 return *this;
@@ -453,6 +1811,13 @@ namespace expression_tree {
 
             /**
              * @brief Evaluates the given object to determine if it satisfies the expressions defined in this expression tree.
+             *        Evaluation walks a flattened copy of the tree's structure in a loop, so it uses a constant amount of stack 
+             *        space regardless of the depth of the tree.
+             * 
+             *        Evaluation does not allocate memory when the tree's leaf nodes use the built-in logical operators (or 
+             *        user-defined operators that take their arguments by reference) and read member variables. Member variables 
+             *        are compared in place without being copied. Const member functions that return a value which allocates 
+             *        (e.g. a std::string) may allocate when they are called.
              * 
              * @returns True if the given object satisfied the expression tree conditions;
              *          False if the given object did not satisfy the expression tree conditions. 
@@ -463,14 +1828,453 @@ namespace expression_tree {
                 }
 
                 try {
-                    return expr_->evaluate(obj);
+                    return program_.evaluate(obj);
                 } catch(std::exception& e) {
                     return false;
                 }
             }
 
+            /**
+             * @brief Evaluates an object of which only some members are known (e.g. decoded), using Kleene's three-valued logic.
+             *        Leaf nodes that read a member (or call a const member function) that is not in known_fields evaluate to
+             *        unknown. An AND op node is false if either of its children is false, and an OR op node is true if either
+             *        of its children is true. Otherwise, an op node with an unknown child is unknown. A threshold node is known 
+             *        if its known children decide it whatever the values of its unknown children.
+             * 
+             * @returns partial_result::true_value or partial_result::false_value if the result of evaluate does not depend on 
+             *          the unknown members; partial_result::unknown otherwise
+            */
+            partial_result evaluate_partial(const Obj& obj, const std::vector<accessor_id>& known_fields) const {
+                if(!expr_) {
+                    throw std::runtime_error("expression_tree has a null root expression node");
+                }
+
+                // since op nodes and threshold nodes are monotonic, the tree is definitely true if it is true when every 
+                // unknown leaf is false, and definitely false if it is false when every unknown leaf is true
+                try {
+                    if(program_.evaluate(obj, detail::assume_unknown<Obj> { known_fields, thresholds_, false })) {
+                        return partial_result::true_value;
+                    }
+                    if(!program_.evaluate(obj, detail::assume_unknown<Obj> { known_fields, thresholds_, true })) {
+                        return partial_result::false_value;
+                    }
+                    return partial_result::unknown;
+                } catch(std::exception& e) {
+                    return partial_result::false_value;
+                }
+            }
+
+            /**
+             * @brief Evaluates a batch of objects.
+             * 
+             * @param objs    An array of count pointers to the objects to evaluate
+             * @param results An array of count bools. Each result is set to the outcome of evaluating the object at the same index
+            */
+            void evaluate_batch(const Obj* const* objs, std::size_t count, bool* results) const {
+                if(!expr_) {
+                    throw std::runtime_error("expression_tree has a null root expression node");
+                }
+
+                for(std::size_t i = 0; i < count; ++i) {
+                    try {
+                        results[i] = program_.evaluate(*objs[i]);
+                    } catch(std::exception& e) {
+                        results[i] = false;
+                    }
+                }
+            }
+
+            /**
+             * @brief Returns a lazy range over the elements of the given range that satisfy this expression tree. Elements are
+             *        evaluated in chunks using evaluate_batch as the returned range is iterated, and matching elements are 
+             *        yielded by reference. This expression tree and the given range must outlive the returned range.
+             * 
+             *        If the given range only provides single-pass input iterators (e.g. std::istream_iterator), each chunk of 
+             *        elements is copied into a buffer owned by the returned range, and matching elements are yielded by reference 
+             *        into that buffer.
+            */
+            template<typename Range>
+            auto filter(Range& range) const -> filter_range<Obj, decltype(std::begin(range))> {
+                return filter(std::begin(range), std::end(range));
+            }
+
+            /**
+             * @brief Returns a lazy range over the elements in [first, last) that satisfy this expression tree.
+            */
+            template<typename Iterator>
+            filter_range<Obj, Iterator> filter(Iterator first, Iterator last) const {
+                return filter_range<Obj, Iterator>(*this, first, last);
+            }
+
+            /**
+             * @brief Reports the member variables and const member functions referenced by this tree's leaf nodes, and whether
+             *        a given member variable can be skipped when populating objects before they are evaluated.
+            */
+            member_access accessed_members() const {
+                if(!expr_) {
+                    throw std::runtime_error("expression_tree has a null root expression node");
+                }
+
+                member_access access;
+                std::vector<const node::expression_tree_node<Obj>*> tests;
+                for(auto& b : program_.branches) {
+                    tests.push_back(b.test);
+                }
+
+                while(!tests.empty()) {
+                    const node::expression_tree_node<Obj>* test = tests.back();
+                    tests.pop_back();
+
+                    // the children of threshold nodes are compiled in turn, so that their leaves are reported
+                    if(auto* threshold = dynamic_cast<const node::expression_tree_threshold_node<Obj>*>(test)) {
+                        for(std::size_t i = 0; i < threshold->child_count(); ++i) {
+                            for(auto& b : detail::compile_branches(*threshold->get_child(i)).branches) {
+                                tests.push_back(b.test);
+                            }
+                        }
+                        continue;
+                    }
+
+                    auto* leaf = dynamic_cast<const node::expression_tree_leaf_node_base<Obj>*>(test);
+                    if(!leaf) {
+                        access.has_opaque_nodes_ = true;
+                        continue;
+                    }
+
+                    const accessor_id accessor = leaf->get_accessor();
+                    if(accessor.get_kind() == accessor_id::kind::member_function) {
+                        access.calls_member_functions_ = true;
+                    }
+                    access.accessors_.push_back(accessor);
+                }
+
+                std::sort(access.accessors_.begin(), access.accessors_.end());
+                access.accessors_.erase(std::unique(access.accessors_.begin(), access.accessors_.end()), access.accessors_.end());
+                return access;
+            }
+
+            /**
+             * @brief Returns the root node of this expression tree, for inspecting the tree's structure.
+            */
+            const node::expression_tree_node<Obj>& root() const {
+                if(!expr_) {
+                    throw std::runtime_error("expression_tree has a null root expression node");
+                }
+                return *expr_;
+            }
+
         private:
             node::expression_tree_node<Obj>* expr_ = nullptr;
+
+            // refer to the nodes owned by expr_, so they are recompiled whenever expr_ is replaced by a copy
+            detail::branching_program<Obj> program_;
+            detail::threshold_programs<Obj> thresholds_;
+
+            void compile() {
+                try {
+                    program_ = detail::compile_branches(*expr_);
+                    thresholds_ = detail::threshold_programs<Obj>(program_);
+                } catch(...) {
+                    delete expr_;
+                    expr_ = nullptr;
+                    throw;
+                }
+            }
     };
+
+    namespace detail {
+
+        constexpr std::size_t filter_chunk_size = 64;
+
+        inline unsigned count_trailing_zeros(std::uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+            return static_cast<unsigned>(__builtin_ctzll(bits));
+#else
+            unsigned count = 0;
+            while(!(bits & 1)) {
+                bits >>= 1;
+                ++count;
+            }
+            return count;
+#endif
+        }
+
+        template<typename Iterator>
+        using is_forward_iterator = std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<Iterator>::iterator_category>;
+    }
+
+    /**
+     * @brief A lazy range over the elements of an underlying multi-pass range that satisfy an expression tree. 
+     *        Created by expression_tree::filter.
+     * 
+     *        Each iterator evaluates the elements ahead of it in chunks of up to 64, and remembers which elements of the 
+     *        current chunk matched in a bit mask. Copies of an iterator advance independently of each other.
+    */
+    template<typename Obj, typename Iterator>
+    class filter_range<Obj, Iterator, typename std::enable_if<detail::is_forward_iterator<Iterator>::value>::type> {
+        public:
+            class iterator {
+                public:
+                    using iterator_category = std::forward_iterator_tag;
+                    using value_type = typename std::iterator_traits<Iterator>::value_type;
+                    using difference_type = typename std::iterator_traits<Iterator>::difference_type;
+                    using reference = typename std::iterator_traits<Iterator>::reference;
+                    using pointer = typename std::iterator_traits<Iterator>::pointer;
+
+                    iterator() = default;
+
+                    reference operator*() const {
+                        return *pos_;
+                    }
+
+                    pointer operator->() const {
+                        return &*pos_;
+                    }
+
+                    iterator& operator++() {
+                        if(matches_) {
+                            // jump to the next match within the current chunk
+                            const unsigned distance = detail::count_trailing_zeros(matches_) + 1;
+                            std::advance(pos_, distance);
+                            matches_ = distance >= 64 ? 0 : matches_ >> distance;
+                            chunk_remaining_ -= distance;
+                        } else {
+                            std::advance(pos_, chunk_remaining_ + 1);
+                            load_chunk();
+                        }
+                        return *this;
+                    }
+
+                    iterator operator++(int) {
+                        iterator copy = *this;
+                        ++*this;
+                        return copy;
+                    }
+
+                    bool operator==(const iterator& other) const {
+                        return pos_ == other.pos_;
+                    }
+
+                    bool operator!=(const iterator& other) const {
+                        return pos_ != other.pos_;
+                    }
+
+                private:
+                    friend class filter_range;
+
+                    const expression_tree<Obj>* tree_ = nullptr;
+                    Iterator pos_ {};
+                    Iterator end_ {};
+
+                    // bit i is set if the element i + 1 places after pos_ matched
+                    std::uint64_t matches_ = 0;
+
+                    // the number of evaluated elements after pos_
+                    std::size_t chunk_remaining_ = 0;
+
+                    iterator(const expression_tree<Obj>* tree, Iterator pos, Iterator end)
+                        : tree_(tree),
+                          pos_(pos),
+                          end_(end) {}
+
+                    /**
+                     * Evaluates chunks starting at pos_ until a match is found, and moves pos_ to the first match (or to the end).
+                    */
+                    void load_chunk() {
+                        const Obj* objs[detail::filter_chunk_size];
+                        bool results[detail::filter_chunk_size];
+
+                        while(pos_ != end_) {
+                            std::size_t count = 0;
+                            Iterator next = pos_;
+                            for(; count < detail::filter_chunk_size && next != end_; ++next, ++count) {
+                                objs[count] = &*next;
+                            }
+
+                            tree_->evaluate_batch(objs, count, results);
+
+                            std::uint64_t bits = 0;
+                            for(std::size_t i = 0; i < count; ++i) {
+                                bits |= static_cast<std::uint64_t>(results[i]) << i;
+                            }
+
+                            if(bits) {
+                                const unsigned first = detail::count_trailing_zeros(bits);
+                                std::advance(pos_, first);
+                                matches_ = first + 1 >= 64 ? 0 : bits >> (first + 1);
+                                chunk_remaining_ = count - first - 1;
+                                return;
+                            }
+                            pos_ = next;
+                        }
+
+                        matches_ = 0;
+                        chunk_remaining_ = 0;
+                    }
+            };
+
+            filter_range(const expression_tree<Obj>& tree, Iterator first, Iterator last)
+                : tree_(&tree),
+                  first_(first),
+                  last_(last) {}
+
+            iterator begin() const {
+                iterator it(tree_, first_, last_);
+                it.load_chunk();
+                return it;
+            }
+
+            iterator end() const {
+                return iterator(tree_, last_, last_);
+            }
+
+        private:
+            const expression_tree<Obj>* tree_;
+            Iterator first_;
+            Iterator last_;
+    };
+
+    /**
+     * @brief A lazy range over the elements of an underlying single-pass input range that satisfy an expression tree. 
+     *        Created by expression_tree::filter. The range can only be iterated once.
+     * 
+     *        Elements are read from the underlying range into a buffer in chunks of up to 64, and the chunk is evaluated in a 
+     *        single batch. Iterators refer to elements in the buffer, which is replaced when the next chunk is read.
+    */
+    template<typename Obj, typename Iterator>
+    class filter_range<Obj, Iterator, typename std::enable_if<!detail::is_forward_iterator<Iterator>::value>::type> {
+        public:
+            using value_type = typename std::iterator_traits<Iterator>::value_type;
+
+            class iterator {
+                public:
+                    using iterator_category = std::input_iterator_tag;
+                    using value_type = typename filter_range::value_type;
+                    using difference_type = std::ptrdiff_t;
+                    using reference = const value_type&;
+                    using pointer = const value_type*;
+
+                    iterator() = default;
+
+                    reference operator*() const {
+                        return range_->buffer_[range_->index_];
+                    }
+
+                    pointer operator->() const {
+                        return &range_->buffer_[range_->index_];
+                    }
+
+                    iterator& operator++() {
+                        range_->advance();
+                        return *this;
+                    }
+
+                    void operator++(int) {
+                        ++*this;
+                    }
+
+                    bool operator==(const iterator& other) const {
+                        return at_end() == other.at_end();
+                    }
+
+                    bool operator!=(const iterator& other) const {
+                        return !(*this == other);
+                    }
+
+                private:
+                    friend class filter_range;
+
+                    filter_range* range_ = nullptr;
+
+                    explicit iterator(filter_range* range)
+                        : range_(range) {}
+
+                    bool at_end() const {
+                        return !range_ || range_->done_;
+                    }
+            };
+
+            filter_range(const expression_tree<Obj>& tree, Iterator first, Iterator last)
+                : tree_(&tree),
+                  first_(first),
+                  last_(last) {}
+
+            iterator begin() {
+                if(!started_) {
+                    started_ = true;
+                    buffer_.reserve(detail::filter_chunk_size);
+                    index_ = 0;
+                    find_match();
+                }
+                return iterator(this);
+            }
+
+            iterator end() {
+                return iterator();
+            }
+
+        private:
+            const expression_tree<Obj>* tree_;
+            Iterator first_;
+            Iterator last_;
+
+            std::vector<value_type> buffer_;
+            bool results_[detail::filter_chunk_size];
+            std::size_t index_ = 0;
+            bool started_ = false;
+            bool done_ = false;
+
+            void advance() {
+                ++index_;
+                find_match();
+            }
+
+            /**
+             * Moves index_ to the next matching element of the buffer, reading and evaluating more chunks as necessary.
+            */
+            void find_match() {
+                while(true) {
+                    for(; index_ < buffer_.size(); ++index_) {
+                        if(results_[index_]) return;
+                    }
+
+                    if(first_ == last_) {
+                        done_ = true;
+                        return;
+                    }
+
+                    buffer_.clear();
+                    for(; buffer_.size() < detail::filter_chunk_size && first_ != last_; ++first_) {
+                        buffer_.push_back(*first_);
+                    }
+
+                    const Obj* objs[detail::filter_chunk_size];
+                    for(std::size_t i = 0; i < buffer_.size(); ++i) {
+                        objs[i] = &buffer_[i];
+                    }
+                    tree_->evaluate_batch(objs, buffer_.size(), results_);
+                    index_ = 0;
+                }
+            }
+    };
+}
+}
+
+namespace std {
+
+    /**
+     * Hashes the characters of a string_ref, so that equal string comparison values of leaf nodes have equal structural hashes.
+    */
+    template<>
+    struct hash<attwoodn::expression_tree::string_ref> {
+        std::size_t operator()(const attwoodn::expression_tree::string_ref& value) const {
+            // 64-bit FNV-1a
+            std::uint64_t hash = 0xcbf29ce484222325ull;
+            for(std::size_t i = 0; i < value.size(); ++i) {
+                hash = (hash ^ static_cast<unsigned char>(value.data()[i])) * 0x100000001b3ull;
+            }
+            return static_cast<std::size_t>(hash);
+        }
+    };
+
 }
-}
\ No newline at end of file
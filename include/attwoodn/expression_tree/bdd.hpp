@@ -0,0 +1,430 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+namespace attwoodn {
+namespace expression_tree {
+
+    namespace detail {
+
+        /**
+         * Estimates the relative cost of evaluating a test node. Member variables compared using a built-in operator are
+         * cheapest. Calling a const member function, using a user-defined operator, or comparing strings each add to the
+         * cost. Nodes that are not leaf nodes are assumed to be the most expensive.
+        */
+        template<typename Obj>
+        double estimate_test_cost(const node::expression_tree_node<Obj>& n) {
+            auto* leaf = dynamic_cast<const node::expression_tree_leaf_node_base<Obj>*>(&n);
+            if(!leaf) {
+                return 8;
+            }
+
+            double cost = 1;
+            if(leaf->get_accessor().get_kind() == accessor_id::kind::member_function) cost += 3;
+            if(leaf->get_comparator() == comparator::custom) cost += 2;
+            if(leaf->comp_value_type() == typeid(std::string)) cost += 1;
+            return cost;
+        }
+
+        /**
+         * A decision node of a binary decision diagram. Evaluation continues at high if the node's variable is true, and at
+         * low otherwise. Targets are node indices, or branch_accept / branch_reject for the terminals.
+        */
+        struct bdd_node {
+            std::uint32_t var;
+            std::int32_t low;
+            std::int32_t high;
+        };
+
+        /**
+         * Thrown when building a diagram creates more nodes than its builder allows.
+        */
+        struct bdd_node_limit_exceeded {};
+
+        /**
+         * Builds a reduced ordered binary decision diagram. Variables are numbered in their order, so a node's variable is
+         * also its level. Equivalent nodes are shared using a unique table, and redundant nodes (whose low and high targets
+         * are the same) are never created.
+        */
+        class bdd_builder {
+            public:
+                /**
+                 * @param node_limit The number of nodes that may exist at once, including nodes that are no longer reachable
+                 *                   but have not yet been collected
+                */
+                explicit bdd_builder(std::size_t node_limit)
+                    : node_limit_(node_limit) {}
+
+                std::int32_t make(std::uint32_t var, std::int32_t low, std::int32_t high) {
+                    if(low == high) {
+                        return low;
+                    }
+
+                    const auto key = std::make_tuple(var, low, high);
+                    auto it = unique_.find(key);
+                    if(it != unique_.end()) {
+                        return it->second;
+                    }
+
+                    if(nodes_.size() >= node_limit_) {
+                        throw bdd_node_limit_exceeded();
+                    }
+                    const auto index = static_cast<std::int32_t>(nodes_.size());
+                    nodes_.push_back(bdd_node { var, low, high });
+                    unique_.emplace(key, index);
+                    return index;
+                }
+
+                /**
+                 * Combines two diagrams using the given boolean operation. Recurses at most once per variable.
+                */
+                std::int32_t apply(node::boolean_op op, std::int32_t f, std::int32_t g) {
+                    const std::int32_t absorbing = op == node::boolean_op::AND ? branch_reject : branch_accept;
+                    const std::int32_t identity = op == node::boolean_op::AND ? branch_accept : branch_reject;
+                    if(f == absorbing || g == absorbing) return absorbing;
+                    if(f == identity) return g;
+                    if(g == identity || f == g) return f;
+
+                    // both operations are commutative
+                    if(g < f) std::swap(f, g);
+                    const auto key = std::make_tuple(op == node::boolean_op::AND, f, g);
+                    auto it = computed_.find(key);
+                    if(it != computed_.end()) {
+                        return it->second;
+                    }
+
+                    const std::uint32_t var = std::min(nodes_[f].var, nodes_[g].var);
+                    const bdd_node f_node = nodes_[f];
+                    const bdd_node g_node = nodes_[g];
+                    const std::int32_t low = apply(op, f_node.var == var ? f_node.low : f, g_node.var == var ? g_node.low : g);
+                    const std::int32_t high = apply(op, f_node.var == var ? f_node.high : f, g_node.var == var ? g_node.high : g);
+
+                    const std::int32_t result = make(var, low, high);
+                    computed_.emplace(key, result);
+                    return result;
+                }
+
+                /**
+                 * Discards the nodes that cannot be reached from the given roots, and renumbers the remaining nodes. The
+                 * roots are updated to refer to the renumbered nodes. Children always precede their parents, in both the
+                 * original and the renumbered order.
+                */
+                void collect(std::vector<std::int32_t>& roots) {
+                    std::vector<bool> live(nodes_.size(), false);
+                    std::vector<std::int32_t> pending;
+                    for(auto root : roots) {
+                        if(root >= 0) pending.push_back(root);
+                    }
+                    while(!pending.empty()) {
+                        const std::int32_t n = pending.back();
+                        pending.pop_back();
+                        if(live[n]) continue;
+                        live[n] = true;
+                        if(nodes_[n].low >= 0) pending.push_back(nodes_[n].low);
+                        if(nodes_[n].high >= 0) pending.push_back(nodes_[n].high);
+                    }
+
+                    auto renumbered = [](const std::vector<std::int32_t>& index, std::int32_t n) {
+                        return n < 0 ? n : index[n];
+                    };
+
+                    std::vector<std::int32_t> index(nodes_.size(), -1);
+                    std::vector<bdd_node> kept;
+                    unique_.clear();
+                    for(std::size_t i = 0; i < nodes_.size(); ++i) {
+                        if(!live[i]) continue;
+                        const bdd_node n { nodes_[i].var, renumbered(index, nodes_[i].low), renumbered(index, nodes_[i].high) };
+                        index[i] = static_cast<std::int32_t>(kept.size());
+                        unique_.emplace(std::make_tuple(n.var, n.low, n.high), index[i]);
+                        kept.push_back(n);
+                    }
+
+                    nodes_.swap(kept);
+                    computed_.clear();
+                    for(auto& root : roots) {
+                        root = renumbered(index, root);
+                    }
+                }
+
+                std::vector<bdd_node>& nodes() {
+                    return nodes_;
+                }
+
+            private:
+                std::size_t node_limit_;
+                std::vector<bdd_node> nodes_;
+                std::map<std::tuple<std::uint32_t, std::int32_t, std::int32_t>, std::int32_t> unique_;
+                std::map<std::tuple<bool, std::int32_t, std::int32_t>, std::int32_t> computed_;
+        };
+    }
+
+    /**
+     * @brief An expression tree compiled into a reduced ordered binary decision diagram (ROBDD) over its distinct leaf nodes.
+     *
+     *        Leaf nodes that compare the same member using the same built-in operator and an equivalent comparison value
+     *        become a single variable of the diagram. Evaluation is a walk from the root of the diagram to a terminal, which
+     *        evaluates each variable at most once and skips every variable that cannot change the result, no matter how
+     *        often the variable appears in the tree.
+     *
+     *        Variables are ordered by their estimated cost, cheapest first, so that expensive tests are only evaluated once
+     *        the cheaper tests cannot decide the result. Variables of equal cost keep the order in which they first appear
+     *        in the tree. A custom cost function may be given instead.
+     *
+     *        Some expressions have no small diagram. If the diagram would have more than node_limit nodes, compilation is
+     *        abandoned and the regular expression tree is evaluated instead (see is_compiled).
+     *
+     *        Leaf nodes are assumed to have no side effects. If a leaf node throws an exception during the walk, the object is
+     *        evaluated again using the regular tree, so that the result matches expression_tree::evaluate even where the
+     *        diagram tests leaves that the tree would have short-circuited past.
+    */
+    template<typename Obj>
+    class bdd_expression_tree {
+        public:
+            static constexpr std::size_t default_node_limit = 4096;
+
+            bdd_expression_tree() = delete;
+
+            explicit bdd_expression_tree(const expression_tree<Obj>& tree, std::size_t node_limit = default_node_limit)
+                : tree_(tree) {
+                compile(detail::estimate_test_cost<Obj>, node_limit);
+            }
+
+            explicit bdd_expression_tree(expression_tree<Obj>&& tree, std::size_t node_limit = default_node_limit)
+                : tree_(std::move(tree)) {
+                compile(detail::estimate_test_cost<Obj>, node_limit);
+            }
+
+            /**
+             * @brief Compiles the given tree, ordering variables by the given cost function. The cost function is called
+             *        with a test node of the tree, and returns a double. Lower cost variables are tested first.
+            */
+            template<typename Cost, typename = typename std::enable_if<!std::is_arithmetic<Cost>::value>::type>
+            bdd_expression_tree(const expression_tree<Obj>& tree, Cost cost, std::size_t node_limit = default_node_limit)
+                : tree_(tree) {
+                compile(cost, node_limit);
+            }
+
+            bdd_expression_tree(const bdd_expression_tree& other)
+                : tree_(other.tree_),
+                  nodes_(other.nodes_),
+                  root_(other.root_),
+                  compiled_(other.compiled_) {
+                // the copied tree has the same structure as the original, so its tests appear in the same order
+                const auto from = detail::compile_branches(other.tree_.root());
+                const auto to = detail::compile_branches(tree_.root());
+
+                std::map<const node::expression_tree_node<Obj>*, const node::expression_tree_node<Obj>*> copied;
+                for(std::size_t i = 0; i < from.branches.size(); ++i) {
+                    copied[from.branches[i].test] = to.branches[i].test;
+                }
+                for(auto* variable : other.variables_) {
+                    variables_.push_back(copied.at(variable));
+                }
+            }
+
+            bdd_expression_tree(bdd_expression_tree&& other) noexcept = default;
+
+            bdd_expression_tree& operator=(const bdd_expression_tree& other) {
+                if(this != &other) {
+                    bdd_expression_tree copy(other);
+                    *this = std::move(copy);
+                }
+                return *this;
+            }
+
+            bdd_expression_tree& operator=(bdd_expression_tree&& other) noexcept = default;
+
+            /**
+             * @brief Evaluates the given object to determine if it satisfies the expressions defined in this expression tree.
+            */
+            bool evaluate(const Obj& obj) const {
+                if(!compiled_) {
+                    return tree_.evaluate(obj);
+                }
+
+                try {
+                    std::int32_t pc = root_;
+                    while(pc >= 0) {
+                        const detail::bdd_node& n = nodes_[pc];
+                        pc = variables_[n.var]->evaluate(obj) ? n.high : n.low;
+                    }
+                    return pc == detail::branch_accept;
+                } catch(std::exception& e) {
+                    return tree_.evaluate(obj);
+                }
+            }
+
+            /**
+             * @brief Evaluates a batch of objects.
+             *
+             * @param objs    An array of count pointers to the objects to evaluate
+             * @param results An array of count bools. Each result is set to the outcome of evaluating the object at the same index
+            */
+            void evaluate_batch(const Obj* const* objs, std::size_t count, bool* results) const {
+                for(std::size_t i = 0; i < count; ++i) {
+                    results[i] = evaluate(*objs[i]);
+                }
+            }
+
+            /**
+             * @brief False if the diagram exceeded its node limit, in which case the regular tree is evaluated.
+            */
+            bool is_compiled() const {
+                return compiled_;
+            }
+
+            /**
+             * @brief The number of decision nodes in the diagram, excluding the two terminals.
+            */
+            std::size_t node_count() const {
+                return nodes_.size();
+            }
+
+            /**
+             * @brief The number of distinct tests in the tree, i.e. the variables of the diagram.
+            */
+            std::size_t variable_count() const {
+                return variables_.size();
+            }
+
+            const expression_tree<Obj>& tree() const {
+                return tree_;
+            }
+
+        private:
+            expression_tree<Obj> tree_;
+            std::vector<const node::expression_tree_node<Obj>*> variables_;
+            std::vector<detail::bdd_node> nodes_;
+            std::int32_t root_ = detail::branch_reject;
+            bool compiled_ = false;
+
+            template<typename Cost>
+            void compile(Cost cost, std::size_t node_limit) {
+                const auto program = detail::compile_branches(tree_.root());
+
+                // each distinct test becomes a variable, numbered in order of first appearance
+                std::map<const node::expression_tree_leaf_node_base<Obj>*, std::uint32_t, detail::mergeable_leaf_less<Obj>> merged;
+                std::map<const node::expression_tree_node<Obj>*, std::uint32_t> variable_of;
+                std::vector<const node::expression_tree_node<Obj>*> tests;
+                for(auto& b : program.branches) {
+                    auto* leaf = detail::as_mergeable_leaf(b.test);
+                    if(leaf) {
+                        auto it = merged.find(leaf);
+                        if(it != merged.end()) {
+                            variable_of[b.test] = it->second;
+                            continue;
+                        }
+                        merged.emplace(leaf, static_cast<std::uint32_t>(tests.size()));
+                    }
+                    variable_of[b.test] = static_cast<std::uint32_t>(tests.size());
+                    tests.push_back(b.test);
+                }
+
+                // order the variables by cost, keeping the order of appearance between variables of equal cost
+                std::vector<std::pair<double, std::uint32_t>> order;
+                for(std::uint32_t i = 0; i < tests.size(); ++i) {
+                    order.emplace_back(static_cast<double>(cost(*tests[i])), i);
+                }
+                std::stable_sort(order.begin(), order.end(), [](const std::pair<double, std::uint32_t>& a,
+                        const std::pair<double, std::uint32_t>& b) {
+                    return a.first < b.first;
+                });
+
+                std::vector<std::uint32_t> level_of(tests.size());
+                variables_.clear();
+                for(std::uint32_t level = 0; level < order.size(); ++level) {
+                    level_of[order[level].second] = level;
+                    variables_.push_back(tests[order[level].second]);
+                }
+
+                // every variable needs at least one node, and building recurses once per variable
+                if(variables_.size() > node_limit) {
+                    return;
+                }
+
+                try {
+                    detail::bdd_builder builder(node_limit * 4);
+                    std::vector<std::int32_t> roots { build(builder, variable_of, level_of, node_limit) };
+                    builder.collect(roots);
+                    root_ = roots.front();
+                    nodes_.swap(builder.nodes());
+                    compiled_ = true;
+                } catch(const detail::bdd_node_limit_exceeded&) {
+                    nodes_.clear();
+                    root_ = detail::branch_reject;
+                    compiled_ = false;
+                }
+            }
+
+            /**
+             * Builds the diagram of the tree bottom up, without recursing once per level of the tree. Unreachable
+             * intermediate nodes are collected whenever there are more than node_limit nodes, and building fails if more
+             * than node_limit nodes are still reachable afterwards.
+            */
+            std::int32_t build(detail::bdd_builder& builder,
+                    const std::map<const node::expression_tree_node<Obj>*, std::uint32_t>& variable_of,
+                    const std::vector<std::uint32_t>& level_of, std::size_t node_limit) const {
+                struct frame {
+                    const node::expression_tree_node<Obj>* n;
+                    bool expanded;
+                };
+
+                std::vector<frame> pending { frame { &tree_.root(), false } };
+                std::vector<std::int32_t> built;
+
+                while(!pending.empty()) {
+                    const frame current = pending.back();
+
+                    auto* op_node = dynamic_cast<const node::expression_tree_op_node_base<Obj>*>(current.n);
+                    if(op_node && op_node->get_left() && op_node->get_right()) {
+                        if(!current.expanded) {
+                            pending.back().expanded = true;
+                            pending.push_back(frame { op_node->get_right(), false });
+                            pending.push_back(frame { op_node->get_left(), false });
+                            continue;
+                        }
+
+                        pending.pop_back();
+                        const std::int32_t right = built.back();
+                        built.pop_back();
+                        const std::int32_t left = built.back();
+                        built.pop_back();
+                        built.push_back(builder.apply(op_node->get_bool_op(), left, right));
+
+                        if(builder.nodes().size() > node_limit) {
+                            builder.collect(built);
+                            if(builder.nodes().size() > node_limit) {
+                                throw detail::bdd_node_limit_exceeded();
+                            }
+                        }
+                        continue;
+                    }
+
+                    pending.pop_back();
+                    if(auto* constant = dynamic_cast<const node::expression_tree_constant_node<Obj>*>(current.n)) {
+                        built.push_back(constant->get_value() ? detail::branch_accept : detail::branch_reject);
+                    } else {
+                        const std::uint32_t level = level_of[variable_of.at(current.n)];
+                        built.push_back(builder.make(level, detail::branch_reject, detail::branch_accept));
+                    }
+                }
+
+                return built.back();
+            }
+    };
+
+    template<typename Obj>
+    constexpr std::size_t bdd_expression_tree<Obj>::default_node_limit;
+
+}
+}
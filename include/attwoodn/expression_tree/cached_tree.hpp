@@ -0,0 +1,257 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace attwoodn {
+namespace expression_tree {
+
+    /**
+     * @brief Wraps an expression tree with a bounded cache of evaluation results, for streams in which the same logical
+     *        object is evaluated many times. Worthwhile when the tree is expensive to evaluate (e.g. it compares strings or
+     *        calls costly const member functions) and the input is repetitive.
+     *
+     *        Results are cached by a key computed from each object using a user-supplied key function. The key must capture
+     *        every member that the tree reads (see expression_tree::accessed_members), since objects with equal keys are
+     *        assumed to evaluate to the same result.
+     *
+     *        The cache is split into shards, each guarded by its own mutex, so the tree may be evaluated from many threads
+     *        at once. Each shard evicts entries using the CLOCK algorithm: a cache hit marks its entry as recently used, and
+     *        an entry is only evicted once the clock hand has passed over it without it being used again. Replacing the tree
+     *        invalidates every cached result.
+    */
+    template<typename Obj, typename Key, typename Hash = std::hash<Key>>
+    class cached_expression_tree {
+        public:
+            static constexpr std::size_t default_shard_count = 16;
+
+            cached_expression_tree() = delete;
+
+            /**
+             * @param tree     The tree to evaluate
+             * @param key      A function that returns the cache key of an object
+             * @param capacity The maximum number of cached results
+             * @param shards   The number of independently locked parts of the cache. At most capacity shards are used
+            */
+            cached_expression_tree(expression_tree<Obj> tree, std::function<Key(const Obj&)> key, std::size_t capacity,
+                    std::size_t shards = default_shard_count)
+                : key_(std::move(key)),
+                  tree_(std::make_shared<const tree_state>(tree_state { std::move(tree), 0 })) {
+                if(!key_) {
+                    throw std::invalid_argument("cached_expression_tree requires a key function");
+                }
+                if(capacity == 0) {
+                    throw std::invalid_argument("cached_expression_tree requires a capacity of at least one result");
+                }
+
+                shard_count_ = std::max<std::size_t>(1, std::min(shards, capacity));
+                shards_.reset(new shard[shard_count_]);
+                for(std::size_t i = 0; i < shard_count_; ++i) {
+                    // the first capacity % shard_count_ shards hold one extra result
+                    shards_[i].slots.resize(capacity / shard_count_ + (i < capacity % shard_count_ ? 1 : 0));
+                }
+                capacity_ = capacity;
+            }
+
+            cached_expression_tree(const cached_expression_tree&) = delete;
+            cached_expression_tree& operator=(const cached_expression_tree&) = delete;
+
+            /**
+             * @brief Evaluates the given object, returning a cached result if an object with the same key has been evaluated
+             *        by the current tree.
+            */
+            bool evaluate(const Obj& obj) const {
+                Key key = key_(obj);
+                const std::size_t hash = Hash()(key);
+                shard& s = shards_[hash % shard_count_];
+                const std::shared_ptr<const tree_state> state = load_tree();
+
+                {
+                    std::lock_guard<std::mutex> lock(s.mutex);
+                    auto it = s.index.find(key);
+                    if(it != s.index.end() && s.slots[it->second].generation == state->generation) {
+                        slot& cached = s.slots[it->second];
+                        cached.referenced = true;
+                        hits_.fetch_add(1, std::memory_order_relaxed);
+                        return cached.result;
+                    }
+                }
+
+                // the tree is evaluated without holding the lock, so that other keys of the shard are not blocked
+                const bool result = state->tree.evaluate(obj);
+                misses_.fetch_add(1, std::memory_order_relaxed);
+
+                std::lock_guard<std::mutex> lock(s.mutex);
+                auto it = s.index.find(key);
+                if(it != s.index.end()) {
+                    s.slots[it->second].result = result;
+                    s.slots[it->second].generation = state->generation;
+                } else {
+                    insert(s, std::move(key), result, state->generation);
+                }
+                return result;
+            }
+
+            /**
+             * @brief Replaces the tree, and invalidates every cached result.
+            */
+            void replace_tree(expression_tree<Obj> tree) {
+                std::lock_guard<std::mutex> lock(replace_mutex_);
+                const std::uint64_t generation = load_tree()->generation + 1;
+                store_tree(std::make_shared<const tree_state>(tree_state { std::move(tree), generation }));
+
+                // results of the previous tree that are inserted after this point are tagged with its generation, and are
+                // never returned
+                clear();
+            }
+
+            /**
+             * @brief Discards every cached result. The hit and miss counts are not reset.
+            */
+            void clear() {
+                for(std::size_t i = 0; i < shard_count_; ++i) {
+                    shard& s = shards_[i];
+                    std::lock_guard<std::mutex> lock(s.mutex);
+                    s.index.clear();
+                    for(auto& sl : s.slots) {
+                        sl = slot();
+                    }
+                    s.hand = 0;
+                }
+            }
+
+            /**
+             * @brief Returns the current tree. The returned tree remains valid if the tree is replaced.
+            */
+            std::shared_ptr<const expression_tree<Obj>> tree() const {
+                const std::shared_ptr<const tree_state> state = load_tree();
+                return std::shared_ptr<const expression_tree<Obj>>(state, &state->tree);
+            }
+
+            /**
+             * @brief The number of evaluations answered from the cache.
+            */
+            std::uint64_t hit_count() const {
+                return hits_.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief The number of evaluations that evaluated the tree.
+            */
+            std::uint64_t miss_count() const {
+                return misses_.load(std::memory_order_relaxed);
+            }
+
+            void reset_counts() {
+                hits_.store(0, std::memory_order_relaxed);
+                misses_.store(0, std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief The number of cached results, including results of a replaced tree that have not yet been discarded.
+            */
+            std::size_t size() const {
+                std::size_t total = 0;
+                for(std::size_t i = 0; i < shard_count_; ++i) {
+                    std::lock_guard<std::mutex> lock(shards_[i].mutex);
+                    total += shards_[i].index.size();
+                }
+                return total;
+            }
+
+            std::size_t capacity() const {
+                return capacity_;
+            }
+
+        private:
+            struct tree_state {
+                expression_tree<Obj> tree;
+                std::uint64_t generation;
+            };
+
+            struct slot {
+                const Key* key = nullptr;
+                bool occupied = false;
+                bool referenced = false;
+                bool result = false;
+                std::uint64_t generation = 0;
+            };
+
+            struct shard {
+                std::mutex mutex;
+                std::vector<slot> slots;
+                std::unordered_map<Key, std::size_t, Hash> index;
+                std::size_t hand = 0;
+            };
+
+            std::function<Key(const Obj&)> key_;
+#ifdef __cpp_lib_atomic_shared_ptr
+            // the atomic free functions for std::shared_ptr are deprecated where std::atomic<std::shared_ptr> exists
+            std::atomic<std::shared_ptr<const tree_state>> tree_;
+#else
+            std::shared_ptr<const tree_state> tree_;
+#endif
+            std::mutex replace_mutex_;
+            std::unique_ptr<shard[]> shards_;
+            std::size_t shard_count_ = 1;
+            std::size_t capacity_ = 0;
+            mutable std::atomic<std::uint64_t> hits_ { 0 };
+            mutable std::atomic<std::uint64_t> misses_ { 0 };
+
+            std::shared_ptr<const tree_state> load_tree() const {
+#ifdef __cpp_lib_atomic_shared_ptr
+                return tree_.load();
+#else
+                return std::atomic_load(&tree_);
+#endif
+            }
+
+            void store_tree(std::shared_ptr<const tree_state> state) {
+#ifdef __cpp_lib_atomic_shared_ptr
+                tree_.store(std::move(state));
+#else
+                std::atomic_store(&tree_, std::move(state));
+#endif
+            }
+
+            /**
+             * Stores a result in the given shard, whose lock must be held. If the shard is full, the clock hand advances
+             * until it finds an entry that has not been used since the hand last passed it, and that entry is evicted.
+            */
+            static void insert(shard& s, Key key, bool result, std::uint64_t generation) {
+                while(s.slots[s.hand].occupied && s.slots[s.hand].referenced) {
+                    s.slots[s.hand].referenced = false;
+                    s.hand = (s.hand + 1) % s.slots.size();
+                }
+
+                slot& victim = s.slots[s.hand];
+                if(victim.occupied) {
+                    s.index.erase(*victim.key);
+                }
+
+                // the slot refers to the key owned by the index, whose address is stable until the key is erased
+                auto inserted = s.index.emplace(std::move(key), s.hand).first;
+                victim.key = &inserted->first;
+                victim.occupied = true;
+                victim.referenced = false;
+                victim.result = result;
+                victim.generation = generation;
+                s.hand = (s.hand + 1) % s.slots.size();
+            }
+    };
+
+    template<typename Obj, typename Key, typename Hash>
+    constexpr std::size_t cached_expression_tree<Obj, Key, Hash>::default_shard_count;
+
+}
+}
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace attwoodn {
+namespace expression_tree {
+
+namespace detail {
+
+    inline std::uint64_t mix_hash(std::uint64_t seed, std::uint64_t value) {
+        // the splitmix64 finalizer, so that every input bit affects every output bit
+        std::uint64_t z = seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    inline std::uint64_t double_bits(double value) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    /**
+     * Assigns each subtree added to the table a structural hash, and an id that is equal for every subtree of the table
+     * with the same canonical form. In the canonical form, chains of op nodes that perform the same boolean operation
+     * are a single n-ary operation, and the operands of op nodes and the children of threshold nodes are unordered.
+     *
+     * Leaves are equivalent if they read the same member using the same built-in operator and equivalent comparison values.
+     * Leaves with custom operators or unordered comparison values, and nodes of types that the table does not know, are
+     * only equivalent to themselves.
+     *
+     * The table refers to the nodes of the added trees, which must outlive it. Trees are walked without recursion.
+    */
+    template<typename Obj>
+    class structure_table {
+        public:
+            using node_type = node::expression_tree_node<Obj>;
+
+            struct entry {
+                std::uint64_t hash;
+                std::size_t id;
+
+                // a copy of the subtree in canonical order, if the table was asked to build copies
+                std::unique_ptr<node_type> copy;
+            };
+
+            explicit structure_table(bool build_copies = false)
+                : build_copies_(build_copies) {}
+
+            entry add(const node_type& root) {
+                if(!is_composite(root)) {
+                    return add_simple(root);
+                }
+
+                std::vector<frame> pending;
+                pending.push_back(make_frame(root));
+                while(true) {
+                    frame& top = pending.back();
+                    if(top.results.size() < top.operands.size()) {
+                        const node_type* next = top.operands[top.results.size()];
+                        if(is_composite(*next)) {
+                            pending.push_back(make_frame(*next));
+                        } else {
+                            top.results.push_back(add_simple(*next));
+                        }
+                        continue;
+                    }
+
+                    entry done = add_composite(top);
+                    pending.pop_back();
+                    if(pending.empty()) {
+                        return done;
+                    }
+                    pending.back().results.push_back(std::move(done));
+                }
+            }
+
+        private:
+            enum tag : std::uint64_t {
+                constant_tag = 1,
+                leaf_tag,
+                opaque_tag,
+                and_tag,
+                or_tag,
+                threshold_tag
+            };
+
+            struct frame {
+                const node_type* n;
+                std::vector<const node_type*> operands;
+                std::vector<entry> results;
+            };
+
+            bool build_copies_;
+            std::map<const node::expression_tree_leaf_node_base<Obj>*, std::size_t, mergeable_leaf_less<Obj>> leaves_;
+            std::map<const node_type*, std::size_t> opaque_;
+            std::map<std::vector<std::uint64_t>, std::size_t> composites_;
+
+            // ids 0 and 1 are the constants false and true
+            std::size_t next_id_ = 2;
+
+            static const node::expression_tree_op_node_base<Obj>* as_op_node(const node_type& n) {
+                auto* op_node = dynamic_cast<const node::expression_tree_op_node_base<Obj>*>(&n);
+                return op_node && op_node->get_left() && op_node->get_right() ? op_node : nullptr;
+            }
+
+            static bool is_composite(const node_type& n) {
+                return as_op_node(n) || dynamic_cast<const node::expression_tree_threshold_node<Obj>*>(&n);
+            }
+
+            static frame make_frame(const node_type& n) {
+                frame f { &n, {}, {} };
+                if(auto* threshold = dynamic_cast<const node::expression_tree_threshold_node<Obj>*>(&n)) {
+                    for(std::size_t i = 0; i < threshold->child_count(); ++i) {
+                        f.operands.push_back(threshold->get_child(i));
+                    }
+                    return f;
+                }
+
+                // collects the operands of the chain of op nodes that perform the same boolean operation as n
+                const node::boolean_op bool_op = as_op_node(n)->get_bool_op();
+                std::vector<const node_type*> chain { &n };
+                while(!chain.empty()) {
+                    const node_type* current = chain.back();
+                    chain.pop_back();
+
+                    auto* op_node = as_op_node(*current);
+                    if(op_node && op_node->get_bool_op() == bool_op) {
+                        chain.push_back(op_node->get_right());
+                        chain.push_back(op_node->get_left());
+                    } else {
+                        f.operands.push_back(current);
+                    }
+                }
+                return f;
+            }
+
+            std::unique_ptr<node_type> copy_of(const node_type& n) const {
+                return build_copies_ ? n.clone() : nullptr;
+            }
+
+            entry add_simple(const node_type& n) {
+                if(auto* constant = dynamic_cast<const node::expression_tree_constant_node<Obj>*>(&n)) {
+                    return entry { mix_hash(constant_tag, constant->get_value()), constant->get_value() ? 1u : 0u, copy_of(n) };
+                }
+
+                if(auto* leaf = dynamic_cast<const node::expression_tree_leaf_node_base<Obj>*>(&n)) {
+                    std::uint64_t hash = mix_hash(leaf_tag, leaf->get_accessor().hash());
+                    hash = mix_hash(hash, static_cast<std::uint64_t>(leaf->get_comparator()));
+                    hash = mix_hash(hash, leaf->comp_value_type().hash_code());
+                    hash = mix_hash(hash, leaf->hash_comp_value());
+
+                    if(as_mergeable_leaf(&n)) {
+                        auto inserted = leaves_.emplace(leaf, next_id_);
+                        if(inserted.second) {
+                            ++next_id_;
+                        }
+                        return entry { hash, inserted.first->second, copy_of(n) };
+                    }
+
+                    // leaves with custom operators of different types are never equivalent
+                    return entry { mix_hash(hash, typeid(n).hash_code()), opaque_id(n), copy_of(n) };
+                }
+
+                return entry { mix_hash(opaque_tag, typeid(n).hash_code()), opaque_id(n), copy_of(n) };
+            }
+
+            std::size_t opaque_id(const node_type& n) {
+                auto inserted = opaque_.emplace(&n, next_id_);
+                if(inserted.second) {
+                    ++next_id_;
+                }
+                return inserted.first->second;
+            }
+
+            std::size_t composite_id(std::vector<std::uint64_t> key) {
+                auto inserted = composites_.emplace(std::move(key), next_id_);
+                if(inserted.second) {
+                    ++next_id_;
+                }
+                return inserted.first->second;
+            }
+
+            entry add_composite(frame& f) {
+                auto* threshold = dynamic_cast<const node::expression_tree_threshold_node<Obj>*>(f.n);
+
+                // weights stay with their children when the children are put in canonical order
+                std::vector<std::size_t> order(f.results.size());
+                for(std::size_t i = 0; i < order.size(); ++i) {
+                    order[i] = i;
+                }
+                std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+                    const double weight_a = threshold ? threshold->get_weight(a) : 0;
+                    const double weight_b = threshold ? threshold->get_weight(b) : 0;
+                    if(f.results[a].hash != f.results[b].hash) return f.results[a].hash < f.results[b].hash;
+                    if(f.results[a].id != f.results[b].id) return f.results[a].id < f.results[b].id;
+                    return weight_a < weight_b;
+                });
+
+                std::vector<std::uint64_t> key;
+                std::uint64_t hash;
+                if(threshold) {
+                    key = { threshold_tag, double_bits(threshold->get_threshold()) };
+                    hash = mix_hash(threshold_tag, key[1]);
+                } else {
+                    const tag t = as_op_node(*f.n)->get_bool_op() == node::boolean_op::AND ? and_tag : or_tag;
+                    key = { t };
+                    hash = mix_hash(t, f.results.size());
+                }
+
+                // the key lists the ids (and weights) of the operands in order of id, since hashes may collide
+                std::vector<std::pair<std::size_t, std::uint64_t>> operand_keys;
+                for(std::size_t i : order) {
+                    const std::uint64_t weight = threshold ? double_bits(threshold->get_weight(i)) : 0;
+                    hash = mix_hash(mix_hash(hash, f.results[i].hash), weight);
+                    operand_keys.emplace_back(f.results[i].id, weight);
+                }
+                std::sort(operand_keys.begin(), operand_keys.end());
+                for(auto& k : operand_keys) {
+                    key.push_back(k.first);
+                    key.push_back(k.second);
+                }
+
+                entry result { hash, composite_id(std::move(key)), nullptr };
+                if(build_copies_) {
+                    result.copy = threshold ? copy_threshold(*threshold, f, order) : copy_chain(as_op_node(*f.n)->get_bool_op(), f, order);
+                }
+                return result;
+            }
+
+            static std::unique_ptr<node_type> copy_chain(node::boolean_op bool_op, frame& f, const std::vector<std::size_t>& order) {
+                std::unique_ptr<node_type> chain = std::move(f.results[order[0]].copy);
+                for(std::size_t i = 1; i < order.size(); ++i) {
+                    auto* op_node = new node::expression_tree_dynamic_op_node<Obj>(bool_op);
+                    op_node->set_left(chain.release());
+                    op_node->set_right(f.results[order[i]].copy.release());
+                    chain.reset(op_node);
+                }
+                return chain;
+            }
+
+            static std::unique_ptr<node_type> copy_threshold(const node::expression_tree_threshold_node<Obj>& threshold, frame& f,
+                    const std::vector<std::size_t>& order) {
+                std::vector<node_type*> children;
+                std::vector<double> weights;
+                for(std::size_t i : order) {
+                    children.push_back(f.results[i].copy.release());
+                    weights.push_back(threshold.get_weight(i));
+                }
+                return std::unique_ptr<node_type>(
+                    new node::expression_tree_threshold_node<Obj>(threshold.get_threshold(), std::move(children), std::move(weights)));
+            }
+    };
+
+}
+
+    /**
+     * @brief Returns a 64-bit hash of the structure of the given tree. Trees that differ only in the order of the operands
+     *        of their AND and OR op nodes (or the children of their threshold nodes), or in how chains of the same boolean
+     *        operation are nested, have equal hashes. Leaves are hashed by the member they read, their operator, and their
+     *        comparison value.
+     *
+     *        Trees with equal hashes are very likely, but not certain, to be equivalent. Use structurally_equal to check.
+    */
+    template<typename Obj>
+    std::uint64_t structural_hash(const expression_tree<Obj>& tree) {
+        return detail::structure_table<Obj>().add(tree.root()).hash;
+    }
+
+    /**
+     * @brief Returns true if the given trees have the same canonical form (see structural_hash), and therefore always
+     *        evaluate to the same result, provided that none of their leaves throw while being evaluated.
+     *
+     *        Leaves with custom operators or unordered comparison values are never considered equal to leaves of another
+     *        tree, so trees that contain them are only structurally equal to themselves.
+    */
+    template<typename Obj>
+    bool structurally_equal(const expression_tree<Obj>& a, const expression_tree<Obj>& b) {
+        detail::structure_table<Obj> table;
+        const std::size_t a_id = table.add(a.root()).id;
+        return table.add(b.root()).id == a_id;
+    }
+
+    /**
+     * @brief Returns a copy of the given tree in canonical form, where the operands of each chain of AND or OR op nodes
+     *        (and the children of each threshold node) are sorted by their structural hash. Trees that are structurally
+     *        equal have identical canonical forms.
+    */
+    template<typename Obj>
+    expression_tree<Obj> canonicalize(const expression_tree<Obj>& tree) {
+        return expression_tree<Obj>(detail::structure_table<Obj>(true).add(tree.root()).copy.release());
+    }
+
+}
+}
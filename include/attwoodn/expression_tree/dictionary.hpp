@@ -0,0 +1,510 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace attwoodn {
+namespace expression_tree {
+
+    /**
+     * @brief The id of a string that is not in a dictionary, and the id of the values that could not be read from an object.
+    */
+    constexpr std::uint32_t no_string_id = 0xffffffff;
+
+    /**
+     * @brief Assigns consecutive 32-bit ids, starting at zero, to distinct strings.
+    */
+    class string_dictionary {
+        public:
+            /**
+             * @brief Returns the id of the given string, adding the string to the dictionary if it is not already in it.
+             *
+             * @throws std::length_error if the dictionary is full
+            */
+            std::uint32_t intern(const std::string& value) {
+                auto it = ids_.find(value);
+                if(it != ids_.end()) {
+                    return it->second;
+                }
+                if(values_.size() >= no_string_id) {
+                    throw std::length_error("string_dictionary cannot hold more than 2^32 - 1 strings");
+                }
+
+                const std::uint32_t id = static_cast<std::uint32_t>(values_.size());
+                values_.push_back(value);
+                ids_.emplace(value, id);
+                return id;
+            }
+
+            /**
+             * @brief Returns the id of the given string, or no_string_id if it is not in the dictionary.
+            */
+            std::uint32_t find(const std::string& value) const {
+                auto it = ids_.find(value);
+                return it == ids_.end() ? no_string_id : it->second;
+            }
+
+            /**
+             * @brief Returns the string with the given id.
+             *
+             * @throws std::out_of_range if there is no string with the given id
+            */
+            const std::string& value(std::uint32_t id) const {
+                if(id >= values_.size()) {
+                    throw std::out_of_range("string_dictionary has no string with the given id");
+                }
+                return values_[id];
+            }
+
+            std::size_t size() const {
+                return values_.size();
+            }
+
+        private:
+            std::vector<std::string> values_;
+            std::unordered_map<std::string, std::uint32_t> ids_;
+    };
+
+    template<typename Obj>
+    class encoded_expression_tree;
+
+    /**
+     * @brief Encodes string members of an array of objects as ids of a dictionary, one dictionary per member. Encoding
+     *        pays off for members with few distinct values, such as host or service names, whose comparisons can then be
+     *        made between ids rather than strings by an encoded_expression_tree.
+     *
+     *        The members are read when they are encoded, and the objects must not change afterwards. The array must
+     *        outlive the encoding.
+    */
+    template<typename Obj>
+    class dictionary_encoding {
+        public:
+            dictionary_encoding() = delete;
+
+            dictionary_encoding(const Obj* objs, std::size_t count)
+                : objs_(objs),
+                  count_(count) {}
+
+            /**
+             * @brief Encodes the given std::string member variable of each object. Chainable.
+            */
+            dictionary_encoding& encode(const std::string Obj::* member_var) {
+                return add_column(accessor_id(accessor_id::kind::member_variable, member_var), member_var);
+            }
+
+            /**
+             * @brief Encodes the std::string returned by the given const member function for each object. Objects for which the
+             *        function throws are given the id no_string_id. Chainable.
+            */
+            template<typename T>
+            dictionary_encoding& encode(T (Obj::* member_func)() const) {
+                static_assert(std::is_same<typename std::decay<T>::type, std::string>::value,
+                    "dictionary_encoding only encodes std::string members");
+                return add_column(accessor_id(accessor_id::kind::member_function, member_func), member_func);
+            }
+
+            bool encodes(const accessor_id& accessor) const {
+                return find_column(accessor) != nullptr;
+            }
+
+            /**
+             * @brief Returns the dictionary of an encoded member.
+             *
+             * @throws std::invalid_argument if the member is not encoded
+            */
+            template<typename Member>
+            const string_dictionary& dictionary(Member member) const {
+                return column(accessor_of(member)).dictionary;
+            }
+
+            /**
+             * @brief Returns the id of an encoded member of each object, in the order of the objects.
+             *
+             * @throws std::invalid_argument if the member is not encoded
+            */
+            template<typename Member>
+            const std::vector<std::uint32_t>& ids(Member member) const {
+                return column(accessor_of(member)).ids;
+            }
+
+            const Obj* objects() const {
+                return objs_;
+            }
+
+            std::size_t size() const {
+                return count_;
+            }
+
+        private:
+            template<typename T>
+            friend class encoded_expression_tree;
+
+            struct encoded_column {
+                accessor_id accessor;
+                string_dictionary dictionary;
+                std::vector<std::uint32_t> ids;
+            };
+
+            const Obj* objs_;
+            std::size_t count_;
+            std::vector<std::unique_ptr<encoded_column>> columns_;
+
+            const encoded_column* find_column(const accessor_id& accessor) const {
+                for(auto& c : columns_) {
+                    if(c->accessor == accessor) {
+                        return c.get();
+                    }
+                }
+                return nullptr;
+            }
+
+            const encoded_column& column(const accessor_id& accessor) const {
+                auto* c = find_column(accessor);
+                if(!c) {
+                    throw std::invalid_argument("dictionary_encoding does not encode the given member");
+                }
+                return *c;
+            }
+
+            template<typename Accessor>
+            dictionary_encoding& add_column(accessor_id id, Accessor accessor) {
+                if(find_column(id)) {
+                    return *this;
+                }
+
+                std::unique_ptr<encoded_column> c(new encoded_column { id, {}, {} });
+                c->ids.reserve(count_);
+                std::string value;
+                for(std::size_t i = 0; i < count_; ++i) {
+                    bool readable = true;
+                    try {
+                        value = detail::read_accessor(objs_[i], accessor);
+                    } catch(std::exception& e) {
+                        readable = false;
+                    }
+                    c->ids.push_back(readable ? c->dictionary.intern(value) : no_string_id);
+                }
+                columns_.push_back(std::move(c));
+                return *this;
+            }
+    };
+
+namespace detail {
+
+    enum class encoded_step_kind : std::uint8_t {
+        // evaluates the node that the step was compiled from
+        node,
+
+        // compares the id of an encoded member with a single id
+        id_equals,
+
+        // looks up the id of an encoded member in a set of ids
+        id_in_set
+    };
+
+    /**
+     * One test of an encoded_expression_tree. A test hits if its node evaluates to true, or if the id of its encoded member
+     * is its id or is in its set. Evaluation then continues at on_hit or on_miss, which are indices of later steps, or
+     * branch_accept / branch_reject. An object whose encoded member could not be read does not satisfy the tree.
+    */
+    template<typename Obj>
+    struct encoded_step {
+        encoded_step_kind kind;
+        std::int32_t on_hit;
+        std::int32_t on_miss;
+        const node::expression_tree_node<Obj>* n;
+        const std::uint32_t* ids;
+
+        // the id compared by id_equals steps, or the index of the set of id_in_set steps
+        std::uint32_t id;
+    };
+
+}
+
+    /**
+     * @brief An expression tree compiled against a dictionary_encoding, which evaluates the objects of the encoding by index.
+     *
+     *        Leaf nodes that compare an encoded member with a string using equals or not_equals compare its id with the id
+     *        of the string instead, which is looked up in the member's dictionary when the tree is compiled. A chain of
+     *        equals leaf nodes on the same member joined by OR (or of not_equals leaf nodes joined by AND) is compiled into a
+     *        single lookup in a set of ids, so testing membership in a set of strings costs the same however many strings
+     *        the set has. Every other leaf node is evaluated as usual.
+     *
+     *        The encoding must outlive the compiled tree. As with expression_tree::evaluate, an object for which a leaf
+     *        throws an exception does not satisfy the tree.
+    */
+    template<typename Obj>
+    class encoded_expression_tree {
+        public:
+            encoded_expression_tree() = delete;
+
+            encoded_expression_tree(const expression_tree<Obj>& tree, const dictionary_encoding<Obj>& encoding)
+                : tree_(tree),
+                  encoding_(&encoding) {
+                compile();
+            }
+
+            encoded_expression_tree(expression_tree<Obj>&& tree, const dictionary_encoding<Obj>& encoding)
+                : tree_(std::move(tree)),
+                  encoding_(&encoding) {
+                compile();
+            }
+
+            encoded_expression_tree(const encoded_expression_tree& other)
+                : tree_(other.tree_),
+                  encoding_(other.encoding_) {
+                compile();
+            }
+
+            encoded_expression_tree(encoded_expression_tree&& other) noexcept = default;
+
+            encoded_expression_tree& operator=(const encoded_expression_tree& other) {
+                if(this != &other) {
+                    encoded_expression_tree copy(other);
+                    *this = std::move(copy);
+                }
+                return *this;
+            }
+
+            encoded_expression_tree& operator=(encoded_expression_tree&& other) noexcept = default;
+
+            /**
+             * @brief Evaluates the object of the encoding at the given index.
+             *
+             * @throws std::out_of_range if there is no object at the given index
+            */
+            bool evaluate(std::size_t index) const {
+                if(index >= encoding_->size()) {
+                    throw std::out_of_range("dictionary_encoding has no object at the given index");
+                }
+                return evaluate_checked(index);
+            }
+
+            /**
+             * @brief Evaluates count consecutive objects of the encoding, starting at the given index.
+             *
+             * @param results An array of count bools. Each result is set to the outcome of evaluating the object at the same offset
+             * @throws std::out_of_range if the objects are not all in the encoding
+            */
+            void evaluate_batch(std::size_t first, std::size_t count, bool* results) const {
+                if(first > encoding_->size() || count > encoding_->size() - first) {
+                    throw std::out_of_range("dictionary_encoding does not hold the given range of objects");
+                }
+                for(std::size_t i = 0; i < count; ++i) {
+                    results[i] = evaluate_checked(first + i);
+                }
+            }
+
+            /**
+             * @brief Calls f(index) with the index of each object of the encoding that satisfies the tree, in order.
+            */
+            template<typename Function>
+            void for_each_match(Function f) const {
+                for(std::size_t i = 0; i < encoding_->size(); ++i) {
+                    if(evaluate_checked(i)) {
+                        f(i);
+                    }
+                }
+            }
+
+            /**
+             * @brief Returns the number of objects of the encoding that satisfy the tree.
+            */
+            std::size_t count() const {
+                std::size_t matches = 0;
+                for(std::size_t i = 0; i < encoding_->size(); ++i) {
+                    matches += evaluate_checked(i);
+                }
+                return matches;
+            }
+
+            /**
+             * @brief The number of leaf nodes that were compiled into comparisons of ids.
+            */
+            std::size_t encoded_leaf_count() const {
+                return encoded_leaves_;
+            }
+
+            /**
+             * @brief The number of sets of ids that chains of leaf nodes were compiled into.
+            */
+            std::size_t set_count() const {
+                return sets_.size();
+            }
+
+            /**
+             * @brief Returns the expression tree that this tree was compiled from.
+            */
+            const expression_tree<Obj>& tree() const {
+                return tree_;
+            }
+
+        private:
+            expression_tree<Obj> tree_;
+            const dictionary_encoding<Obj>* encoding_;
+
+            std::vector<detail::encoded_step<Obj>> steps_;
+            std::int32_t entry_ = detail::branch_reject;
+
+            // one flag per id of the member's dictionary
+            std::vector<std::vector<unsigned char>> sets_;
+            std::size_t encoded_leaves_ = 0;
+
+            bool evaluate_checked(std::size_t index) const {
+                try {
+                    return evaluate_unchecked(index);
+                } catch(std::exception& e) {
+                    return false;
+                }
+            }
+
+            bool evaluate_unchecked(std::size_t index) const {
+                const Obj& obj = encoding_->objects()[index];
+                std::int32_t pc = entry_;
+                while(pc >= 0) {
+                    const detail::encoded_step<Obj>& s = steps_[pc];
+                    bool hit;
+                    if(s.kind == detail::encoded_step_kind::node) {
+                        hit = s.n->evaluate(obj);
+                    } else {
+                        const std::uint32_t id = s.ids[index];
+                        if(id == no_string_id) {
+                            // the member threw when it was encoded, so the leaf node would throw here too
+                            return false;
+                        }
+                        hit = s.kind == detail::encoded_step_kind::id_equals ? id == s.id : sets_[s.id][id] != 0;
+                    }
+                    pc = hit ? s.on_hit : s.on_miss;
+                }
+                return pc == detail::branch_accept;
+            }
+
+            /**
+             * Returns the encoded member that the given node compares with a string using equals or not_equals, or nullptr
+             * if the node cannot be compiled into a comparison of ids.
+            */
+            const typename dictionary_encoding<Obj>::encoded_column* encoded_column_of(const node::expression_tree_node<Obj>* n) const {
+                auto* leaf = dynamic_cast<const node::expression_tree_leaf_node_base<Obj>*>(n);
+                if(!leaf || (leaf->get_comparator() != comparator::equals && leaf->get_comparator() != comparator::not_equals)
+                        || (leaf->comp_value_type() != typeid(std::string) && leaf->comp_value_type() != typeid(string_ref))) {
+                    return nullptr;
+                }
+                return encoding_->find_column(leaf->get_accessor());
+            }
+
+            /**
+             * Returns the id of the comparison value of an encoded leaf, or no_string_id if it is not in the column's 
+             * dictionary. A null string_ref equals no string, so it has no id.
+            */
+            static std::uint32_t comp_value_id(const typename dictionary_encoding<Obj>::encoded_column& column, 
+                    const node::expression_tree_leaf_node_base<Obj>& leaf) {
+                if(leaf.comp_value_type() == typeid(string_ref)) {
+                    const string_ref& value = *static_cast<const string_ref*>(leaf.comp_value_ptr());
+                    return value.is_null() ? no_string_id : column.dictionary.find(std::string(value.data(), value.size()));
+                }
+                return column.dictionary.find(*static_cast<const std::string*>(leaf.comp_value_ptr()));
+            }
+
+            void compile() {
+                const auto program = detail::compile_branches(tree_.root());
+
+                steps_.clear();
+                sets_.clear();
+                encoded_leaves_ = 0;
+
+                // the id of each encoded leaf's string, and the number of jumps into each branch
+                std::vector<std::uint32_t> ids(program.branches.size(), no_string_id);
+                std::vector<const typename dictionary_encoding<Obj>::encoded_column*> columns(program.branches.size(), nullptr);
+                std::vector<std::size_t> incoming(program.branches.size(), 0);
+                for(std::size_t i = 0; i < program.branches.size(); ++i) {
+                    const detail::branch<Obj>& b = program.branches[i];
+                    if(b.on_true >= 0) ++incoming[b.on_true];
+                    if(b.on_false >= 0) ++incoming[b.on_false];
+
+                    columns[i] = encoded_column_of(b.test);
+                    if(columns[i]) {
+                        ids[i] = comp_value_id(*columns[i], *static_cast<const node::expression_tree_leaf_node_base<Obj>*>(b.test));
+                        ++encoded_leaves_;
+                    }
+                }
+                if(program.entry >= 0) ++incoming[program.entry];
+
+                auto to_step = [&](std::size_t i) {
+                    const detail::branch<Obj>& b = program.branches[i];
+                    detail::encoded_step<Obj> s { detail::encoded_step_kind::node, b.on_true, b.on_false, b.test, nullptr, 0 };
+                    if(columns[i]) {
+                        s.kind = detail::encoded_step_kind::id_equals;
+                        s.ids = columns[i]->ids.data();
+                        s.id = ids[i];
+                        if(static_cast<const node::expression_tree_leaf_node_base<Obj>*>(b.test)->get_comparator() == comparator::not_equals) {
+                            std::swap(s.on_hit, s.on_miss);
+                        }
+                    }
+                    return s;
+                };
+
+                // steps are merged into the first step of each chain, so each later step of the chain maps to no step
+                std::vector<std::int32_t> step_of(program.branches.size(), -1);
+                std::vector<std::size_t> merged;
+                for(std::size_t i = 0; i < program.branches.size();) {
+                    detail::encoded_step<Obj> s = to_step(i);
+                    merged.assign(1, i);
+
+                    // a step continues the chain if only the previous step jumps to it, when the previous step misses, and
+                    // it tests the same member using the same comparator and jumps to the same step when it hits
+                    std::size_t next = i + 1;
+                    while(s.kind != detail::encoded_step_kind::node && next < program.branches.size()
+                            && s.on_miss == static_cast<std::int32_t>(next) && incoming[next] == 1 && columns[next] == columns[i]
+                            && same_comparator(program.branches[i].test, program.branches[next].test)) {
+                        const detail::encoded_step<Obj> candidate = to_step(next);
+                        if(candidate.on_hit != s.on_hit) {
+                            break;
+                        }
+                        merged.push_back(next);
+                        s.on_miss = candidate.on_miss;
+                        ++next;
+                    }
+
+                    if(merged.size() > 1) {
+                        std::vector<unsigned char> set(columns[i]->dictionary.size(), 0);
+                        for(std::size_t m : merged) {
+                            if(ids[m] != no_string_id) {
+                                set[ids[m]] = 1;
+                            }
+                        }
+                        s.kind = detail::encoded_step_kind::id_in_set;
+                        s.id = static_cast<std::uint32_t>(sets_.size());
+                        sets_.push_back(std::move(set));
+                    }
+
+                    step_of[i] = static_cast<std::int32_t>(steps_.size());
+                    steps_.push_back(s);
+                    i = next;
+                }
+
+                auto remap = [&](std::int32_t target) {
+                    return target < 0 ? target : step_of[target];
+                };
+                for(auto& s : steps_) {
+                    s.on_hit = remap(s.on_hit);
+                    s.on_miss = remap(s.on_miss);
+                }
+                entry_ = remap(program.entry);
+            }
+
+            static bool same_comparator(const node::expression_tree_node<Obj>* a, const node::expression_tree_node<Obj>* b) {
+                return static_cast<const node::expression_tree_leaf_node_base<Obj>*>(a)->get_comparator()
+                    == static_cast<const node::expression_tree_leaf_node_base<Obj>*>(b)->get_comparator();
+            }
+    };
+
+}
+}
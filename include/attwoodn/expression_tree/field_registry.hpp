@@ -0,0 +1,404 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace attwoodn {
+namespace expression_tree {
+
+    namespace detail {
+
+        /**
+         * Literal parsers, used to turn the text form of a comparison value into a value of a field's type.
+         * Each parser must consume the whole literal.
+         *
+         * @returns False if the literal is not a valid value of the requested type
+        */
+        inline bool parse_literal(const char* text, std::size_t length, bool& out) {
+            if(length == 4 && std::char_traits<char>::compare(text, "true", 4) == 0) {
+                out = true;
+                return true;
+            }
+            if(length == 5 && std::char_traits<char>::compare(text, "false", 5) == 0) {
+                out = false;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * The longest numeric literal that is parsed. Longer literals are rejected.
+        */
+        constexpr std::size_t max_numeric_literal_length = 127;
+
+        /**
+         * Copies a numeric literal into a NUL-terminated buffer, since the literal is not NUL-terminated and the strto*
+         * functions would otherwise read past it. The literal must start with a digit, or with '-' followed by a digit 
+         * when negative values are allowed, which rejects the leading whitespace and '+' that the strto* functions skip.
+         *
+         * @returns False if the literal is empty, too long, or does not start as required
+        */
+        inline bool copy_numeric_literal(const char* text, std::size_t length, bool allow_negative, 
+                char (&buffer)[max_numeric_literal_length + 1]) {
+            if(length == 0 || length > max_numeric_literal_length) return false;
+            const std::size_t first_digit = allow_negative && text[0] == '-' ? 1 : 0;
+            if(first_digit >= length || text[first_digit] < '0' || text[first_digit] > '9') return false;
+
+            std::memcpy(buffer, text, length);
+            buffer[length] = '\0';
+            return true;
+        }
+
+        /**
+         * Integer literals are always decimal, so that leading zeros do not make a literal octal, and 0x is not accepted.
+        */
+        template<typename T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, int>::type = 0>
+        bool parse_literal(const char* text, std::size_t length, T& out) {
+            char buffer[max_numeric_literal_length + 1];
+            if(!copy_numeric_literal(text, length, true, buffer)) return false;
+            char* end = nullptr;
+            errno = 0;
+            long long value = std::strtoll(buffer, &end, 10);
+            if(errno != 0 || end != buffer + length) return false;
+            if(value < std::numeric_limits<T>::min() || value > std::numeric_limits<T>::max()) return false;
+            out = static_cast<T>(value);
+            return true;
+        }
+
+        template<typename T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, int>::type = 0>
+        bool parse_literal(const char* text, std::size_t length, T& out) {
+            char buffer[max_numeric_literal_length + 1];
+            if(!copy_numeric_literal(text, length, false, buffer)) return false;
+            char* end = nullptr;
+            errno = 0;
+            unsigned long long value = std::strtoull(buffer, &end, 10);
+            if(errno != 0 || end != buffer + length) return false;
+            if(value > std::numeric_limits<T>::max()) return false;
+            out = static_cast<T>(value);
+            return true;
+        }
+
+        /**
+         * Floating-point literals are decimal, with an optional fraction and exponent. nan, inf, hexadecimal literals and
+         * literals that are out of the range of T are not accepted, so that a literal never gives a NaN or infinite value.
+        */
+        template<typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+        bool parse_literal(const char* text, std::size_t length, T& out) {
+            char buffer[max_numeric_literal_length + 1];
+            if(!copy_numeric_literal(text, length, true, buffer)) return false;
+            for(std::size_t i = 0; i < length; ++i) {
+                const char c = buffer[i];
+                if(!((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '-' || c == '+')) return false;
+            }
+
+            char* end = nullptr;
+            errno = 0;
+            long double value = std::strtold(buffer, &end);
+            if(errno != 0 || end != buffer + length) return false;
+            if(value > std::numeric_limits<T>::max() || value < std::numeric_limits<T>::lowest()) return false;
+            out = static_cast<T>(value);
+            return true;
+        }
+
+        /**
+         * Parses a double-quoted string literal. The escape sequences \" \\ \n and \t are supported.
+        */
+        inline bool parse_literal(const char* text, std::size_t length, std::string& out) {
+            if(length < 2 || text[0] != '"' || text[length - 1] != '"') return false;
+
+            out.clear();
+            out.reserve(length - 2);
+            for(std::size_t i = 1; i < length - 1; ++i) {
+                char c = text[i];
+                if(c == '\\') {
+                    if(++i >= length - 1) return false;
+                    switch(text[i]) {
+                        case 'n': c = '\n'; break;
+                        case 't': c = '\t'; break;
+                        case '"': c = '"'; break;
+                        case '\\': c = '\\'; break;
+                        default: return false;
+                    }
+                }
+                out.push_back(c);
+            }
+            return true;
+        }
+
+        /**
+         * The widest scalar field value, in bytes. Serialized trees hold scalar comparison values in slots of this size.
+        */
+        constexpr std::size_t max_field_value_size = 8;
+
+        template<typename T, typename = void>
+        struct has_literal_parser : std::false_type {};
+
+        template<typename T>
+        struct has_literal_parser<T, void_t<decltype(parse_literal(std::declval<const char*>(), std::size_t(), std::declval<T&>()))>>
+            : std::true_type {};
+
+        /**
+         * Whether field_registry supports fields of type T: T must have a literal parser, and be either a std::string or
+         * a scalar no wider than max_field_value_size (which excludes e.g. long double).
+        */
+        template<typename T>
+        struct is_supported_field
+            : std::integral_constant<bool, has_literal_parser<T>::value 
+                && (std::is_same<typename std::decay<T>::type, std::string>::value 
+                    || sizeof(typename std::decay<T>::type) <= max_field_value_size)> {};
+
+        /**
+         * Compares a field value against a comparison value using a built-in operator. std::string fields are compared
+         * against a string_ref, so that no std::string needs to be constructed for the comparison value.
+        */
+        template<typename T>
+        bool compare_builtin(const T& actual, comparator c, const T& value) {
+            switch(c) {
+                case comparator::equals: return actual == value;
+                case comparator::not_equals: return actual != value;
+                case comparator::less_than: return actual < value;
+                case comparator::greater_than: return actual > value;
+                default: throw std::logic_error("there is no built-in operator for a custom comparator");
+            }
+        }
+
+        inline bool compare_builtin(const std::string& actual, comparator c, const string_ref& value) {
+            const int result = -value.compare(actual);
+            switch(c) {
+                case comparator::equals: return result == 0;
+                case comparator::not_equals: return result != 0;
+                case comparator::less_than: return result < 0;
+                case comparator::greater_than: return result > 0;
+                default: throw std::logic_error("there is no built-in operator for a custom comparator");
+            }
+        }
+
+        template<typename T>
+        struct field_value_view {
+            using type = T;
+        };
+
+        template<>
+        struct field_value_view<std::string> {
+            using type = string_ref;
+        };
+    }
+
+    /**
+     * @brief The categories of value that a registered field may hold.
+    */
+    enum class value_kind : unsigned char {
+        boolean,
+        signed_integer,
+        unsigned_integer,
+        floating_point,
+        string
+    };
+
+    namespace detail {
+
+        template<typename T>
+        constexpr value_kind kind_of() {
+            return std::is_same<T, bool>::value ? value_kind::boolean
+                : std::is_same<T, std::string>::value ? value_kind::string
+                : std::is_floating_point<T>::value ? value_kind::floating_point
+                : std::is_signed<T>::value ? value_kind::signed_integer
+                : value_kind::unsigned_integer;
+        }
+    }
+
+    /**
+     * @brief A named member variable or const member function of Obj that has been added to a field_registry.
+    */
+    template<typename Obj>
+    class field {
+        public:
+            field(std::string name, std::size_t id)
+                : name_(std::move(name)),
+                  id_(id) {}
+
+            virtual ~field() = default;
+
+            const std::string& name() const {
+                return name_;
+            }
+
+            /**
+             * @brief The index of this field within its registry, in order of registration.
+            */
+            std::size_t id() const {
+                return id_;
+            }
+
+            virtual accessor_id accessor() const = 0;
+
+            virtual const std::type_info& value_type() const = 0;
+
+            virtual value_kind kind() const = 0;
+
+            /**
+             * @brief The size in bytes of this field's type. 
+            */
+            virtual std::size_t value_size() const = 0;
+
+            /**
+             * @brief Compares this field of the given object against a comparison value using a built-in operator.
+             * 
+             * @param value Points to a value of this field's type or, for std::string fields, to a string_ref
+            */
+            virtual bool compare(const Obj& obj, comparator c, const void* value) const = 0;
+
+            /**
+             * @brief Makes a heap-allocated leaf node that compares this field against the given literal using a built-in operator.
+             *
+             * @throws std::invalid_argument if the literal is not a valid value of this field's type
+            */
+            virtual node::expression_tree_node<Obj>* make_leaf(comparator c, const char* literal, std::size_t length) const = 0;
+
+        private:
+            std::string name_;
+            std::size_t id_;
+    };
+
+    namespace detail {
+
+        template<typename Obj, typename T, typename Accessor>
+        class typed_field : public field<Obj> {
+            public:
+                typed_field(std::string name, std::size_t id, accessor_id::kind kind, Accessor accessor)
+                    : field<Obj>(std::move(name), id),
+                      kind_(kind),
+                      accessor_(accessor) {}
+
+                accessor_id accessor() const override {
+                    return accessor_id(kind_, accessor_);
+                }
+
+                const std::type_info& value_type() const override {
+                    return typeid(T);
+                }
+
+                value_kind kind() const override {
+                    return kind_of<T>();
+                }
+
+                std::size_t value_size() const override {
+                    return sizeof(T);
+                }
+
+                bool compare(const Obj& obj, comparator c, const void* value) const override {
+                    // the value may live in a byte buffer (e.g. a mapped file), so it is copied out rather than dereferenced
+                    typename field_value_view<T>::type comp_value;
+                    std::memcpy(&comp_value, value, sizeof(comp_value));
+                    return compare_builtin(read_accessor(obj, accessor_), c, comp_value);
+                }
+
+                node::expression_tree_node<Obj>* make_leaf(comparator c, const char* literal, std::size_t length) const override {
+                    T value;
+                    if(!parse_literal(literal, length, value)) {
+                        throw std::invalid_argument("\"" + std::string(literal, length) + "\" is not a valid value for field " + this->name());
+                    }
+                    switch(c) {
+                        case comparator::equals: return make_expr(accessor_, op::equals, value);
+                        case comparator::not_equals: return make_expr(accessor_, op::not_equals, value);
+                        case comparator::less_than: return make_expr(accessor_, op::less_than, value);
+                        case comparator::greater_than: return make_expr(accessor_, op::greater_than, value);
+                        default: throw std::logic_error("there is no built-in operator for a custom comparator");
+                    }
+                }
+
+            private:
+                accessor_id::kind kind_;
+                Accessor accessor_;
+        };
+    }
+
+    /**
+     * @brief Maps names to the member variables and const member functions of Obj, so that expression trees can be
+     *        assembled at runtime (e.g. by parse_expr) from the names of fields.
+     *
+     *        Supported field types are bool, the integral and floating point types of at most 8 bytes (so not long double),
+     *        and std::string.
+    */
+    template<typename Obj>
+    class field_registry {
+        public:
+            /**
+             * @brief Registers a member variable of Obj under the given name.
+            */
+            template<typename T>
+            field_registry& add(std::string name, const T Obj::* member_var) {
+                static_assert(detail::is_supported_field<T>::value, "field_registry does not support fields of this type");
+                return add_field(std::unique_ptr<field<Obj>>(new detail::typed_field<Obj, T, const T Obj::*>(
+                    name, fields_.size(), accessor_id::kind::member_variable, member_var)));
+            }
+
+            /**
+             * @brief Registers a const member function of Obj under the given name.
+            */
+            template<typename T>
+            field_registry& add(std::string name, T (Obj::* member_func)() const) {
+                static_assert(detail::is_supported_field<T>::value, "field_registry does not support fields of this type");
+                return add_field(std::unique_ptr<field<Obj>>(new detail::typed_field<Obj, T, T (Obj::*)() const>(
+                    name, fields_.size(), accessor_id::kind::member_function, member_func)));
+            }
+
+            /**
+             * @returns The field registered under the given name, or nullptr if there is no such field
+            */
+            const field<Obj>* find(const char* name, std::size_t length) const {
+                auto it = by_name_.find(string_ref(name, length));
+                return it == by_name_.end() ? nullptr : it->second;
+            }
+
+            const field<Obj>* find(const std::string& name) const {
+                return find(name.data(), name.size());
+            }
+
+            /**
+             * @returns The field referencing the same member as the given accessor, or nullptr if there is no such field
+            */
+            const field<Obj>* find(const accessor_id& accessor) const {
+                for(auto& f : fields_) {
+                    if(f->accessor() == accessor) return f.get();
+                }
+                return nullptr;
+            }
+
+            /**
+             * @returns The field with the given id, or nullptr if there is no such field
+            */
+            const field<Obj>* at(std::size_t id) const {
+                return id < fields_.size() ? fields_[id].get() : nullptr;
+            }
+
+            std::size_t size() const {
+                return fields_.size();
+            }
+
+        private:
+            std::vector<std::unique_ptr<field<Obj>>> fields_;
+            std::map<std::string, const field<Obj>*, std::less<>> by_name_;
+
+            field_registry& add_field(std::unique_ptr<field<Obj>> f) {
+                if(by_name_.count(f->name())) {
+                    throw std::invalid_argument("a field named " + f->name() + " is already registered");
+                }
+                by_name_.emplace(f->name(), f.get());
+                fields_.push_back(std::move(f));
+                return *this;
+            }
+    };
+
+}
+}
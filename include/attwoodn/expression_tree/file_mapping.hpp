@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define ATTWOODN_EXPRESSION_TREE_HAS_MMAP 1
+#endif
+
+namespace attwoodn {
+namespace expression_tree {
+
+#ifdef ATTWOODN_EXPRESSION_TREE_HAS_MMAP
+
+    namespace detail {
+
+        /**
+         * A read-only, shared memory mapping of an entire file. Processes that map the same file share its physical pages.
+         * The mapping of an empty file has a size of 0 and null data.
+        */
+        class file_mapping {
+            public:
+                explicit file_mapping(const std::string& path) {
+                    int fd = ::open(path.c_str(), O_RDONLY);
+                    if(fd < 0) {
+                        throw std::runtime_error("failed to open " + path);
+                    }
+
+                    struct stat info;
+                    if(::fstat(fd, &info) != 0 || info.st_size < 0) {
+                        ::close(fd);
+                        throw std::runtime_error("failed to read the size of " + path);
+                    }
+
+                    // an empty file cannot be mapped, so it is represented by an empty mapping with no data
+                    size_ = static_cast<std::size_t>(info.st_size);
+                    if(size_ == 0) {
+                        ::close(fd);
+                        return;
+                    }
+
+                    data_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+                    ::close(fd);
+
+                    if(data_ == MAP_FAILED) {
+                        data_ = nullptr;
+                        throw std::runtime_error("failed to map " + path);
+                    }
+                }
+
+                file_mapping(const file_mapping&) = delete;
+                file_mapping& operator=(const file_mapping&) = delete;
+
+                ~file_mapping() {
+                    if(data_) {
+                        ::munmap(data_, size_);
+                    }
+                }
+
+                const void* data() const {
+                    return data_;
+                }
+
+                std::size_t size() const {
+                    return size_;
+                }
+
+                /**
+                 * Advises the kernel that the mapping will be read once from start to end, so that it reads ahead 
+                 * aggressively and drops pages behind the reader. Also requests transparent huge pages where they are 
+                 * supported, to reduce TLB misses. Both are hints, and failures are ignored.
+                */
+                void advise_sequential() const {
+                    if(!data_) {
+                        return;
+                    }
+#ifdef MADV_SEQUENTIAL
+                    ::madvise(data_, size_, MADV_SEQUENTIAL);
+#endif
+#ifdef MADV_HUGEPAGE
+                    ::madvise(data_, size_, MADV_HUGEPAGE);
+#endif
+                }
+
+            private:
+                void* data_ = nullptr;
+                std::size_t size_ = 0;
+        };
+    }
+
+#endif
+
+}
+}
@@ -0,0 +1,809 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace attwoodn {
+namespace expression_tree {
+
+    /**
+     * @brief How a flat_expression_tree combines the results of its leaves.
+     * 
+     *        short_circuit: each leaf jumps to the next leaf that could change the result, so no leaf is evaluated needlessly.
+     *                       Fast when leaf outcomes are predictable.
+     * 
+     *        branchless:    subtrees made up only of cheap leaves are evaluated in full, and their result is looked up in a
+     *                       truth table indexed by the leaf results, so no leaf outcome steers a branch. Fast when leaf 
+     *                       outcomes are close to random, and short-circuiting would cause frequent branch mispredictions.
+    */
+    enum class evaluation_mode : std::uint8_t {
+        short_circuit,
+        branchless
+    };
+
+namespace detail {
+
+    /**
+     * The closed set of leaf kinds understood by flat_expression_tree. Every kind except generic names the type of
+     * the member variable (or const member function return value) that the leaf compares against its comparison value.
+    */
+    enum class flat_leaf_kind : std::uint8_t {
+        generic,
+        boolean,
+        char_value,
+        signed_char,
+        unsigned_char,
+        short_int,
+        unsigned_short_int,
+        int_value,
+        unsigned_int,
+        long_int,
+        unsigned_long_int,
+        long_long_int,
+        unsigned_long_long_int,
+        float_value,
+        double_value,
+        string,
+        string_ref,
+        block
+    };
+
+    template<typename T> struct flat_kind_of;
+    template<> struct flat_kind_of<bool> : std::integral_constant<flat_leaf_kind, flat_leaf_kind::boolean> {};
+    template<> struct flat_kind_of<char> : std::integral_constant<flat_leaf_kind, flat_leaf_kind::char_value> {};
+    template<> struct flat_kind_of<signed char> : std::integral_constant<flat_leaf_kind, flat_leaf_kind::signed_char> {};
+    template<> struct flat_kind_of<unsigned char> : std::integral_constant<flat_leaf_kind, flat_leaf_kind::unsigned_char> {};
+    template<> struct flat_kind_of<short> : std::integral_constant<flat_leaf_kind, flat_leaf_kind::short_int> {};
+    template<> struct flat_kind_of<unsigned short> : std::integral_constant<flat_leaf_kind, flat_leaf_kind::unsigned_short_int> {};
+    template<> struct flat_kind_of<int> : std::integral_constant<flat_leaf_kind, flat_leaf_kind::int_value> {};
+    template<> struct flat_kind_of<unsigned int> : std::integral_constant<flat_leaf_kind, flat_leaf_kind::unsigned_int> {};
+    template<> struct flat_kind_of<long> : std::integral_constant<flat_leaf_kind, flat_leaf_kind::long_int> {};
+    template<> struct flat_kind_of<unsigned long> : std::integral_constant<flat_leaf_kind, flat_leaf_kind::unsigned_long_int> {};
+    template<> struct flat_kind_of<long long> : std::integral_constant<flat_leaf_kind, flat_leaf_kind::long_long_int> {};
+    template<> struct flat_kind_of<unsigned long long> : std::integral_constant<flat_leaf_kind, flat_leaf_kind::unsigned_long_long_int> {};
+    template<> struct flat_kind_of<float> : std::integral_constant<flat_leaf_kind, flat_leaf_kind::float_value> {};
+    template<> struct flat_kind_of<double> : std::integral_constant<flat_leaf_kind, flat_leaf_kind::double_value> {};
+    template<> struct flat_kind_of<std::string> : std::integral_constant<flat_leaf_kind, flat_leaf_kind::string> {};
+
+    /**
+     * One leaf of a flat_expression_tree, together with the short-circuit jump targets of the branching program it was
+     * compiled into. The member pointer and comparison value are held in raw storage whose type is given by kind, i.e.
+     * a tagged union. Scalar comparison values are held inline. A string or string_ref comparison value is referenced in the 
+     * leaf node it was compiled from, and generic leaves refer to that node for evaluation.
+     * 
+     * A leaf of kind block stands for a whole subtree of cheap leaves that is evaluated without branching. Its value holds
+     * the index of a flat_block.
+    */
+    template<typename Obj>
+    struct flat_leaf {
+        struct any_class;
+
+        flat_leaf_kind kind;
+        comparator op;
+        bool is_member_function;
+        std::int32_t on_true;
+        std::int32_t on_false;
+        unsigned char accessor[sizeof(int (any_class::*)() const)];
+        unsigned char value[8];
+        const node::expression_tree_node<Obj>* n;
+    };
+
+    /**
+     * The most leaves and constants that a branchless block may contain. The result of a block is looked up in a truth 
+     * table that has one bit for each combination of its leaves' results. Larger cheap subtrees are split into blocks.
+    */
+    constexpr std::size_t flat_block_max_leaves = 10;
+
+    /**
+     * One leaf of a branchless block. Every block leaf compares a scalar member variable, whose type and comparator are 
+     * given by the run of leaves it belongs to. bit is the position of the leaf's result in the index of the block's truth table.
+    */
+    template<typename Obj>
+    struct flat_block_leaf {
+        std::uint8_t bit;
+        unsigned char accessor[sizeof(int (flat_leaf<Obj>::any_class::*)() const)];
+        unsigned char value[8];
+    };
+
+    /**
+     * A run of consecutive block leaves of the same kind that use the same comparator, so that the kind and the comparator
+     * are dispatched on once per run rather than once per leaf.
+    */
+    struct flat_block_run {
+        flat_leaf_kind kind;
+        comparator op;
+        std::uint32_t first;
+        std::uint32_t count;
+    };
+
+    struct flat_block {
+        std::uint32_t first_run;
+        std::uint32_t run_count;
+        std::uint32_t table;
+    };
+
+    /**
+     * The estimated cost of a branch misprediction, as a number of block leaf evaluations (including each leaf's share of
+     * the dispatch on its run). Measured using tests/branchless_benchmark.cpp. Used by flat_expression_tree::calibrate.
+    */
+    constexpr double flat_misprediction_cost = 3.0;
+
+    template<typename T>
+    bool flat_compare(comparator op, const T& a, const T& b) {
+        switch(op) {
+            case comparator::equals: return a == b;
+            case comparator::not_equals: return a != b;
+            case comparator::less_than: return a < b;
+            default: return b < a;
+        }
+    }
+
+    /**
+     * Evaluates a run of block leaves that compare member variables of type T using the same comparator, and returns 
+     * their results as bits. The comparator is a template parameter so that each comparison compiles to a flag-setting 
+     * instruction rather than to a branch.
+    */
+    template<typename Obj, typename T, typename Compare>
+    std::uint32_t flat_block_run_bits(const flat_block_leaf<Obj>* leaves, std::uint32_t count, const Obj& obj, Compare compare) {
+        std::uint32_t bits = 0;
+        for(std::uint32_t i = 0; i < count; ++i) {
+            T value;
+            std::memcpy(&value, leaves[i].value, sizeof(T));
+
+            const T Obj::* member_var;
+            std::memcpy(&member_var, leaves[i].accessor, sizeof(member_var));
+            bits |= static_cast<std::uint32_t>(compare(obj.*member_var, value)) << leaves[i].bit;
+        }
+        return bits;
+    }
+
+    template<typename Obj, typename T>
+    std::uint32_t flat_block_run_bits(const flat_block_run& run, const flat_block_leaf<Obj>* leaves, const Obj& obj) {
+        switch(run.op) {
+            case comparator::equals: return flat_block_run_bits<Obj, T>(leaves, run.count, obj, std::equal_to<T>());
+            case comparator::not_equals: return flat_block_run_bits<Obj, T>(leaves, run.count, obj, std::not_equal_to<T>());
+            case comparator::less_than: return flat_block_run_bits<Obj, T>(leaves, run.count, obj, std::less<T>());
+            default: return flat_block_run_bits<Obj, T>(leaves, run.count, obj, std::greater<T>());
+        }
+    }
+
+    template<typename Obj, typename T>
+    bool flat_compare_scalar(const flat_leaf<Obj>& leaf, const Obj& obj) {
+        T value;
+        std::memcpy(&value, leaf.value, sizeof(T));
+
+        if(leaf.is_member_function) {
+            T (Obj::* member_func)() const;
+            std::memcpy(&member_func, leaf.accessor, sizeof(member_func));
+            return flat_compare(leaf.op, (obj.*member_func)(), value);
+        }
+
+        const T Obj::* member_var;
+        std::memcpy(&member_var, leaf.accessor, sizeof(member_var));
+        return flat_compare(leaf.op, obj.*member_var, value);
+    }
+
+    /**
+     * Compares a std::string member with a comparison value of type V, which is either a std::string or a non-null string_ref.
+    */
+    template<typename Obj, typename V>
+    bool flat_compare_string(const flat_leaf<Obj>& leaf, const Obj& obj) {
+        const V* value;
+        std::memcpy(&value, leaf.value, sizeof(value));
+
+        if(leaf.is_member_function) {
+            std::string (Obj::* member_func)() const;
+            std::memcpy(&member_func, leaf.accessor, sizeof(member_func));
+            return flat_compare<V>(leaf.op, (obj.*member_func)(), *value);
+        }
+
+        const std::string Obj::* member_var;
+        std::memcpy(&member_var, leaf.accessor, sizeof(member_var));
+        return flat_compare<V>(leaf.op, obj.*member_var, *value);
+    }
+
+    template<typename Obj, typename T>
+    void store_flat_value(flat_leaf<Obj>& out, const T* value) {
+        static_assert(sizeof(T) <= sizeof(out.value), "flat leaf value is too large");
+        std::memcpy(out.value, value, sizeof(T));
+    }
+
+    template<typename Obj>
+    void store_flat_value(flat_leaf<Obj>& out, const std::string* value) {
+        std::memcpy(out.value, &value, sizeof(value));
+    }
+
+    /**
+     * Attempts to describe the given leaf node as a flat leaf of kind flat_kind_of<T>. This succeeds when the leaf uses a
+     * built-in comparator, and reads a T from a member variable or const member function in order to compare it to a T.
+    */
+    template<typename Obj, typename T>
+    bool flatten_leaf_as(const node::expression_tree_leaf_node_base<Obj>& leaf, flat_leaf<Obj>& out) {
+        if(leaf.comp_value_type() != typeid(T)) {
+            return false;
+        }
+
+        const accessor_id accessor = leaf.get_accessor();
+        const T Obj::* member_var;
+        T (Obj::* member_func)() const;
+
+        if(accessor.get(member_var)) {
+            out.is_member_function = false;
+            std::memcpy(out.accessor, &member_var, sizeof(member_var));
+        } else if(accessor.get(member_func)) {
+            out.is_member_function = true;
+            std::memcpy(out.accessor, &member_func, sizeof(member_func));
+        } else {
+            return false;
+        }
+
+        store_flat_value(out, static_cast<const T*>(leaf.comp_value_ptr()));
+        out.kind = flat_kind_of<T>::value;
+        out.op = leaf.get_comparator();
+        return true;
+    }
+
+    /**
+     * Attempts to describe the given leaf node as a flat leaf of kind string_ref. This succeeds when the leaf reads a
+     * std::string from a member variable or const member function in order to compare it to a non-null string_ref. Leaves
+     * with a null string_ref follow the null rules of the built-in operators, so they are kept as generic leaves.
+    */
+    template<typename Obj>
+    bool flatten_string_ref_leaf(const node::expression_tree_leaf_node_base<Obj>& leaf, flat_leaf<Obj>& out) {
+        if(leaf.comp_value_type() != typeid(string_ref)) {
+            return false;
+        }
+
+        const string_ref* value = static_cast<const string_ref*>(leaf.comp_value_ptr());
+        if(value->is_null()) {
+            return false;
+        }
+
+        const accessor_id accessor = leaf.get_accessor();
+        const std::string Obj::* member_var;
+        std::string (Obj::* member_func)() const;
+
+        if(accessor.get(member_var)) {
+            out.is_member_function = false;
+            std::memcpy(out.accessor, &member_var, sizeof(member_var));
+        } else if(accessor.get(member_func)) {
+            out.is_member_function = true;
+            std::memcpy(out.accessor, &member_func, sizeof(member_func));
+        } else {
+            return false;
+        }
+
+        std::memcpy(out.value, &value, sizeof(value));
+        out.kind = flat_leaf_kind::string_ref;
+        out.op = leaf.get_comparator();
+        return true;
+    }
+
+    template<typename Obj>
+    bool flatten_leaf(const node::expression_tree_leaf_node_base<Obj>& leaf, flat_leaf<Obj>& out) {
+        if(leaf.get_comparator() == comparator::custom) {
+            return false;
+        }
+
+        return flatten_leaf_as<Obj, bool>(leaf, out)
+            || flatten_leaf_as<Obj, char>(leaf, out)
+            || flatten_leaf_as<Obj, signed char>(leaf, out)
+            || flatten_leaf_as<Obj, unsigned char>(leaf, out)
+            || flatten_leaf_as<Obj, short>(leaf, out)
+            || flatten_leaf_as<Obj, unsigned short>(leaf, out)
+            || flatten_leaf_as<Obj, int>(leaf, out)
+            || flatten_leaf_as<Obj, unsigned int>(leaf, out)
+            || flatten_leaf_as<Obj, long>(leaf, out)
+            || flatten_leaf_as<Obj, unsigned long>(leaf, out)
+            || flatten_leaf_as<Obj, long long>(leaf, out)
+            || flatten_leaf_as<Obj, unsigned long long>(leaf, out)
+            || flatten_leaf_as<Obj, float>(leaf, out)
+            || flatten_leaf_as<Obj, double>(leaf, out)
+            || flatten_leaf_as<Obj, std::string>(leaf, out)
+            || flatten_string_ref_leaf(leaf, out);
+    }
+
+}
+
+    /**
+     * @brief A devirtualized copy of an expression tree, for trees that are built at runtime (e.g. using parse_expr, or by
+     *        combining nodes created with make_expr in a loop).
+     *
+     *        The tree is compiled into a contiguous vector of leaves, where each leaf is a tagged union over a closed set of
+     *        leaf kinds: one kind for each built-in scalar type, std::string and string_ref, compared using one of the built-in operators
+     *        of the op namespace. Op nodes are compiled into short-circuit jump targets between the leaves, and constant nodes
+     *        are folded away. Evaluation is a single loop that switches on the kind of each leaf, so it makes no virtual calls
+     *        and needs no stack.
+     *
+     *        Leaves that do not fit the closed set, such as leaves with custom operators or pointer comparison values, are kept
+     *        as generic leaves that evaluate the original leaf node.
+     * 
+     *        In evaluation_mode::branchless, the largest subtrees of at most 10 leaves that all compare scalar member 
+     *        variables are evaluated in full without branching, and short-circuit jumps are kept only around the remaining, more expensive 
+     *        leaves (strings, const member functions, and generic leaves). Both modes always return the same result. The
+     *        calibrate function chooses the mode that is expected to be faster for a sample of objects.
+    */
+    template<typename Obj>
+    class flat_expression_tree {
+        public:
+            flat_expression_tree() = delete;
+
+            explicit flat_expression_tree(const expression_tree<Obj>& tree, evaluation_mode mode = evaluation_mode::short_circuit)
+                : tree_(tree),
+                  mode_(mode) {
+                compile();
+            }
+
+            explicit flat_expression_tree(expression_tree<Obj>&& tree, evaluation_mode mode = evaluation_mode::short_circuit)
+                : tree_(std::move(tree)),
+                  mode_(mode) {
+                compile();
+            }
+
+            flat_expression_tree(const flat_expression_tree& other)
+                : tree_(other.tree_),
+                  mode_(other.mode_) {
+                compile();
+            }
+
+            flat_expression_tree(flat_expression_tree&& other) noexcept = default;
+
+            flat_expression_tree& operator=(const flat_expression_tree& other) {
+                if(this != &other) {
+                    flat_expression_tree copy(other);
+                    *this = std::move(copy);
+                }
+                return *this;
+            }
+
+            flat_expression_tree& operator=(flat_expression_tree&& other) noexcept = default;
+
+            /**
+             * @brief Evaluates the given object to determine if it satisfies the expressions defined in this expression tree.
+             *        Leaves that throw an exception evaluate to false, in which case the whole tree evaluates to false.
+            */
+            bool evaluate(const Obj& obj) const {
+                try {
+                    return evaluate_unchecked(obj);
+                } catch(std::exception& e) {
+                    return false;
+                }
+            }
+
+            /**
+             * @brief Evaluates a batch of objects.
+             *
+             * @param objs    An array of count pointers to the objects to evaluate
+             * @param results An array of count bools. Each result is set to the outcome of evaluating the object at the same index
+            */
+            void evaluate_batch(const Obj* const* objs, std::size_t count, bool* results) const {
+                for(std::size_t i = 0; i < count; ++i) {
+                    results[i] = evaluate(*objs[i]);
+                }
+            }
+
+            /**
+             * @brief The number of leaves that the tree was compiled into, after constant nodes were folded away.
+            */
+            std::size_t leaf_count() const {
+                return leaves_.size();
+            }
+
+            /**
+             * @brief The number of leaves that did not fit the closed set of leaf kinds, and are evaluated using a virtual call.
+            */
+            std::size_t generic_leaf_count() const {
+                std::size_t count = 0;
+                for(auto& leaf : leaves_) {
+                    if(leaf.kind == detail::flat_leaf_kind::generic) ++count;
+                }
+                return count;
+            }
+
+            /**
+             * @brief The number of subtrees that are evaluated without branching in evaluation_mode::branchless.
+            */
+            std::size_t block_count() const {
+                std::size_t count = 0;
+                for(auto& leaf : branchless_leaves_) {
+                    if(leaf.kind == detail::flat_leaf_kind::block) ++count;
+                }
+                return count;
+            }
+
+            evaluation_mode mode() const {
+                return mode_;
+            }
+
+            void set_mode(evaluation_mode mode) {
+                mode_ = mode;
+            }
+
+            /**
+             * @brief Chooses the evaluation mode that is expected to be faster for objects like the given sample, and switches 
+             *        to it.
+             * 
+             *        The sample is evaluated by short-circuiting, while recording how often each cheap leaf is evaluated and 
+             *        how often it is true. A leaf that is true with probability p is assumed to mispredict with probability 
+             *        min(p, 1 - p). The sample is then evaluated by the branchless program, while recording how many block 
+             *        leaves it evaluates. Branchless evaluation is chosen if the expected cost of the mispredictions exceeds 
+             *        the cost of evaluating the block leaves that short-circuiting would have skipped.
+             * 
+             * @param objs  An array of count pointers to the sample objects
+             * @returns The chosen mode
+            */
+            evaluation_mode calibrate(const Obj* const* objs, std::size_t count) {
+                std::vector<std::uint64_t> evaluated(leaves_.size(), 0);
+                std::vector<std::uint64_t> true_counts(leaves_.size(), 0);
+                double block_leaves_evaluated = 0;
+
+                for(std::size_t i = 0; i < count; ++i) {
+                    try {
+                        std::int32_t pc = entry_;
+                        while(pc >= 0) {
+                            const bool result = evaluate_leaf(leaves_[pc], *objs[i]);
+                            ++evaluated[pc];
+                            true_counts[pc] += result;
+                            pc = result ? leaves_[pc].on_true : leaves_[pc].on_false;
+                        }
+
+                        // blocks are skipped by the branchless program in the same way as single leaves
+                        pc = branchless_entry_;
+                        while(pc >= 0) {
+                            const detail::flat_leaf<Obj>& leaf = branchless_leaves_[pc];
+                            if(leaf.kind == detail::flat_leaf_kind::block) {
+                                block_leaves_evaluated += static_cast<double>(block_size(leaf));
+                            }
+                            pc = evaluate_leaf(leaf, *objs[i]) ? leaf.on_true : leaf.on_false;
+                        }
+                    } catch(std::exception& e) {
+                        continue;
+                    }
+                }
+
+                double mispredictions = 0;
+                double extra = block_leaves_evaluated;
+                for(std::size_t i = 0; i < leaves_.size(); ++i) {
+                    if(in_block_[i]) {
+                        mispredictions += static_cast<double>(std::min(true_counts[i], evaluated[i] - true_counts[i]));
+                        extra -= static_cast<double>(evaluated[i]);
+                    }
+                }
+
+                mode_ = mispredictions * detail::flat_misprediction_cost > extra 
+                    ? evaluation_mode::branchless 
+                    : evaluation_mode::short_circuit;
+                return mode_;
+            }
+
+            /**
+             * @brief Returns the expression tree that this flat tree was compiled from.
+            */
+            const expression_tree<Obj>& tree() const {
+                return tree_;
+            }
+
+        private:
+            expression_tree<Obj> tree_;
+            evaluation_mode mode_;
+
+            // the short-circuit program, and whether each of its leaves belongs to a block of the branchless program
+            std::vector<detail::flat_leaf<Obj>> leaves_;
+            std::int32_t entry_ = detail::branch_reject;
+            std::vector<bool> in_block_;
+
+            // the branchless program. Its blocks refer to runs of block leaves, and to truth tables
+            std::vector<detail::flat_leaf<Obj>> branchless_leaves_;
+            std::int32_t branchless_entry_ = detail::branch_reject;
+            std::vector<detail::flat_block> blocks_;
+            std::vector<detail::flat_block_run> block_runs_;
+            std::vector<detail::flat_block_leaf<Obj>> block_leaves_;
+            std::vector<std::uint8_t> block_tables_;
+
+            static detail::flat_leaf<Obj> flatten(const detail::branch<Obj>& b) {
+                detail::flat_leaf<Obj> leaf {};
+                leaf.kind = detail::flat_leaf_kind::generic;
+                leaf.on_true = b.on_true;
+                leaf.on_false = b.on_false;
+                leaf.n = b.test;
+
+                auto* leaf_node = dynamic_cast<const node::expression_tree_leaf_node_base<Obj>*>(b.test);
+                if(leaf_node) {
+                    detail::flatten_leaf(*leaf_node, leaf);
+                }
+                return leaf;
+            }
+
+            /**
+             * A leaf is cheap if it compares a scalar member variable using a built-in operator, so that evaluating it
+             * costs less than a mispredicted branch, and it cannot throw.
+            */
+            static bool is_cheap_leaf(const detail::flat_leaf<Obj>& leaf) {
+                return leaf.kind != detail::flat_leaf_kind::generic && leaf.kind != detail::flat_leaf_kind::string 
+                    && leaf.kind != detail::flat_leaf_kind::string_ref && !leaf.is_member_function;
+            }
+
+            void compile() {
+                const auto program = detail::compile_branches(tree_.root());
+                entry_ = program.entry;
+
+                leaves_.clear();
+                leaves_.reserve(program.branches.size());
+                for(auto& b : program.branches) {
+                    leaves_.push_back(flatten(b));
+                }
+
+                compile_branchless();
+            }
+
+            /**
+             * Finds the cheap subtrees of the tree (along with the number of leaves and constants in each), and compiles 
+             * the largest of them that fit in a block into blocks.
+            */
+            void compile_branchless() {
+                struct frame {
+                    const node::expression_tree_node<Obj>* n;
+                    bool expanded;
+                };
+
+                std::map<const node::expression_tree_node<Obj>*, std::size_t> cheap_size;
+                std::vector<frame> pending { frame { &tree_.root(), false } };
+                while(!pending.empty()) {
+                    const frame current = pending.back();
+                    auto* op_node = dynamic_cast<const node::expression_tree_op_node_base<Obj>*>(current.n);
+
+                    if(op_node && op_node->get_left() && op_node->get_right()) {
+                        if(!current.expanded) {
+                            pending.back().expanded = true;
+                            pending.push_back(frame { op_node->get_right(), false });
+                            pending.push_back(frame { op_node->get_left(), false });
+                            continue;
+                        }
+
+                        pending.pop_back();
+                        auto left = cheap_size.find(op_node->get_left());
+                        auto right = cheap_size.find(op_node->get_right());
+                        if(left != cheap_size.end() && right != cheap_size.end() 
+                                && left->second + right->second <= detail::flat_block_max_leaves) {
+                            cheap_size[current.n] = left->second + right->second;
+                        }
+                        continue;
+                    }
+
+                    pending.pop_back();
+                    if(dynamic_cast<const node::expression_tree_constant_node<Obj>*>(current.n)
+                            || (!op_node && is_cheap_leaf(flatten(detail::branch<Obj> { current.n, 0, 0 })))) {
+                        cheap_size[current.n] = 1;
+                    }
+                }
+
+                auto is_block = [&cheap_size](const node::expression_tree_op_node_base<Obj>& op_node) {
+                    return cheap_size.count(&op_node) != 0;
+                };
+                const auto program = detail::compile_branches(tree_.root(), is_block);
+                branchless_entry_ = program.entry;
+
+                branchless_leaves_.clear();
+                blocks_.clear();
+                block_runs_.clear();
+                block_leaves_.clear();
+                block_tables_.clear();
+                std::vector<const node::expression_tree_node<Obj>*> block_members;
+
+                for(auto& b : program.branches) {
+                    auto* op_node = dynamic_cast<const node::expression_tree_op_node_base<Obj>*>(b.test);
+                    if(!op_node || !is_block(*op_node)) {
+                        branchless_leaves_.push_back(flatten(b));
+                        continue;
+                    }
+
+                    detail::flat_leaf<Obj> block {};
+                    block.kind = detail::flat_leaf_kind::block;
+                    block.on_true = b.on_true;
+                    block.on_false = b.on_false;
+                    block.n = b.test;
+
+                    const auto index = static_cast<std::uint32_t>(blocks_.size());
+                    std::memcpy(block.value, &index, sizeof(index));
+                    compile_block(*op_node, block_members);
+                    branchless_leaves_.push_back(block);
+                }
+
+                std::sort(block_members.begin(), block_members.end());
+                in_block_.assign(leaves_.size(), false);
+                for(std::size_t i = 0; i < leaves_.size(); ++i) {
+                    in_block_[i] = std::binary_search(block_members.begin(), block_members.end(), leaves_[i].n);
+                }
+            }
+
+            /**
+             * Compiles the given cheap subtree into a block: its leaves, grouped into runs of the same kind, and the truth
+             * table of the subtree over the results of its leaves. The leaves are appended to members.
+            */
+            void compile_block(const node::expression_tree_node<Obj>& root, std::vector<const node::expression_tree_node<Obj>*>& members) {
+                struct frame {
+                    const node::expression_tree_node<Obj>* n;
+                    bool expanded;
+                };
+
+                // the subtree in postfix order. Non-negative steps push the result of the leaf with that bit, and
+                // negative steps push a constant or combine the top two results
+                enum : int { push_false = -1, push_true = -2, and_step = -3, or_step = -4 };
+                std::vector<int> steps;
+                std::vector<detail::flat_leaf<Obj>> leaves;
+
+                std::vector<frame> pending { frame { &root, false } };
+                while(!pending.empty()) {
+                    const frame current = pending.back();
+                    auto* op_node = dynamic_cast<const node::expression_tree_op_node_base<Obj>*>(current.n);
+
+                    if(op_node) {
+                        if(!current.expanded) {
+                            pending.back().expanded = true;
+                            pending.push_back(frame { op_node->get_right(), false });
+                            pending.push_back(frame { op_node->get_left(), false });
+                            continue;
+                        }
+
+                        pending.pop_back();
+                        steps.push_back(op_node->get_bool_op() == node::boolean_op::AND ? and_step : or_step);
+                        continue;
+                    }
+
+                    pending.pop_back();
+                    if(auto* constant = dynamic_cast<const node::expression_tree_constant_node<Obj>*>(current.n)) {
+                        steps.push_back(constant->get_value() ? push_true : push_false);
+                        continue;
+                    }
+
+                    steps.push_back(static_cast<int>(leaves.size()));
+                    leaves.push_back(flatten(detail::branch<Obj> { current.n, 0, 0 }));
+                    members.push_back(current.n);
+                }
+
+                detail::flat_block block { static_cast<std::uint32_t>(block_runs_.size()), 0, 
+                    static_cast<std::uint32_t>(block_tables_.size()) };
+
+                // group the leaves into runs by kind and comparator, keeping the bit of each leaf
+                std::vector<std::uint8_t> order(leaves.size());
+                for(std::size_t i = 0; i < leaves.size(); ++i) {
+                    order[i] = static_cast<std::uint8_t>(i);
+                }
+                std::sort(order.begin(), order.end(), [&leaves](std::uint8_t a, std::uint8_t b) {
+                    return std::make_tuple(leaves[a].kind, leaves[a].op, a) < std::make_tuple(leaves[b].kind, leaves[b].op, b);
+                });
+                for(auto bit : order) {
+                    const detail::flat_leaf<Obj>& leaf = leaves[bit];
+                    if(block.run_count == 0 || block_runs_.back().kind != leaf.kind || block_runs_.back().op != leaf.op) {
+                        block_runs_.push_back(detail::flat_block_run { leaf.kind, leaf.op, 
+                            static_cast<std::uint32_t>(block_leaves_.size()), 0 });
+                        ++block.run_count;
+                    }
+                    ++block_runs_.back().count;
+
+                    detail::flat_block_leaf<Obj> block_leaf {};
+                    block_leaf.bit = bit;
+                    std::memcpy(block_leaf.accessor, leaf.accessor, sizeof(block_leaf.accessor));
+                    std::memcpy(block_leaf.value, leaf.value, sizeof(block_leaf.value));
+                    block_leaves_.push_back(block_leaf);
+                }
+
+                // evaluate the subtree for every combination of leaf results
+                const std::size_t combinations = std::size_t(1) << leaves.size();
+                block_tables_.resize(block_tables_.size() + (combinations + 7) / 8, 0);
+                std::vector<bool> results;
+                for(std::size_t bits = 0; bits < combinations; ++bits) {
+                    results.clear();
+                    for(int step : steps) {
+                        if(step >= 0) {
+                            results.push_back(((bits >> step) & 1) != 0);
+                        } else if(step == push_false || step == push_true) {
+                            results.push_back(step == push_true);
+                        } else {
+                            const bool right = results.back();
+                            results.pop_back();
+                            results.back() = step == and_step ? (results.back() && right) : (results.back() || right);
+                        }
+                    }
+
+                    if(results.back()) {
+                        block_tables_[block.table + bits / 8] |= static_cast<std::uint8_t>(1u << (bits % 8));
+                    }
+                }
+
+                blocks_.push_back(block);
+            }
+
+            bool evaluate_unchecked(const Obj& obj) const {
+                const bool branchless = mode_ == evaluation_mode::branchless;
+                const detail::flat_leaf<Obj>* leaves = branchless ? branchless_leaves_.data() : leaves_.data();
+                std::int32_t pc = branchless ? branchless_entry_ : entry_;
+
+                while(pc >= 0) {
+                    const detail::flat_leaf<Obj>& leaf = leaves[pc];
+                    pc = evaluate_leaf(leaf, obj) ? leaf.on_true : leaf.on_false;
+                }
+                return pc == detail::branch_accept;
+            }
+
+            bool evaluate_leaf(const detail::flat_leaf<Obj>& leaf, const Obj& obj) const {
+                switch(leaf.kind) {
+                    case detail::flat_leaf_kind::boolean: return detail::flat_compare_scalar<Obj, bool>(leaf, obj);
+                    case detail::flat_leaf_kind::char_value: return detail::flat_compare_scalar<Obj, char>(leaf, obj);
+                    case detail::flat_leaf_kind::signed_char: return detail::flat_compare_scalar<Obj, signed char>(leaf, obj);
+                    case detail::flat_leaf_kind::unsigned_char: return detail::flat_compare_scalar<Obj, unsigned char>(leaf, obj);
+                    case detail::flat_leaf_kind::short_int: return detail::flat_compare_scalar<Obj, short>(leaf, obj);
+                    case detail::flat_leaf_kind::unsigned_short_int: return detail::flat_compare_scalar<Obj, unsigned short>(leaf, obj);
+                    case detail::flat_leaf_kind::int_value: return detail::flat_compare_scalar<Obj, int>(leaf, obj);
+                    case detail::flat_leaf_kind::unsigned_int: return detail::flat_compare_scalar<Obj, unsigned int>(leaf, obj);
+                    case detail::flat_leaf_kind::long_int: return detail::flat_compare_scalar<Obj, long>(leaf, obj);
+                    case detail::flat_leaf_kind::unsigned_long_int: return detail::flat_compare_scalar<Obj, unsigned long>(leaf, obj);
+                    case detail::flat_leaf_kind::long_long_int: return detail::flat_compare_scalar<Obj, long long>(leaf, obj);
+                    case detail::flat_leaf_kind::unsigned_long_long_int: return detail::flat_compare_scalar<Obj, unsigned long long>(leaf, obj);
+                    case detail::flat_leaf_kind::float_value: return detail::flat_compare_scalar<Obj, float>(leaf, obj);
+                    case detail::flat_leaf_kind::double_value: return detail::flat_compare_scalar<Obj, double>(leaf, obj);
+                    case detail::flat_leaf_kind::string: return detail::flat_compare_string<Obj, std::string>(leaf, obj);
+                    case detail::flat_leaf_kind::string_ref: return detail::flat_compare_string<Obj, string_ref>(leaf, obj);
+                    case detail::flat_leaf_kind::block: return evaluate_block(leaf, obj);
+                    default: return leaf.n->evaluate(obj);
+                }
+            }
+
+            std::size_t block_size(const detail::flat_leaf<Obj>& leaf) const {
+                std::uint32_t index;
+                std::memcpy(&index, leaf.value, sizeof(index));
+                const detail::flat_block& block = blocks_[index];
+
+                std::size_t size = 0;
+                for(std::uint32_t r = block.first_run; r < block.first_run + block.run_count; ++r) {
+                    size += block_runs_[r].count;
+                }
+                return size;
+            }
+
+            /**
+             * Evaluates every leaf of a block, run by run, and looks up the block's result in its truth table.
+            */
+            bool evaluate_block(const detail::flat_leaf<Obj>& leaf, const Obj& obj) const {
+                std::uint32_t index;
+                std::memcpy(&index, leaf.value, sizeof(index));
+                const detail::flat_block& block = blocks_[index];
+
+                std::uint32_t bits = 0;
+                for(std::uint32_t r = block.first_run; r < block.first_run + block.run_count; ++r) {
+                    const detail::flat_block_run& run = block_runs_[r];
+                    const detail::flat_block_leaf<Obj>* leaves = block_leaves_.data() + run.first;
+
+                    switch(run.kind) {
+                        case detail::flat_leaf_kind::boolean: bits |= detail::flat_block_run_bits<Obj, bool>(run, leaves, obj); break;
+                        case detail::flat_leaf_kind::char_value: bits |= detail::flat_block_run_bits<Obj, char>(run, leaves, obj); break;
+                        case detail::flat_leaf_kind::signed_char: bits |= detail::flat_block_run_bits<Obj, signed char>(run, leaves, obj); break;
+                        case detail::flat_leaf_kind::unsigned_char: bits |= detail::flat_block_run_bits<Obj, unsigned char>(run, leaves, obj); break;
+                        case detail::flat_leaf_kind::short_int: bits |= detail::flat_block_run_bits<Obj, short>(run, leaves, obj); break;
+                        case detail::flat_leaf_kind::unsigned_short_int: bits |= detail::flat_block_run_bits<Obj, unsigned short>(run, leaves, obj); break;
+                        case detail::flat_leaf_kind::int_value: bits |= detail::flat_block_run_bits<Obj, int>(run, leaves, obj); break;
+                        case detail::flat_leaf_kind::unsigned_int: bits |= detail::flat_block_run_bits<Obj, unsigned int>(run, leaves, obj); break;
+                        case detail::flat_leaf_kind::long_int: bits |= detail::flat_block_run_bits<Obj, long>(run, leaves, obj); break;
+                        case detail::flat_leaf_kind::unsigned_long_int: bits |= detail::flat_block_run_bits<Obj, unsigned long>(run, leaves, obj); break;
+                        case detail::flat_leaf_kind::long_long_int: bits |= detail::flat_block_run_bits<Obj, long long>(run, leaves, obj); break;
+                        case detail::flat_leaf_kind::unsigned_long_long_int: bits |= detail::flat_block_run_bits<Obj, unsigned long long>(run, leaves, obj); break;
+                        case detail::flat_leaf_kind::float_value: bits |= detail::flat_block_run_bits<Obj, float>(run, leaves, obj); break;
+                        default: bits |= detail::flat_block_run_bits<Obj, double>(run, leaves, obj); break;
+                    }
+                }
+
+                return ((block_tables_[block.table + bits / 8] >> (bits % 8)) & 1u) != 0;
+            }
+    };
+
+}
+}
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+namespace attwoodn {
+namespace expression_tree {
+
+    /**
+     * @brief Evaluates long-lived objects against an expression tree, and re-evaluates them after an update by recomputing
+     *        only the leaves that read the changed members, and the op nodes above them whose results changed.
+     *
+     *        The evaluator keeps the last result of every node of the tree for each object slot. Callers assign each of their
+     *        objects a slot index, fully evaluate the object once using evaluate, and then call update with the members that
+     *        changed whenever the object is modified.
+     *
+     *        A leaf that calls a const member function cannot know which members the function reads. Such leaves are
+     *        re-evaluated by every update, unless the members they depend on are declared using add_dependency. Leaves that
+     *        throw an exception evaluate to false.
+    */
+    template<typename Obj>
+    class incremental_evaluator {
+        public:
+            incremental_evaluator() = delete;
+
+            explicit incremental_evaluator(const expression_tree<Obj>& tree)
+                : tree_(tree) {
+                flatten();
+            }
+
+            /**
+             * @brief Declares that the leaves calling the given const member function only need to be re-evaluated when
+             *        the given member (or the member function itself) is passed to update.
+            */
+            template<typename Getter, typename Member>
+            incremental_evaluator& add_dependency(Getter getter, Member member) {
+                const accessor_id getter_id = accessor_of(getter);
+                auto it = leaves_by_accessor_.find(getter_id);
+                if(it == leaves_by_accessor_.end()) {
+                    return *this;
+                }
+
+                for(auto index : it->second) {
+                    nodes_[index].is_volatile = false;
+                }
+                volatile_leaves_.clear();
+                for(std::size_t i = 0; i < nodes_.size(); ++i) {
+                    if(nodes_[i].is_volatile) volatile_leaves_.push_back(static_cast<std::int32_t>(i));
+                }
+
+                // the getter's own leaves are already re-evaluated when the getter is passed to update
+                const accessor_id member_id = accessor_of(member);
+                if(member_id == getter_id) {
+                    return *this;
+                }
+
+                // the indices are copied, so that they are never appended to the vector they are read from
+                const std::vector<std::int32_t> getter_leaves = it->second;
+                auto& dependents = leaves_by_accessor_[member_id];
+                for(auto index : getter_leaves) {
+                    if(std::find(dependents.begin(), dependents.end(), index) == dependents.end()) {
+                        dependents.push_back(index);
+                    }
+                }
+                return *this;
+            }
+
+            /**
+             * @brief Fully evaluates the given object, and remembers the result of every node for the given slot.
+            */
+            bool evaluate(std::size_t slot, const Obj& obj) {
+                std::uint8_t* results = slot_results(slot);
+
+                for(std::size_t i = 0; i < nodes_.size(); ++i) {
+                    results[i] = compute(nodes_[i], results, obj);
+                }
+                results[nodes_.size()] = 1;
+
+                last_update_evaluations_ = leaf_count_;
+                return results[nodes_.size() - 1];
+            }
+
+            /**
+             * @brief Re-evaluates an object after the given members of it have changed. The object must be in the same slot
+             *        that it was previously evaluated in. If the slot has never been evaluated, the object is fully evaluated.
+             *
+             * @param changed The member variables and/or const member functions whose values may have changed
+            */
+            bool update(std::size_t slot, const Obj& obj, const std::vector<accessor_id>& changed) {
+                std::uint8_t* results = slot_results(slot);
+                if(!results[nodes_.size()]) {
+                    return evaluate(slot, obj);
+                }
+
+                last_update_evaluations_ = 0;
+                for(auto index : volatile_leaves_) {
+                    reevaluate(index, results, obj);
+                }
+
+                for(auto& id : changed) {
+                    auto it = leaves_by_accessor_.find(id);
+                    if(it == leaves_by_accessor_.end()) continue;
+
+                    for(auto index : it->second) {
+                        reevaluate(index, results, obj);
+                    }
+                }
+                return results[nodes_.size() - 1];
+            }
+
+            /**
+             * @brief Re-evaluates an object after the given member variables and/or const member functions have changed.
+            */
+            template<typename... Members>
+            bool update(std::size_t slot, const Obj& obj, Members... changed) {
+                return update(slot, obj, std::vector<accessor_id> { accessor_of(changed)... });
+            }
+
+            /**
+             * @brief Returns the last result of the given slot, without evaluating anything.
+            */
+            bool result(std::size_t slot) const {
+                if(slot >= slot_count() || !results_[slot * stride() + nodes_.size()]) {
+                    throw std::out_of_range("incremental_evaluator slot has not been evaluated");
+                }
+                return results_[slot * stride() + nodes_.size() - 1];
+            }
+
+            /**
+             * @brief Forgets the results of the given slot, e.g. when the object that occupied it is destroyed.
+            */
+            void reset(std::size_t slot) {
+                if(slot < slot_count()) {
+                    results_[slot * stride() + nodes_.size()] = 0;
+                }
+            }
+
+            std::size_t slot_count() const {
+                return results_.size() / stride();
+            }
+
+            /**
+             * @brief The number of leaves evaluated by the most recent call to evaluate or update.
+            */
+            std::size_t last_update_evaluations() const {
+                return last_update_evaluations_;
+            }
+
+        private:
+            enum class node_kind : std::uint8_t {
+                leaf,
+                op,
+                constant
+            };
+
+            struct flat_node {
+                const node::expression_tree_node<Obj>* n;
+                node_kind kind;
+                node::boolean_op bool_op;
+                bool is_volatile;
+                std::int32_t parent;
+                std::int32_t left;
+                std::int32_t right;
+            };
+
+            expression_tree<Obj> tree_;
+
+            // nodes are stored in post-order, so children always precede their parents and the root is last
+            std::vector<flat_node> nodes_;
+            std::map<accessor_id, std::vector<std::int32_t>> leaves_by_accessor_;
+            std::vector<std::int32_t> volatile_leaves_;
+            std::size_t leaf_count_ = 0;
+            std::size_t last_update_evaluations_ = 0;
+
+            // one result per node for each slot, followed by a flag marking whether the slot has been evaluated
+            std::vector<std::uint8_t> results_;
+
+            std::size_t stride() const {
+                return nodes_.size() + 1;
+            }
+
+            std::uint8_t* slot_results(std::size_t slot) {
+                if(slot >= slot_count()) {
+                    results_.resize((slot + 1) * stride(), 0);
+                }
+                return &results_[slot * stride()];
+            }
+
+            void flatten() {
+                struct frame {
+                    const node::expression_tree_node<Obj>* n;
+                    std::int32_t parent_frame;
+                    bool is_left;
+                    bool expanded;
+                    std::int32_t left;
+                    std::int32_t right;
+                };
+
+                // frames are never removed, so a frame's id stays valid while its subtree is being walked
+                std::vector<frame> frames { frame { &tree_.root(), -1, false, false, -1, -1 } };
+                std::vector<std::int32_t> stack { 0 };
+
+                while(!stack.empty()) {
+                    const std::int32_t id = stack.back();
+                    auto* op_node = dynamic_cast<const node::expression_tree_op_node_base<Obj>*>(frames[id].n);
+
+                    if(op_node && !frames[id].expanded) {
+                        if(!op_node->get_left() || !op_node->get_right()) {
+                            throw std::runtime_error("expression_tree_op_node has a missing child node");
+                        }
+                        frames[id].expanded = true;
+                        stack.push_back(static_cast<std::int32_t>(frames.size()));
+                        frames.push_back(frame { op_node->get_right(), id, false, false, -1, -1 });
+                        stack.push_back(static_cast<std::int32_t>(frames.size()));
+                        frames.push_back(frame { op_node->get_left(), id, true, false, -1, -1 });
+                        continue;
+                    }
+
+                    stack.pop_back();
+                    const auto index = static_cast<std::int32_t>(nodes_.size());
+                    const frame& current = frames[id];
+
+                    flat_node flat { current.n, node_kind::leaf, node::boolean_op::AND, false, -1, -1, -1 };
+                    if(op_node) {
+                        flat.kind = node_kind::op;
+                        flat.bool_op = op_node->get_bool_op();
+                        flat.left = current.left;
+                        flat.right = current.right;
+                        nodes_[flat.left].parent = index;
+                        nodes_[flat.right].parent = index;
+                    } else if(dynamic_cast<const node::expression_tree_constant_node<Obj>*>(current.n)) {
+                        flat.kind = node_kind::constant;
+                    } else {
+                        ++leaf_count_;
+                        auto* leaf = dynamic_cast<const node::expression_tree_leaf_node_base<Obj>*>(current.n);
+                        if(leaf) {
+                            leaves_by_accessor_[leaf->get_accessor()].push_back(index);
+                        }
+                        flat.is_volatile = !leaf || leaf->get_accessor().get_kind() == accessor_id::kind::member_function;
+                        if(flat.is_volatile) {
+                            volatile_leaves_.push_back(index);
+                        }
+                    }
+
+                    if(current.parent_frame >= 0) {
+                        frame& parent = frames[current.parent_frame];
+                        (current.is_left ? parent.left : parent.right) = index;
+                    }
+                    nodes_.push_back(flat);
+                }
+            }
+
+            std::uint8_t compute(const flat_node& n, const std::uint8_t* results, const Obj& obj) const {
+                switch(n.kind) {
+                    case node_kind::op: {
+                        return n.bool_op == node::boolean_op::AND
+                            ? (results[n.left] && results[n.right])
+                            : (results[n.left] || results[n.right]);
+                    }
+
+                    default: {
+                        try {
+                            return n.n->evaluate(obj);
+                        } catch(std::exception& e) {
+                            return false;
+                        }
+                    }
+                }
+            }
+
+            /**
+             * Re-evaluates a leaf, and recomputes its ancestors until one of them is unaffected by the change.
+            */
+            void reevaluate(std::int32_t index, std::uint8_t* results, const Obj& obj) {
+                ++last_update_evaluations_;
+                std::uint8_t value = compute(nodes_[index], results, obj);
+
+                while(results[index] != value) {
+                    results[index] = value;
+                    index = nodes_[index].parent;
+                    if(index < 0) break;
+                    value = compute(nodes_[index], results, obj);
+                }
+            }
+    };
+
+}
+}
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+namespace attwoodn {
+namespace expression_tree {
+
+    /**
+     * @brief Describes what a call to minimize removed from an expression tree.
+    */
+    struct minimize_report {
+        std::size_t leaves_before = 0;
+        std::size_t leaves_after = 0;
+
+        // leaves dropped because a sibling leaf on the same member implies them (AND) or covers them (OR)
+        std::size_t subsumed = 0;
+
+        // AND groups that could never be satisfied, and were replaced with a constant false
+        std::size_t contradictions = 0;
+
+        // OR groups that were always satisfied, and were replaced with a constant true
+        std::size_t tautologies = 0;
+
+        std::size_t leaves_removed() const {
+            return leaves_before - leaves_after;
+        }
+    };
+
+    namespace detail {
+
+        template<typename Obj>
+        class minimizer {
+            public:
+                using node_type = node::expression_tree_node<Obj>;
+                using leaf_type = node::expression_tree_leaf_node_base<Obj>;
+                using op_type = node::expression_tree_op_node_base<Obj>;
+                using constant_type = node::expression_tree_constant_node<Obj>;
+                using node_ptr = std::unique_ptr<node_type>;
+
+                explicit minimizer(minimize_report& report)
+                    : report_(report) {}
+
+                node_ptr run(const node_type& n) {
+                    if(auto* op_node = dynamic_cast<const op_type*>(&n)) {
+                        std::vector<const node_type*> operands;
+                        flatten(*op_node, op_node->get_bool_op(), operands);
+
+                        std::vector<node_ptr> simplified;
+                        simplified.reserve(operands.size());
+                        for(auto* operand : operands) {
+                            simplified.push_back(run(*operand));
+                        }
+                        return combine(op_node->get_bool_op(), std::move(simplified));
+                    }
+
+                    if(dynamic_cast<const leaf_type*>(&n)) {
+                        ++report_.leaves_before;
+                    }
+                    return n.clone();
+                }
+
+            private:
+                minimize_report& report_;
+
+                /**
+                 * Collects the operands of a chain of op nodes that all perform the same boolean operation,
+                 * in left to right order. A chain of ANDs (or ORs) is a single n-ary AND (or OR).
+                */
+                static void flatten(const op_type& root, node::boolean_op bool_op, std::vector<const node_type*>& out) {
+                    std::vector<const node_type*> pending { &root };
+                    while(!pending.empty()) {
+                        const node_type* current = pending.back();
+                        pending.pop_back();
+
+                        auto* op_node = dynamic_cast<const op_type*>(current);
+                        if(op_node && op_node->get_bool_op() == bool_op) {
+                            if(!op_node->get_left() || !op_node->get_right()) {
+                                throw std::runtime_error("expression_tree_op_node has a missing child node");
+                            }
+                            pending.push_back(op_node->get_right());
+                            pending.push_back(op_node->get_left());
+                        } else {
+                            out.push_back(current);
+                        }
+                    }
+                }
+
+                /**
+                 * Returns the given node as a leaf node if its values are totally ordered against its comparison value, so
+                 * that it can be analyzed with the other leaves of its group. Otherwise, returns nullptr. Leaves whose
+                 * comparison value is NaN are not ordered (see is_comp_value_ordered).
+                */
+                static const leaf_type* as_groupable_leaf(const node_ptr& n) {
+                    auto* leaf = dynamic_cast<const leaf_type*>(n.get());
+                    if(!leaf || leaf->get_comparator() == comparator::custom || !leaf->is_comp_value_ordered() 
+                            || leaf->reads_nullable_value()) {
+                        return nullptr;
+                    }
+                    return leaf;
+                }
+
+                static bool less(const leaf_type* a, const leaf_type* b) {
+                    return a->compare_comp_value(*b) < 0;
+                }
+
+                static bool same(const leaf_type* a, const leaf_type* b) {
+                    return a->compare_comp_value(*b) == 0;
+                }
+
+                /**
+                 * Decides which leaves of a group (all reading the same member) survive an AND of the group.
+                 *
+                 * @returns False if the group is a contradiction
+                */
+                static bool reduce_and_group(const std::vector<const leaf_type*>& group, std::vector<const leaf_type*>& keep) {
+                    const leaf_type* lo = nullptr;
+                    const leaf_type* hi = nullptr;
+                    const leaf_type* eq = nullptr;
+
+                    for(auto* leaf : group) {
+                        switch(leaf->get_comparator()) {
+                            case comparator::greater_than: if(!lo || less(lo, leaf)) lo = leaf; break;
+                            case comparator::less_than: if(!hi || less(leaf, hi)) hi = leaf; break;
+                            case comparator::equals: {
+                                if(eq && !same(eq, leaf)) return false;
+                                if(!eq) eq = leaf;
+                                break;
+                            }
+                            default: break;
+                        }
+                    }
+
+                    if(eq) {
+                        if(lo && !less(lo, eq)) return false;
+                        if(hi && !less(eq, hi)) return false;
+                        for(auto* leaf : group) {
+                            if(leaf->get_comparator() == comparator::not_equals && same(leaf, eq)) return false;
+                        }
+                        keep.push_back(eq);
+                        return true;
+                    }
+
+                    if(lo && hi && !less(lo, hi)) return false;
+                    if(lo) keep.push_back(lo);
+                    if(hi) keep.push_back(hi);
+
+                    for(std::size_t i = 0; i < group.size(); ++i) {
+                        auto* leaf = group[i];
+                        if(leaf->get_comparator() != comparator::not_equals) continue;
+                        if((lo && !less(lo, leaf)) || (hi && !less(leaf, hi))) continue;
+
+                        bool duplicate = false;
+                        for(std::size_t j = 0; j < i && !duplicate; ++j) {
+                            duplicate = group[j]->get_comparator() == comparator::not_equals && same(group[j], leaf);
+                        }
+                        if(!duplicate) keep.push_back(leaf);
+                    }
+                    return true;
+                }
+
+                /**
+                 * Decides which leaves of a group (all reading the same member) survive an OR of the group.
+                 *
+                 * @returns False if the group is a tautology
+                */
+                static bool reduce_or_group(const std::vector<const leaf_type*>& group, std::vector<const leaf_type*>& keep) {
+                    const leaf_type* lo = nullptr;
+                    const leaf_type* hi = nullptr;
+                    const leaf_type* ne = nullptr;
+
+                    for(auto* leaf : group) {
+                        switch(leaf->get_comparator()) {
+                            case comparator::greater_than: if(!lo || less(leaf, lo)) lo = leaf; break;
+                            case comparator::less_than: if(!hi || less(hi, leaf)) hi = leaf; break;
+                            case comparator::not_equals: {
+                                if(ne && !same(ne, leaf)) return false;
+                                if(!ne) ne = leaf;
+                                break;
+                            }
+                            default: break;
+                        }
+                    }
+
+                    if(ne) {
+                        // every other leaf is either satisfied by the excluded value, or is contained in "!= value"
+                        if(lo && less(lo, ne)) return false;
+                        if(hi && less(ne, hi)) return false;
+                        for(auto* leaf : group) {
+                            if(leaf->get_comparator() == comparator::equals && same(leaf, ne)) return false;
+                        }
+                        keep.push_back(ne);
+                        return true;
+                    }
+
+                    // a NaN value is neither greater nor less than any value, so overlapping ranges of floating-point values
+                    // do not cover every value
+                    if(lo && hi && less(lo, hi) && !lo->reads_unordered_value()) return false;
+                    if(lo) keep.push_back(lo);
+                    if(hi) keep.push_back(hi);
+
+                    for(std::size_t i = 0; i < group.size(); ++i) {
+                        auto* leaf = group[i];
+                        if(leaf->get_comparator() != comparator::equals) continue;
+                        if((lo && less(lo, leaf)) || (hi && less(leaf, hi))) continue;
+
+                        bool duplicate = false;
+                        for(std::size_t j = 0; j < i && !duplicate; ++j) {
+                            duplicate = group[j]->get_comparator() == comparator::equals && same(group[j], leaf);
+                        }
+                        if(!duplicate) keep.push_back(leaf);
+                    }
+                    return true;
+                }
+
+                node_ptr combine(node::boolean_op bool_op, std::vector<node_ptr> operands) {
+                    const bool is_and = bool_op == node::boolean_op::AND;
+
+                    // constant operands either decide the whole operation or can be dropped
+                    std::vector<node_ptr> remaining;
+                    for(auto& operand : operands) {
+                        if(auto* constant = dynamic_cast<const constant_type*>(operand.get())) {
+                            if(constant->get_value() != is_and) {
+                                return node_ptr(new constant_type(!is_and));
+                            }
+                            continue;
+                        }
+                        remaining.push_back(std::move(operand));
+                    }
+
+                    // group the leaves that compare the same member with built-in operators and comparison values of the same
+                    // type, since only comparison values of the same type can be ordered against each other
+                    std::map<std::pair<accessor_id, std::type_index>, std::vector<const leaf_type*>> groups;
+                    for(auto& operand : remaining) {
+                        if(auto* leaf = as_groupable_leaf(operand)) {
+                            groups[std::make_pair(leaf->get_accessor(), std::type_index(leaf->comp_value_type()))].push_back(leaf);
+                        }
+                    }
+
+                    std::vector<const leaf_type*> keep;
+                    for(auto& group : groups) {
+                        const std::size_t kept_before = keep.size();
+                        bool decided = is_and
+                            ? !reduce_and_group(group.second, keep)
+                            : !reduce_or_group(group.second, keep);
+
+                        if(decided) {
+                            if(is_and) ++report_.contradictions;
+                            else ++report_.tautologies;
+                            return node_ptr(new constant_type(!is_and));
+                        }
+                        report_.subsumed += group.second.size() - (keep.size() - kept_before);
+                    }
+
+                    std::vector<node_ptr> survivors;
+                    for(auto& operand : remaining) {
+                        auto* leaf = as_groupable_leaf(operand);
+                        if(!leaf || std::find(keep.begin(), keep.end(), leaf) != keep.end()) {
+                            survivors.push_back(std::move(operand));
+                        }
+                    }
+
+                    if(survivors.empty()) {
+                        return node_ptr(new constant_type(is_and));
+                    }
+
+                    // rebuild the surviving operands as a left-deep chain
+                    node_ptr result = std::move(survivors.front());
+                    for(std::size_t i = 1; i < survivors.size(); ++i) {
+                        auto* op_node = new node::expression_tree_dynamic_op_node<Obj>(bool_op);
+                        op_node->set_left(result.release());
+                        op_node->set_right(survivors[i].release());
+                        result.reset(op_node);
+                    }
+                    return result;
+                }
+        };
+
+        template<typename Obj>
+        std::size_t count_leaves(const node::expression_tree_node<Obj>& root) {
+            std::size_t count = 0;
+            std::vector<const node::expression_tree_node<Obj>*> pending { &root };
+            while(!pending.empty()) {
+                auto* current = pending.back();
+                pending.pop_back();
+
+                if(auto* op_node = dynamic_cast<const node::expression_tree_op_node_base<Obj>*>(current)) {
+                    if(op_node->get_left()) pending.push_back(op_node->get_left());
+                    if(op_node->get_right()) pending.push_back(op_node->get_right());
+                } else if(dynamic_cast<const node::expression_tree_leaf_node_base<Obj>*>(current)) {
+                    ++count;
+                }
+            }
+            return count;
+        }
+    }
+
+    /**
+     * @brief Returns a logically equivalent copy of the given expression tree with redundant leaf nodes removed.
+     *
+     *        Leaves that compare the same member variable or member function using the built-in op functions are analyzed
+     *        together whenever they are operands of the same chain of ANDs or ORs:
+     *          - subsumed predicates are dropped (e.g. my_int > 5 OR my_int > 10 becomes my_int > 5);
+     *          - overlapping ranges are merged (e.g. my_int > 5 AND my_int > 10 AND my_int != 2 becomes my_int > 10);
+     *          - contradictions are replaced with a constant false node (e.g. my_int < 0 AND my_int > 10); and
+     *          - tautologies are replaced with a constant true node (e.g. my_int < 10 OR my_int > 0). Since a NaN value
+     *            satisfies neither comparison, my_double < 10.0 OR my_double > 0.0 is not a tautology.
+     *
+     *        Comparison values must be totally ordered by operator< for the analysis to be sound. NaN and pointer 
+     *        comparison values, leaves that read pointers (such as char* members compared as C strings), and leaves with
+     *        user-defined operators are left untouched. Leaves on the same member are only analyzed together if their
+     *        comparison values have the same type.
+     *
+     * @param report If not null, receives a summary of what was removed from the tree
+    */
+    template<typename Obj>
+    expression_tree<Obj> minimize(const expression_tree<Obj>& tree, minimize_report* report = nullptr) {
+        minimize_report local_report;
+        detail::minimizer<Obj> pass(local_report);
+
+        auto result = pass.run(tree.root());
+        local_report.leaves_after = detail::count_leaves(*result);
+
+        if(report) {
+            *report = local_report;
+        }
+        return expression_tree<Obj>(std::move(result));
+    }
+
+}
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/field_registry.hpp>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace attwoodn {
+namespace expression_tree {
+
+    /**
+     * @brief Thrown by parse_expr when the given text is not a valid expression.
+    */
+    class parse_error : public std::runtime_error {
+        public:
+            parse_error(const std::string& what, std::size_t position)
+                : std::runtime_error(what + " at position " + std::to_string(position)),
+                  position_(position) {}
+
+            /**
+             * @brief The offset of the offending character within the parsed text.
+            */
+            std::size_t position() const {
+                return position_;
+            }
+
+        private:
+            std::size_t position_;
+    };
+
+    namespace detail {
+
+        /**
+         * A single-pass shunting-yard parser. Predicates are turned into leaf nodes as soon as they are read, and
+         * op nodes are assembled from an explicit operand stack, so parsing is linear in the length of the text and
+         * does not recurse, regardless of how long or deeply nested the expression is.
+        */
+        template<typename Obj>
+        class expression_parser {
+            public:
+                using node_type = node::expression_tree_node<Obj>;
+                using node_ptr = std::unique_ptr<node_type>;
+
+                expression_parser(const field_registry<Obj>& registry, const char* text, std::size_t length)
+                    : registry_(registry),
+                      begin_(text),
+                      cur_(text),
+                      end_(text + length) {}
+
+                node_ptr parse() {
+                    bool expect_operand = true;
+
+                    while(true) {
+                        skip_whitespace();
+
+                        if(expect_operand) {
+                            if(cur_ == end_) fail("expected a predicate or '('");
+
+                            if(*cur_ == '(') {
+                                operators_.push_back('(');
+                                ++cur_;
+                                continue;
+                            }
+
+                            operands_.push_back(parse_predicate());
+                            expect_operand = false;
+                            continue;
+                        }
+
+                        if(cur_ == end_) break;
+
+                        if(*cur_ == ')') {
+                            while(!operators_.empty() && operators_.back() != '(') {
+                                reduce();
+                            }
+                            if(operators_.empty()) fail("unbalanced ')'");
+                            operators_.pop_back();
+                            ++cur_;
+                            continue;
+                        }
+
+                        char bool_op = 0;
+                        if(starts_with("&&")) bool_op = '&';
+                        else if(starts_with("||")) bool_op = '|';
+                        else fail("expected '&&', '||' or ')'");
+
+                        // AND binds tighter than OR, and both are left-associative
+                        while(!operators_.empty() && operators_.back() != '('
+                                && (operators_.back() == '&' || bool_op == '|')) {
+                            reduce();
+                        }
+                        operators_.push_back(bool_op);
+                        cur_ += 2;
+                        expect_operand = true;
+                    }
+
+                    while(!operators_.empty()) {
+                        if(operators_.back() == '(') fail("unbalanced '('");
+                        reduce();
+                    }
+
+                    return std::move(operands_.back());
+                }
+
+            private:
+                const field_registry<Obj>& registry_;
+                const char* begin_;
+                const char* cur_;
+                const char* end_;
+                std::vector<node_ptr> operands_;
+                std::vector<char> operators_;
+
+                [[noreturn]] void fail(const std::string& what) const {
+                    throw parse_error(what, static_cast<std::size_t>(cur_ - begin_));
+                }
+
+                void skip_whitespace() {
+                    while(cur_ != end_ && (*cur_ == ' ' || *cur_ == '\t' || *cur_ == '\n' || *cur_ == '\r')) {
+                        ++cur_;
+                    }
+                }
+
+                bool starts_with(const char* token) const {
+                    const char* p = cur_;
+                    while(*token) {
+                        if(p == end_ || *p != *token) return false;
+                        ++p;
+                        ++token;
+                    }
+                    return true;
+                }
+
+                static bool is_identifier_char(char c, bool first) {
+                    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (!first && c >= '0' && c <= '9');
+                }
+
+                void reduce() {
+                    auto* op_node = new node::expression_tree_dynamic_op_node<Obj>(
+                        operators_.back() == '&' ? node::boolean_op::AND : node::boolean_op::OR);
+                    operators_.pop_back();
+
+                    op_node->set_right(operands_.back().release());
+                    operands_.pop_back();
+                    op_node->set_left(operands_.back().release());
+                    operands_.back().reset(op_node);
+                }
+
+                /**
+                 * Parses: field_name [ "()" ] comparison_operator literal
+                */
+                node_ptr parse_predicate() {
+                    const char* name = cur_;
+                    if(cur_ == end_ || !is_identifier_char(*cur_, true)) fail("expected a field name");
+                    while(cur_ != end_ && is_identifier_char(*cur_, false)) {
+                        ++cur_;
+                    }
+
+                    const field<Obj>* f = registry_.find(name, static_cast<std::size_t>(cur_ - name));
+                    if(!f) {
+                        cur_ = name;
+                        fail("unknown field");
+                    }
+
+                    skip_whitespace();
+                    if(starts_with("()")) {
+                        cur_ += 2;
+                        skip_whitespace();
+                    }
+
+                    comparator c = comparator::custom;
+                    if(starts_with("==")) c = comparator::equals;
+                    else if(starts_with("!=")) c = comparator::not_equals;
+                    else if(starts_with("<")) c = comparator::less_than;
+                    else if(starts_with(">")) c = comparator::greater_than;
+                    else fail("expected '==', '!=', '<' or '>'");
+                    cur_ += (c == comparator::equals || c == comparator::not_equals) ? 2 : 1;
+
+                    skip_whitespace();
+                    const char* literal = cur_;
+                    scan_literal();
+
+                    try {
+                        return node_ptr(f->make_leaf(c, literal, static_cast<std::size_t>(cur_ - literal)));
+                    } catch(const std::invalid_argument& e) {
+                        cur_ = literal;
+                        fail(e.what());
+                    }
+                }
+
+                /**
+                 * Advances past a quoted string literal, or past a bare literal such as a number, true or false.
+                */
+                void scan_literal() {
+                    if(cur_ != end_ && *cur_ == '"') {
+                        ++cur_;
+                        while(cur_ != end_ && *cur_ != '"') {
+                            if(*cur_ == '\\' && cur_ + 1 != end_) ++cur_;
+                            ++cur_;
+                        }
+                        if(cur_ == end_) fail("unterminated string literal");
+                        ++cur_;
+                        return;
+                    }
+
+                    const char* start = cur_;
+                    while(cur_ != end_ && *cur_ != ' ' && *cur_ != '\t' && *cur_ != '\n' && *cur_ != '\r'
+                            && *cur_ != ')' && *cur_ != '&' && *cur_ != '|') {
+                        ++cur_;
+                    }
+                    if(cur_ == start) fail("expected a literal");
+                }
+        };
+    }
+
+    /**
+     * @brief Parses the text form of an expression into a heap-allocated expression tree node, using the given
+     *        registry to resolve field names. For example:
+     *
+     *          my_bool == true || (get_my_int() > 0 && my_int < 10)
+     *
+     *        Predicates compare a registered field with a literal using ==, !=, < or >. Getter fields may optionally be
+     *        followed by (). Predicates are combined with && and ||, where && binds tighter than ||, and may be grouped
+     *        with parentheses. Literals are true, false, numbers, or double-quoted strings.
+     *
+     *        As with make_expr, the returned pointer should be wrapped in an expression_tree or a smart pointer.
+     *
+     * @throws parse_error if the text is not a valid expression
+    */
+    template<typename Obj>
+    node::expression_tree_node<Obj>* parse_expr(const field_registry<Obj>& registry, const std::string& text) {
+        return detail::expression_parser<Obj>(registry, text.c_str(), text.size()).parse().release();
+    }
+
+}
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/canonical.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace attwoodn {
+namespace expression_tree {
+
+    /**
+     * @brief Shares one immutable compiled plan between all structurally equal trees (see structurally_equal), so that
+     *        when many users submit the same filter, memory use and compile time grow with the number of distinct filters
+     *        rather than the total number of filters.
+     *
+     *        Plan is the compiled form of a tree, constructed from a const expression_tree<Obj>&. It may be, for example,
+     *        an expression_tree<Obj>, a flat_expression_tree<Obj> or a bdd_expression_tree<Obj>. The cache holds plans
+     *        weakly: a plan is destroyed once no returned pointer refers to it, and the next request for an equal tree
+     *        compiles it again.
+     *
+     *        A shared plan is compiled from the first tree that was requested, so it may evaluate the operands of its
+     *        op nodes in a different order than an equal tree requested later. The results only differ for trees with
+     *        leaves that throw while being evaluated.
+     *
+     *        The cache may be used from many threads at once. global() returns a process-wide cache for each Obj and Plan.
+    */
+    template<typename Obj, typename Plan = expression_tree<Obj>>
+    class plan_cache {
+        public:
+            plan_cache() = default;
+            plan_cache(const plan_cache&) = delete;
+            plan_cache& operator=(const plan_cache&) = delete;
+
+            static plan_cache& global() {
+                static plan_cache cache;
+                return cache;
+            }
+
+            /**
+             * @brief Returns the plan of a tree that is structurally equal to the given tree, compiling the given tree if
+             *        no such plan is alive.
+            */
+            std::shared_ptr<const Plan> get(const expression_tree<Obj>& tree) {
+                const std::uint64_t hash = structural_hash(tree);
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if(auto plan = find(hash, tree)) {
+                        hits_.fetch_add(1, std::memory_order_relaxed);
+                        return plan;
+                    }
+                }
+
+                // the tree is compiled without holding the lock, so that requests for other trees are not blocked
+                auto compiled = std::make_shared<const entry>(tree);
+                misses_.fetch_add(1, std::memory_order_relaxed);
+
+                std::lock_guard<std::mutex> lock(mutex_);
+                if(auto plan = find(hash, tree)) {
+                    return plan;
+                }
+                entries_.emplace(hash, compiled);
+                if(entries_.size() >= sweep_at_) {
+                    sweep();
+                }
+                return std::shared_ptr<const Plan>(compiled, &compiled->plan);
+            }
+
+            /**
+             * @brief The number of distinct plans that are alive.
+            */
+            std::size_t size() const {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return static_cast<std::size_t>(std::count_if(entries_.begin(), entries_.end(),
+                    [](const typename entries_type::value_type& e) { return !e.second.expired(); }));
+            }
+
+            /**
+             * @brief The number of requests that were answered with a plan that was already compiled.
+            */
+            std::uint64_t hit_count() const {
+                return hits_.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief The number of requests that compiled a tree.
+            */
+            std::uint64_t miss_count() const {
+                return misses_.load(std::memory_order_relaxed);
+            }
+
+        private:
+            struct entry {
+                expression_tree<Obj> tree;
+                Plan plan;
+
+                explicit entry(const expression_tree<Obj>& t)
+                    : tree(t),
+                      plan(tree) {}
+            };
+
+            using entries_type = std::unordered_multimap<std::uint64_t, std::weak_ptr<const entry>>;
+
+            mutable std::mutex mutex_;
+            entries_type entries_;
+            std::size_t sweep_at_ = 16;
+            std::atomic<std::uint64_t> hits_ { 0 };
+            std::atomic<std::uint64_t> misses_ { 0 };
+
+            /**
+             * Returns the live plan of a tree with the given hash that is structurally equal to the given tree, or null.
+             * The lock must be held.
+            */
+            std::shared_ptr<const Plan> find(std::uint64_t hash, const expression_tree<Obj>& tree) {
+                auto range = entries_.equal_range(hash);
+                for(auto it = range.first; it != range.second; ++it) {
+                    if(auto cached = it->second.lock()) {
+                        if(structurally_equal(cached->tree, tree)) {
+                            return std::shared_ptr<const Plan>(cached, &cached->plan);
+                        }
+                    }
+                }
+                return nullptr;
+            }
+
+            /**
+             * Removes the entries of destroyed plans. Sweeps are spaced out as the number of live plans grows, so that their
+             * cost is amortized over the requests that compiled a tree. The lock must be held.
+            */
+            void sweep() {
+                for(auto it = entries_.begin(); it != entries_.end();) {
+                    it = it->second.expired() ? entries_.erase(it) : std::next(it);
+                }
+                sweep_at_ = std::max<std::size_t>(16, 2 * entries_.size());
+            }
+    };
+
+}
+}
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+
+namespace attwoodn {
+namespace expression_tree {
+
+    /**
+     * @brief A packed binary record, e.g. a packet in a network buffer. Expression trees of type expression_tree<record_view>
+     *        evaluate records in place, using leaf nodes that read fields at fixed byte offsets.
+    */
+    struct record_view {
+        const unsigned char* data;
+        std::size_t size;
+    };
+
+    /**
+     * @brief The byte order of a field of a binary record.
+    */
+    enum class byte_order : std::uint8_t {
+        little_endian,
+        big_endian
+    };
+
+    namespace detail {
+
+        inline bool host_is_little_endian() {
+            const std::uint16_t one = 1;
+            unsigned char first;
+            std::memcpy(&first, &one, 1);
+            return first == 1;
+        }
+
+        inline std::uint8_t byte_swap(std::uint8_t value) {
+            return value;
+        }
+
+        inline std::uint16_t byte_swap(std::uint16_t value) {
+            return static_cast<std::uint16_t>((value >> 8) | (value << 8));
+        }
+
+        inline std::uint32_t byte_swap(std::uint32_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+            return __builtin_bswap32(value);
+#else
+            return ((value & 0x000000ffu) << 24) | ((value & 0x0000ff00u) << 8)
+                 | ((value & 0x00ff0000u) >> 8)  | ((value & 0xff000000u) >> 24);
+#endif
+        }
+
+        inline std::uint64_t byte_swap(std::uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+            return __builtin_bswap64(value);
+#else
+            return (static_cast<std::uint64_t>(byte_swap(static_cast<std::uint32_t>(value))) << 32)
+                 | byte_swap(static_cast<std::uint32_t>(value >> 32));
+#endif
+        }
+
+        template<std::size_t Size> struct unsigned_of_size;
+        template<> struct unsigned_of_size<1> { using type = std::uint8_t; };
+        template<> struct unsigned_of_size<2> { using type = std::uint16_t; };
+        template<> struct unsigned_of_size<4> { using type = std::uint32_t; };
+        template<> struct unsigned_of_size<8> { using type = std::uint64_t; };
+
+        /**
+         * Reads a T from unaligned memory holding a T in the given byte order.
+        */
+        template<typename T>
+        T load(const unsigned char* bytes, byte_order order) {
+            using bits_type = typename unsigned_of_size<sizeof(T)>::type;
+
+            bits_type bits;
+            std::memcpy(&bits, bytes, sizeof(T));
+            if((order == byte_order::little_endian) != host_is_little_endian()) {
+                bits = byte_swap(bits);
+            }
+
+            T value;
+            std::memcpy(&value, &bits, sizeof(T));
+            return value;
+        }
+
+        template<>
+        inline bool load<bool>(const unsigned char* bytes, byte_order) {
+            return *bytes != 0;
+        }
+
+        /**
+         * The identity of a record_field, held by the accessor_id of leaf nodes that read the field. It has no padding,
+         * since accessor_ids are compared bytewise.
+        */
+        template<typename T>
+        struct record_field_key {
+            std::uint64_t offset;
+            std::uint64_t order;
+        };
+
+    }
+
+    /**
+     * @brief A typed field at a fixed byte offset of a binary record. Used as the accessor of leaf nodes that evaluate
+     *        records in place. The width of the field is sizeof(T).
+    */
+    template<typename T>
+    class record_field {
+        public:
+            static_assert(std::is_arithmetic<T>::value, "record fields must have an arithmetic type");
+            static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8,
+                "record fields must be 1, 2, 4 or 8 bytes wide");
+
+            record_field(std::size_t offset, byte_order order)
+                : offset_(offset),
+                  order_(order) {}
+
+            std::size_t offset() const {
+                return offset_;
+            }
+
+            byte_order order() const {
+                return order_;
+            }
+
+            /**
+             * @brief Reads this field from the given record. Throws std::out_of_range if the record is too small to hold it.
+            */
+            T read(const record_view& record) const {
+                if(record.size < sizeof(T) || offset_ > record.size - sizeof(T)) {
+                    throw std::out_of_range("record_field lies outside of the record");
+                }
+                return detail::load<T>(record.data + offset_, order_);
+            }
+
+            accessor_id id() const {
+                return accessor_id(accessor_id::kind::member_variable,
+                    detail::record_field_key<T> { offset_, static_cast<std::uint64_t>(order_) });
+            }
+
+            // record fields are never null, unlike member pointers
+            explicit operator bool() const {
+                return true;
+            }
+
+        private:
+            std::size_t offset_;
+            byte_order order_;
+    };
+
+    /**
+     * @brief Describes the fields of a fixed-size binary record, by mapping field names to their types, byte offsets, and
+     *        byte orders.
+    */
+    class record_layout {
+        public:
+            explicit record_layout(std::size_t record_size)
+                : record_size_(record_size) {}
+
+            std::size_t record_size() const {
+                return record_size_;
+            }
+
+            /**
+             * @brief Adds a field of type T at the given byte offset. Chainable.
+             *
+             *        Throws std::invalid_argument if the name is already in use, or if the field does not fit within the record.
+            */
+            template<typename T>
+            record_layout& add(std::string name, std::size_t offset, byte_order order) {
+                // instantiating record_field<T> checks that T is a supported field type
+                static_cast<void>(record_field<T>(offset, order));
+                if(sizeof(T) > record_size_ || offset > record_size_ - sizeof(T)) {
+                    throw std::invalid_argument("record field '" + name + "' does not fit within the record");
+                }
+                if(fields_.count(name)) {
+                    throw std::invalid_argument("record field '" + name + "' has already been added");
+                }
+                fields_.emplace(std::move(name), entry { offset, order, &typeid(T) });
+                return *this;
+            }
+
+            /**
+             * @brief Returns the field with the given name. Throws std::invalid_argument if there is no such field, or if its
+             *        type is not T.
+            */
+            template<typename T>
+            record_field<T> get(const std::string& name) const {
+                auto it = fields_.find(name);
+                if(it == fields_.end()) {
+                    throw std::invalid_argument("record layout has no field named '" + name + "'");
+                }
+                if(*it->second.type != typeid(T)) {
+                    throw std::invalid_argument("record field '" + name + "' has a different type");
+                }
+                return record_field<T>(it->second.offset, it->second.order);
+            }
+
+            std::size_t size() const {
+                return fields_.size();
+            }
+
+        private:
+            struct entry {
+                std::size_t offset;
+                byte_order order;
+                const std::type_info* type;
+            };
+
+            std::size_t record_size_;
+            std::map<std::string, entry, std::less<>> fields_;
+    };
+
+    /**
+     * Makes an expression tree leaf node for comparing a field of a binary record
+    */
+    template<typename T, typename Op>
+    auto* make_expr( const record_field<T>& field, Op op, const typename type_id<T>::type& comp_value ) {
+        using stored = detail::stored_op<Op>;
+        return new node::expression_tree_leaf_node<record_view, typename stored::type, T, record_field<T>>(
+            field, stored::get(std::move(op)), comp_value );
+    }
+
+    /**
+     * @brief Calls f(index) with the index of each record that satisfies the given tree, in order. The records are count
+     *        consecutive records of record_size bytes each, starting at data.
+    */
+    template<typename Function>
+    void for_each_matching_record(const expression_tree<record_view>& tree, const unsigned char* data, std::size_t count,
+            std::size_t record_size, Function f) {
+        for(std::size_t i = 0; i < count; ++i) {
+            if(tree.evaluate(record_view { data + i * record_size, record_size })) {
+                f(i);
+            }
+        }
+    }
+
+    /**
+     * @brief Returns the number of records that satisfy the given tree. The records are count consecutive records of
+     *        record_size bytes each, starting at data.
+    */
+    inline std::size_t count_matching_records(const expression_tree<record_view>& tree, const unsigned char* data,
+            std::size_t count, std::size_t record_size) {
+        std::size_t matches = 0;
+        for(std::size_t i = 0; i < count; ++i) {
+            matches += tree.evaluate(record_view { data + i * record_size, record_size });
+        }
+        return matches;
+    }
+
+}
+}
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace attwoodn {
+namespace expression_tree {
+
+    /**
+     * @brief Classifies objects by an ordered list of expression tree rules, sending each object to the first rule that it
+     *        satisfies.
+     *
+     *        The rules are compiled into one shared branching program. Each rule's branches are chained to the next rule's
+     *        entry point when the rule fails, and its accept target names the rule's index, so a classification is a single
+     *        forward walk that ends on the winning rule. Leaf nodes that compare the same member using the same built-in
+     *        operator and an equivalent comparison value are merged into one test, and the result of every test is remembered
+     *        for the duration of a classification. Therefore, each distinct test is evaluated at most once per object, no
+     *        matter how many rules share it. A branch whose outcome leads to a branch of the same test is linked straight to
+     *        that branch's target for the same outcome, so consecutive rules that fail on the result of a shared test are
+     *        skipped without being visited.
+     *
+     *        A rule that throws an exception while being evaluated is treated as not satisfied, as with expression_tree::evaluate.
+     *
+     *        The number of objects sent to each rule is counted. Counting is thread-safe, so a classifier may be shared
+     *        between threads.
+    */
+    template<typename Obj>
+    class rule_classifier {
+        public:
+            /**
+             * @brief The result of classify for an object that satisfies none of the rules.
+            */
+            static constexpr std::size_t no_match = static_cast<std::size_t>(-1);
+
+            /**
+             * @brief Classifications allocate no memory when there are at most this many distinct tests. Otherwise, the
+             *        first classification on each thread allocates the memory that remembers the results of the tests.
+            */
+            static constexpr std::size_t inline_test_capacity = 256;
+
+            rule_classifier() = delete;
+
+            explicit rule_classifier(std::vector<expression_tree<Obj>> rules)
+                : rules_(std::move(rules)),
+                  hits_(new std::atomic<std::uint64_t>[rules_.size() + 1]) {
+                reset_hit_counts();
+                compile();
+            }
+
+            rule_classifier(const rule_classifier&) = delete;
+            rule_classifier& operator=(const rule_classifier&) = delete;
+
+            // moving the rules does not move the nodes they own, so the compiled tests remain valid
+            rule_classifier(rule_classifier&&) = default;
+            rule_classifier& operator=(rule_classifier&&) = default;
+
+            /**
+             * @brief Returns the index of the first rule that the given object satisfies, or no_match.
+            */
+            std::size_t classify(const Obj& obj) const {
+                const std::uint32_t generation = next_generation();
+                if(tests_.size() <= inline_test_capacity) {
+                    memo_slot* slots = memo().slots;
+                    return classify(obj, generation, [slots](std::uint32_t test) -> memo_slot& { return slots[test]; });
+                }
+
+                auto& slots = overflow_memo_slots();
+                if(slots.size() < tests_.size()) {
+                    slots.resize(tests_.size());
+                }
+                // the slots are looked up for every access, in case a test classifies with a larger classifier and grows them
+                return classify(obj, generation, [&slots](std::uint32_t test) -> memo_slot& { return slots[test]; });
+            }
+
+            /**
+             * @brief Classifies a batch of objects.
+             *
+             * @param objs    An array of count pointers to the objects to classify
+             * @param results An array of count indices. Each is set to the rule index of the object at the same index, or no_match
+            */
+            void classify_batch(const Obj* const* objs, std::size_t count, std::size_t* results) const {
+                for(std::size_t i = 0; i < count; ++i) {
+                    results[i] = classify(*objs[i]);
+                }
+            }
+
+            std::size_t rule_count() const {
+                return rules_.size();
+            }
+
+            const expression_tree<Obj>& rule(std::size_t index) const {
+                if(index >= rules_.size()) {
+                    throw std::out_of_range("rule_classifier has no rule at the given index");
+                }
+                return rules_[index];
+            }
+
+            /**
+             * @brief The number of distinct tests across all rules, after leaf nodes shared between rules have been merged.
+            */
+            std::size_t test_count() const {
+                return tests_.size();
+            }
+
+            /**
+             * @brief The number of objects that have been sent to the given rule since construction, or since the last call
+             *        to reset_hit_counts.
+            */
+            std::uint64_t hit_count(std::size_t index) const {
+                if(index >= rules_.size()) {
+                    throw std::out_of_range("rule_classifier has no rule at the given index");
+                }
+                return hits_[index].load(std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief The number of objects that have satisfied none of the rules.
+            */
+            std::uint64_t no_match_count() const {
+                return hits_[rules_.size()].load(std::memory_order_relaxed);
+            }
+
+            void reset_hit_counts() {
+                for(std::size_t i = 0; i <= rules_.size(); ++i) {
+                    hits_[i].store(0, std::memory_order_relaxed);
+                }
+            }
+
+        private:
+            enum test_result : std::uint8_t {
+                tested_false,
+                tested_true,
+                tested_error
+            };
+
+            /**
+             * The remembered result of a test. The result belongs to the classification that is numbered generation, so 
+             * that starting a classification does not need to clear the results of the previous one.
+            */
+            struct memo_slot {
+                std::uint32_t generation;
+                std::uint8_t result;
+            };
+
+            /**
+             * The results of the tests of classifiers with at most inline_test_capacity tests, for each thread. It is 
+             * trivially destructible, so that using it for the first time on a thread allocates nothing.
+            */
+            struct thread_memo {
+                std::uint32_t generation;
+                memo_slot slots[inline_test_capacity];
+            };
+
+            static thread_memo& memo() {
+                thread_local thread_memo m {};
+                return m;
+            }
+
+            static std::vector<memo_slot>& overflow_memo_slots() {
+                thread_local std::vector<memo_slot> slots;
+                return slots;
+            }
+
+            /**
+             * Numbers a new classification on the calling thread. No slot holds generation 0, so when the numbers wrap 
+             * around, every slot is cleared.
+            */
+            static std::uint32_t next_generation() {
+                thread_memo& m = memo();
+                if(++m.generation == 0) {
+                    for(auto& slot : m.slots) {
+                        slot.generation = 0;
+                    }
+                    for(auto& slot : overflow_memo_slots()) {
+                        slot.generation = 0;
+                    }
+                    m.generation = 1;
+                }
+                return m.generation;
+            }
+
+            /**
+             * A branch of the shared program. Non-negative targets are branch indices, and a negative target t is the
+             * terminal for rule -1 - t. The terminal for rule_count() is no_match. on_error is the entry point of the next rule.
+            */
+            struct rule_branch {
+                std::uint32_t test;
+                std::int32_t on_true;
+                std::int32_t on_false;
+                std::int32_t on_error;
+            };
+
+            std::vector<expression_tree<Obj>> rules_;
+            std::vector<const node::expression_tree_node<Obj>*> tests_;
+            std::vector<rule_branch> branches_;
+            std::int32_t entry_ = -1;
+            std::unique_ptr<std::atomic<std::uint64_t>[]> hits_;
+
+            static std::int32_t terminal(std::size_t rule) {
+                return -1 - static_cast<std::int32_t>(rule);
+            }
+
+            void compile() {
+                std::vector<detail::branching_program<Obj>> programs;
+                std::vector<std::int32_t> bases;
+                std::size_t branch_count = 0;
+                for(auto& r : rules_) {
+                    programs.push_back(detail::compile_branches(r.root()));
+                    bases.push_back(static_cast<std::int32_t>(branch_count));
+                    branch_count += programs.back().branches.size();
+                }
+                branches_.resize(branch_count);
+
+                std::map<const node::expression_tree_leaf_node_base<Obj>*, std::uint32_t, detail::mergeable_leaf_less<Obj>> merged;
+                auto test_of = [this, &merged](const node::expression_tree_node<Obj>* n) {
+                    if(auto* leaf = detail::as_mergeable_leaf(n)) {
+                        auto it = merged.find(leaf);
+                        if(it != merged.end()) {
+                            return it->second;
+                        }
+                        merged.emplace(leaf, static_cast<std::uint32_t>(tests_.size()));
+                    }
+                    tests_.push_back(n);
+                    return static_cast<std::uint32_t>(tests_.size() - 1);
+                };
+
+                // the rules are linked from last to first, so that each rule's failure target is known when it is linked
+                std::int32_t next_entry = terminal(rules_.size());
+                for(std::size_t i = rules_.size(); i-- > 0;) {
+                    auto target = [&](std::int32_t local) {
+                        if(local == detail::branch_accept) return terminal(i);
+                        if(local == detail::branch_reject) return next_entry;
+                        return bases[i] + local;
+                    };
+
+                    auto& program = programs[i];
+                    for(std::size_t b = 0; b < program.branches.size(); ++b) {
+                        branches_[bases[i] + b] = rule_branch { 0, target(program.branches[b].on_true),
+                            target(program.branches[b].on_false), next_entry };
+                    }
+                    next_entry = target(program.entry);
+                }
+                entry_ = next_entry;
+
+                // tests are numbered in branch order, so that the tests of earlier rules come first
+                for(std::size_t i = 0; i < rules_.size(); ++i) {
+                    for(std::size_t b = 0; b < programs[i].branches.size(); ++b) {
+                        branches_[bases[i] + b].test = test_of(programs[i].branches[b].test);
+                    }
+                }
+
+                // a target that tests the same test has the same outcome, so it is replaced by that outcome's target. The
+                // program has no cycles, so following the targets terminates
+                auto skip_known = [this](std::uint32_t test, std::int32_t target, std::int32_t rule_branch::* outcome) {
+                    while(target >= 0 && branches_[target].test == test) {
+                        target = branches_[target].*outcome;
+                    }
+                    return target;
+                };
+                for(auto& b : branches_) {
+                    b.on_true = skip_known(b.test, b.on_true, &rule_branch::on_true);
+                    b.on_false = skip_known(b.test, b.on_false, &rule_branch::on_false);
+                    b.on_error = skip_known(b.test, b.on_error, &rule_branch::on_error);
+                }
+            }
+
+            template<typename Slot>
+            std::size_t classify(const Obj& obj, std::uint32_t generation, Slot slot) const {
+                std::int32_t pc = entry_;
+                while(pc >= 0) {
+                    const rule_branch& b = branches_[pc];
+                    std::uint8_t result;
+                    if(slot(b.test).generation == generation) {
+                        result = slot(b.test).result;
+                    } else {
+                        try {
+                            result = tests_[b.test]->evaluate(obj) ? tested_true : tested_false;
+                        } catch(std::exception& e) {
+                            result = tested_error;
+                        }
+                        slot(b.test) = memo_slot { generation, result };
+                    }
+                    pc = result == tested_true ? b.on_true : (result == tested_false ? b.on_false : b.on_error);
+                }
+
+                const std::size_t rule = static_cast<std::size_t>(-1 - pc);
+                hits_[rule].fetch_add(1, std::memory_order_relaxed);
+                return rule == rules_.size() ? no_match : rule;
+            }
+    };
+
+    template<typename Obj>
+    constexpr std::size_t rule_classifier<Obj>::no_match;
+
+    template<typename Obj>
+    constexpr std::size_t rule_classifier<Obj>::inline_test_capacity;
+
+}
+}
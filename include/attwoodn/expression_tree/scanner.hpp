@@ -0,0 +1,162 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/file_mapping.hpp>
+#include <cstddef>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace attwoodn {
+namespace expression_tree {
+
+#ifdef ATTWOODN_EXPRESSION_TREE_HAS_MMAP
+
+    /**
+     * @brief Scans a file of packed, fixed-size Obj records, evaluating each record in place from the read-only memory
+     *        mapped pages of the file. No record is copied.
+     *
+     *        The file must hold a whole number of records, as written by e.g. fwrite(records, sizeof(Obj), count, file) on
+     *        a machine with the same ABI. Records are split into one contiguous chunk per thread, and the chunks are
+     *        scanned in parallel. The mapping is advised for sequential access, and for transparent huge pages where they
+     *        are supported.
+     *
+     *        The scan functions accept any tree with a bool evaluate(const Obj&) const member function, such as an
+     *        expression_tree<Obj> or a flat_expression_tree<Obj>.
+    */
+    template<typename Obj>
+    class mapped_record_scanner {
+        public:
+            static_assert(std::is_trivially_copyable<Obj>::value, "mapped records must be trivially copyable");
+
+            explicit mapped_record_scanner(const std::string& path)
+                : mapping_(path) {
+                if(mapping_.size() % sizeof(Obj) != 0) {
+                    throw std::runtime_error("the size of " + path + " is not a multiple of the record size");
+                }
+                mapping_.advise_sequential();
+            }
+
+            mapped_record_scanner(const mapped_record_scanner&) = delete;
+            mapped_record_scanner& operator=(const mapped_record_scanner&) = delete;
+
+            const Obj* records() const {
+                return static_cast<const Obj*>(mapping_.data());
+            }
+
+            std::size_t record_count() const {
+                return mapping_.size() / sizeof(Obj);
+            }
+
+            std::size_t size_bytes() const {
+                return mapping_.size();
+            }
+
+            /**
+             * @brief Returns the number of records that satisfy the given tree.
+             *
+             * @param threads The number of threads to scan with. If 0, one thread per hardware thread is used
+            */
+            template<typename Tree>
+            std::size_t count(const Tree& tree, unsigned threads = 0) const {
+                std::vector<std::size_t> counts(chunk_count(threads), 0);
+                scan_chunks(counts.size(), [&](std::size_t chunk, const Obj* first, const Obj* last) {
+                    std::size_t matches = 0;
+                    for(const Obj* record = first; record != last; ++record) {
+                        matches += tree.evaluate(*record);
+                    }
+                    counts[chunk] = matches;
+                });
+
+                std::size_t total = 0;
+                for(auto c : counts) {
+                    total += c;
+                }
+                return total;
+            }
+
+            /**
+             * @brief Returns the byte offsets within the file of the records that satisfy the given tree, in ascending order.
+             *
+             * @param threads The number of threads to scan with. If 0, one thread per hardware thread is used
+            */
+            template<typename Tree>
+            std::vector<std::size_t> matching_offsets(const Tree& tree, unsigned threads = 0) const {
+                std::vector<std::vector<std::size_t>> offsets(chunk_count(threads));
+                scan_chunks(offsets.size(), [&](std::size_t chunk, const Obj* first, const Obj* last) {
+                    for(const Obj* record = first; record != last; ++record) {
+                        if(tree.evaluate(*record)) {
+                            offsets[chunk].push_back(static_cast<std::size_t>(record - records()) * sizeof(Obj));
+                        }
+                    }
+                });
+
+                std::vector<std::size_t> all;
+                for(auto& chunk : offsets) {
+                    all.insert(all.end(), chunk.begin(), chunk.end());
+                }
+                return all;
+            }
+
+        private:
+            detail::file_mapping mapping_;
+
+            std::size_t chunk_count(unsigned threads) const {
+                if(threads == 0) {
+                    threads = std::thread::hardware_concurrency();
+                }
+                std::size_t chunks = threads ? threads : 1;
+                return record_count() < chunks ? (record_count() ? record_count() : 1) : chunks;
+            }
+
+            /**
+             * Calls scan(chunk, first, last) for each of the given number of contiguous chunks of records, each on its own
+             * thread. An exception thrown by any chunk is rethrown once every thread has finished.
+            */
+            template<typename Scan>
+            void scan_chunks(std::size_t chunks, Scan scan) const {
+                const std::size_t per_chunk = record_count() / chunks;
+                const std::size_t remainder = record_count() % chunks;
+
+                std::vector<std::exception_ptr> errors(chunks);
+                std::vector<std::thread> threads;
+                threads.reserve(chunks);
+
+                const Obj* first = records();
+                for(std::size_t chunk = 0; chunk < chunks; ++chunk) {
+                    const Obj* last = first + per_chunk + (chunk < remainder ? 1 : 0);
+                    auto work = [&scan, &errors, chunk, first, last] {
+                        try {
+                            scan(chunk, first, last);
+                        } catch(...) {
+                            errors[chunk] = std::current_exception();
+                        }
+                    };
+
+                    // the last chunk is scanned on the calling thread
+                    if(chunk + 1 == chunks) {
+                        work();
+                    } else {
+                        threads.emplace_back(work);
+                    }
+                    first = last;
+                }
+
+                for(auto& t : threads) {
+                    t.join();
+                }
+                for(auto& error : errors) {
+                    if(error) {
+                        std::rethrow_exception(error);
+                    }
+                }
+            }
+    };
+
+#endif
+
+}
+}
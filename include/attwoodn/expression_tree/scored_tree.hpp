@@ -0,0 +1,196 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace attwoodn {
+namespace expression_tree {
+
+    /**
+     * @brief One weighted predicate of a scored_expression_tree. An object earns the weight if it satisfies the tree.
+    */
+    template<typename Obj>
+    struct scored_term {
+        expression_tree<Obj> tree;
+        double weight;
+    };
+
+    /**
+     * @brief One of the objects returned by scored_expression_tree::top_k.
+    */
+    template<typename Obj>
+    struct scored_match {
+        const Obj* obj;
+        double score;
+
+        // the position of the object in the range that was ranked
+        std::size_t index;
+    };
+
+    /**
+     * @brief Describes how much work a call to scored_expression_tree::top_k did, and how much it skipped.
+    */
+    struct top_k_report {
+        std::size_t candidates = 0;
+
+        // candidates that were discarded before all of their terms were evaluated, because they could no longer enter the top k
+        std::size_t pruned = 0;
+
+        std::size_t terms_evaluated = 0;
+        std::size_t terms_skipped = 0;
+    };
+
+    /**
+     * @brief Scores objects by a set of weighted predicates, and finds the objects with the highest scores.
+     *
+     *        The score of an object is the sum of the weights of the terms that it satisfies. Terms are evaluated in
+     *        descending order of weight, so that the most an object can still score falls as quickly as possible. While
+     *        ranking, a candidate is discarded as soon as its score plus the weights of its unevaluated terms cannot beat the
+     *        lowest score in the current top k, and its remaining terms are not evaluated (as in the max-score variant of WAND
+     *        pruning). Therefore, for large candidate sets and small k, most terms of most candidates are never evaluated.
+     *
+     *        As with expression_tree::evaluate, a term that throws an exception while being evaluated is not satisfied.
+    */
+    template<typename Obj>
+    class scored_expression_tree {
+        public:
+            scored_expression_tree() = delete;
+
+            explicit scored_expression_tree(std::vector<scored_term<Obj>> terms)
+                : terms_(std::move(terms)) {
+                for(auto& term : terms_) {
+                    if(!(term.weight >= 0)) {
+                        throw std::invalid_argument("scored_expression_tree requires term weights that are not negative");
+                    }
+                }
+
+                std::stable_sort(terms_.begin(), terms_.end(), [](const scored_term<Obj>& a, const scored_term<Obj>& b) {
+                    return a.weight > b.weight;
+                });
+
+                // bounds_[i] is the most that terms i and later can add to a score
+                bounds_.resize(terms_.size() + 1, 0);
+                for(std::size_t i = terms_.size(); i-- > 0;) {
+                    bounds_[i] = bounds_[i + 1] + terms_[i].weight;
+                }
+            }
+
+            /**
+             * @brief Returns the sum of the weights of the terms that the given object satisfies.
+            */
+            double score(const Obj& obj) const {
+                double total = 0;
+                for(auto& term : terms_) {
+                    if(term.tree.evaluate(obj)) {
+                        total += term.weight;
+                    }
+                }
+                return total;
+            }
+
+            /**
+             * @brief Returns the highest possible score, which an object earns by satisfying every term.
+            */
+            double max_score() const {
+                return bounds_.front();
+            }
+
+            /**
+             * @brief Returns the k objects of the given range with the highest scores, in descending order of score. Objects
+             *        with equal scores are ordered by their position in the range, and an object only displaces an earlier
+             *        object from the top k if its score is strictly higher. The range must outlive the returned matches.
+             *
+             * @param report If not null, receives the number of terms that were evaluated and skipped
+            */
+            template<typename Range>
+            std::vector<scored_match<Obj>> top_k(const Range& range, std::size_t k, top_k_report* report = nullptr) const {
+                return top_k(std::begin(range), std::end(range), k, report);
+            }
+
+            /**
+             * @brief Returns the k objects in [first, last) with the highest scores. Dereferencing an iterator must yield a
+             *        reference to an Obj that outlives the returned matches.
+            */
+            template<typename Iterator>
+            std::vector<scored_match<Obj>> top_k(Iterator first, Iterator last, std::size_t k, top_k_report* report = nullptr) const {
+                top_k_report local_report;
+                top_k_report& r = report ? *report : local_report;
+                r = top_k_report();
+
+                // a min-heap on (score, -index), so that the front is the match that the next candidate must beat
+                auto worse = [](const scored_match<Obj>& a, const scored_match<Obj>& b) {
+                    return a.score > b.score || (a.score == b.score && a.index < b.index);
+                };
+                std::vector<scored_match<Obj>> heap;
+                if(k == 0) {
+                    return heap;
+                }
+
+                std::size_t index = 0;
+                for(; first != last; ++first, ++index) {
+                    const Obj& obj = *first;
+                    ++r.candidates;
+
+                    // a candidate must score strictly higher than the worst match to displace it
+                    const bool full = heap.size() == k;
+                    const double to_beat = full ? heap.front().score : 0;
+
+                    double total = 0;
+                    std::size_t t = 0;
+                    for(; t < terms_.size(); ++t) {
+                        if(full && total + bounds_[t] <= to_beat) {
+                            break;
+                        }
+                        ++r.terms_evaluated;
+                        if(terms_[t].tree.evaluate(obj)) {
+                            total += terms_[t].weight;
+                        }
+                    }
+
+                    if(t < terms_.size()) {
+                        ++r.pruned;
+                        r.terms_skipped += terms_.size() - t;
+                        continue;
+                    }
+                    if(full && total <= to_beat) {
+                        continue;
+                    }
+
+                    if(full) {
+                        std::pop_heap(heap.begin(), heap.end(), worse);
+                        heap.pop_back();
+                    }
+                    heap.push_back(scored_match<Obj> { &obj, total, index });
+                    std::push_heap(heap.begin(), heap.end(), worse);
+                }
+
+                std::sort_heap(heap.begin(), heap.end(), worse);
+                return heap;
+            }
+
+            std::size_t term_count() const {
+                return terms_.size();
+            }
+
+            /**
+             * @brief Returns the term at the given index, in descending order of weight.
+            */
+            const scored_term<Obj>& term(std::size_t index) const {
+                if(index >= terms_.size()) {
+                    throw std::out_of_range("scored_expression_tree has no term at the given index");
+                }
+                return terms_[index];
+            }
+
+        private:
+            std::vector<scored_term<Obj>> terms_;
+            std::vector<double> bounds_;
+    };
+
+}
+}
@@ -0,0 +1,339 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/field_registry.hpp>
+#include <attwoodn/expression_tree/file_mapping.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace attwoodn {
+namespace expression_tree {
+
+    /**
+     * The version of the binary format written by serialize. Readers reject any other version.
+    */
+    constexpr std::uint16_t serial_format_version = 2;
+
+    namespace detail {
+
+        constexpr char serial_magic[4] = { 'E', 'T', 'R', 'B' };
+        constexpr std::uint16_t serial_byte_order = 0x0102;
+
+        /**
+         * The binary format is a header, followed by an array of branches, followed by a pool of string bytes. It is a
+         * branching program (see detail::compile_branches) whose tests compare registered fields against inline constants.
+         * Nothing in the format is an address, so a serialized tree can be used from wherever it is loaded or mapped.
+        */
+        struct serial_header {
+            char magic[4];
+            std::uint16_t version;
+            std::uint16_t byte_order;
+            std::uint32_t branch_count;
+            std::int32_t entry;
+            std::uint32_t string_pool_size;
+
+            // a hash of the ids and names of the fields that the branches read, so that a tree is not loaded with a
+            // registry whose ids name other fields (see field_names_hash)
+            std::uint32_t field_names_hash;
+        };
+
+        struct serial_branch {
+            std::uint32_t field_id;
+            std::uint8_t comparator;
+            std::uint8_t kind;
+            std::uint8_t value_size;
+            std::uint8_t reserved;
+            std::int32_t on_true;
+            std::int32_t on_false;
+
+            // scalar constants are stored inline, string constants are stored as a
+            // 32-bit offset into the string pool followed by a 32-bit length
+            unsigned char value[8];
+        };
+
+        /**
+         * Hashes the id and name of every field read by the given branches, in order of id, using 32-bit FNV-1a so that
+         * the hash is the same on every platform. fields holds the registry's fields, indexed by id, and every field id
+         * of the branches must be less than its size.
+        */
+        template<typename Obj>
+        std::uint32_t field_names_hash(const serial_branch* branches, std::size_t count, 
+                const std::vector<const field<Obj>*>& fields) {
+            std::vector<bool> used(fields.size(), false);
+            for(std::size_t i = 0; i < count; ++i) {
+                used[branches[i].field_id] = true;
+            }
+
+            std::uint32_t hash = 2166136261u;
+            auto mix = [&hash](unsigned char byte) {
+                hash = (hash ^ byte) * 16777619u;
+            };
+            for(std::size_t id = 0; id < fields.size(); ++id) {
+                if(!used[id]) continue;
+                for(std::size_t shift = 0; shift < 32; shift += 8) {
+                    mix(static_cast<unsigned char>(id >> shift));
+                }
+                for(char c : fields[id]->name()) {
+                    mix(static_cast<unsigned char>(c));
+                }
+                // names are terminated, so that the boundary between two names is part of the hash
+                mix(0);
+            }
+            return hash;
+        }
+
+        template<typename Obj>
+        std::vector<const field<Obj>*> fields_by_id(const field_registry<Obj>& registry) {
+            std::vector<const field<Obj>*> fields;
+            fields.reserve(registry.size());
+            for(std::size_t id = 0; id < registry.size(); ++id) {
+                fields.push_back(registry.at(id));
+            }
+            return fields;
+        }
+
+        static_assert(sizeof(serial_header) == 24, "unexpected padding in serial_header");
+        static_assert(sizeof(serial_branch) == 24, "unexpected padding in serial_branch");
+        static_assert(sizeof(serial_branch::value) >= max_field_value_size, "serial_branch cannot hold every field value");
+    }
+
+    /**
+     * @brief Serializes an expression tree into a versioned binary format. Leaves are stored as the ids of the registry
+     *        fields they read, along with their built-in operator and comparison value.
+     *
+     * @throws std::invalid_argument if the tree contains a leaf whose member is not registered, a leaf with a user-defined
+     *         operator or a null string comparison value, or a node that is not a leaf, op or constant node
+    */
+    template<typename Obj>
+    std::string serialize(const expression_tree<Obj>& tree, const field_registry<Obj>& registry) {
+        auto program = detail::compile_branches(tree.root());
+
+        std::vector<detail::serial_branch> branches;
+        branches.reserve(program.branches.size());
+        std::string pool;
+
+        for(auto& b : program.branches) {
+            auto* leaf = dynamic_cast<const node::expression_tree_leaf_node_base<Obj>*>(b.test);
+            if(!leaf) {
+                throw std::invalid_argument("only leaf, op and constant nodes can be serialized");
+            }
+
+            const field<Obj>* f = registry.find(leaf->get_accessor());
+            const bool is_string_ref = leaf->comp_value_type() == typeid(string_ref);
+            if(!f || (f->value_type() != leaf->comp_value_type() && !(is_string_ref && f->kind() == value_kind::string))) {
+                throw std::invalid_argument("expression tree leaf references a member that is not in the field registry");
+            }
+            if(leaf->get_comparator() == comparator::custom) {
+                throw std::invalid_argument("expression tree leaves with user-defined operators cannot be serialized");
+            }
+
+            detail::serial_branch out {};
+            out.field_id = static_cast<std::uint32_t>(f->id());
+            out.comparator = static_cast<std::uint8_t>(leaf->get_comparator());
+            out.kind = static_cast<std::uint8_t>(f->kind());
+            out.value_size = static_cast<std::uint8_t>(f->value_size());
+            out.on_true = b.on_true;
+            out.on_false = b.on_false;
+
+            if(f->kind() == value_kind::string) {
+                const string_ref str = is_string_ref ? *static_cast<const string_ref*>(leaf->comp_value_ptr()) 
+                                                     : string_ref(*static_cast<const std::string*>(leaf->comp_value_ptr()));
+                if(str.is_null()) {
+                    throw std::invalid_argument("null string comparison values cannot be serialized");
+                }
+                const std::uint32_t location[2] = { static_cast<std::uint32_t>(pool.size()), static_cast<std::uint32_t>(str.size()) };
+                std::memcpy(out.value, location, sizeof(location));
+                pool.append(str.data(), str.size());
+            } else {
+                std::memcpy(out.value, leaf->comp_value_ptr(), f->value_size());
+            }
+            branches.push_back(out);
+        }
+
+        detail::serial_header header {};
+        std::memcpy(header.magic, detail::serial_magic, sizeof(header.magic));
+        header.version = serial_format_version;
+        header.byte_order = detail::serial_byte_order;
+        header.branch_count = static_cast<std::uint32_t>(branches.size());
+        header.entry = program.entry;
+        header.string_pool_size = static_cast<std::uint32_t>(pool.size());
+        header.field_names_hash = detail::field_names_hash(branches.data(), branches.size(), detail::fields_by_id(registry));
+
+        std::string bytes;
+        bytes.reserve(sizeof(header) + branches.size() * sizeof(detail::serial_branch) + pool.size());
+        bytes.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        bytes.append(reinterpret_cast<const char*>(branches.data()), branches.size() * sizeof(detail::serial_branch));
+        bytes += pool;
+        return bytes;
+    }
+
+    /**
+     * @brief Serializes an expression tree and writes it to the file at the given path.
+    */
+    template<typename Obj>
+    void serialize_to_file(const std::string& path, const expression_tree<Obj>& tree, const field_registry<Obj>& registry) {
+        const std::string bytes = serialize(tree, registry);
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if(!file) {
+            throw std::runtime_error("failed to write serialized expression tree to " + path);
+        }
+    }
+
+    /**
+     * @brief Evaluates a serialized expression tree in place, without copying or deserializing it. The serialized bytes
+     *        and the field registry must outlive this object. The registry must register the fields read by the tree with 
+     *        the same names and ids (i.e. in the same order) as the registry that the tree was serialized with.
+    */
+    template<typename Obj>
+    class serialized_expression_tree {
+        public:
+            serialized_expression_tree() = delete;
+
+            /**
+             * @throws std::invalid_argument if the bytes are not a valid serialized expression tree for the given registry
+            */
+            serialized_expression_tree(const void* data, std::size_t size, const field_registry<Obj>& registry) {
+                if(reinterpret_cast<std::uintptr_t>(data) % alignof(detail::serial_branch) != 0) {
+                    throw std::invalid_argument("serialized expression tree is not suitably aligned");
+                }
+                if(size < sizeof(detail::serial_header)) {
+                    throw std::invalid_argument("serialized expression tree is truncated");
+                }
+
+                auto* header = static_cast<const detail::serial_header*>(data);
+                if(std::memcmp(header->magic, detail::serial_magic, sizeof(header->magic)) != 0) {
+                    throw std::invalid_argument("data is not a serialized expression tree");
+                }
+                if(header->version != serial_format_version) {
+                    throw std::invalid_argument("unsupported serialized expression tree version " + std::to_string(header->version));
+                }
+                if(header->byte_order != detail::serial_byte_order) {
+                    throw std::invalid_argument("serialized expression tree was written on a machine with a different byte order");
+                }
+
+                const std::size_t count = header->branch_count;
+                if(size != sizeof(detail::serial_header) + count * sizeof(detail::serial_branch) + header->string_pool_size) {
+                    throw std::invalid_argument("serialized expression tree has an unexpected size");
+                }
+
+                branches_ = reinterpret_cast<const detail::serial_branch*>(header + 1);
+                pool_ = reinterpret_cast<const char*>(branches_ + count);
+                entry_ = header->entry;
+
+                fields_ = detail::fields_by_id(registry);
+
+                auto valid_target = [count](std::int32_t pc, std::int32_t target) {
+                    // jumps must move forward so that evaluation always terminates
+                    return target == detail::branch_accept || target == detail::branch_reject
+                        || (target > pc && static_cast<std::size_t>(target) < count);
+                };
+
+                if(!valid_target(-1, entry_)) {
+                    throw std::invalid_argument("serialized expression tree has an invalid entry point");
+                }
+
+                for(std::size_t i = 0; i < count; ++i) {
+                    const auto& b = branches_[i];
+                    const auto pc = static_cast<std::int32_t>(i);
+                    if(b.field_id >= fields_.size()) {
+                        throw std::invalid_argument("serialized expression tree references an unregistered field id");
+                    }
+
+                    const field<Obj>* f = fields_[b.field_id];
+                    if(static_cast<value_kind>(b.kind) != f->kind() || b.value_size != f->value_size()) {
+                        throw std::invalid_argument("serialized expression tree does not match the type of field " + f->name());
+                    }
+                    if(b.comparator == static_cast<std::uint8_t>(comparator::custom)
+                            || b.comparator > static_cast<std::uint8_t>(comparator::greater_than)) {
+                        throw std::invalid_argument("serialized expression tree contains an unknown operator");
+                    }
+                    if(!valid_target(pc, b.on_true) || !valid_target(pc, b.on_false)) {
+                        throw std::invalid_argument("serialized expression tree contains an invalid jump");
+                    }
+                    if(f->kind() == value_kind::string) {
+                        std::uint32_t location[2];
+                        std::memcpy(location, b.value, sizeof(location));
+                        if(static_cast<std::uint64_t>(location[0]) + location[1] > header->string_pool_size) {
+                            throw std::invalid_argument("serialized expression tree contains an invalid string constant");
+                        }
+                    }
+                }
+
+                // a registry whose fields have the same types but are in another order would otherwise evaluate the
+                // wrong members
+                if(header->field_names_hash != detail::field_names_hash(branches_, count, fields_)) {
+                    throw std::invalid_argument("serialized expression tree was written with a registry whose fields have other names or ids");
+                }
+            }
+
+            /**
+             * @brief Evaluates the given object to determine if it satisfies the serialized expression tree.
+             *
+             * @returns True if the given object satisfied the expression tree conditions;
+             *          False if the given object did not satisfy the expression tree conditions.
+            */
+            bool evaluate(const Obj& obj) const {
+                try {
+                    std::int32_t pc = entry_;
+                    while(pc >= 0) {
+                        const detail::serial_branch& b = branches_[pc];
+                        const field<Obj>* f = fields_[b.field_id];
+
+                        bool result;
+                        if(b.kind == static_cast<std::uint8_t>(value_kind::string)) {
+                            std::uint32_t location[2];
+                            std::memcpy(location, b.value, sizeof(location));
+                            const string_ref value(pool_ + location[0], location[1]);
+                            result = f->compare(obj, static_cast<comparator>(b.comparator), &value);
+                        } else {
+                            result = f->compare(obj, static_cast<comparator>(b.comparator), b.value);
+                        }
+                        pc = result ? b.on_true : b.on_false;
+                    }
+                    return pc == detail::branch_accept;
+                } catch(std::exception& e) {
+                    return false;
+                }
+            }
+
+        private:
+            const detail::serial_branch* branches_ = nullptr;
+            const char* pool_ = nullptr;
+            std::int32_t entry_ = detail::branch_reject;
+            std::vector<const field<Obj>*> fields_;
+    };
+
+#ifdef ATTWOODN_EXPRESSION_TREE_HAS_MMAP
+
+    /**
+     * @brief A serialized expression tree that is evaluated directly from the read-only, shared memory mapped pages of
+     *        the file that it was written to. The field registry must outlive this object.
+    */
+    template<typename Obj>
+    class mapped_expression_tree {
+        public:
+            mapped_expression_tree(const std::string& path, const field_registry<Obj>& registry)
+                : mapping_(path),
+                  tree_(mapping_.data(), mapping_.size(), registry) {}
+
+            mapped_expression_tree(const mapped_expression_tree&) = delete;
+            mapped_expression_tree& operator=(const mapped_expression_tree&) = delete;
+
+            bool evaluate(const Obj& obj) const {
+                return tree_.evaluate(obj);
+            }
+
+        private:
+            detail::file_mapping mapping_;
+            serialized_expression_tree<Obj> tree_;
+    };
+
+#endif
+
+}
+}
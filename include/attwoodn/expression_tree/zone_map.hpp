@@ -0,0 +1,454 @@
+#pragma once
+
+#include <attwoodn/expression_tree.hpp>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+namespace attwoodn {
+namespace expression_tree {
+
+    /**
+     * @brief The statistics of one tracked member over one block of objects. Pointer members are summarized by the values
+     *        they point to, and null pointers are counted separately.
+    */
+    template<typename T>
+    struct block_zone {
+        T min {};
+        T max {};
+
+        // the number of values that are summarized by min and max, i.e. that are not null
+        std::size_t count = 0;
+
+        std::size_t null_count = 0;
+
+        // false if a value of the block could not be read, or could not be ordered (e.g. NaN), so that min and max are not bounds
+        bool complete = true;
+    };
+
+    /**
+     * @brief Describes how much work a zone_map scan did, and how much it skipped.
+    */
+    struct zone_scan_report {
+        std::size_t blocks = 0;
+
+        // blocks in which no object can satisfy the tree, whose objects were not evaluated
+        std::size_t blocks_skipped = 0;
+
+        // blocks in which every object satisfies the tree, whose objects were not evaluated
+        std::size_t blocks_accepted = 0;
+
+        std::size_t objects_evaluated = 0;
+    };
+
+namespace detail {
+
+    template<typename T>
+    using zone_value_t = typename std::remove_cv<typename std::remove_pointer<typename std::decay<T>::type>::type>::type;
+
+    /**
+     * Returns whether every value summarized by the given zone satisfies a built-in comparison with a non-null value,
+     * none of them do, or neither is certain. Null values do not satisfy less_than, greater_than or equals, and satisfy
+     * not_equals, as with the pointer overloads of the built-in operators. The value may be of another type than the zone's
+     * values, such as a string_ref compared with a zone of std::string values. A NaN value satisfies not_equals with every
+     * value, and no other comparison.
+    */
+    template<typename T, typename V>
+    partial_result check_zone(comparator c, const V& value, const block_zone<T>& zone) {
+        if(is_unordered_value(value, std::is_floating_point<V>{})) {
+            switch(c) {
+                case comparator::less_than:
+                case comparator::greater_than:
+                case comparator::equals:
+                    return partial_result::false_value;
+                case comparator::not_equals:
+                    return partial_result::true_value;
+                default:
+                    return partial_result::unknown;
+            }
+        }
+
+        const bool no_values = zone.count == 0;
+        const bool no_nulls = zone.null_count == 0;
+        const bool outside = no_values || value < zone.min || zone.max < value;
+        const bool single = !no_values && !(zone.min < value) && !(value < zone.max);
+
+        switch(c) {
+            case comparator::less_than:
+                if(no_values || !(zone.min < value)) return partial_result::false_value;
+                if(no_nulls && zone.max < value) return partial_result::true_value;
+                break;
+            case comparator::greater_than:
+                if(no_values || !(value < zone.max)) return partial_result::false_value;
+                if(no_nulls && value < zone.min) return partial_result::true_value;
+                break;
+            case comparator::equals:
+                if(outside) return partial_result::false_value;
+                if(no_nulls && single) return partial_result::true_value;
+                break;
+            case comparator::not_equals:
+                if(outside) return partial_result::true_value;
+                if(no_nulls && single) return partial_result::false_value;
+                break;
+            default:
+                break;
+        }
+        return partial_result::unknown;
+    }
+
+    template<typename Obj>
+    class zone_column_base {
+        public:
+            virtual ~zone_column_base() = default;
+
+            virtual accessor_id accessor() const = 0;
+
+            /**
+             * Checks a leaf node that reads this column against the statistics of the given block.
+            */
+            virtual partial_result check(const node::expression_tree_leaf_node_base<Obj>& leaf, std::size_t block) const = 0;
+    };
+
+    template<typename Obj, typename V>
+    class zone_column : public zone_column_base<Obj> {
+        public:
+            const block_zone<V>& zone(std::size_t block) const {
+                return zones_.at(block);
+            }
+
+        protected:
+            std::vector<block_zone<V>> zones_;
+    };
+
+    template<typename Obj, typename T, typename Accessor>
+    class typed_zone_column : public zone_column<Obj, zone_value_t<T>> {
+        public:
+            using stored_type = typename std::decay<T>::type;
+            using value_type = zone_value_t<T>;
+
+            static_assert(is_ordered<value_type>::value, "zone_map requires members whose values have an operator<");
+
+            typed_zone_column(accessor_id id, Accessor accessor, const Obj* objs, std::size_t count, std::size_t block_size)
+                : id_(id) {
+                for(std::size_t first = 0; first < count; first += block_size) {
+                    const std::size_t last = first + block_size < count ? first + block_size : count;
+                    block_zone<value_type> zone;
+                    for(std::size_t i = first; i < last && zone.complete; ++i) {
+                        try {
+                            add(zone, read_accessor(objs[i], accessor), std::is_pointer<stored_type>{});
+                        } catch(std::exception& e) {
+                            zone.complete = false;
+                        }
+                    }
+                    this->zones_.push_back(zone);
+                }
+            }
+
+            accessor_id accessor() const override {
+                return id_;
+            }
+
+            partial_result check(const node::expression_tree_leaf_node_base<Obj>& leaf, std::size_t block) const override {
+                const block_zone<value_type>& zone = this->zones_[block];
+                if(!zone.complete || leaf.get_comparator() == comparator::custom) {
+                    return partial_result::unknown;
+                }
+                if(leaf.comp_value_type() == typeid(stored_type)) {
+                    return check(leaf.get_comparator(), *static_cast<const stored_type*>(leaf.comp_value_ptr()), zone,
+                        std::is_pointer<stored_type>{});
+                }
+                if(leaf.comp_value_type() == typeid(string_ref)) {
+                    return check_string_ref(leaf.get_comparator(), *static_cast<const string_ref*>(leaf.comp_value_ptr()), zone,
+                        std::is_same<stored_type, std::string>{});
+                }
+                return partial_result::unknown;
+            }
+
+        private:
+            accessor_id id_;
+
+            static void add(block_zone<value_type>& zone, const value_type& value, std::false_type) {
+                if(is_unordered_value(value, std::is_floating_point<value_type>{})) {
+                    zone.complete = false;
+                } else if(zone.count++ == 0) {
+                    zone.min = value;
+                    zone.max = value;
+                } else if(value < zone.min) {
+                    zone.min = value;
+                } else if(zone.max < value) {
+                    zone.max = value;
+                }
+            }
+
+            static void add(block_zone<value_type>& zone, const stored_type& value, std::true_type) {
+                if(value == nullptr) {
+                    ++zone.null_count;
+                } else {
+                    add(zone, *value, std::false_type{});
+                }
+            }
+
+            static partial_result check(comparator c, const stored_type& value, const block_zone<value_type>& zone, std::false_type) {
+                return check_zone(c, value, zone);
+            }
+
+            static partial_result check(comparator c, const stored_type& value, const block_zone<value_type>& zone, std::true_type) {
+                if(value != nullptr) {
+                    return check_zone(c, *value, zone);
+                }
+
+                // only null pointers are equal to a null comparison value, and nothing is ordered against it
+                switch(c) {
+                    case comparator::equals:
+                        if(zone.count == 0) return partial_result::true_value;
+                        if(zone.null_count == 0) return partial_result::false_value;
+                        return partial_result::unknown;
+                    case comparator::not_equals:
+                        if(zone.count == 0) return partial_result::false_value;
+                        if(zone.null_count == 0) return partial_result::true_value;
+                        return partial_result::unknown;
+                    default:
+                        return partial_result::false_value;
+                }
+            }
+
+            static partial_result check_string_ref(comparator, const string_ref&, const block_zone<value_type>&, std::false_type) {
+                return partial_result::unknown;
+            }
+
+            /**
+             * Checks a std::string column against a string_ref. Strings are never null, so they are all unequal to, and
+             * not ordered against, a null string_ref.
+            */
+            static partial_result check_string_ref(comparator c, const string_ref& value, const block_zone<value_type>& zone, std::true_type) {
+                if(!value.is_null()) {
+                    return check_zone(c, value, zone);
+                }
+                return c == comparator::not_equals ? partial_result::true_value : partial_result::false_value;
+            }
+    };
+
+}
+
+    /**
+     * @brief Splits an array of objects into fixed-size blocks, and keeps the minimum, maximum, and null count of each
+     *        tracked member over each block. When scanning the array with an expression tree, the leaf nodes that compare
+     *        tracked members using built-in operators are checked against each block's statistics first. Blocks in which
+     *        no object can satisfy the tree are skipped, and blocks in which every object satisfies the tree are accepted,
+     *        without evaluating their objects. Only the remaining blocks are evaluated object by object.
+     *
+     *        Zone maps pay off when the tracked members are sorted or clustered, e.g. timestamps of time-ordered data, so
+     *        that most blocks span a narrow range of values. The statistics are computed once, when a member is tracked,
+     *        and the objects must not change afterwards. The array must outlive the zone map.
+    */
+    template<typename Obj>
+    class zone_map {
+        public:
+            zone_map() = delete;
+
+            /**
+             * @throws std::invalid_argument if the block size is zero
+            */
+            zone_map(const Obj* objs, std::size_t count, std::size_t block_size = 1024)
+                : objs_(objs),
+                  count_(count),
+                  block_size_(block_size) {
+                if(block_size == 0) {
+                    throw std::invalid_argument("zone_map requires a block size greater than zero");
+                }
+            }
+
+            /**
+             * @brief Computes the statistics of the given member variable for each block. Chainable.
+            */
+            template<typename T>
+            zone_map& track(const T Obj::* member_var) {
+                return add_column<T>(accessor_id(accessor_id::kind::member_variable, member_var), member_var);
+            }
+
+            /**
+             * @brief Computes the statistics of the values returned by the given const member function for each block. Chainable.
+            */
+            template<typename T>
+            zone_map& track(T (Obj::* member_func)() const) {
+                return add_column<T>(accessor_id(accessor_id::kind::member_function, member_func), member_func);
+            }
+
+            bool tracks(const accessor_id& accessor) const {
+                return find_column(accessor) != nullptr;
+            }
+
+            /**
+             * @brief Returns the statistics of a tracked member for the given block.
+             *
+             * @throws std::invalid_argument if the member is not tracked, and std::out_of_range if there is no such block
+            */
+            template<typename T>
+            const block_zone<detail::zone_value_t<T>>& zone(const T Obj::* member_var, std::size_t block) const {
+                return typed_column<T>(accessor_of(member_var)).zone(block);
+            }
+
+            template<typename T>
+            const block_zone<detail::zone_value_t<T>>& zone(T (Obj::* member_func)() const, std::size_t block) const {
+                return typed_column<T>(accessor_of(member_func)).zone(block);
+            }
+
+            std::size_t size() const {
+                return count_;
+            }
+
+            std::size_t block_size() const {
+                return block_size_;
+            }
+
+            std::size_t block_count() const {
+                return (count_ + block_size_ - 1) / block_size_;
+            }
+
+            /**
+             * @brief Returns partial_result::false_value if no object of the given block satisfies the tree,
+             *        partial_result::true_value if every object of the block satisfies it, or partial_result::unknown if
+             *        the statistics of the block cannot tell.
+             *
+             * @throws std::out_of_range if there is no such block
+            */
+            partial_result check_block(const expression_tree<Obj>& tree, std::size_t block) const {
+                if(block >= block_count()) {
+                    throw std::out_of_range("zone_map has no block at the given index");
+                }
+                const detail::branching_program<Obj> program = detail::compile_branches(tree.root());
+                return check_block(program, detail::threshold_programs<Obj>(program), block);
+            }
+
+            /**
+             * @brief Calls f(index) with the index of each object that satisfies the given tree, in order.
+             *
+             * @param report If not null, receives the number of blocks that were skipped and accepted
+            */
+            template<typename Function>
+            void for_each_match(const expression_tree<Obj>& tree, Function f, zone_scan_report* report = nullptr) const {
+                zone_scan_report local_report;
+                zone_scan_report& r = report ? *report : local_report;
+                r = zone_scan_report();
+
+                const detail::branching_program<Obj> program = detail::compile_branches(tree.root());
+                const detail::threshold_programs<Obj> thresholds(program);
+                for(std::size_t block = 0; block < block_count(); ++block) {
+                    const std::size_t first = block * block_size_;
+                    const std::size_t last = first + block_size_ < count_ ? first + block_size_ : count_;
+                    ++r.blocks;
+
+                    switch(check_block(program, thresholds, block)) {
+                        case partial_result::false_value:
+                            ++r.blocks_skipped;
+                            break;
+                        case partial_result::true_value:
+                            ++r.blocks_accepted;
+                            for(std::size_t i = first; i < last; ++i) {
+                                f(i);
+                            }
+                            break;
+                        case partial_result::unknown:
+                            r.objects_evaluated += last - first;
+                            for(std::size_t i = first; i < last; ++i) {
+                                if(tree.evaluate(objs_[i])) {
+                                    f(i);
+                                }
+                            }
+                            break;
+                    }
+                }
+            }
+
+            /**
+             * @brief Returns the number of objects that satisfy the given tree.
+            */
+            std::size_t count(const expression_tree<Obj>& tree, zone_scan_report* report = nullptr) const {
+                std::size_t matches = 0;
+                for_each_match(tree, [&matches](std::size_t) { ++matches; }, report);
+                return matches;
+            }
+
+        private:
+            const Obj* objs_;
+            std::size_t count_;
+            std::size_t block_size_;
+            std::vector<std::unique_ptr<detail::zone_column_base<Obj>>> columns_;
+
+            /**
+             * The test used to evaluate a tree against the statistics of a block. Leaf nodes that the statistics cannot
+             * decide evaluate to unknown_value. The children of threshold nodes are evaluated using the same test.
+            */
+            struct zone_test {
+                const zone_map& zones;
+                const detail::threshold_programs<Obj>& thresholds;
+                std::size_t block;
+                bool unknown_value;
+
+                bool operator()(const node::expression_tree_node<Obj>& test, const Obj& obj) const {
+                    if(auto* threshold = dynamic_cast<const node::expression_tree_threshold_node<Obj>*>(&test)) {
+                        return threshold->evaluate(obj, [this](const node::expression_tree_node<Obj>& child, const Obj& o) {
+                            return thresholds.of(child).evaluate(o, *this);
+                        });
+                    }
+
+                    auto* leaf = dynamic_cast<const node::expression_tree_leaf_node_base<Obj>*>(&test);
+                    auto* column = leaf ? zones.find_column(leaf->get_accessor()) : nullptr;
+                    if(!column) {
+                        return unknown_value;
+                    }
+
+                    switch(column->check(*leaf, block)) {
+                        case partial_result::true_value: return true;
+                        case partial_result::false_value: return false;
+                        default: return unknown_value;
+                    }
+                }
+            };
+
+            partial_result check_block(const detail::branching_program<Obj>& program, const detail::threshold_programs<Obj>& thresholds,
+                    std::size_t block) const {
+                // as in expression_tree::evaluate_partial, the tree is decided if it has the same result whatever the
+                // undecided leaves evaluate to. The first object of the block is only passed through to the test
+                const Obj& first = objs_[block * block_size_];
+                if(program.evaluate(first, zone_test { *this, thresholds, block, false })) {
+                    return partial_result::true_value;
+                }
+                if(!program.evaluate(first, zone_test { *this, thresholds, block, true })) {
+                    return partial_result::false_value;
+                }
+                return partial_result::unknown;
+            }
+
+            const detail::zone_column_base<Obj>* find_column(const accessor_id& accessor) const {
+                for(auto& column : columns_) {
+                    if(column->accessor() == accessor) {
+                        return column.get();
+                    }
+                }
+                return nullptr;
+            }
+
+            template<typename T, typename Accessor>
+            zone_map& add_column(accessor_id id, Accessor accessor) {
+                if(!find_column(id)) {
+                    columns_.emplace_back(new detail::typed_zone_column<Obj, T, Accessor>(id, accessor, objs_, count_, block_size_));
+                }
+                return *this;
+            }
+
+            template<typename T>
+            const detail::zone_column<Obj, detail::zone_value_t<T>>& typed_column(const accessor_id& accessor) const {
+                auto* column = dynamic_cast<const detail::zone_column<Obj, detail::zone_value_t<T>>*>(find_column(accessor));
+                if(!column) {
+                    throw std::invalid_argument("zone_map does not track the given member");
+                }
+                return *column;
+            }
+    };
+
+}
+}
@@ -0,0 +1,236 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/flat_tree.hpp>
+#include <attwoodn/expression_tree/parser.hpp>
+#include <attwoodn/expression_tree/serialize.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include "allocation_counter.hpp"
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+struct record {
+    int id;
+    bool active;
+    uint16_t port;
+    double score;
+    std::string name;
+    std::vector<int> tags;
+    char* code;
+
+    int get_id() const {
+        return id;
+    }
+
+    bool is_active() const {
+        return active;
+    }
+};
+
+// longer than any small string optimization buffer, so that a copy of it would allocate
+const std::string long_name = "a record name that is much too long to fit in a small string buffer";
+
+void test_allocation_counter();
+void test_evaluate_does_not_allocate();
+void test_evaluate_batch_does_not_allocate();
+void test_filter_does_not_allocate();
+void test_flat_tree_evaluate_does_not_allocate();
+void test_serialized_evaluate_does_not_allocate();
+void test_string_literal_leaf_does_not_allocate();
+void test_threshold_evaluate_partial_does_not_allocate();
+
+int main() {
+    test_allocation_counter();
+    test_evaluate_does_not_allocate();
+    test_evaluate_batch_does_not_allocate();
+    test_filter_does_not_allocate();
+    test_flat_tree_evaluate_does_not_allocate();
+    test_serialized_evaluate_does_not_allocate();
+    test_string_literal_leaf_does_not_allocate();
+    test_threshold_evaluate_partial_does_not_allocate();
+
+    return EXIT_SUCCESS;
+}
+
+std::vector<record> make_records() {
+    static char code_a = 'a';
+    static char code_b = 'b';
+
+    std::vector<record> records;
+    for(int i = 0; i < 200; ++i) {
+        records.push_back(record { i, i % 2 == 0, static_cast<uint16_t>(i * 10), i / 7.0,
+            i % 3 == 0 ? long_name : long_name + "!", { i, i + 1, i + 2 }, i % 5 == 0 ? &code_a : &code_b });
+    }
+    return records;
+}
+
+expression_tree<record> make_record_tree() {
+    static char code_a = 'a';
+
+    return expression_tree<record> {
+        make_expr(&record::name, op::equals, long_name)
+        ->AND(make_expr(&record::tags, op::not_equals, std::vector<int> { 3, 4, 5 }))
+        ->AND(make_expr(&record::get_id, op::greater_than, 10)
+            ->OR(make_expr(&record::is_active, op::equals, true)))
+        ->AND(make_expr(&record::port, op::less_than, (uint16_t) 1800)
+            ->OR(make_expr(&record::score, op::greater_than, 5.0)))
+        ->AND(make_expr(&record::code, op::not_equals, &code_a)
+            ->OR(make_expr(&record::active, op::equals, false)))
+    };
+}
+
+void test_allocation_counter() {
+    // the replaced operator new sees allocations made by the library and by this program
+    assert(count_allocations([] { ::operator delete(::operator new(16)); }) == 1);
+    assert(count_allocations([] { std::string copy(long_name); assert(copy.size() == long_name.size()); }) == 1);
+    assert(count_allocations([] { delete make_expr(&record::id, op::equals, 1); }) == 1);
+}
+
+void test_evaluate_does_not_allocate() {
+    const auto records = make_records();
+    const auto expr = make_record_tree();
+
+    std::size_t matches = 0;
+    assert(count_allocations([&] {
+        for(auto& r : records) {
+            matches += expr.evaluate(r);
+        }
+    }) == 0);
+
+    std::size_t expected = 0;
+    for(auto& r : records) {
+        expected += expr.evaluate(r);
+    }
+    assert(matches == expected);
+    assert(matches > 0 && matches < records.size());
+
+    // a user-defined operator that takes its arguments by reference does not allocate either
+    auto same_length = [](const std::string& a, const std::string& b) { return a.size() == b.size(); };
+    expression_tree<record> custom { make_expr(&record::name, same_length, long_name) };
+    assert(count_allocations([&] { assert(custom.evaluate(records[0])); }) == 0);
+}
+
+void test_evaluate_batch_does_not_allocate() {
+    const auto records = make_records();
+    const auto expr = make_record_tree();
+
+    std::vector<const record*> ptrs;
+    for(auto& r : records) {
+        ptrs.push_back(&r);
+    }
+    std::unique_ptr<bool[]> results(new bool[ptrs.size()]);
+
+    assert(count_allocations([&] { expr.evaluate_batch(ptrs.data(), ptrs.size(), results.get()); }) == 0);
+
+    for(std::size_t i = 0; i < records.size(); ++i) {
+        assert(results[i] == expr.evaluate(records[i]));
+    }
+}
+
+void test_filter_does_not_allocate() {
+    const auto records = make_records();
+    const auto expr = make_record_tree();
+
+    std::size_t matches = 0;
+    assert(count_allocations([&] {
+        for(const record& r : expr.filter(records)) {
+            matches += r.name == long_name;
+        }
+    }) == 0);
+    assert(matches > 0);
+}
+
+void test_flat_tree_evaluate_does_not_allocate() {
+    const auto records = make_records();
+    const auto expr = make_record_tree();
+    const flat_expression_tree<record> flat(expr);
+
+    std::size_t matches = 0;
+    assert(count_allocations([&] {
+        for(auto& r : records) {
+            matches += flat.evaluate(r);
+        }
+    }) == 0);
+
+    std::size_t expected = 0;
+    for(auto& r : records) {
+        expected += expr.evaluate(r);
+    }
+    assert(matches == expected);
+}
+
+void test_serialized_evaluate_does_not_allocate() {
+    const auto records = make_records();
+
+    field_registry<record> registry;
+    registry.add("id", &record::id)
+            .add("active", &record::active)
+            .add("name", &record::name);
+
+    const expression_tree<record> expr {
+        parse_expr(registry, "name == \"" + long_name + "\" && (id > 10 || active == true)")
+    };
+    const std::string bytes = serialize(expr, registry);
+    const serialized_expression_tree<record> serialized(bytes.data(), bytes.size(), registry);
+
+    std::size_t matches = 0;
+    assert(count_allocations([&] {
+        for(auto& r : records) {
+            matches += serialized.evaluate(r);
+        }
+    }) == 0);
+
+    std::size_t expected = 0;
+    for(auto& r : records) {
+        expected += expr.evaluate(r);
+    }
+    assert(matches == expected);
+    assert(matches > 0);
+}
+
+void test_string_literal_leaf_does_not_allocate() {
+    const auto records = make_records();
+    const char* literal = "a record name that is much too long to fit in a small string buffer";
+
+    // a leaf that compares with a string literal refers to it, while a leaf that compares with a std::string copies it
+    assert(count_allocations([&] { delete make_expr(&record::name, op::equals, literal); }) == 1);
+    assert(count_allocations([&] { delete make_expr(&record::name, op::equals, long_name); }) == 2);
+
+    const expression_tree<record> expr { 
+        make_expr(&record::name, op::equals, "a record name that is much too long to fit in a small string buffer")
+        ->AND(make_expr(&record::name, op::less_than, literal)->OR(make_expr(&record::id, op::less_than, 100)))
+    };
+    const flat_expression_tree<record> flat(expr);
+
+    std::size_t matches = 0;
+    std::size_t flat_matches = 0;
+    assert(count_allocations([&] {
+        for(auto& r : records) {
+            matches += expr.evaluate(r);
+            flat_matches += flat.evaluate(r);
+        }
+    }) == 0);
+    assert(matches == 34);
+    assert(flat_matches == matches);
+}
+
+void test_threshold_evaluate_partial_does_not_allocate() {
+    const auto records = make_records();
+
+    // the children of threshold nodes, including nested ones, are compiled when the tree is
+    const expression_tree<record> expr { 
+        make_threshold(2, 
+            make_expr(&record::get_id, op::greater_than, 10), 
+            make_expr(&record::is_active, op::equals, true)->AND(make_expr(&record::port, op::less_than, (uint16_t) 1800)),
+            make_threshold(1, make_expr(&record::score, op::greater_than, 5.0), make_expr(&record::name, op::equals, long_name)))
+    };
+    const std::vector<accessor_id> known { accessor_of(&record::get_id), accessor_of(&record::is_active) };
+
+    std::size_t decided = 0;
+    assert(count_allocations([&] {
+        for(auto& r : records) {
+            decided += expr.evaluate_partial(r, known) != partial_result::unknown;
+        }
+    }) == 0);
+    assert(decided > 0);
+}
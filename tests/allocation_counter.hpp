@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+/**
+ * Replaces the global allocation functions, so that every heap allocation made by the including program is counted.
+ * Include this header in exactly one translation unit of a test program.
+*/
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+// GCC does not recognize that the replaced allocation functions below pair malloc with free
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+static std::size_t allocation_count = 0;
+
+void* operator new(std::size_t size) {
+    ++allocation_count;
+    void* ptr = std::malloc(size ? size : 1);
+    if(!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+/**
+ * Returns the number of heap allocations made while calling the given function.
+*/
+template<typename Function>
+std::size_t count_allocations(Function f) {
+    const std::size_t before = allocation_count;
+    f();
+    return allocation_count - before;
+}
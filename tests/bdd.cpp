@@ -0,0 +1,246 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/bdd.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <memory>
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+struct policy_input {
+    int level;
+    int region;
+    bool admin;
+    bool flagged;
+
+    static int level_reads;
+
+    int get_level() const {
+        ++level_reads;
+        return level;
+    }
+};
+
+int policy_input::level_reads = 0;
+
+void test_bdd_matches_expression_tree();
+void test_bdd_reduction();
+void test_bdd_tests_each_leaf_once();
+void test_bdd_cost_order();
+void test_bdd_node_limit();
+void test_bdd_exception_fallback();
+void test_bdd_copy();
+
+int main() {
+    test_bdd_matches_expression_tree();
+    test_bdd_reduction();
+    test_bdd_tests_each_leaf_once();
+    test_bdd_cost_order();
+    test_bdd_node_limit();
+    test_bdd_exception_fallback();
+    test_bdd_copy();
+
+    return EXIT_SUCCESS;
+}
+
+std::vector<policy_input> make_inputs() {
+    std::vector<policy_input> inputs;
+    for(int level = 0; level < 6; ++level) {
+        for(int region = 0; region < 4; ++region) {
+            for(int bits = 0; bits < 4; ++bits) {
+                inputs.push_back(policy_input { level, region, (bits & 1) != 0, (bits & 2) != 0 });
+            }
+        }
+    }
+    return inputs;
+}
+
+expression_tree<policy_input> make_policy() {
+    // the same leaves are re-tested along different paths of the tree
+    return expression_tree<policy_input> {
+        make_expr(&policy_input::admin, op::equals, true)
+            ->AND(make_expr(&policy_input::flagged, op::equals, false))
+        ->OR(make_expr(&policy_input::get_level, op::greater_than, 3)
+            ->AND(make_expr(&policy_input::flagged, op::equals, false)))
+        ->OR(make_expr(&policy_input::region, op::equals, 2)
+            ->AND(make_expr(&policy_input::get_level, op::greater_than, 3)
+                ->OR(make_expr(&policy_input::admin, op::equals, true))))
+    };
+}
+
+void test_bdd_matches_expression_tree() {
+    const auto expr = make_policy();
+    bdd_expression_tree<policy_input> bdd(expr);
+    assert(bdd.is_compiled());
+    assert(bdd.variable_count() == 4);
+
+    const auto inputs = make_inputs();
+    for(auto& input : inputs) {
+        assert(bdd.evaluate(input) == expr.evaluate(input));
+    }
+
+    std::vector<const policy_input*> ptrs;
+    for(auto& input : inputs) {
+        ptrs.push_back(&input);
+    }
+    std::unique_ptr<bool[]> results(new bool[ptrs.size()]);
+    bdd.evaluate_batch(ptrs.data(), ptrs.size(), results.get());
+    for(std::size_t i = 0; i < inputs.size(); ++i) {
+        assert(results[i] == expr.evaluate(inputs[i]));
+    }
+}
+
+void test_bdd_reduction() {
+    // (a || b) && (b || a) only needs to test a and b
+    bdd_expression_tree<policy_input> repeated(expression_tree<policy_input> {
+        make_expr(&policy_input::admin, op::equals, true)
+            ->OR(make_expr(&policy_input::flagged, op::equals, true))
+        ->AND(make_expr(&policy_input::flagged, op::equals, true)
+            ->OR(make_expr(&policy_input::admin, op::equals, true)))
+    });
+    assert(repeated.variable_count() == 2);
+    assert(repeated.node_count() == 2);
+
+    // a tautology needs no tests at all
+    auto* root = new node::expression_tree_dynamic_op_node<policy_input>(node::boolean_op::OR);
+    root->set_left(make_expr(&policy_input::level, op::less_than, 3));
+    root->set_right(new node::expression_tree_constant_node<policy_input>(true));
+    bdd_expression_tree<policy_input> tautology(expression_tree<policy_input> { root });
+    assert(tautology.node_count() == 0);
+    assert(tautology.evaluate(policy_input { 5, 0, false, false }));
+}
+
+void test_bdd_tests_each_leaf_once() {
+    const auto expr = make_policy();
+    bdd_expression_tree<policy_input> bdd(expr);
+
+    for(auto& input : make_inputs()) {
+        policy_input::level_reads = 0;
+        bdd.evaluate(input);
+        assert(policy_input::level_reads <= 1);
+    }
+
+    // the tree itself re-tests the level of this input
+    policy_input::level_reads = 0;
+    assert(expr.evaluate(policy_input { 4, 2, false, true }));
+    assert(policy_input::level_reads == 2);
+
+    policy_input::level_reads = 0;
+    assert(bdd.evaluate(policy_input { 4, 2, false, true }));
+    assert(policy_input::level_reads == 1);
+}
+
+void test_bdd_cost_order() {
+    const expression_tree<policy_input> expr {
+        make_expr(&policy_input::get_level, op::greater_than, 3)
+            ->AND(make_expr(&policy_input::admin, op::equals, true))
+    };
+
+    // the member function is more expensive than the member variable, so it is tested last
+    bdd_expression_tree<policy_input> bdd(expr);
+    policy_input::level_reads = 0;
+    assert(!bdd.evaluate(policy_input { 4, 0, false, false }));
+    assert(policy_input::level_reads == 0);
+    assert(bdd.evaluate(policy_input { 4, 0, true, false }));
+    assert(policy_input::level_reads == 1);
+
+    // a custom cost function may prefer the member function
+    auto prefer_functions = [](const node::expression_tree_node<policy_input>& n) {
+        auto* leaf = dynamic_cast<const node::expression_tree_leaf_node_base<policy_input>*>(&n);
+        return leaf && leaf->get_accessor() == accessor_of(&policy_input::get_level) ? 0.0 : 1.0;
+    };
+    bdd_expression_tree<policy_input> custom(expr, prefer_functions);
+    policy_input::level_reads = 0;
+    assert(!custom.evaluate(policy_input { 4, 0, false, false }));
+    assert(policy_input::level_reads == 1);
+}
+
+void test_bdd_node_limit() {
+    const auto expr = make_policy();
+    bdd_expression_tree<policy_input> limited(expr, 2);
+    assert(!limited.is_compiled());
+    assert(limited.node_count() == 0);
+    for(auto& input : make_inputs()) {
+        assert(limited.evaluate(input) == expr.evaluate(input));
+    }
+
+    // a chain of distinct leaves has more variables than the default limit allows
+    node::expression_tree_node<policy_input>* chain = make_expr(&policy_input::level, op::equals, 0);
+    for(int i = 1; i < 10000; ++i) {
+        auto* next = new node::expression_tree_dynamic_op_node<policy_input>(node::boolean_op::OR);
+        next->set_left(chain);
+        next->set_right(make_expr(&policy_input::level, op::equals, i));
+        chain = next;
+    }
+    bdd_expression_tree<policy_input> deep(expression_tree<policy_input> { chain });
+    assert(!deep.is_compiled());
+    assert(deep.evaluate(policy_input { 9999, 0, false, false }));
+    assert(!deep.evaluate(policy_input { 10000, 0, false, false }));
+
+    // a shorter chain compiles into one node per leaf
+    chain = make_expr(&policy_input::level, op::equals, 0);
+    for(int i = 1; i < 300; ++i) {
+        auto* next = new node::expression_tree_dynamic_op_node<policy_input>(node::boolean_op::OR);
+        next->set_left(chain);
+        next->set_right(make_expr(&policy_input::level, op::equals, i));
+        chain = next;
+    }
+    bdd_expression_tree<policy_input> shallow(expression_tree<policy_input> { chain });
+    assert(shallow.is_compiled());
+    assert(shallow.node_count() == 300);
+    assert(shallow.evaluate(policy_input { 299, 0, false, false }));
+    assert(!shallow.evaluate(policy_input { 300, 0, false, false }));
+}
+
+void test_bdd_exception_fallback() {
+    auto throws = [](bool, bool) -> bool {
+        throw std::runtime_error("not decodable");
+    };
+    const expression_tree<policy_input> expr {
+        make_expr(&policy_input::admin, op::equals, true)
+            ->OR(make_expr(&policy_input::flagged, throws, false))
+    };
+
+    // the tree short-circuits past the throwing leaf when admin is true
+    assert(expr.evaluate(policy_input { 0, 0, true, false }));
+    assert(!expr.evaluate(policy_input { 0, 0, false, false }));
+
+    // make the throwing leaf the first variable of the diagram
+    auto throwing_first = [](const node::expression_tree_node<policy_input>& n) {
+        auto* leaf = dynamic_cast<const node::expression_tree_leaf_node_base<policy_input>*>(&n);
+        return leaf->get_comparator() == comparator::custom ? 0.0 : 1.0;
+    };
+    bdd_expression_tree<policy_input> bdd(expr, throwing_first);
+    assert(bdd.is_compiled());
+    assert(bdd.evaluate(policy_input { 0, 0, true, false }));
+    assert(!bdd.evaluate(policy_input { 0, 0, false, false }));
+}
+
+void test_bdd_copy() {
+    std::unique_ptr<bdd_expression_tree<test_fixture>> original(new bdd_expression_tree<test_fixture>(expression_tree<test_fixture> {
+        make_expr(&test_fixture::some_string, op::equals, std::string("hello"))
+        ->OR(make_expr(&test_fixture::some_uint, op::greater_than, (uint16_t) 5))
+    }));
+
+    bdd_expression_tree<test_fixture> copy(*original);
+    bdd_expression_tree<test_fixture> assigned(expression_tree<test_fixture> { 
+        make_expr(&test_fixture::some_uint, op::equals, (uint16_t) 0) 
+    });
+    assigned = *original;
+    original.reset();
+
+    // the copies must not refer to the nodes of the destroyed original
+    test_fixture fixture;
+    fixture.some_uint = 0;
+    fixture.some_string = "hello";
+    assert(copy.evaluate(fixture));
+    assert(assigned.evaluate(fixture));
+
+    fixture.some_string = "world";
+    assert(!copy.evaluate(fixture));
+    assert(!assigned.evaluate(fixture));
+
+    fixture.some_uint = 6;
+    assert(copy.evaluate(fixture));
+    assert(assigned.evaluate(fixture));
+}
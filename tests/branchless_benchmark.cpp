@@ -0,0 +1,122 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/flat_tree.hpp>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+/**
+ * Compares the evaluation time (in ns per object) of a flat_expression_tree in evaluation_mode::short_circuit and in 
+ * evaluation_mode::branchless, for a tree of only cheap leaves and a tree that mixes cheap leaves with a string comparison,
+ * and for objects whose leaf outcomes are predictable and for objects whose leaf outcomes are close to 50/50. Also reports the mode chosen by flat_expression_tree::calibrate for each data set.
+ *
+ * Usage: branchless_benchmark
+*/
+
+struct event {
+    int severity;
+    int source;
+    double score;
+    bool acknowledged;
+    unsigned flags;
+    std::string category;
+};
+
+const std::size_t object_count = 1 << 16;
+const int repetitions = 7;
+
+std::vector<event> make_events(bool predictable) {
+    std::mt19937 rng(7);
+    std::vector<event> events;
+    events.reserve(object_count);
+    for(std::size_t i = 0; i < object_count; ++i) {
+        if(predictable) {
+            events.push_back(event { 5, 3, 0.9, false, 1, "disk" });
+        } else {
+            events.push_back(event { static_cast<int>(rng() % 10), static_cast<int>(rng() % 8), (rng() % 100) / 100.0, 
+                rng() % 2 == 0, static_cast<unsigned>(rng() % 4), rng() % 2 == 0 ? "disk" : "network" });
+        }
+    }
+    return events;
+}
+
+expression_tree<event> make_cheap_tree() {
+    // a single cheap subtree
+    return expression_tree<event> {
+        make_expr(&event::severity, op::greater_than, 4)
+        ->AND(make_expr(&event::source, op::less_than, 4)->OR(make_expr(&event::score, op::greater_than, 0.5)))
+        ->AND(make_expr(&event::acknowledged, op::equals, false)->OR(make_expr(&event::flags, op::not_equals, 0u)))
+    };
+}
+
+expression_tree<event> make_mixed_tree() {
+    // cheap subtrees, with a string comparison between them
+    return expression_tree<event> {
+        make_expr(&event::severity, op::greater_than, 4)
+        ->AND(make_expr(&event::source, op::less_than, 4)->OR(make_expr(&event::score, op::greater_than, 0.5)))
+        ->AND(make_expr(&event::acknowledged, op::equals, false)->OR(make_expr(&event::flags, op::not_equals, 0u)))
+        ->AND(make_expr(&event::category, op::equals, std::string("disk")))
+        ->OR(make_expr(&event::source, op::equals, 7)
+            ->AND(make_expr(&event::score, op::less_than, 0.3))
+            ->AND(make_expr(&event::severity, op::not_equals, 0)))
+    };
+}
+
+double measure(const flat_expression_tree<event>& flat, const std::vector<event>& events, std::size_t& matches) {
+    double best = 0;
+    for(int rep = 0; rep < repetitions; ++rep) {
+        std::size_t count = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for(auto& e : events) {
+            count += flat.evaluate(e);
+        }
+        const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        matches = count;
+        if(rep == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best / events.size();
+}
+
+int main() {
+    std::printf("%-8s %-12s %16s %16s %14s\n", "tree", "data", "short_circuit", "branchless", "calibrated");
+    for(bool mixed : { false, true }) {
+        const auto expr = mixed ? make_mixed_tree() : make_cheap_tree();
+        flat_expression_tree<event> short_circuit(expr, evaluation_mode::short_circuit);
+        flat_expression_tree<event> branchless(expr, evaluation_mode::branchless);
+
+        for(bool predictable : { true, false }) {
+            const auto events = make_events(predictable);
+
+            std::size_t expected = 0;
+            for(auto& e : events) {
+                expected += expr.evaluate(e);
+            }
+
+            std::size_t short_circuit_matches = 0;
+            std::size_t branchless_matches = 0;
+            const double short_circuit_ns = measure(short_circuit, events, short_circuit_matches);
+            const double branchless_ns = measure(branchless, events, branchless_matches);
+            if(short_circuit_matches != expected || branchless_matches != expected) {
+                std::fprintf(stderr, "the evaluation modes disagree with expression_tree::evaluate\n");
+                return EXIT_FAILURE;
+            }
+
+            std::vector<const event*> sample;
+            for(std::size_t i = 0; i < 1024; ++i) {
+                sample.push_back(&events[i]);
+            }
+            flat_expression_tree<event> calibrated(expr);
+            const evaluation_mode mode = calibrated.calibrate(sample.data(), sample.size());
+
+            std::printf("%-8s %-12s %13.2f ns %13.2f ns %14s\n", mixed ? "mixed" : "cheap", predictable ? "predictable" : "random", 
+                short_circuit_ns, branchless_ns, mode == evaluation_mode::branchless ? "branchless" : "short_circuit");
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
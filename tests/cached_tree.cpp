@@ -0,0 +1,182 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/cached_tree.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+struct message {
+    std::string sender;
+    int priority;
+
+    static int priority_reads;
+
+    int get_priority() const {
+        ++priority_reads;
+        return priority;
+    }
+};
+
+int message::priority_reads = 0;
+
+void test_cached_results();
+void test_cache_eviction();
+void test_replace_tree_invalidates();
+void test_concurrent_evaluation();
+void test_cache_errors();
+
+int main() {
+    test_cached_results();
+    test_cache_eviction();
+    test_replace_tree_invalidates();
+    test_concurrent_evaluation();
+    test_cache_errors();
+
+    return EXIT_SUCCESS;
+}
+
+expression_tree<message> make_message_tree() {
+    return expression_tree<message> {
+        make_expr(&message::sender, op::equals, std::string("alice"))
+        ->OR(make_expr(&message::get_priority, op::greater_than, 5))
+    };
+}
+
+std::string message_key(const message& m) {
+    return m.sender + "/" + std::to_string(m.priority);
+}
+
+void test_cached_results() {
+    const auto expr = make_message_tree();
+    cached_expression_tree<message, std::string> cached(expr, message_key, 64);
+    assert(cached.capacity() == 64);
+
+    std::vector<message> stream;
+    for(int i = 0; i < 100; ++i) {
+        stream.push_back(message { i % 3 == 0 ? "alice" : "bob", i % 10 });
+    }
+
+    for(auto& m : stream) {
+        assert(cached.evaluate(m) == expr.evaluate(m));
+    }
+
+    // there are 20 distinct keys in the stream
+    assert(cached.miss_count() == 20);
+    assert(cached.hit_count() == 80);
+    assert(cached.size() == 20);
+
+    message::priority_reads = 0;
+    assert(cached.evaluate(message { "bob", 9 }));
+    assert(message::priority_reads == 0);
+
+    cached.reset_counts();
+    assert(cached.hit_count() == 0);
+    assert(cached.miss_count() == 0);
+
+    cached.clear();
+    assert(cached.size() == 0);
+    assert(cached.evaluate(message { "bob", 9 }));
+    assert(cached.miss_count() == 1);
+}
+
+void test_cache_eviction() {
+    cached_expression_tree<message, std::string> cached(make_message_tree(), message_key, 2, 1);
+
+    const message a { "alice", 0 };
+    const message b { "bob", 0 };
+    const message c { "carol", 9 };
+
+    cached.evaluate(a);
+    cached.evaluate(b);
+    assert(cached.miss_count() == 2);
+
+    // a is used again, so the clock hand gives it a second chance and evicts b instead
+    cached.evaluate(a);
+    assert(cached.hit_count() == 1);
+    cached.evaluate(c);
+    assert(cached.size() == 2);
+
+    cached.evaluate(a);
+    assert(cached.hit_count() == 2);
+    cached.evaluate(b);
+    assert(cached.miss_count() == 4);
+    assert(cached.size() == 2);
+
+    // the cache never holds more results than its capacity
+    cached_expression_tree<message, std::string> sharded(make_message_tree(), message_key, 10, 4);
+    for(int i = 0; i < 1000; ++i) {
+        sharded.evaluate(message { "bob", i });
+    }
+    assert(sharded.size() <= 10);
+}
+
+void test_replace_tree_invalidates() {
+    cached_expression_tree<message, std::string> cached(make_message_tree(), message_key, 16);
+
+    const message m { "bob", 7 };
+    assert(cached.evaluate(m));
+    assert(cached.evaluate(m));
+    assert(cached.hit_count() == 1);
+
+    cached.replace_tree(expression_tree<message> { make_expr(&message::priority, op::greater_than, 8) });
+    assert(cached.size() == 0);
+    assert(!cached.evaluate(m));
+    assert(cached.miss_count() == 2);
+    assert(!cached.evaluate(m));
+    assert(cached.hit_count() == 2);
+
+    // a tree returned before the replacement remains valid
+    auto previous = cached.tree();
+    cached.replace_tree(make_message_tree());
+    assert(!previous->evaluate(m));
+    assert(cached.tree()->evaluate(m));
+    assert(cached.evaluate(m));
+}
+
+void test_concurrent_evaluation() {
+    const auto expr = make_message_tree();
+    cached_expression_tree<message, std::string> cached(expr, message_key, 32, 4);
+
+    std::vector<std::thread> threads;
+    std::vector<int> mismatches(4, 0);
+    for(int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for(int i = 0; i < 2000; ++i) {
+                const message m { (i + t) % 4 == 0 ? "alice" : "bob", (i * 7 + t) % 50 };
+                if(cached.evaluate(m) != expr.evaluate(m)) {
+                    ++mismatches[t];
+                }
+            }
+        });
+    }
+    for(auto& t : threads) {
+        t.join();
+    }
+
+    for(int count : mismatches) {
+        assert(count == 0);
+    }
+    assert(cached.hit_count() + cached.miss_count() == 8000);
+    assert(cached.size() <= 32);
+}
+
+void test_cache_errors() {
+    bool threw = false;
+    try {
+        cached_expression_tree<message, std::string> cached(make_message_tree(), message_key, 0);
+    } catch(const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+
+    threw = false;
+    try {
+        cached_expression_tree<message, std::string> cached(make_message_tree(), nullptr, 4);
+    } catch(const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+}
@@ -0,0 +1,165 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/canonical.hpp>
+#include <attwoodn/expression_tree/serialize.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <string>
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+void test_commutative_trees_are_equal();
+void test_different_trees_are_not_equal();
+void test_custom_leaves();
+void test_canonicalize();
+void test_deep_tree_hash();
+
+int main() {
+    test_commutative_trees_are_equal();
+    test_different_trees_are_not_equal();
+    test_custom_leaves();
+    test_canonicalize();
+    test_deep_tree_hash();
+
+    return EXIT_SUCCESS;
+}
+
+void test_commutative_trees_are_equal() {
+    // (a AND b) OR c
+    expression_tree<my_type> expr {
+        make_expr(&my_type::my_int, op::greater_than, 5)
+        ->AND(make_expr(&my_type::my_bool, op::equals, true))
+        ->OR(make_expr(&my_type::get_my_int, op::less_than, -3))
+    };
+
+    // c OR (b AND a)
+    expression_tree<my_type> swapped {
+        make_expr(&my_type::get_my_int, op::less_than, -3)
+        ->OR(make_expr(&my_type::my_bool, op::equals, true)->AND(make_expr(&my_type::my_int, op::greater_than, 5)))
+    };
+
+    assert(structural_hash(expr) == structural_hash(swapped));
+    assert(structurally_equal(expr, swapped));
+    assert(structurally_equal(expr, expr));
+
+    // chains of the same operation are equal however they are nested: (a AND b) AND c == a AND (b AND c)
+    expression_tree<my_type> left_deep {
+        make_expr(&my_type::my_int, op::greater_than, 1)
+        ->AND(make_expr(&my_type::my_int, op::less_than, 9))
+        ->AND(make_expr(&my_type::my_bool, op::equals, false))
+    };
+    expression_tree<my_type> right_deep {
+        make_expr(&my_type::my_int, op::greater_than, 1)
+        ->AND(make_expr(&my_type::my_int, op::less_than, 9)->AND(make_expr(&my_type::my_bool, op::equals, false)))
+    };
+    assert(structural_hash(left_deep) == structural_hash(right_deep));
+    assert(structurally_equal(left_deep, right_deep));
+
+    // the children of threshold nodes are unordered, but keep their weights
+    expression_tree<my_type> threshold { make_threshold(3.0, std::vector<node::expression_tree_node<my_type>*> {
+        make_expr(&my_type::my_int, op::greater_than, 1), make_expr(&my_type::my_bool, op::equals, true) }, 
+        std::vector<double> { 2.0, 1.0 }) };
+    expression_tree<my_type> threshold_swapped { make_threshold(3.0, std::vector<node::expression_tree_node<my_type>*> {
+        make_expr(&my_type::my_bool, op::equals, true), make_expr(&my_type::my_int, op::greater_than, 1) }, 
+        std::vector<double> { 1.0, 2.0 }) };
+    expression_tree<my_type> threshold_reweighted { make_threshold(3.0, std::vector<node::expression_tree_node<my_type>*> {
+        make_expr(&my_type::my_bool, op::equals, true), make_expr(&my_type::my_int, op::greater_than, 1) }, 
+        std::vector<double> { 2.0, 1.0 }) };
+    assert(structurally_equal(threshold, threshold_swapped));
+    assert(!structurally_equal(threshold, threshold_reweighted));
+}
+
+void test_different_trees_are_not_equal() {
+    auto make = [](int value, bool use_and) {
+        auto* left = make_expr(&my_type::my_int, op::greater_than, value);
+        auto* right = make_expr(&my_type::my_bool, op::equals, true);
+        return use_and ? expression_tree<my_type> { left->AND(right) } : expression_tree<my_type> { left->OR(right) };
+    };
+
+    const auto base = make(5, true);
+    assert(!structurally_equal(base, make(6, true)));
+    assert(!structurally_equal(base, make(5, false)));
+    assert(structural_hash(base) != structural_hash(make(6, true)));
+    assert(structural_hash(base) != structural_hash(make(5, false)));
+
+    // the same value compared by a different operator, or read from a different member
+    expression_tree<my_type> less { make_expr(&my_type::my_int, op::less_than, 5) };
+    expression_tree<my_type> greater { make_expr(&my_type::my_int, op::greater_than, 5) };
+    expression_tree<my_type> getter { make_expr(&my_type::get_my_int, op::less_than, 5) };
+    assert(!structurally_equal(less, greater));
+    assert(!structurally_equal(less, getter));
+
+    // AND(a, a) is not simplified to a
+    expression_tree<my_type> doubled { make_expr(&my_type::my_int, op::less_than, 5)->AND(make_expr(&my_type::my_int, op::less_than, 5)) };
+    assert(!structurally_equal(less, doubled));
+}
+
+void test_custom_leaves() {
+    auto is_even = [](int value, int) { return value % 2 == 0; };
+    expression_tree<my_type> expr { make_expr(&my_type::my_int, is_even, 0)->AND(make_expr(&my_type::my_bool, op::equals, true)) };
+    expression_tree<my_type> copy(expr);
+
+    // custom operators cannot be compared, so only a tree itself is equal to it
+    assert(structurally_equal(expr, expr));
+    assert(!structurally_equal(expr, copy));
+    assert(structural_hash(expr) == structural_hash(copy));
+}
+
+void test_canonicalize() {
+    expression_tree<my_type> expr {
+        make_expr(&my_type::my_int, op::greater_than, 5)
+        ->AND(make_expr(&my_type::my_bool, op::equals, true))
+        ->OR(make_expr(&my_type::get_my_int, op::less_than, -3))
+    };
+    expression_tree<my_type> swapped {
+        make_expr(&my_type::get_my_int, op::less_than, -3)
+        ->OR(make_expr(&my_type::my_bool, op::equals, true)->AND(make_expr(&my_type::my_int, op::greater_than, 5)))
+    };
+
+    const auto canonical = canonicalize(expr);
+    const auto canonical_swapped = canonicalize(swapped);
+    assert(structurally_equal(canonical, expr));
+    assert(structural_hash(canonical) == structural_hash(expr));
+
+    // structurally equal trees have identical canonical forms
+    field_registry<my_type> registry;
+    registry.add("my_int", &my_type::my_int)
+            .add("my_bool", &my_type::my_bool)
+            .add("get_my_int", &my_type::get_my_int);
+    assert(serialize(canonical, registry) == serialize(canonical_swapped, registry));
+    assert(serialize(expr, registry) != serialize(swapped, registry));
+
+    for(int i = -10; i < 10; ++i) {
+        for(bool b : { true, false }) {
+            my_type obj { i, b };
+            assert(canonical.evaluate(obj) == expr.evaluate(obj));
+            assert(canonical_swapped.evaluate(obj) == expr.evaluate(obj));
+        }
+    }
+}
+
+void test_deep_tree_hash() {
+    // long chains of alternating operations
+    node::expression_tree_node<my_type>* deep = make_expr(&my_type::my_int, op::equals, 0);
+    node::expression_tree_node<my_type>* deep_reversed = make_expr(&my_type::my_int, op::equals, 999);
+    for(int i = 1; i < 1000; ++i) {
+        auto* next = new node::expression_tree_dynamic_op_node<my_type>(i % 2 ? node::boolean_op::OR : node::boolean_op::AND);
+        next->set_left(make_expr(&my_type::my_int, op::equals, i));
+        next->set_right(deep);
+        deep = next;
+
+        auto* next_reversed = new node::expression_tree_dynamic_op_node<my_type>(i % 2 ? node::boolean_op::OR : node::boolean_op::AND);
+        next_reversed->set_left(deep_reversed);
+        next_reversed->set_right(make_expr(&my_type::my_int, op::equals, 999 - i));
+        deep_reversed = next_reversed;
+    }
+
+    expression_tree<my_type> expr { deep };
+    expression_tree<my_type> copy(expr);
+    assert(structural_hash(expr) == structural_hash(copy));
+    assert(structurally_equal(expr, copy));
+    assert(structural_hash(canonicalize(expr)) == structural_hash(expr));
+
+    expression_tree<my_type> other { deep_reversed };
+    assert(!structurally_equal(expr, other));
+}
@@ -0,0 +1,268 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/dictionary.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+struct log_line {
+    std::string host;
+    std::string service;
+    int severity;
+
+    std::string get_region() const {
+        if(host.empty()) {
+            throw std::runtime_error("log line has no host");
+        }
+        return host.substr(0, 2);
+    }
+};
+
+void test_string_dictionary();
+void test_encoding();
+void test_sets();
+void test_matches_evaluate();
+void test_unreadable_members();
+void test_copies();
+
+int main() {
+    test_string_dictionary();
+    test_encoding();
+    test_sets();
+    test_matches_evaluate();
+    test_unreadable_members();
+    test_copies();
+
+    return EXIT_SUCCESS;
+}
+
+std::vector<log_line> make_lines(std::size_t count) {
+    const std::vector<std::string> hosts { "us-web-1", "us-web-2", "eu-web-1", "eu-db-1", "ap-cache-1" };
+    const std::vector<std::string> services { "nginx", "postgres", "redis", "cron" };
+
+    std::vector<log_line> lines;
+    for(std::size_t i = 0; i < count; ++i) {
+        lines.push_back(log_line { hosts[(i * 7) % hosts.size()], services[(i / 3) % services.size()], static_cast<int>(i % 8) });
+    }
+    return lines;
+}
+
+void test_string_dictionary() {
+    string_dictionary dictionary;
+    assert(dictionary.intern("nginx") == 0);
+    assert(dictionary.intern("redis") == 1);
+    assert(dictionary.intern("nginx") == 0);
+    assert(dictionary.size() == 2);
+    assert(dictionary.find("redis") == 1);
+    assert(dictionary.find("cron") == no_string_id);
+    assert(dictionary.value(1) == "redis");
+
+    bool out_of_range = false;
+    try {
+        dictionary.value(2);
+    } catch(std::out_of_range& e) {
+        out_of_range = true;
+    }
+    assert(out_of_range);
+}
+
+void test_encoding() {
+    const auto lines = make_lines(100);
+    dictionary_encoding<log_line> encoding(lines.data(), lines.size());
+    encoding.encode(&log_line::host).encode(&log_line::get_region);
+
+    assert(encoding.size() == 100);
+    assert(encoding.encodes(accessor_of(&log_line::host)));
+    assert(!encoding.encodes(accessor_of(&log_line::service)));
+    assert(encoding.dictionary(&log_line::host).size() == 5);
+    assert(encoding.dictionary(&log_line::get_region).size() == 3);
+
+    const auto& ids = encoding.ids(&log_line::host);
+    assert(ids.size() == lines.size());
+    for(std::size_t i = 0; i < lines.size(); ++i) {
+        assert(encoding.dictionary(&log_line::host).value(ids[i]) == lines[i].host);
+    }
+
+    bool invalid_argument = false;
+    try {
+        encoding.ids(&log_line::service);
+    } catch(std::invalid_argument& e) {
+        invalid_argument = true;
+    }
+    assert(invalid_argument);
+}
+
+void test_sets() {
+    const auto lines = make_lines(1000);
+    dictionary_encoding<log_line> encoding(lines.data(), lines.size());
+    encoding.encode(&log_line::host).encode(&log_line::service);
+
+    // host IN (us-web-1, eu-web-1, unknown-host) AND severity > 5
+    expression_tree<log_line> web_errors {
+        make_expr(&log_line::host, op::equals, std::string("us-web-1"))
+        ->OR(make_expr(&log_line::host, op::equals, std::string("eu-web-1")))
+        ->OR(make_expr(&log_line::host, op::equals, std::string("unknown-host")))
+        ->AND(make_expr(&log_line::severity, op::greater_than, 5))
+    };
+    encoded_expression_tree<log_line> encoded(web_errors, encoding);
+    assert(encoded.encoded_leaf_count() == 3);
+    assert(encoded.set_count() == 1);
+
+    std::size_t expected = 0;
+    for(std::size_t i = 0; i < lines.size(); ++i) {
+        assert(encoded.evaluate(i) == web_errors.evaluate(lines[i]));
+        expected += web_errors.evaluate(lines[i]);
+    }
+    assert(expected > 0);
+    assert(encoded.count() == expected);
+
+    // service NOT IN (cron, redis)
+    expression_tree<log_line> not_background {
+        make_expr(&log_line::service, op::not_equals, std::string("cron"))
+        ->AND(make_expr(&log_line::service, op::not_equals, std::string("redis")))
+    };
+    encoded_expression_tree<log_line> encoded_not(not_background, encoding);
+    assert(encoded_not.set_count() == 1);
+    for(std::size_t i = 0; i < lines.size(); ++i) {
+        assert(encoded_not.evaluate(i) == (lines[i].service != "cron" && lines[i].service != "redis"));
+    }
+
+    // equals leaves joined by AND cannot be merged into a set
+    expression_tree<log_line> both {
+        make_expr(&log_line::host, op::equals, std::string("us-web-1"))
+        ->AND(make_expr(&log_line::host, op::equals, std::string("eu-web-1")))
+    };
+    encoded_expression_tree<log_line> encoded_both(both, encoding);
+    assert(encoded_both.encoded_leaf_count() == 2);
+    assert(encoded_both.set_count() == 0);
+    assert(encoded_both.count() == 0);
+
+    // other comparisons of encoded members are evaluated as usual
+    expression_tree<log_line> ordered { make_expr(&log_line::host, op::less_than, std::string("f")) };
+    encoded_expression_tree<log_line> encoded_ordered(ordered, encoding);
+    assert(encoded_ordered.encoded_leaf_count() == 0);
+    for(std::size_t i = 0; i < lines.size(); ++i) {
+        assert(encoded_ordered.evaluate(i) == (lines[i].host < "f"));
+    }
+}
+
+void test_matches_evaluate() {
+    const auto lines = make_lines(500);
+    dictionary_encoding<log_line> encoding(lines.data(), lines.size());
+    encoding.encode(&log_line::host).encode(&log_line::service).encode(&log_line::get_region);
+
+    std::vector<std::function<node::expression_tree_node<log_line>*()>> leaves {
+        []() { return make_expr(&log_line::host, op::equals, std::string("us-web-1")); },
+        []() { return make_expr(&log_line::host, op::equals, std::string("eu-db-1")); },
+        []() { return make_expr(&log_line::host, op::not_equals, std::string("ap-cache-1")); },
+        []() { return make_expr(&log_line::host, op::not_equals, std::string("us-web-2")); },
+        []() { return make_expr(&log_line::service, op::equals, std::string("nginx")); },
+        []() { return make_expr(&log_line::service, op::equals, std::string("cron")); },
+        []() { return make_expr(&log_line::service, op::not_equals, std::string("redis")); },
+        []() { return make_expr(&log_line::get_region, op::equals, std::string("eu")); },
+        []() { return make_expr(&log_line::get_region, op::equals, std::string("sa")); },
+        []() { return make_expr(&log_line::severity, op::greater_than, 4); },
+        []() { return make_expr(&log_line::severity, op::less_than, 2); }
+    };
+
+    std::srand(49);
+    auto random_tree = [&](auto& self, int depth) -> node::expression_tree_node<log_line>* {
+        if(depth == 0 || std::rand() % 4 == 0) {
+            return leaves[std::rand() % leaves.size()]();
+        }
+        if(std::rand() % 6 == 0) {
+            return make_threshold(static_cast<std::size_t>(std::rand() % 3), std::vector<node::expression_tree_node<log_line>*> {
+                self(self, depth - 1), self(self, depth - 1), self(self, depth - 1) });
+        }
+        auto* op_node = new node::expression_tree_dynamic_op_node<log_line>(std::rand() % 2 ? node::boolean_op::AND : node::boolean_op::OR);
+        op_node->set_left(self(self, depth - 1));
+        op_node->set_right(self(self, depth - 1));
+        return op_node;
+    };
+
+    std::size_t sets = 0;
+    for(int i = 0; i < 300; ++i) {
+        expression_tree<log_line> tree { random_tree(random_tree, 5) };
+        encoded_expression_tree<log_line> encoded(tree, encoding);
+        sets += encoded.set_count();
+
+        bool batch[50];
+        encoded.evaluate_batch(100, 50, batch);
+
+        std::vector<std::size_t> matches;
+        encoded.for_each_match([&matches](std::size_t index) { matches.push_back(index); });
+
+        std::vector<std::size_t> expected;
+        for(std::size_t j = 0; j < lines.size(); ++j) {
+            const bool result = tree.evaluate(lines[j]);
+            assert(encoded.evaluate(j) == result);
+            if(j >= 100 && j < 150) {
+                assert(batch[j - 100] == result);
+            }
+            if(result) {
+                expected.push_back(j);
+            }
+        }
+        assert(matches == expected);
+        assert(encoded.count() == expected.size());
+    }
+    assert(sets > 0);
+
+    expression_tree<log_line> any { make_expr(&log_line::severity, op::greater_than, -1) };
+    encoded_expression_tree<log_line> encoded(any, encoding);
+    bool out_of_range = false;
+    try {
+        bool result;
+        encoded.evaluate_batch(lines.size(), 1, &result);
+    } catch(std::out_of_range& e) {
+        out_of_range = true;
+    }
+    assert(out_of_range);
+}
+
+void test_unreadable_members() {
+    auto lines = make_lines(10);
+    lines[4].host.clear();
+
+    dictionary_encoding<log_line> encoding(lines.data(), lines.size());
+    encoding.encode(&log_line::get_region);
+    assert(encoding.ids(&log_line::get_region)[4] == no_string_id);
+
+    // as with evaluate, an object for which get_region throws does not satisfy the tree, even through not_equals
+    expression_tree<log_line> outside_us { make_expr(&log_line::get_region, op::not_equals, std::string("us")) };
+    encoded_expression_tree<log_line> encoded(outside_us, encoding);
+    assert(encoded.encoded_leaf_count() == 1);
+    for(std::size_t i = 0; i < lines.size(); ++i) {
+        assert(encoded.evaluate(i) == outside_us.evaluate(lines[i]));
+    }
+    assert(!encoded.evaluate(4));
+}
+
+void test_copies() {
+    const auto lines = make_lines(50);
+    dictionary_encoding<log_line> encoding(lines.data(), lines.size());
+    encoding.encode(&log_line::host);
+
+    expression_tree<log_line> tree {
+        make_expr(&log_line::host, op::equals, std::string("eu-db-1"))
+        ->OR(make_expr(&log_line::host, op::equals, std::string("us-web-2")))
+    };
+
+    encoded_expression_tree<log_line> encoded(tree, encoding);
+    encoded_expression_tree<log_line> copy(encoded);
+    encoded_expression_tree<log_line> assigned(expression_tree<log_line> { make_expr(&log_line::severity, op::equals, 0) }, encoding);
+    assigned = copy;
+    encoded_expression_tree<log_line> moved(std::move(copy));
+
+    const std::size_t expected = encoded.count();
+    assert(expected > 0);
+    assert(assigned.count() == expected);
+    assert(moved.count() == expected);
+    assert(moved.set_count() == 1);
+    assert(&moved.tree() != &encoded.tree());
+}
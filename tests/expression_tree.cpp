@@ -14,6 +14,10 @@ void test_complex_expression_tree();
 void test_moved_expression_tree();
 void test_copied_expression_tree();
 void test_user_defined_operator();
+void test_deep_expression_tree();
+void test_missing_child_expression_tree();
+void test_accessed_members();
+void test_partial_evaluation();
 
 int main() {
     test_quick_example_expression_tree();
@@ -24,6 +28,10 @@ int main() {
     test_moved_expression_tree();
     test_copied_expression_tree();
     test_user_defined_operator();
+    test_deep_expression_tree();
+    test_missing_child_expression_tree();
+    test_accessed_members();
+    test_partial_evaluation();
 
     return EXIT_SUCCESS;
 }
@@ -393,4 +401,168 @@ void test_user_defined_operator() {
     // Jim sends a packet has an error code
     incoming_packet.payload.error_code = 404;
     assert(!expr.evaluate(incoming_packet));     // fails evaluation. The packet's payload had an error code
-}
\ No newline at end of file
+}
+
+void test_deep_expression_tree() {
+    // a generated rule of 100,000 clauses, combined left-deep as ->AND chaining would combine them:
+    // my_int != 1 AND my_int != 3 AND my_int != 5 AND ...
+    const int clause_count = 100000;
+
+    node::expression_tree_node<my_type>* root = make_expr(&my_type::my_int, op::not_equals, 1);
+    for(int i = 1; i < clause_count; ++i) {
+        auto* op_node = new node::expression_tree_dynamic_op_node<my_type>(node::boolean_op::AND);
+        op_node->set_left(root);
+        op_node->set_right(make_expr(&my_type::my_int, op::not_equals, i * 2 + 1));
+        root = op_node;
+    }
+
+    expression_tree<my_type> expr { root };
+
+    my_type obj;
+    obj.my_int = 2;
+    assert(expr.evaluate(obj));
+
+    obj.my_int = 1;
+    assert(!expr.evaluate(obj));
+
+    obj.my_int = clause_count * 2 - 1;
+    assert(!expr.evaluate(obj));
+
+    // the tree is destroyed without recursing once per level
+    expression_tree<my_type> moved { std::move(expr) };
+    obj.my_int = clause_count * 2;
+    assert(moved.evaluate(obj));
+
+    // the tree is copied without recursing once per level
+    expression_tree<my_type> copy { moved };
+    assert(copy.evaluate(obj));
+    obj.my_int = 3;
+    assert(!copy.evaluate(obj));
+
+    expression_tree<my_type> assigned { make_expr(&my_type::my_bool, op::equals, true) };
+    assigned = copy;
+    assert(!assigned.evaluate(obj));
+    obj.my_int = 4;
+    assert(assigned.evaluate(obj));
+}
+
+void test_missing_child_expression_tree() {
+    auto* op_node = new node::expression_tree_dynamic_op_node<my_type>(node::boolean_op::OR);
+    op_node->set_left(make_expr(&my_type::my_bool, op::equals, true));
+
+    // evaluating an op node with a missing child throws, so the tree evaluates to false
+    expression_tree<my_type> expr { op_node };
+    my_type obj;
+    obj.my_bool = true;
+    assert(!expr.evaluate(obj));
+}
+
+void test_accessed_members() {
+    auto is_small_packet_payload = [](const packet_payload& incoming, const packet_payload&) -> bool {
+        return incoming.data.size() < 10;
+    };
+
+    // reads two of data_packet's fields: sender_name twice, and payload once
+    expression_tree<data_packet> expr {
+        make_expr(&data_packet::sender_name, op::equals, std::string("Jim"))
+        ->OR(make_expr(&data_packet::sender_name, op::equals, std::string("Pam")))
+        ->AND(make_expr(&data_packet::payload, is_small_packet_payload, packet_payload()))
+    };
+
+    auto access = expr.accessed_members();
+    assert(access.accessors().size() == 2);
+    assert(access.reads(&data_packet::sender_name));
+    assert(access.reads(&data_packet::payload));
+    assert(!access.calls_member_functions());
+    assert(!access.has_opaque_nodes());
+    assert(!access.can_skip(&data_packet::sender_name));
+    assert(!access.can_skip(&data_packet::payload));
+
+    expression_tree<packet_payload> payload_expr {
+        make_expr(&packet_payload::error_code, op::equals, (uint16_t) 0)
+        ->AND(make_expr(&packet_payload::checksum_ok, op::equals, true))
+    };
+
+    access = payload_expr.accessed_members();
+    assert(access.accessors().size() == 2);
+    assert(access.can_skip(&packet_payload::data));
+    assert(!access.can_skip(&packet_payload::error_code));
+    assert(!access.reads(&packet_payload::payload_size));
+
+    // a const member function may read any member, so no member can be skipped
+    expression_tree<packet_payload> getter_expr {
+        make_expr(&packet_payload::error_code, op::equals, (uint16_t) 0)
+        ->AND(make_expr(&packet_payload::payload_size, op::less_than, (uint64_t) 10))
+    };
+
+    access = getter_expr.accessed_members();
+    assert(access.calls_member_functions());
+    assert(access.reads(&packet_payload::payload_size));
+    assert(!access.reads(&packet_payload::data));
+    assert(!access.can_skip(&packet_payload::data));
+}
+
+void test_partial_evaluation() {
+    // the header fields (sender_name and checksum_ok) are cheap to decode. The payload data is expensive to decode
+    expression_tree<data_packet> expr {
+        make_expr(&data_packet::sender_name, op::equals, std::string("Jim"))
+        ->AND(make_expr(&data_packet::sender_name, op::not_equals, std::string("Pam"))
+            ->OR(make_expr(&data_packet::payload, 
+                [](const packet_payload& incoming, const packet_payload&) { return incoming.checksum_ok; }, packet_payload())))
+    };
+
+    const std::vector<accessor_id> header { accessor_of(&data_packet::sender_name) };
+    const std::vector<accessor_id> everything { accessor_of(&data_packet::sender_name), accessor_of(&data_packet::payload) };
+
+    data_packet packet;
+    packet.payload.checksum_ok = false;
+
+    // rejected using the header alone: FALSE AND (x) is FALSE
+    packet.sender_name = "Bob";
+    assert(expr.evaluate_partial(packet, header) == partial_result::false_value);
+
+    // accepted using the header alone: TRUE AND (TRUE OR x) is TRUE
+    packet.sender_name = "Jim";
+    assert(expr.evaluate_partial(packet, header) == partial_result::true_value);
+
+    // with no known fields, the result is unknown
+    assert(expr.evaluate_partial(packet, {}) == partial_result::unknown);
+
+    // unknown leaves do not hide a result that is already determined
+    expression_tree<my_type> or_expr {
+        make_expr(&my_type::my_int, op::greater_than, 5)
+        ->OR(make_expr(&my_type::my_bool, op::equals, true))
+    };
+    const std::vector<accessor_id> my_int_only { accessor_of(&my_type::my_int) };
+    assert(or_expr.evaluate_partial(my_type { 6, false }, my_int_only) == partial_result::true_value);
+    assert(or_expr.evaluate_partial(my_type { 4, false }, my_int_only) == partial_result::unknown);
+
+    expression_tree<my_type> and_expr {
+        make_expr(&my_type::my_int, op::greater_than, 5)
+        ->AND(make_expr(&my_type::get_my_int, op::less_than, 10))
+    };
+    assert(and_expr.evaluate_partial(my_type { 4, false }, my_int_only) == partial_result::false_value);
+    assert(and_expr.evaluate_partial(my_type { 6, false }, my_int_only) == partial_result::unknown);
+
+    // a definite partial result always agrees with a full evaluation, whatever the unknown members hold
+    for(int i = 0; i < 12; ++i) {
+        for(int b = 0; b < 2; ++b) {
+            const my_type obj { i, b == 1 };
+            const partial_result partial = or_expr.evaluate_partial(obj, my_int_only);
+            if(partial != partial_result::unknown) {
+                assert((partial == partial_result::true_value) == or_expr.evaluate(my_type { i, false }));
+                assert((partial == partial_result::true_value) == or_expr.evaluate(my_type { i, true }));
+            }
+        }
+    }
+
+    const std::vector<accessor_id> all_my_type { accessor_of(&my_type::my_int), accessor_of(&my_type::get_my_int) };
+    for(int i = 0; i < 12; ++i) {
+        const my_type obj { i, false };
+        const partial_result expected = and_expr.evaluate(obj) ? partial_result::true_value : partial_result::false_value;
+        assert(and_expr.evaluate_partial(obj, all_my_type) == expected);
+    }
+    packet.payload.checksum_ok = true;
+    packet.sender_name = "Jim";
+    assert(expr.evaluate_partial(packet, everything) == partial_result::true_value);
+}
@@ -2,6 +2,7 @@
 #include "test_utils.hpp"
 #include "release_asserts.hpp"
 #include <limits>
+#include <vector>
 
 using namespace attwoodn::expression_tree;
 
@@ -9,12 +10,16 @@ void test_string_evaluation();
 void test_char_ptr_evaluation();
 void test_uint_evaluation();
 void test_const_func_evaluation();
+void test_leaf_node_layout();
+void test_comp_value_construction();
 
 int main() {
     test_string_evaluation();
     test_char_ptr_evaluation();
     test_uint_evaluation();
     test_const_func_evaluation();
+    test_leaf_node_layout();
+    test_comp_value_construction();
 
     return EXIT_SUCCESS;
 }
@@ -686,4 +691,117 @@ void test_const_func_evaluation() {
         assert(!expr1->evaluate(fixture));
         assert(expr2->evaluate(fixture));
     }
-}
\ No newline at end of file
+}
+
+void test_leaf_node_layout() {
+    // leaves using built-in operators hold only a vtable pointer, one member reference, and the comparison value
+    {
+        using leaf_type = std::remove_pointer<decltype(make_expr(&my_type::my_int, op::equals, 5))>::type;
+        assert(std::is_empty<op::equals_t>::value);
+        assert(sizeof(leaf_type) <= sizeof(void*) + sizeof(int my_type::*) + sizeof(void*));
+    }
+
+    // leaves calling a member function do not store a member variable reference
+    {
+        using leaf_type = std::remove_pointer<decltype(make_expr(&my_type::get_my_int, op::less_than, 5))>::type;
+        assert(sizeof(leaf_type) <= sizeof(void*) + sizeof(int (my_type::*)() const) + sizeof(void*));
+    }
+
+    // pointers to built-in operators are stored as the operators themselves
+    {
+        using by_value = std::remove_pointer<decltype(make_expr(&my_type::my_int, op::greater_than, 5))>::type;
+        using by_pointer = std::remove_pointer<decltype(make_expr(&my_type::my_int, &op::greater_than, 5))>::type;
+        assert((std::is_same<by_value, by_pointer>::value));
+    }
+
+    // user-defined operators are still supported, and report themselves as custom
+    {
+        auto is_odd = [](int a, int) { return a % 2 == 1; };
+        auto expr = std::unique_ptr<node::expression_tree_leaf_node_base<my_type>>(
+            make_expr(&my_type::my_int, is_odd, 0)
+        );
+        assert(expr->get_comparator() == comparator::custom);
+        assert(expr->evaluate(my_type { 3, false }));
+        assert(!expr->evaluate(my_type { 4, false }));
+    }
+}
+
+struct counted_value {
+    static int copies;
+    static int moves;
+
+    std::vector<int> values;
+
+    counted_value(std::initializer_list<int> init)
+        : values(init) {}
+
+    counted_value(const counted_value& other)
+        : values(other.values) {
+        ++copies;
+    }
+
+    counted_value(counted_value&& other) noexcept
+        : values(std::move(other.values)) {
+        ++moves;
+    }
+
+    bool operator==(const counted_value& other) const {
+        return values == other.values;
+    }
+
+    bool operator!=(const counted_value& other) const {
+        return values != other.values;
+    }
+
+    static void reset() {
+        copies = 0;
+        moves = 0;
+    }
+};
+
+int counted_value::copies = 0;
+int counted_value::moves = 0;
+
+struct counted_wrapper {
+    counted_value value { 1, 2, 3 };
+
+    counted_value get_value() const {
+        return value;
+    }
+};
+
+void test_comp_value_construction() {
+    // rvalue comparison values are moved into the leaf node, and never copied
+    {
+        counted_value::reset();
+        expression_tree<counted_wrapper> expr {
+            make_expr(&counted_wrapper::value, op::equals, counted_value { 1, 2, 3 })
+            ->AND(make_expr(&counted_wrapper::value, op::not_equals, counted_value { 4 }))
+        };
+        assert(counted_value::copies == 0);
+        assert(counted_value::moves == 2);
+        assert(expr.evaluate(counted_wrapper()));
+    }
+
+    // as are the comparison values of leaves that call a member function
+    {
+        counted_value::reset();
+        auto expr = std::unique_ptr<node::expression_tree_node<counted_wrapper>>(
+            make_expr(&counted_wrapper::get_value, op::equals, counted_value { 1, 2, 3 })
+        );
+        assert(counted_value::copies == 0);
+        assert(counted_value::moves == 1);
+    }
+
+    // lvalue comparison values are copied exactly once
+    {
+        counted_value expected { 1, 2, 3 };
+        counted_value::reset();
+        auto expr = std::unique_ptr<node::expression_tree_node<counted_wrapper>>(
+            make_expr(&counted_wrapper::value, op::equals, expected)
+        );
+        assert(counted_value::copies == 1);
+        assert(counted_value::moves == 0);
+        assert(expected.values.size() == 3);
+    }
+}
@@ -0,0 +1,176 @@
+#include <attwoodn/expression_tree.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <algorithm>
+#include <deque>
+#include <iterator>
+#include <list>
+#include <sstream>
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+void test_evaluate_batch();
+void test_filter_vector();
+void test_filter_deque_and_list();
+void test_filter_chunk_boundaries();
+void test_filter_iterator_copies();
+void test_filter_input_iterator();
+
+int main() {
+    test_evaluate_batch();
+    test_filter_vector();
+    test_filter_deque_and_list();
+    test_filter_chunk_boundaries();
+    test_filter_iterator_copies();
+    test_filter_input_iterator();
+
+    return EXIT_SUCCESS;
+}
+
+std::istream& operator>>(std::istream& in, my_type& obj) {
+    return in >> obj.my_int >> obj.my_bool;
+}
+
+expression_tree<my_type> make_even_or_flagged_expr() {
+    // my_bool == true OR (my_int > 10 AND my_int < 20)
+    return expression_tree<my_type> {
+        make_expr(&my_type::my_bool, op::equals, true)
+        ->OR(make_expr(&my_type::my_int, op::greater_than, 10)
+            ->AND(make_expr(&my_type::my_int, op::less_than, 20)))
+    };
+}
+
+template<typename Container>
+Container make_objects(int count) {
+    Container objects;
+    for(int i = 0; i < count; ++i) {
+        objects.push_back(my_type { i, i % 7 == 0 });
+    }
+    return objects;
+}
+
+template<typename Container>
+std::vector<int> expected_matches(const expression_tree<my_type>& expr, const Container& objects) {
+    std::vector<int> expected;
+    for(auto& obj : objects) {
+        if(expr.evaluate(obj)) expected.push_back(obj.my_int);
+    }
+    return expected;
+}
+
+void test_evaluate_batch() {
+    auto expr = make_even_or_flagged_expr();
+    auto objects = make_objects<std::vector<my_type>>(30);
+
+    std::vector<const my_type*> ptrs;
+    for(auto& obj : objects) {
+        ptrs.push_back(&obj);
+    }
+
+    bool results[30];
+    expr.evaluate_batch(ptrs.data(), ptrs.size(), results);
+    for(std::size_t i = 0; i < objects.size(); ++i) {
+        assert(results[i] == expr.evaluate(objects[i]));
+    }
+}
+
+void test_filter_vector() {
+    auto expr = make_even_or_flagged_expr();
+    auto objects = make_objects<std::vector<my_type>>(200);
+
+    std::vector<int> actual;
+    for(const my_type& obj : expr.filter(objects)) {
+        actual.push_back(obj.my_int);
+    }
+    assert(actual == expected_matches(expr, objects));
+
+    // matching elements are yielded by reference, without copying
+    auto range = expr.filter(objects);
+    auto it = range.begin();
+    assert(&*it == &objects[0]);
+    ++it;
+    assert(&*it == &objects[7]);
+
+    // the range can be iterated more than once
+    assert(std::distance(range.begin(), range.end()) == static_cast<std::ptrdiff_t>(actual.size()));
+
+    std::vector<my_type> empty;
+    assert(expr.filter(empty).begin() == expr.filter(empty).end());
+}
+
+void test_filter_deque_and_list() {
+    auto expr = make_even_or_flagged_expr();
+
+    auto deque_objects = make_objects<std::deque<my_type>>(150);
+    std::vector<int> actual;
+    for(auto& obj : expr.filter(deque_objects)) {
+        actual.push_back(obj.my_int);
+    }
+    assert(actual == expected_matches(expr, deque_objects));
+
+    const auto list_objects = make_objects<std::list<my_type>>(150);
+    actual.clear();
+    auto range = expr.filter(list_objects);
+    std::transform(range.begin(), range.end(), std::back_inserter(actual), [](const my_type& obj) { return obj.my_int; });
+    assert(actual == expected_matches(expr, list_objects));
+}
+
+void test_filter_chunk_boundaries() {
+    expression_tree<my_type> expr {
+        make_expr(&my_type::my_bool, op::equals, true)
+    };
+
+    for(int size : { 1, 63, 64, 65, 127, 128, 129, 300 }) {
+        for(int stride : { 1, 2, 63, 64, 65, 1000 }) {
+            std::vector<my_type> objects;
+            for(int i = 0; i < size; ++i) {
+                objects.push_back(my_type { i, (i + 1) % stride == 0 });
+            }
+
+            std::vector<int> actual;
+            for(auto& obj : expr.filter(objects)) {
+                actual.push_back(obj.my_int);
+            }
+            assert(actual == expected_matches(expr, objects));
+        }
+    }
+}
+
+void test_filter_iterator_copies() {
+    auto expr = make_even_or_flagged_expr();
+    auto objects = make_objects<std::vector<my_type>>(100);
+    auto range = expr.filter(objects);
+
+    auto a = range.begin();
+    auto b = a;
+    ++a;
+    ++a;
+    assert(b->my_int == 0);
+    assert(a->my_int == 11);
+    ++b;
+    ++b;
+    assert(a == b);
+}
+
+void test_filter_input_iterator() {
+    auto expr = make_even_or_flagged_expr();
+    auto objects = make_objects<std::vector<my_type>>(150);
+
+    std::stringstream stream;
+    for(auto& obj : objects) {
+        stream << obj.my_int << " " << obj.my_bool << "\n";
+    }
+
+    std::vector<int> actual;
+    std::istream_iterator<my_type> first(stream), last;
+    for(auto& obj : expr.filter(first, last)) {
+        actual.push_back(obj.my_int);
+    }
+    assert(actual == expected_matches(expr, objects));
+
+    std::stringstream empty_stream;
+    std::istream_iterator<my_type> empty_first(empty_stream);
+    auto empty = expr.filter(empty_first, last);
+    assert(empty.begin() == empty.end());
+}
@@ -0,0 +1,333 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/flat_tree.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+
+using namespace attwoodn::expression_tree;
+
+void test_flat_tree_matches_expression_tree();
+void test_flat_tree_leaf_kinds();
+void test_flat_tree_constants();
+void test_flat_tree_deep_tree();
+void test_flat_tree_copy();
+void test_flat_tree_branchless();
+void test_flat_tree_calibrate();
+
+int main() {
+    test_flat_tree_matches_expression_tree();
+    test_flat_tree_leaf_kinds();
+    test_flat_tree_constants();
+    test_flat_tree_deep_tree();
+    test_flat_tree_copy();
+    test_flat_tree_branchless();
+    test_flat_tree_calibrate();
+
+    return EXIT_SUCCESS;
+}
+
+void test_flat_tree_matches_expression_tree() {
+    expression_tree<my_type> expr {
+        make_expr(&my_type::my_bool, op::equals, true)
+        ->OR((make_expr(&my_type::get_my_int, op::greater_than, 0)
+            ->AND(make_expr(&my_type::my_int, op::less_than, 10))
+            )
+        )
+        ->AND(make_expr(&my_type::my_int, op::not_equals, 7))
+    };
+
+    flat_expression_tree<my_type> flat(expr);
+    assert(flat.leaf_count() == 4);
+    assert(flat.generic_leaf_count() == 0);
+
+    my_type obj;
+    for(int i = -5; i < 15; ++i) {
+        obj.my_int = i;
+        obj.my_bool = false;
+        assert(flat.evaluate(obj) == expr.evaluate(obj));
+        obj.my_bool = true;
+        assert(flat.evaluate(obj) == expr.evaluate(obj));
+    }
+
+    std::vector<my_type> objs;
+    for(int i = -5; i < 15; ++i) {
+        objs.push_back(my_type { i, i % 3 == 0 });
+    }
+    std::vector<const my_type*> ptrs;
+    for(auto& o : objs) {
+        ptrs.push_back(&o);
+    }
+
+    std::unique_ptr<bool[]> results(new bool[objs.size()]);
+    flat.evaluate_batch(ptrs.data(), ptrs.size(), results.get());
+    for(std::size_t i = 0; i < objs.size(); ++i) {
+        assert(results[i] == expr.evaluate(objs[i]));
+    }
+}
+
+void test_flat_tree_leaf_kinds() {
+    auto is_small_packet_payload = [](const packet_payload& incoming, const packet_payload&) -> bool {
+        return incoming.data.size() < 10;
+    };
+
+    // a string member, and a custom operator that falls back to a generic leaf
+    expression_tree<data_packet> expr {
+        make_expr(&data_packet::sender_name, op::equals, std::string("Jim"))
+        ->AND(make_expr(&data_packet::payload, is_small_packet_payload, packet_payload()))
+    };
+
+    flat_expression_tree<data_packet> flat(expr);
+    assert(flat.leaf_count() == 2);
+    assert(flat.generic_leaf_count() == 1);
+
+    data_packet packet;
+    packet.sender_name = "Jim";
+    packet.payload.data = "hello";
+    assert(flat.evaluate(packet));
+
+    packet.payload.data = "hello, world";
+    assert(!flat.evaluate(packet));
+
+    packet.sender_name = "Bob";
+    packet.payload.data = "hello";
+    assert(!flat.evaluate(packet));
+
+    struct numbers {
+        std::uint16_t u16;
+        std::int64_t i64;
+        double d;
+        float f;
+        char c;
+
+        std::uint64_t doubled() const {
+            return static_cast<std::uint64_t>(i64) * 2;
+        }
+    };
+
+    expression_tree<numbers> numeric {
+        make_expr(&numbers::u16, op::greater_than, static_cast<std::uint16_t>(100))
+        ->AND(make_expr(&numbers::i64, op::less_than, static_cast<std::int64_t>(-3)))
+        ->AND(make_expr(&numbers::d, op::greater_than, 0.5))
+        ->AND(make_expr(&numbers::f, op::less_than, 2.5f))
+        ->AND(make_expr(&numbers::c, op::not_equals, 'x'))
+        ->AND(make_expr(&numbers::doubled, op::greater_than, static_cast<std::uint64_t>(1000)))
+    };
+
+    flat_expression_tree<numbers> flat_numeric(numeric);
+    assert(flat_numeric.leaf_count() == 6);
+    assert(flat_numeric.generic_leaf_count() == 0);
+
+    // doubled() wraps around for negative values of i64
+    numbers n { 101, -4, 0.75, 1.0f, 'a' };
+    assert(flat_numeric.evaluate(n));
+    assert(numeric.evaluate(n));
+
+    n.c = 'x';
+    assert(!flat_numeric.evaluate(n));
+    n.c = 'a';
+    n.u16 = 100;
+    assert(!flat_numeric.evaluate(n));
+    n.u16 = 101;
+    n.d = 0.5;
+    assert(!flat_numeric.evaluate(n));
+    n.d = 0.75;
+    n.f = 2.5f;
+    assert(!flat_numeric.evaluate(n));
+    n.f = 1.0f;
+    n.i64 = -3;
+    assert(!flat_numeric.evaluate(n));
+}
+
+void test_flat_tree_constants() {
+    auto* always = new node::expression_tree_dynamic_op_node<my_type>(node::boolean_op::OR);
+    always->set_left(new node::expression_tree_constant_node<my_type>(true));
+    always->set_right(make_expr(&my_type::my_int, op::equals, 3));
+
+    auto* root = new node::expression_tree_dynamic_op_node<my_type>(node::boolean_op::AND);
+    root->set_left(always);
+    root->set_right(make_expr(&my_type::my_bool, op::equals, true));
+
+    expression_tree<my_type> expr { root };
+    flat_expression_tree<my_type> flat(expr);
+
+    // the constant is folded into the jumps that lead to it, so the my_int leaf is never evaluated
+    assert(flat.leaf_count() == 2);
+    assert(flat.evaluate(my_type { 0, true }));
+    assert(!flat.evaluate(my_type { 3, false }));
+}
+
+void test_flat_tree_deep_tree() {
+    auto* root = make_expr(&my_type::my_int, op::equals, 0);
+    node::expression_tree_node<my_type>* expr = root;
+    for(int i = 1; i < 2000; ++i) {
+        auto* next = new node::expression_tree_dynamic_op_node<my_type>(node::boolean_op::OR);
+        next->set_left(expr);
+        next->set_right(make_expr(&my_type::my_int, op::equals, i * 2));
+        expr = next;
+    }
+
+    flat_expression_tree<my_type> flat { expression_tree<my_type> { expr } };
+    assert(flat.leaf_count() == 2000);
+
+    assert(flat.evaluate(my_type { 3998, false }));
+    assert(!flat.evaluate(my_type { 3999, false }));
+    assert(flat.evaluate(my_type { 0, false }));
+}
+
+void test_flat_tree_copy() {
+    expression_tree<test_fixture> expr {
+        make_expr(&test_fixture::some_string, op::equals, std::string("hello"))
+        ->OR(make_expr(&test_fixture::is_some_uint_greater_than_zero, op::equals, true))
+    };
+
+    std::unique_ptr<flat_expression_tree<test_fixture>> original(new flat_expression_tree<test_fixture>(expr));
+    flat_expression_tree<test_fixture> copy(*original);
+    flat_expression_tree<test_fixture> assigned(expression_tree<test_fixture> { make_expr(&test_fixture::some_uint, op::equals, (uint16_t) 0) });
+    assigned = *original;
+    original.reset();
+
+    // the copies must not refer to the string value held by the destroyed original
+    test_fixture fixture;
+    fixture.some_uint = 0;
+    fixture.some_string = "hello";
+    assert(copy.evaluate(fixture));
+    assert(assigned.evaluate(fixture));
+    assert(copy.generic_leaf_count() == 0);
+
+    fixture.some_string = "world";
+    assert(!copy.evaluate(fixture));
+    assert(!assigned.evaluate(fixture));
+
+    fixture.some_uint = 1;
+    assert(copy.evaluate(fixture));
+    assert(assigned.evaluate(fixture));
+}
+
+struct sample {
+    int a;
+    int b;
+    double c;
+    bool d;
+    std::string name;
+
+    int get_a() const {
+        return a;
+    }
+};
+
+expression_tree<sample> make_sample_tree() {
+    auto* constant_or = new node::expression_tree_dynamic_op_node<sample>(node::boolean_op::OR);
+    constant_or->set_left(new node::expression_tree_constant_node<sample>(false));
+    constant_or->set_right(make_expr(&sample::b, op::equals, 3));
+
+    auto* root = new node::expression_tree_dynamic_op_node<sample>(node::boolean_op::OR);
+    root->set_left(make_expr(&sample::a, op::greater_than, 4)
+        ->AND(make_expr(&sample::c, op::less_than, 0.5)->OR(make_expr(&sample::d, op::equals, true)))
+        ->AND(make_expr(&sample::name, op::equals, std::string("x"))));
+    root->set_right(constant_or);
+
+    auto* tree = new node::expression_tree_dynamic_op_node<sample>(node::boolean_op::AND);
+    tree->set_left(root);
+    tree->set_right(make_expr(&sample::get_a, op::not_equals, 7)->OR(make_expr(&sample::b, op::less_than, 2)));
+    return expression_tree<sample> { tree };
+}
+
+std::vector<sample> make_samples() {
+    std::vector<sample> samples;
+    for(int a = 0; a < 10; ++a) {
+        for(int b = 0; b < 5; ++b) {
+            for(int bits = 0; bits < 8; ++bits) {
+                samples.push_back(sample { a, b, (bits & 1) ? 0.25 : 0.75, (bits & 2) != 0, (bits & 4) ? "x" : "y" });
+            }
+        }
+    }
+    return samples;
+}
+
+void test_flat_tree_branchless() {
+    const auto expr = make_sample_tree();
+    flat_expression_tree<sample> branchless(expr, evaluation_mode::branchless);
+    assert(branchless.mode() == evaluation_mode::branchless);
+
+    // the string and member function leaves keep their short-circuit jumps, around two cheap blocks
+    assert(branchless.block_count() == 2);
+
+    flat_expression_tree<sample> short_circuit(expr);
+    assert(short_circuit.mode() == evaluation_mode::short_circuit);
+    for(auto& s : make_samples()) {
+        assert(branchless.evaluate(s) == expr.evaluate(s));
+        assert(short_circuit.evaluate(s) == expr.evaluate(s));
+    }
+
+    short_circuit.set_mode(evaluation_mode::branchless);
+    flat_expression_tree<sample> copy(short_circuit);
+    assert(copy.mode() == evaluation_mode::branchless);
+    for(auto& s : make_samples()) {
+        assert(copy.evaluate(s) == expr.evaluate(s));
+    }
+
+    // a tree made only of cheap leaves is a single block
+    flat_expression_tree<my_type> single(expression_tree<my_type> {
+        make_expr(&my_type::my_int, op::greater_than, 0)
+        ->AND(make_expr(&my_type::my_int, op::less_than, 10))
+        ->OR(make_expr(&my_type::my_bool, op::equals, true))
+    }, evaluation_mode::branchless);
+    assert(single.block_count() == 1);
+    assert(single.evaluate(my_type { 5, false }));
+    assert(single.evaluate(my_type { 50, true }));
+    assert(!single.evaluate(my_type { 50, false }));
+
+    // cheap subtrees with too many leaves are split into blocks of at most flat_block_max_leaves leaves
+    std::vector<node::expression_tree_node<my_type>*> level;
+    for(int i = 0; i < 64; ++i) {
+        level.push_back(make_expr(&my_type::my_int, op::equals, i));
+    }
+    while(level.size() > 1) {
+        std::vector<node::expression_tree_node<my_type>*> next;
+        for(std::size_t i = 0; i < level.size(); i += 2) {
+            auto* pair = new node::expression_tree_dynamic_op_node<my_type>(node::boolean_op::OR);
+            pair->set_left(level[i]);
+            pair->set_right(level[i + 1]);
+            next.push_back(pair);
+        }
+        level = next;
+    }
+    flat_expression_tree<my_type> split(expression_tree<my_type> { level.front() }, evaluation_mode::branchless);
+    assert(split.block_count() == 8);
+    for(int i = -5; i < 70; ++i) {
+        assert(split.evaluate(my_type { i, false }) == (i >= 0 && i < 64));
+    }
+}
+
+void test_flat_tree_calibrate() {
+    flat_expression_tree<my_type> flat(expression_tree<my_type> {
+        make_expr(&my_type::my_int, op::greater_than, 0)
+        ->AND(make_expr(&my_type::my_bool, op::equals, true))
+        ->AND(make_expr(&my_type::my_int, op::less_than, 1000))
+    });
+
+    // leaf outcomes that never change predict well
+    std::vector<my_type> predictable(256, my_type { 5, true });
+    std::vector<const my_type*> ptrs;
+    for(auto& o : predictable) {
+        ptrs.push_back(&o);
+    }
+    assert(flat.calibrate(ptrs.data(), ptrs.size()) == evaluation_mode::short_circuit);
+    assert(flat.mode() == evaluation_mode::short_circuit);
+
+    // leaf outcomes that are close to 50/50 do not
+    std::vector<my_type> random;
+    unsigned state = 12345;
+    for(int i = 0; i < 256; ++i) {
+        state = state * 1103515245u + 12345u;
+        random.push_back(my_type { (state >> 16) % 2 ? 5 : -5, (state >> 17) % 2 == 0 });
+    }
+    ptrs.clear();
+    for(auto& o : random) {
+        ptrs.push_back(&o);
+    }
+    assert(flat.calibrate(ptrs.data(), ptrs.size()) == evaluation_mode::branchless);
+    assert(flat.mode() == evaluation_mode::branchless);
+    for(auto& o : random) {
+        assert(flat.evaluate(o) == (o.my_int > 0 && o.my_bool));
+    }
+}
@@ -0,0 +1,200 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/incremental.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+
+using namespace attwoodn::expression_tree;
+
+void test_incremental_matches_full_evaluation();
+void test_incremental_evaluates_only_changed_leaves();
+void test_incremental_getter_dependencies();
+void test_incremental_slots();
+
+int main() {
+    test_incremental_matches_full_evaluation();
+    test_incremental_evaluates_only_changed_leaves();
+    test_incremental_getter_dependencies();
+    test_incremental_slots();
+
+    return EXIT_SUCCESS;
+}
+
+void test_incremental_matches_full_evaluation() {
+    expression_tree<my_type> expr {
+        make_expr(&my_type::my_bool, op::equals, true)
+        ->OR((make_expr(&my_type::get_my_int, op::greater_than, 0)
+            ->AND(make_expr(&my_type::my_int, op::less_than, 10))
+            )
+        )
+    };
+
+    incremental_evaluator<my_type> incremental(expr);
+
+    my_type obj { 4, false };
+    assert(incremental.evaluate(0, obj) == expr.evaluate(obj));
+
+    for(int i = -5; i < 15; ++i) {
+        obj.my_int = i;
+        assert(incremental.update(0, obj, &my_type::my_int) == expr.evaluate(obj));
+
+        obj.my_bool = !obj.my_bool;
+        assert(incremental.update(0, obj, &my_type::my_bool) == expr.evaluate(obj));
+        assert(incremental.result(0) == expr.evaluate(obj));
+    }
+}
+
+void test_incremental_evaluates_only_changed_leaves() {
+    struct wide_type {
+        int a, b, c, d, e;
+    };
+
+    // a > 0 AND b > 0 AND c > 0 AND d > 0 AND (e == 1 OR e == 2)
+    expression_tree<wide_type> expr {
+        make_expr(&wide_type::a, op::greater_than, 0)
+        ->AND(make_expr(&wide_type::b, op::greater_than, 0))
+        ->AND(make_expr(&wide_type::c, op::greater_than, 0))
+        ->AND(make_expr(&wide_type::d, op::greater_than, 0))
+        ->AND(make_expr(&wide_type::e, op::equals, 1)
+            ->OR(make_expr(&wide_type::e, op::equals, 2)))
+    };
+
+    incremental_evaluator<wide_type> incremental(expr);
+
+    wide_type obj { 1, 1, 1, 1, 1 };
+    assert(incremental.evaluate(0, obj));
+    assert(incremental.last_update_evaluations() == 6);
+
+    obj.c = 0;
+    assert(!incremental.update(0, obj, &wide_type::c));
+    assert(incremental.last_update_evaluations() == 1);
+
+    obj.c = 5;
+    assert(incremental.update(0, obj, &wide_type::c));
+    assert(incremental.last_update_evaluations() == 1);
+
+    obj.e = 2;
+    assert(incremental.update(0, obj, &wide_type::e));
+    assert(incremental.last_update_evaluations() == 2);
+
+    obj.e = 3;
+    obj.a = 0;
+    assert(!incremental.update(0, obj, &wide_type::e, &wide_type::a));
+    assert(incremental.last_update_evaluations() == 3);
+
+    // nothing changed
+    assert(!incremental.update(0, obj, std::vector<accessor_id> {}));
+    assert(incremental.last_update_evaluations() == 0);
+}
+
+void test_incremental_getter_dependencies() {
+    expression_tree<my_type> expr {
+        make_expr(&my_type::get_my_int, op::greater_than, 0)
+        ->AND(make_expr(&my_type::my_bool, op::equals, true))
+    };
+
+    // leaves calling member functions are re-evaluated on every update by default
+    {
+        incremental_evaluator<my_type> incremental(expr);
+        my_type obj { 1, true };
+        assert(incremental.evaluate(0, obj));
+
+        obj.my_int = 0;
+        assert(!incremental.update(0, obj, &my_type::my_int));
+        assert(incremental.last_update_evaluations() == 1);
+
+        obj.my_bool = false;
+        assert(!incremental.update(0, obj, &my_type::my_bool));
+        assert(incremental.last_update_evaluations() == 2);
+    }
+
+    // unless their dependencies are declared
+    {
+        incremental_evaluator<my_type> incremental(expr);
+        incremental.add_dependency(&my_type::get_my_int, &my_type::my_int);
+
+        my_type obj { 1, true };
+        assert(incremental.evaluate(0, obj));
+
+        obj.my_bool = false;
+        assert(!incremental.update(0, obj, &my_type::my_bool));
+        assert(incremental.last_update_evaluations() == 1);
+
+        obj.my_bool = true;
+        obj.my_int = -1;
+        assert(!incremental.update(0, obj, &my_type::my_bool, &my_type::my_int));
+        assert(incremental.last_update_evaluations() == 2);
+
+        obj.my_int = 1;
+        assert(incremental.update(0, obj, &my_type::get_my_int));
+        assert(incremental.last_update_evaluations() == 1);
+    }
+
+    // declaring the same dependency again adds nothing
+    {
+        incremental_evaluator<my_type> incremental(expr);
+        incremental.add_dependency(&my_type::get_my_int, &my_type::my_int)
+            .add_dependency(&my_type::get_my_int, &my_type::my_int);
+
+        my_type obj { 1, true };
+        assert(incremental.evaluate(0, obj));
+
+        obj.my_int = -1;
+        assert(!incremental.update(0, obj, &my_type::my_int));
+        assert(incremental.last_update_evaluations() == 1);
+    }
+
+    // a member function that only depends on itself is only re-evaluated when it is passed to update
+    {
+        incremental_evaluator<my_type> incremental(expr);
+        incremental.add_dependency(&my_type::get_my_int, &my_type::get_my_int);
+
+        my_type obj { 1, true };
+        assert(incremental.evaluate(0, obj));
+
+        obj.my_bool = false;
+        assert(!incremental.update(0, obj, &my_type::my_bool));
+        assert(incremental.last_update_evaluations() == 1);
+
+        obj.my_bool = true;
+        obj.my_int = -1;
+        assert(!incremental.update(0, obj, &my_type::get_my_int));
+        assert(incremental.last_update_evaluations() == 1);
+    }
+}
+
+void test_incremental_slots() {
+    expression_tree<my_type> expr {
+        make_expr(&my_type::my_int, op::less_than, 10)
+    };
+
+    incremental_evaluator<my_type> incremental(expr);
+
+    my_type small { 1, false };
+    my_type big { 100, false };
+
+    assert(incremental.evaluate(0, small));
+    assert(!incremental.evaluate(3, big));
+    assert(incremental.slot_count() == 4);
+    assert(incremental.result(0));
+    assert(!incremental.result(3));
+
+    // an update to a slot that was never evaluated falls back to a full evaluation
+    assert(incremental.update(2, small, &my_type::my_int));
+
+    bool threw = false;
+    try {
+        incremental.result(1);
+    } catch(const std::out_of_range&) {
+        threw = true;
+    }
+    assert(threw);
+
+    incremental.reset(0);
+    threw = false;
+    try {
+        incremental.result(0);
+    } catch(const std::out_of_range&) {
+        threw = true;
+    }
+    assert(threw);
+}
@@ -0,0 +1,339 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/minimize.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <limits>
+
+using namespace attwoodn::expression_tree;
+
+void test_subsumed_predicates();
+void test_contradictions();
+void test_tautologies();
+void test_overlapping_ranges();
+void test_untouched_expressions();
+void test_string_comparison_values();
+void test_floating_point_members();
+
+int main() {
+    test_subsumed_predicates();
+    test_contradictions();
+    test_tautologies();
+    test_overlapping_ranges();
+    test_untouched_expressions();
+    test_string_comparison_values();
+    test_floating_point_members();
+
+    return EXIT_SUCCESS;
+}
+
+void test_subsumed_predicates() {
+    // my_int > 5 OR my_int > 10  =>  my_int > 5
+    {
+        expression_tree<my_type> expr {
+            make_expr(&my_type::my_int, op::greater_than, 5)
+            ->OR(make_expr(&my_type::my_int, op::greater_than, 10))
+        };
+
+        minimize_report report;
+        auto minimized = minimize(expr, &report);
+        assert(report.leaves_before == 2);
+        assert(report.leaves_after == 1);
+        assert(report.subsumed == 1);
+        assert(report.leaves_removed() == 1);
+
+        my_type obj;
+        for(obj.my_int = -20; obj.my_int < 20; ++obj.my_int) {
+            assert(minimized.evaluate(obj) == expr.evaluate(obj));
+        }
+    }
+
+    // my_bool == true AND my_int == 4 AND my_int < 10 AND my_int != 7  =>  my_bool == true AND my_int == 4
+    {
+        expression_tree<my_type> expr {
+            make_expr(&my_type::my_bool, op::equals, true)
+            ->AND(make_expr(&my_type::my_int, op::equals, 4))
+            ->AND(make_expr(&my_type::my_int, op::less_than, 10))
+            ->AND(make_expr(&my_type::my_int, op::not_equals, 7))
+        };
+
+        minimize_report report;
+        auto minimized = minimize(expr, &report);
+        assert(report.leaves_after == 2);
+        assert(report.subsumed == 2);
+
+        my_type obj;
+        for(obj.my_int = -20; obj.my_int < 20; ++obj.my_int) {
+            obj.my_bool = obj.my_int % 2;
+            assert(minimized.evaluate(obj) == expr.evaluate(obj));
+        }
+    }
+
+    // member variables and member functions are distinct, even if they return the same value
+    {
+        expression_tree<my_type> expr {
+            make_expr(&my_type::my_int, op::greater_than, 5)
+            ->OR(make_expr(&my_type::get_my_int, op::greater_than, 10))
+        };
+
+        minimize_report report;
+        minimize(expr, &report);
+        assert(report.leaves_removed() == 0);
+    }
+}
+
+void test_contradictions() {
+    // my_int < 0 AND my_int > 10  =>  false
+    {
+        expression_tree<my_type> expr {
+            make_expr(&my_type::my_int, op::less_than, 0)
+            ->AND(make_expr(&my_type::my_int, op::greater_than, 10))
+        };
+
+        minimize_report report;
+        auto minimized = minimize(expr, &report);
+        assert(report.contradictions == 1);
+        assert(report.leaves_after == 0);
+
+        my_type obj;
+        for(obj.my_int = -20; obj.my_int < 20; ++obj.my_int) {
+            assert(!minimized.evaluate(obj));
+        }
+    }
+
+    // my_bool == true OR (my_int == 3 AND my_int == 4)  =>  my_bool == true
+    {
+        expression_tree<my_type> expr {
+            make_expr(&my_type::my_bool, op::equals, true)
+            ->OR(make_expr(&my_type::my_int, op::equals, 3)
+                ->AND(make_expr(&my_type::my_int, op::equals, 4)))
+        };
+
+        minimize_report report;
+        auto minimized = minimize(expr, &report);
+        assert(report.contradictions == 1);
+        assert(report.leaves_after == 1);
+
+        my_type obj;
+        obj.my_int = 3;
+        obj.my_bool = true;
+        assert(minimized.evaluate(obj));
+        obj.my_bool = false;
+        assert(!minimized.evaluate(obj));
+    }
+
+    // string members are ordered too
+    {
+        expression_tree<test_fixture> expr {
+            make_expr(&test_fixture::some_string, op::equals, std::string("abc"))
+            ->AND(make_expr(&test_fixture::some_string, op::not_equals, std::string("abc")))
+        };
+
+        minimize_report report;
+        auto minimized = minimize(expr, &report);
+        assert(report.contradictions == 1);
+
+        test_fixture fixture;
+        fixture.some_string = "abc";
+        assert(!minimized.evaluate(fixture));
+    }
+}
+
+void test_tautologies() {
+    // my_int < 10 OR my_int > 0  =>  true
+    {
+        expression_tree<my_type> expr {
+            make_expr(&my_type::my_int, op::less_than, 10)
+            ->OR(make_expr(&my_type::my_int, op::greater_than, 0))
+        };
+
+        minimize_report report;
+        auto minimized = minimize(expr, &report);
+        assert(report.tautologies == 1);
+        assert(report.leaves_after == 0);
+
+        my_type obj;
+        for(obj.my_int = -20; obj.my_int < 20; ++obj.my_int) {
+            assert(minimized.evaluate(obj));
+        }
+    }
+
+    // my_bool == false AND (my_int != 3 OR my_int == 3)  =>  my_bool == false
+    {
+        expression_tree<my_type> expr {
+            make_expr(&my_type::my_bool, op::equals, false)
+            ->AND(make_expr(&my_type::my_int, op::not_equals, 3)
+                ->OR(make_expr(&my_type::my_int, op::equals, 3)))
+        };
+
+        minimize_report report;
+        auto minimized = minimize(expr, &report);
+        assert(report.tautologies == 1);
+        assert(report.leaves_after == 1);
+
+        my_type obj;
+        for(obj.my_int = -20; obj.my_int < 20; ++obj.my_int) {
+            obj.my_bool = obj.my_int % 2;
+            assert(minimized.evaluate(obj) == expr.evaluate(obj));
+        }
+    }
+}
+
+void test_overlapping_ranges() {
+    // my_int > 0 AND my_int > 5 AND my_int < 100 AND my_int < 50 AND my_int != 2 AND my_int != 20
+    //  =>  my_int > 5 AND my_int < 50 AND my_int != 20
+    expression_tree<my_type> expr {
+        make_expr(&my_type::my_int, op::greater_than, 0)
+        ->AND(make_expr(&my_type::my_int, op::greater_than, 5))
+        ->AND(make_expr(&my_type::my_int, op::less_than, 100))
+        ->AND(make_expr(&my_type::my_int, op::less_than, 50))
+        ->AND(make_expr(&my_type::my_int, op::not_equals, 2))
+        ->AND(make_expr(&my_type::my_int, op::not_equals, 20))
+    };
+
+    minimize_report report;
+    auto minimized = minimize(expr, &report);
+    assert(report.leaves_before == 6);
+    assert(report.leaves_after == 3);
+    assert(report.subsumed == 3);
+
+    my_type obj;
+    for(obj.my_int = -20; obj.my_int < 120; ++obj.my_int) {
+        assert(minimized.evaluate(obj) == expr.evaluate(obj));
+    }
+}
+
+void test_untouched_expressions() {
+    auto is_even = [](int a, int) -> bool {
+        return a % 2 == 0;
+    };
+
+    // user-defined operators are not analyzed
+    expression_tree<my_type> expr {
+        make_expr(&my_type::my_int, is_even, 0)
+        ->AND(make_expr(&my_type::my_int, op::greater_than, 5))
+        ->AND(make_expr(&my_type::my_bool, op::equals, true))
+    };
+
+    minimize_report report;
+    auto minimized = minimize(expr, &report);
+    assert(report.leaves_before == 3);
+    assert(report.leaves_after == 3);
+    assert(report.subsumed == 0);
+
+    my_type obj;
+    for(obj.my_int = -20; obj.my_int < 20; ++obj.my_int) {
+        obj.my_bool = obj.my_int % 3;
+        assert(minimized.evaluate(obj) == expr.evaluate(obj));
+    }
+}
+
+struct named {
+    std::string name;
+    const char* cname;
+};
+
+void test_string_comparison_values() {
+    const char* const names[] = { nullptr, "", "a", "aa", "b", "c" };
+
+    // leaves on the same member with comparison values of different types are not ordered against each other
+    {
+        expression_tree<named> expr {
+            make_expr(&named::name, op::equals, "a")
+            ->OR(make_expr(&named::name, op::equals, std::string("b")))
+        };
+
+        auto minimized = minimize(expr);
+        for(auto* n : names) {
+            const named obj { n ? n : "", n };
+            assert(minimized.evaluate(obj) == expr.evaluate(obj));
+        }
+    }
+
+    // a null char* fails both comparisons, so they are not a tautology
+    {
+        expression_tree<named> expr {
+            make_expr(&named::cname, op::greater_than, "a")
+            ->OR(make_expr(&named::cname, op::less_than, "b"))
+        };
+
+        minimize_report report;
+        auto minimized = minimize(expr, &report);
+        assert(report.tautologies == 0);
+        assert(report.leaves_after == 2);
+
+        for(auto* n : names) {
+            const named obj { "", n };
+            assert(minimized.evaluate(obj) == expr.evaluate(obj));
+        }
+        assert(!minimized.evaluate(named { "", nullptr }));
+    }
+}
+
+struct measured {
+    double x;
+};
+
+void test_floating_point_members() {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double values[] = { nan, -1.0, 0.0, 3.0, 5.0, 7.5, 12.0 };
+
+    // a NaN value is neither greater than 0.0 nor less than 10.0, so this is not a tautology
+    {
+        expression_tree<measured> expr {
+            make_expr(&measured::x, op::greater_than, 0.0)
+            ->OR(make_expr(&measured::x, op::less_than, 10.0))
+        };
+
+        minimize_report report;
+        auto minimized = minimize(expr, &report);
+        assert(report.tautologies == 0);
+        assert(report.leaves_after == 2);
+        assert(!minimized.evaluate(measured { nan }));
+
+        for(double v : values) {
+            assert(minimized.evaluate(measured { v }) == expr.evaluate(measured { v }));
+        }
+    }
+
+    // x > nan is never satisfied, so it does not subsume, and is not subsumed by, x > 5.0
+    {
+        expression_tree<measured> expr {
+            make_expr(&measured::x, op::greater_than, 5.0)
+            ->AND(make_expr(&measured::x, op::greater_than, nan))
+        };
+
+        minimize_report report;
+        auto minimized = minimize(expr, &report);
+        assert(report.subsumed == 0);
+        assert(report.leaves_after == 2);
+
+        for(double v : values) {
+            assert(!minimized.evaluate(measured { v }));
+            assert(minimized.evaluate(measured { v }) == expr.evaluate(measured { v }));
+        }
+    }
+
+    // contradictions and subsumed predicates of floating-point members are still found
+    {
+        expression_tree<measured> expr {
+            make_expr(&measured::x, op::greater_than, 5.0)
+            ->OR(make_expr(&measured::x, op::greater_than, 10.0))
+        };
+
+        minimize_report report;
+        auto minimized = minimize(expr, &report);
+        assert(report.subsumed == 1);
+
+        expression_tree<measured> never {
+            make_expr(&measured::x, op::greater_than, 5.0)
+            ->AND(make_expr(&measured::x, op::less_than, 3.0))
+        };
+        auto minimized_never = minimize(never, &report);
+        assert(report.contradictions == 1);
+
+        for(double v : values) {
+            assert(minimized.evaluate(measured { v }) == expr.evaluate(measured { v }));
+            assert(minimized_never.evaluate(measured { v }) == never.evaluate(measured { v }));
+        }
+    }
+}
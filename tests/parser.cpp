@@ -0,0 +1,252 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/parser.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <memory>
+
+using namespace attwoodn::expression_tree;
+
+void test_field_registry();
+void test_parse_quick_example();
+void test_parse_precedence();
+void test_parse_literals();
+void test_invalid_literals();
+void test_parse_long_expression();
+void test_parse_errors();
+
+int main() {
+    test_field_registry();
+    test_parse_quick_example();
+    test_parse_precedence();
+    test_parse_literals();
+    test_invalid_literals();
+    test_parse_long_expression();
+    test_parse_errors();
+
+    return EXIT_SUCCESS;
+}
+
+field_registry<my_type> make_my_type_registry() {
+    field_registry<my_type> registry;
+    registry.add("my_int", &my_type::my_int)
+            .add("my_bool", &my_type::my_bool)
+            .add("get_my_int", &my_type::get_my_int);
+    return registry;
+}
+
+void test_field_registry() {
+    auto registry = make_my_type_registry();
+    assert(registry.size() == 3);
+
+    assert(registry.find("my_int")->id() == 0);
+    assert(registry.find("my_bool")->id() == 1);
+    assert(registry.find("get_my_int")->id() == 2);
+    assert(registry.find("my_intt") == nullptr);
+    assert(registry.find("") == nullptr);
+    assert(registry.at(1)->name() == "my_bool");
+    assert(registry.at(3) == nullptr);
+
+    assert(registry.find("my_int")->value_type() == typeid(int));
+    assert(registry.find("get_my_int")->accessor().get_kind() == accessor_id::kind::member_function);
+
+    bool threw = false;
+    try {
+        registry.add("my_int", &my_type::my_int);
+    } catch(const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void test_parse_quick_example() {
+    auto registry = make_my_type_registry();
+
+    expression_tree<my_type> expr {
+        parse_expr(registry, "my_bool == true || (get_my_int() > 0 && my_int < 10)")
+    };
+
+    my_type obj;
+
+    obj.my_bool = true;
+    obj.my_int = 4;
+    assert(expr.evaluate(obj));
+
+    obj.my_bool = true;
+    obj.my_int = 12;
+    assert(expr.evaluate(obj));
+
+    obj.my_bool = false;
+    obj.my_int = 0;
+    assert(!expr.evaluate(obj));
+
+    obj.my_int = 9;
+    assert(expr.evaluate(obj));
+}
+
+void test_parse_precedence() {
+    auto registry = make_my_type_registry();
+
+    // && binds tighter than ||:  my_bool == true || (my_int > 0 && my_int < 10)
+    expression_tree<my_type> implicit { parse_expr(registry, "my_bool == true || my_int > 0 && my_int < 10") };
+
+    // parentheses override precedence
+    expression_tree<my_type> grouped { parse_expr(registry, "(my_bool == true || my_int > 0) && my_int < 10") };
+
+    my_type obj;
+    obj.my_bool = true;
+    obj.my_int = 20;
+    assert(implicit.evaluate(obj));
+    assert(!grouped.evaluate(obj));
+
+    obj.my_bool = false;
+    obj.my_int = 5;
+    assert(implicit.evaluate(obj));
+    assert(grouped.evaluate(obj));
+
+    obj.my_int = -5;
+    assert(!implicit.evaluate(obj));
+    assert(!grouped.evaluate(obj));
+
+    // whitespace is optional, and redundant parentheses are permitted
+    expression_tree<my_type> compact { parse_expr(registry, "((my_int>0))&&(my_int!=3)") };
+    obj.my_int = 3;
+    assert(!compact.evaluate(obj));
+    obj.my_int = 4;
+    assert(compact.evaluate(obj));
+}
+
+void test_parse_literals() {
+    field_registry<test_fixture> registry;
+    registry.add("some_string", &test_fixture::some_string)
+            .add("some_uint", &test_fixture::some_uint);
+
+    expression_tree<test_fixture> expr {
+        parse_expr(registry, "some_string == \"hello, \\\"world\\\"\" || some_uint == 16")
+    };
+
+    test_fixture fixture;
+    fixture.some_uint = 0;
+    fixture.some_string = "hello, \"world\"";
+    assert(expr.evaluate(fixture));
+
+    fixture.some_string = "hello, world";
+    assert(!expr.evaluate(fixture));
+
+    fixture.some_uint = 16;
+    assert(expr.evaluate(fixture));
+
+    struct measurement {
+        double value;
+    };
+
+    field_registry<measurement> measurement_registry;
+    measurement_registry.add("value", &measurement::value);
+
+    expression_tree<measurement> range { parse_expr(measurement_registry, "value > -1.5 && value < 2.5e1") };
+    assert(range.evaluate(measurement { 0.0 }));
+    assert(range.evaluate(measurement { 24.9 }));
+    assert(!range.evaluate(measurement { -1.5 }));
+    assert(!range.evaluate(measurement { 25.0 }));
+
+    // integer literals are decimal, even with leading zeros
+    expression_tree<test_fixture> leading_zero { parse_expr(registry, "some_uint == 010") };
+    fixture.some_uint = 10;
+    assert(leading_zero.evaluate(fixture));
+    fixture.some_uint = 8;
+    assert(!leading_zero.evaluate(fixture));
+}
+
+void test_invalid_literals() {
+    struct measurement {
+        double value;
+        unsigned count;
+        int delta;
+    };
+
+    field_registry<measurement> registry;
+    registry.add("value", &measurement::value)
+            .add("count", &measurement::count)
+            .add("delta", &measurement::delta);
+
+    auto is_valid = [&](const char* field, const std::string& literal) {
+        try {
+            delete registry.find(field)->make_leaf(comparator::equals, literal.data(), literal.size());
+        } catch(const std::invalid_argument&) {
+            return false;
+        }
+        return true;
+    };
+
+    // only the given length of the literal is read, even when the characters that follow are digits
+    const char digits[] = { '1', '2', '3' };
+    std::unique_ptr<node::expression_tree_node<measurement>> twelve(registry.find("count")->make_leaf(comparator::equals, digits, 2));
+    assert(twelve->evaluate(measurement { 0.0, 12, 0 }));
+    assert(!twelve->evaluate(measurement { 0.0, 123, 0 }));
+
+    assert(is_valid("count", "5"));
+    assert(is_valid("delta", "-5"));
+    assert(is_valid("value", "-1.5e-3"));
+    assert(is_valid("value", "2.5E+2"));
+
+    // leading whitespace and '+' are not accepted, so " -5" does not wrap around to a large unsigned value
+    for(const char* literal : { " -5", "-5", "+5", " 5", "5 ", "" }) {
+        assert(!is_valid("count", literal));
+    }
+    for(const char* literal : { " -5", "+5", "-", "- 5", "5-" }) {
+        assert(!is_valid("delta", literal));
+    }
+
+    // nan, inf, hexadecimal floats and values out of range would give NaN or infinite comparison values
+    for(const char* literal : { "nan", "NAN", "-nan", "inf", "-inf", "infinity", "0x1p3", "1e400", "+1.5", ".5", " 1.5" }) {
+        assert(!is_valid("value", literal));
+    }
+
+    // literals longer than any valid number are rejected without being parsed
+    assert(!is_valid("count", std::string(200, '1')));
+}
+
+void test_parse_long_expression() {
+    auto registry = make_my_type_registry();
+
+    std::string text = "my_int == 0";
+    for(int i = 1; i < 1000; ++i) {
+        text += " || my_int == " + std::to_string(i * 2);
+    }
+
+    expression_tree<my_type> expr { parse_expr(registry, text) };
+
+    my_type obj;
+    obj.my_int = 1998;
+    assert(expr.evaluate(obj));
+    obj.my_int = 1999;
+    assert(!expr.evaluate(obj));
+    obj.my_int = 0;
+    assert(expr.evaluate(obj));
+}
+
+void test_parse_errors() {
+    auto registry = make_my_type_registry();
+
+    auto error_position = [&](const std::string& text) -> std::size_t {
+        try {
+            delete parse_expr(registry, text);
+        } catch(const parse_error& e) {
+            return e.position();
+        }
+        return std::string::npos;
+    };
+
+    assert(error_position("") == 0);
+    assert(error_position("my_int") == 6);
+    assert(error_position("my_int >") == 8);
+    assert(error_position("not_a_field == 1") == 0);
+    assert(error_position("my_int == 1 &&") == 14);
+    assert(error_position("my_int == 1 && my_bool == yes") == 26);
+    assert(error_position("my_int == 99999999999") == 10);
+    assert(error_position("my_int == 0x10") == 10);
+    assert(error_position("(my_int == 1") == 12);
+    assert(error_position("my_int == 1)") == 11);
+    assert(error_position("my_int == 1 & my_bool == true") == 12);
+    assert(error_position("my_int <= 1") == 8);
+    assert(error_position("my_int == 1 || (my_bool == true && my_int > 2)") == std::string::npos);
+}
@@ -0,0 +1,321 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/flat_tree.hpp>
+#include "allocation_counter.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+/**
+ * Measures the evaluation time (in ns per object) and the number of allocations per evaluation of a set of standard
+ * tree shapes, and compares them against a checked-in baseline file.
+ *
+ * Usage: perf_test <baseline file> [--write-baseline]
+ *
+ * The baseline file lists two tolerances, followed by one line per shape: its name, its ns per object, its time relative
+ * to the reference shape (and_chain_8), and its allocations per evaluation. The test fails if a shape allocates more than
+ * its baseline, if it is slower than its baseline ns per object multiplied by the tolerance, or if its time relative to
+ * the reference shape exceeds its baseline multiplied by the relative tolerance. Only shapes at least as slow as the 
+ * reference shape are checked against their relative time.
+ *
+ * Absolute times differ between machines, so their tolerance is loose. Relative times are measured by timing each shape 
+ * and the reference shape back to back, on the same machine and run, so a cost added to every node (such as an extra 
+ * indirection) shows up as a change in the relative time of the larger shapes, under a much tighter tolerance. Passing 
+ * --write-baseline overwrites the baseline file with the measured values, keeping the tolerances.
+*/
+
+struct perf_record {
+    int id;
+    int group;
+    bool active;
+    double score;
+    uint32_t flags;
+    std::string name;
+
+    int get_id() const {
+        return id;
+    }
+};
+
+struct shape {
+    std::string name;
+    std::function<bool(const perf_record&)> evaluate;
+};
+
+struct measurement {
+    double ns_per_object;
+    double relative;
+    double allocations_per_evaluate;
+};
+
+struct baseline {
+    double tolerance = 3.0;
+    double relative_tolerance = 1.3;
+    std::map<std::string, measurement> shapes;
+};
+
+const std::size_t object_count = 4096;
+const int repetitions = 15;
+const char* const reference_shape = "and_chain_8";
+
+// longer than any small string optimization buffer
+const std::string long_name = "a record name that is much too long to fit in a small string buffer";
+
+std::vector<perf_record> make_records() {
+    std::mt19937 rng(12345);
+    std::vector<perf_record> records;
+    records.reserve(object_count);
+
+    for(std::size_t i = 0; i < object_count; ++i) {
+        perf_record r;
+        r.id = static_cast<int>(rng() % 4096);
+        r.group = static_cast<int>(rng() % 128);
+        r.active = rng() % 2 == 0;
+        r.score = (rng() % 1000) / 10.0;
+        r.flags = static_cast<uint32_t>(rng());
+        r.name = rng() % 2 == 0 ? long_name : long_name + "!";
+        records.push_back(r);
+    }
+    return records;
+}
+
+node::expression_tree_node<perf_record>* make_or_chain(int count) {
+    node::expression_tree_node<perf_record>* root = make_expr(&perf_record::group, op::equals, 0);
+    for(int i = 1; i < count; ++i) {
+        auto* op_node = new node::expression_tree_dynamic_op_node<perf_record>(node::boolean_op::OR);
+        op_node->set_left(root);
+        op_node->set_right(make_expr(&perf_record::group, op::equals, i));
+        root = op_node;
+    }
+    return root;
+}
+
+node::expression_tree_node<perf_record>* make_deep_and(int count) {
+    node::expression_tree_node<perf_record>* root = make_expr(&perf_record::id, op::not_equals, -1);
+    for(int i = 1; i < count; ++i) {
+        auto* op_node = new node::expression_tree_dynamic_op_node<perf_record>(node::boolean_op::AND);
+        op_node->set_left(root);
+        op_node->set_right(make_expr(&perf_record::id, op::not_equals, -1 - i));
+        root = op_node;
+    }
+    return root;
+}
+
+node::expression_tree_node<perf_record>* make_and_chain() {
+    return make_expr(&perf_record::active, op::equals, true)
+        ->AND(make_expr(&perf_record::id, op::greater_than, 100))
+        ->AND(make_expr(&perf_record::score, op::less_than, 90.0))
+        ->AND(make_expr(&perf_record::group, op::not_equals, 7))
+        ->AND(make_expr(&perf_record::flags, op::greater_than, (uint32_t) 1000))
+        ->AND(make_expr(&perf_record::get_id, op::less_than, 4000))
+        ->AND(make_expr(&perf_record::group, op::less_than, 120))
+        ->AND(make_expr(&perf_record::score, op::greater_than, 1.0));
+}
+
+node::expression_tree_node<perf_record>* make_quick_example() {
+    return make_expr(&perf_record::active, op::equals, true)
+        ->OR((make_expr(&perf_record::get_id, op::greater_than, 0)
+            ->AND(make_expr(&perf_record::id, op::less_than, 10))
+            )
+        );
+}
+
+template<typename Tree>
+shape make_shape(const std::string& name, std::shared_ptr<Tree> tree) {
+    return shape { name, [tree](const perf_record& r) { return tree->evaluate(r); } };
+}
+
+std::vector<shape> make_shapes() {
+    using tree = expression_tree<perf_record>;
+    using flat_tree = flat_expression_tree<perf_record>;
+
+    std::vector<shape> shapes;
+    shapes.push_back(make_shape("single_leaf", std::make_shared<tree>(make_expr(&perf_record::id, op::greater_than, 2048))));
+    shapes.push_back(make_shape("string_equals", std::make_shared<tree>(make_expr(&perf_record::name, op::equals, long_name))));
+    shapes.push_back(make_shape("quick_example", std::make_shared<tree>(make_quick_example())));
+    shapes.push_back(make_shape("and_chain_8", std::make_shared<tree>(make_and_chain())));
+    shapes.push_back(make_shape("or_chain_64", std::make_shared<tree>(make_or_chain(64))));
+    shapes.push_back(make_shape("deep_and_1000", std::make_shared<tree>(make_deep_and(1000))));
+    shapes.push_back(make_shape("flat_and_chain_8", std::make_shared<flat_tree>(tree { make_and_chain() })));
+    shapes.push_back(make_shape("flat_or_chain_64", std::make_shared<flat_tree>(tree { make_or_chain(64) })));
+    return shapes;
+}
+
+/**
+ * Returns the time in ns that the given shape takes to evaluate every record once.
+*/
+double time_shape(const shape& s, const std::vector<perf_record>& records) {
+    static volatile std::size_t sink = 0;
+
+    std::size_t matches = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for(auto& r : records) {
+        matches += s.evaluate(r);
+    }
+    const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    sink = sink + matches;
+    return elapsed;
+}
+
+/**
+ * Measures a shape. Each repetition times the reference shape directly before the shape, so that both times are taken 
+ * under the same conditions. The shape's relative time is the median of the ratios of the two times.
+*/
+measurement measure(const shape& s, const shape& reference, const std::vector<perf_record>& records) {
+    volatile std::size_t sink = 0;
+    double best = 0;
+    std::vector<double> ratios;
+
+    for(int rep = 0; rep < repetitions; ++rep) {
+        const double reference_elapsed = time_shape(reference, records);
+        const double elapsed = time_shape(s, records);
+        ratios.push_back(elapsed / reference_elapsed);
+
+        if(rep == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    std::sort(ratios.begin(), ratios.end());
+
+    std::size_t matches = 0;
+    const std::size_t allocations = count_allocations([&] {
+        for(auto& r : records) {
+            matches += s.evaluate(r);
+        }
+    });
+    sink = sink + matches;
+
+    return measurement { best / records.size(), ratios[ratios.size() / 2], static_cast<double>(allocations) / records.size() };
+}
+
+bool read_baseline(const std::string& path, baseline& out) {
+    std::ifstream file(path);
+    if(!file) {
+        return false;
+    }
+
+    std::string line;
+    while(std::getline(file, line)) {
+        if(line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::string name;
+        fields >> name;
+        if(name == "tolerance") {
+            fields >> out.tolerance;
+        } else if(name == "relative_tolerance") {
+            fields >> out.relative_tolerance;
+        } else {
+            measurement m;
+            fields >> m.ns_per_object >> m.relative >> m.allocations_per_evaluate;
+            out.shapes[name] = m;
+        }
+    }
+    return true;
+}
+
+bool write_baseline(const std::string& path, const baseline& b, const std::vector<std::pair<std::string, measurement>>& results) {
+    std::ofstream file(path);
+    if(!file) {
+        return false;
+    }
+
+    file << "# Baseline for perf_test. Regenerate using: perf_test <this file> --write-baseline\n";
+    file << "# A shape fails if it is slower than ns_per_object * tolerance, if its time relative to " << reference_shape 
+         << " (measured in the same run) exceeds relative * relative_tolerance (for shapes with a relative of at least 1), or if it allocates more than allocations_per_evaluate\n";
+    file << "tolerance " << b.tolerance << "\n";
+    file << "relative_tolerance " << b.relative_tolerance << "\n";
+    file << "# shape ns_per_object relative allocations_per_evaluate\n";
+    for(auto& result : results) {
+        char line[128];
+        std::snprintf(line, sizeof(line), "%s %.2f %.3f %g\n", result.first.c_str(), result.second.ns_per_object,
+            result.second.relative, result.second.allocations_per_evaluate);
+        file << line;
+    }
+    return static_cast<bool>(file);
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        std::fprintf(stderr, "usage: %s <baseline file> [--write-baseline]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const std::string baseline_path = argv[1];
+    const bool write = argc > 2 && std::strcmp(argv[2], "--write-baseline") == 0;
+
+    baseline b;
+    if(!read_baseline(baseline_path, b) && !write) {
+        std::fprintf(stderr, "could not read baseline file %s\n", baseline_path.c_str());
+        return EXIT_FAILURE;
+    }
+
+    const auto records = make_records();
+    std::vector<std::pair<std::string, measurement>> results;
+    bool passed = true;
+
+    const auto shapes = make_shapes();
+    const auto reference = std::find_if(shapes.begin(), shapes.end(), [](const shape& s) { return s.name == reference_shape; });
+
+    std::printf("%-20s %12s %12s %10s %10s %12s %10s\n", "shape", "ns/object", "baseline", "relative", "baseline", "allocs/eval", "baseline");
+    for(auto& s : shapes) {
+        const measurement m = measure(s, *reference, records);
+        results.emplace_back(s.name, m);
+
+        auto it = b.shapes.find(s.name);
+        if(it == b.shapes.end()) {
+            std::printf("%-20s %12.2f %12s %10.3f %10s %12g %10s\n", s.name.c_str(), m.ns_per_object, "-", m.relative, "-", 
+                m.allocations_per_evaluate, "-");
+            if(!write) {
+                std::printf("  FAILED: shape has no baseline\n");
+                passed = false;
+            }
+            continue;
+        }
+
+        const measurement& expected = it->second;
+        std::printf("%-20s %12.2f %12.2f %10.3f %10.3f %12g %10g\n", s.name.c_str(), m.ns_per_object, expected.ns_per_object,
+            m.relative, expected.relative, m.allocations_per_evaluate, expected.allocations_per_evaluate);
+
+        if(write) {
+            continue;
+        }
+        if(m.ns_per_object > expected.ns_per_object * b.tolerance) {
+            std::printf("  FAILED: slower than %.2f ns/object (baseline * tolerance %g)\n", expected.ns_per_object * b.tolerance,
+                b.tolerance);
+            passed = false;
+        }
+        // shapes smaller than the reference shape are dominated by the cost of the call, which is too noisy to compare
+        if(expected.relative >= 1 && m.relative > expected.relative * b.relative_tolerance) {
+            std::printf("  FAILED: slower than %.3f times %s (baseline * relative tolerance %g)\n", 
+                expected.relative * b.relative_tolerance, reference_shape, b.relative_tolerance);
+            passed = false;
+        }
+        if(m.allocations_per_evaluate > expected.allocations_per_evaluate) {
+            std::printf("  FAILED: allocates more than the baseline\n");
+            passed = false;
+        }
+    }
+
+    if(write) {
+        if(!write_baseline(baseline_path, b, results)) {
+            std::fprintf(stderr, "could not write baseline file %s\n", baseline_path.c_str());
+            return EXIT_FAILURE;
+        }
+        std::printf("wrote %s\n", baseline_path.c_str());
+    }
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,126 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/flat_tree.hpp>
+#include <attwoodn/expression_tree/plan_cache.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+void test_equal_trees_share_a_plan();
+void test_plans_expire();
+void test_flat_plans();
+void test_global_cache();
+void test_concurrent_requests();
+
+int main() {
+    test_equal_trees_share_a_plan();
+    test_plans_expire();
+    test_flat_plans();
+    test_global_cache();
+    test_concurrent_requests();
+
+    return EXIT_SUCCESS;
+}
+
+expression_tree<my_type> make_filter(int threshold, bool swap) {
+    auto* by_value = make_expr(&my_type::my_int, op::greater_than, threshold);
+    auto* by_flag = make_expr(&my_type::my_bool, op::equals, true);
+    return swap ? expression_tree<my_type> { by_flag->AND(by_value) } : expression_tree<my_type> { by_value->AND(by_flag) };
+}
+
+void test_equal_trees_share_a_plan() {
+    plan_cache<my_type> cache;
+
+    auto first = cache.get(make_filter(5, false));
+    auto second = cache.get(make_filter(5, true));
+    auto other = cache.get(make_filter(6, false));
+
+    assert(first == second);
+    assert(first != other);
+    assert(cache.size() == 2);
+    assert(cache.hit_count() == 1);
+    assert(cache.miss_count() == 2);
+
+    assert(first->evaluate(my_type { 10, true }));
+    assert(!first->evaluate(my_type { 10, false }));
+    assert(other->evaluate(my_type { 7, true }));
+    assert(!other->evaluate(my_type { 6, true }));
+}
+
+void test_plans_expire() {
+    plan_cache<my_type> cache;
+
+    auto plan = cache.get(make_filter(5, false));
+    std::weak_ptr<const expression_tree<my_type>> weak = plan;
+    plan.reset();
+
+    // the cache does not keep plans alive
+    assert(weak.expired());
+    assert(cache.size() == 0);
+
+    plan = cache.get(make_filter(5, false));
+    assert(cache.miss_count() == 2);
+    assert(cache.hit_count() == 0);
+    assert(cache.size() == 1);
+
+    // many short-lived plans do not accumulate in the cache
+    for(int i = 0; i < 1000; ++i) {
+        assert(cache.get(make_filter(100 + i, false))->evaluate(my_type { 101 + i, true }));
+    }
+    assert(cache.size() == 1);
+    assert(cache.get(make_filter(5, true)) == plan);
+}
+
+void test_flat_plans() {
+    plan_cache<my_type, flat_expression_tree<my_type>> cache;
+
+    auto first = cache.get(make_filter(5, false));
+    auto second = cache.get(make_filter(5, true));
+    assert(first == second);
+    assert(first->evaluate(my_type { 10, true }));
+    assert(!first->evaluate(my_type { 1, true }));
+}
+
+void test_global_cache() {
+    auto& cache = plan_cache<my_type>::global();
+    assert(&cache == &plan_cache<my_type>::global());
+
+    auto first = cache.get(make_filter(42, false));
+    auto second = plan_cache<my_type>::global().get(make_filter(42, true));
+    assert(first == second);
+}
+
+void test_concurrent_requests() {
+    plan_cache<my_type> cache;
+    const int thread_count = 8;
+    const int filter_count = 16;
+
+    std::vector<std::vector<std::shared_ptr<const expression_tree<my_type>>>> plans(thread_count);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&cache, &plans, t]() {
+            for(int i = 0; i < filter_count; ++i) {
+                plans[t].push_back(cache.get(make_filter(i, (t + i) % 2 == 0)));
+            }
+        });
+    }
+    for(auto& thread : threads) {
+        thread.join();
+    }
+
+    // every thread holds the same plan for each filter
+    assert(cache.size() == filter_count);
+    for(int t = 1; t < thread_count; ++t) {
+        for(int i = 0; i < filter_count; ++i) {
+            assert(plans[t][i] == plans[0][i]);
+        }
+    }
+    assert(cache.hit_count() + cache.miss_count() == thread_count * filter_count);
+    for(int i = 0; i < filter_count; ++i) {
+        assert(plans[0][i]->evaluate(my_type { i + 1, true }));
+        assert(!plans[0][i]->evaluate(my_type { i, true }));
+    }
+}
@@ -0,0 +1,183 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/record.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <functional>
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+void test_record_layout();
+void test_record_field_byte_order();
+void test_record_expression_tree();
+void test_record_scan();
+
+int main() {
+    test_record_layout();
+    test_record_field_byte_order();
+    test_record_expression_tree();
+    test_record_scan();
+
+    return EXIT_SUCCESS;
+}
+
+// a 16 byte packet header: source port and destination port (big endian), sequence number (big endian), 
+// flags, a "retransmitted" flag, two unused bytes, and a round trip time estimate in milliseconds (little endian float)
+const std::size_t header_size = 16;
+
+record_layout make_header_layout() {
+    record_layout layout(header_size);
+    layout.add<std::uint16_t>("src_port", 0, byte_order::big_endian)
+          .add<std::uint16_t>("dst_port", 2, byte_order::big_endian)
+          .add<std::uint32_t>("seq", 4, byte_order::big_endian)
+          .add<std::uint8_t>("flags", 8, byte_order::big_endian)
+          .add<bool>("retransmitted", 9, byte_order::big_endian)
+          .add<float>("rtt", 12, byte_order::little_endian);
+    return layout;
+}
+
+void write_header(unsigned char* out, std::uint16_t src_port, std::uint16_t dst_port, std::uint32_t seq, std::uint8_t flags, 
+        bool retransmitted, float rtt) {
+    out[0] = static_cast<unsigned char>(src_port >> 8);
+    out[1] = static_cast<unsigned char>(src_port);
+    out[2] = static_cast<unsigned char>(dst_port >> 8);
+    out[3] = static_cast<unsigned char>(dst_port);
+    out[4] = static_cast<unsigned char>(seq >> 24);
+    out[5] = static_cast<unsigned char>(seq >> 16);
+    out[6] = static_cast<unsigned char>(seq >> 8);
+    out[7] = static_cast<unsigned char>(seq);
+    out[8] = flags;
+    out[9] = retransmitted ? 1 : 0;
+    out[10] = 0;
+    out[11] = 0;
+
+    std::uint32_t rtt_bits;
+    std::memcpy(&rtt_bits, &rtt, sizeof(rtt));
+    for(int i = 0; i < 4; ++i) {
+        out[12 + i] = static_cast<unsigned char>(rtt_bits >> (8 * i));
+    }
+}
+
+void test_record_layout() {
+    auto layout = make_header_layout();
+    assert(layout.size() == 6);
+    assert(layout.record_size() == header_size);
+    assert(layout.get<std::uint32_t>("seq").offset() == 4);
+    assert(layout.get<std::uint32_t>("seq").order() == byte_order::big_endian);
+
+    auto throws_invalid_argument = [](std::function<void()> f) {
+        try {
+            f();
+        } catch(const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+
+    assert(throws_invalid_argument([&] { layout.get<std::uint32_t>("no_such_field"); }));
+    assert(throws_invalid_argument([&] { layout.get<std::uint16_t>("seq"); }));
+    assert(throws_invalid_argument([&] { layout.add<std::uint32_t>("seq", 0, byte_order::big_endian); }));
+    assert(throws_invalid_argument([&] { layout.add<std::uint64_t>("too_far", 12, byte_order::big_endian); }));
+
+    // leaves that read the same field report the same accessor
+    auto* a = make_expr(layout.get<std::uint16_t>("dst_port"), op::equals, (std::uint16_t) 80);
+    auto* b = make_expr(layout.get<std::uint16_t>("dst_port"), op::equals, (std::uint16_t) 443);
+    auto* c = make_expr(layout.get<std::uint16_t>("src_port"), op::equals, (std::uint16_t) 80);
+    assert(a->get_accessor() == b->get_accessor());
+    assert(a->get_accessor() != c->get_accessor());
+    delete a;
+    delete b;
+    delete c;
+}
+
+void test_record_field_byte_order() {
+    const unsigned char bytes[8] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 };
+    const record_view record { bytes, sizeof(bytes) };
+
+    assert(record_field<std::uint16_t>(0, byte_order::big_endian).read(record) == 0x0102);
+    assert(record_field<std::uint16_t>(0, byte_order::little_endian).read(record) == 0x0201);
+    assert(record_field<std::uint32_t>(1, byte_order::big_endian).read(record) == 0x02030405u);
+    assert(record_field<std::uint32_t>(1, byte_order::little_endian).read(record) == 0x05040302u);
+    assert(record_field<std::uint64_t>(0, byte_order::big_endian).read(record) == 0x0102030405060708ull);
+    assert(record_field<std::int8_t>(7, byte_order::big_endian).read(record) == 8);
+
+    const unsigned char negative[2] = { 0xff, 0xfe };
+    assert(record_field<std::int16_t>(0, byte_order::big_endian).read(record_view { negative, 2 }) == -2);
+
+    bool threw = false;
+    try {
+        record_field<std::uint32_t>(6, byte_order::big_endian).read(record);
+    } catch(const std::out_of_range&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void test_record_expression_tree() {
+    auto layout = make_header_layout();
+
+    // dst_port == 443 AND (flags == 2 OR (rtt > 100 AND retransmitted == false))
+    expression_tree<record_view> expr {
+        make_expr(layout.get<std::uint16_t>("dst_port"), op::equals, (std::uint16_t) 443)
+        ->AND(make_expr(layout.get<std::uint8_t>("flags"), op::equals, (std::uint8_t) 2)
+            ->OR(make_expr(layout.get<float>("rtt"), op::greater_than, 100.0f)
+                ->AND(make_expr(layout.get<bool>("retransmitted"), op::equals, false))))
+    };
+
+    unsigned char header[header_size];
+
+    write_header(header, 51000, 443, 1, 2, false, 5.0f);
+    assert(expr.evaluate(record_view { header, header_size }));
+
+    write_header(header, 51000, 80, 1, 2, false, 5.0f);
+    assert(!expr.evaluate(record_view { header, header_size }));
+
+    write_header(header, 51000, 443, 1, 0, false, 150.0f);
+    assert(expr.evaluate(record_view { header, header_size }));
+
+    write_header(header, 51000, 443, 1, 0, true, 150.0f);
+    assert(!expr.evaluate(record_view { header, header_size }));
+
+    write_header(header, 51000, 443, 1, 0, false, 50.0f);
+    assert(!expr.evaluate(record_view { header, header_size }));
+
+    // a truncated record cannot satisfy a tree that reads beyond its end
+    write_header(header, 51000, 443, 1, 0, false, 150.0f);
+    assert(!expr.evaluate(record_view { header, 10 }));
+
+    // the members a tree reads are reported as record fields
+    auto access = expr.accessed_members();
+    assert(access.accessors().size() == 4);
+    assert(access.reads(layout.get<std::uint16_t>("dst_port").id()));
+    assert(access.can_skip(layout.get<std::uint32_t>("seq").id()));
+}
+
+void test_record_scan() {
+    auto layout = make_header_layout();
+    expression_tree<record_view> expr {
+        make_expr(layout.get<std::uint16_t>("dst_port"), op::equals, (std::uint16_t) 443)
+        ->AND(make_expr(layout.get<std::uint32_t>("seq"), op::greater_than, (std::uint32_t) 70000))
+    };
+
+    const std::size_t count = 1000;
+    std::vector<unsigned char> buffer(count * header_size);
+    std::size_t expected = 0;
+    for(std::size_t i = 0; i < count; ++i) {
+        const std::uint16_t dst_port = i % 3 == 0 ? 443 : 80;
+        const std::uint32_t seq = static_cast<std::uint32_t>(i * 100);
+        write_header(&buffer[i * header_size], 1234, dst_port, seq, 0, false, 1.0f);
+        expected += dst_port == 443 && seq > 70000;
+    }
+
+    assert(count_matching_records(expr, buffer.data(), count, header_size) == expected);
+
+    std::vector<std::size_t> matches;
+    for_each_matching_record(expr, buffer.data(), count, header_size, [&](std::size_t index) {
+        matches.push_back(index);
+    });
+    assert(matches.size() == expected);
+    assert(matches.front() == 702);
+    for(auto index : matches) {
+        assert(index % 3 == 0 && index * 100 > 70000);
+    }
+}
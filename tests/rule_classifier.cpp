@@ -0,0 +1,300 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/rule_classifier.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <limits>
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+struct route {
+    int port;
+    int priority;
+    bool internal;
+    std::string host;
+
+    static int port_reads;
+
+    int get_port() const {
+        ++port_reads;
+        return port;
+    }
+};
+
+int route::port_reads = 0;
+
+void test_first_match();
+void test_shared_tests();
+void test_each_test_evaluated_once();
+void test_hit_counts();
+void test_throwing_rule();
+void test_constant_and_empty_rules();
+void test_many_rules();
+void test_many_distinct_tests();
+void test_nan_comparison_value();
+
+int main() {
+    test_first_match();
+    test_shared_tests();
+    test_each_test_evaluated_once();
+    test_hit_counts();
+    test_throwing_rule();
+    test_constant_and_empty_rules();
+    test_many_rules();
+    test_many_distinct_tests();
+    test_nan_comparison_value();
+
+    return EXIT_SUCCESS;
+}
+
+std::vector<expression_tree<route>> make_rules() {
+    std::vector<expression_tree<route>> rules;
+    rules.emplace_back(make_expr(&route::internal, op::equals, true)
+        ->AND(make_expr(&route::port, op::equals, 22)));
+    rules.emplace_back(make_expr(&route::port, op::equals, 443)
+        ->OR(make_expr(&route::port, op::equals, 80)));
+    rules.emplace_back(make_expr(&route::host, op::equals, std::string("example.com"))
+        ->AND(make_expr(&route::priority, op::greater_than, 5)));
+    rules.emplace_back(make_expr(&route::priority, op::greater_than, 5));
+    return rules;
+}
+
+std::size_t classify_naively(const std::vector<expression_tree<route>>& rules, const route& r) {
+    for(std::size_t i = 0; i < rules.size(); ++i) {
+        if(rules[i].evaluate(r)) {
+            return i;
+        }
+    }
+    return rule_classifier<route>::no_match;
+}
+
+std::vector<route> make_routes() {
+    std::vector<route> routes;
+    for(int port : { 22, 80, 443, 8080 }) {
+        for(int priority = 0; priority < 10; priority += 3) {
+            for(bool internal : { false, true }) {
+                for(auto host : { "example.com", "example.org" }) {
+                    routes.push_back(route { port, priority, internal, host });
+                }
+            }
+        }
+    }
+    return routes;
+}
+
+void test_first_match() {
+    const auto rules = make_rules();
+    rule_classifier<route> classifier(rules);
+    assert(classifier.rule_count() == 4);
+
+    for(auto& r : make_routes()) {
+        assert(classifier.classify(r) == classify_naively(rules, r));
+    }
+
+    assert(classifier.classify(route { 22, 0, true, "" }) == 0);
+    assert(classifier.classify(route { 22, 9, true, "example.com" }) == 0);
+    assert(classifier.classify(route { 80, 9, true, "example.com" }) == 1);
+    assert(classifier.classify(route { 22, 9, false, "example.com" }) == 2);
+    assert(classifier.classify(route { 22, 9, false, "" }) == 3);
+    assert(classifier.classify(route { 22, 0, false, "" }) == rule_classifier<route>::no_match);
+
+    const auto routes = make_routes();
+    std::vector<const route*> ptrs;
+    for(auto& r : routes) {
+        ptrs.push_back(&r);
+    }
+    std::vector<std::size_t> results(ptrs.size());
+    classifier.classify_batch(ptrs.data(), ptrs.size(), results.data());
+    for(std::size_t i = 0; i < routes.size(); ++i) {
+        assert(results[i] == classify_naively(rules, routes[i]));
+    }
+}
+
+void test_shared_tests() {
+    // priority > 5 appears in two rules, but is a single test
+    rule_classifier<route> classifier(make_rules());
+    assert(classifier.test_count() == 6);
+
+    // leaves with custom operators are never merged
+    auto is_even = [](int a, int) { return a % 2 == 0; };
+    std::vector<expression_tree<route>> rules;
+    rules.emplace_back(make_expr(&route::port, is_even, 0));
+    rules.emplace_back(make_expr(&route::port, is_even, 0)->AND(make_expr(&route::internal, op::equals, true)));
+    rule_classifier<route> custom(std::move(rules));
+    assert(custom.test_count() == 3);
+    assert(custom.classify(route { 2, 0, false, "" }) == 0);
+    assert(custom.classify(route { 3, 0, true, "" }) == rule_classifier<route>::no_match);
+}
+
+void test_each_test_evaluated_once() {
+    std::vector<expression_tree<route>> rules;
+    rules.emplace_back(make_expr(&route::get_port, op::greater_than, 1000)
+        ->AND(make_expr(&route::internal, op::equals, true)));
+    rules.emplace_back(make_expr(&route::get_port, op::greater_than, 1000)
+        ->AND(make_expr(&route::priority, op::equals, 3)));
+    rules.emplace_back(make_expr(&route::priority, op::equals, 4)
+        ->OR(make_expr(&route::get_port, op::greater_than, 1000)));
+
+    rule_classifier<route> classifier(std::move(rules));
+    assert(classifier.test_count() == 4);
+
+    route::port_reads = 0;
+    assert(classifier.classify(route { 8080, 0, false, "" }) == 2);
+    assert(route::port_reads == 1);
+
+    route::port_reads = 0;
+    assert(classifier.classify(route { 80, 0, false, "" }) == rule_classifier<route>::no_match);
+    assert(route::port_reads == 1);
+}
+
+void test_hit_counts() {
+    const auto rules = make_rules();
+    rule_classifier<route> classifier(rules);
+
+    const auto routes = make_routes();
+    std::vector<std::uint64_t> expected(rules.size(), 0);
+    std::uint64_t expected_no_match = 0;
+    for(auto& r : routes) {
+        const std::size_t rule = classifier.classify(r);
+        if(rule == rule_classifier<route>::no_match) {
+            ++expected_no_match;
+        } else {
+            ++expected[rule];
+        }
+    }
+
+    for(std::size_t i = 0; i < rules.size(); ++i) {
+        assert(classifier.hit_count(i) == expected[i]);
+        assert(expected[i] > 0);
+    }
+    assert(classifier.no_match_count() == expected_no_match);
+
+    classifier.reset_hit_counts();
+    assert(classifier.hit_count(0) == 0);
+    assert(classifier.no_match_count() == 0);
+
+    bool threw = false;
+    try {
+        classifier.hit_count(rules.size());
+    } catch(const std::out_of_range&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void test_throwing_rule() {
+    auto throws_on_zero = [](int a, int) -> bool {
+        if(a == 0) throw std::runtime_error("zero");
+        return true;
+    };
+
+    // a rule that throws is not satisfied, and the shared test fails every rule that reaches it
+    std::vector<expression_tree<route>> rules;
+    rules.emplace_back(make_expr(&route::priority, throws_on_zero, 0));
+    rules.emplace_back(make_expr(&route::internal, op::equals, true));
+
+    rule_classifier<route> classifier(std::move(rules));
+    assert(classifier.classify(route { 0, 0, true, "" }) == 1);
+    assert(classifier.classify(route { 0, 0, false, "" }) == rule_classifier<route>::no_match);
+    assert(classifier.classify(route { 0, 1, false, "" }) == 0);
+}
+
+void test_constant_and_empty_rules() {
+    rule_classifier<route> empty(std::vector<expression_tree<route>> {});
+    assert(empty.classify(route { 0, 0, false, "" }) == rule_classifier<route>::no_match);
+    assert(empty.no_match_count() == 1);
+
+    std::vector<expression_tree<route>> rules;
+    rules.emplace_back(new node::expression_tree_constant_node<route>(false));
+    rules.emplace_back(make_expr(&route::port, op::equals, 22));
+    rules.emplace_back(new node::expression_tree_constant_node<route>(true));
+    rules.emplace_back(make_expr(&route::port, op::equals, 80));
+
+    rule_classifier<route> classifier(std::move(rules));
+    assert(classifier.classify(route { 22, 0, false, "" }) == 1);
+    assert(classifier.classify(route { 80, 0, false, "" }) == 2);
+    assert(classifier.hit_count(0) == 0);
+    assert(classifier.hit_count(3) == 0);
+
+    rule_classifier<route> moved(std::move(classifier));
+    assert(moved.classify(route { 22, 0, false, "" }) == 1);
+    assert(moved.hit_count(1) == 2);
+}
+
+void test_many_rules() {
+    // hundreds of rules that mostly share their tests
+    std::vector<expression_tree<route>> rules;
+    for(int i = 0; i < 400; ++i) {
+        rules.emplace_back(make_expr(&route::port, op::equals, i % 100)
+            ->AND(make_expr(&route::priority, op::equals, i / 100)));
+    }
+    const auto naive = rules;
+
+    rule_classifier<route> classifier(std::move(rules));
+    assert(classifier.test_count() == 104);
+
+    for(int port = 0; port < 110; port += 3) {
+        for(int priority = 0; priority < 5; ++priority) {
+            const route r { port, priority, false, "" };
+            const std::size_t expected = port < 100 && priority < 4 ? static_cast<std::size_t>(priority * 100 + port) 
+                : rule_classifier<route>::no_match;
+            assert(classifier.classify(r) == expected);
+            assert(classify_naively(naive, r) == expected);
+        }
+    }
+}
+
+void test_many_distinct_tests() {
+    // more distinct tests than are remembered inline
+    std::vector<expression_tree<route>> rules;
+    for(int i = 0; i < 300; ++i) {
+        rules.emplace_back(make_expr(&route::port, op::equals, i)->AND(make_expr(&route::internal, op::equals, true)));
+    }
+    rules.emplace_back(make_expr(&route::priority, op::greater_than, 5));
+    const auto naive = rules;
+
+    rule_classifier<route> large(std::move(rules));
+    assert(large.test_count() > rule_classifier<route>::inline_test_capacity);
+    rule_classifier<route> small(make_rules());
+
+    // classifications by different classifiers on the same thread, including one made while evaluating a test of 
+    // another, do not see each other's results
+    auto classified_by_small = [&small](int port, int) { return small.classify(route { port, 0, true, "" }) == 0; };
+    std::vector<expression_tree<route>> nested_rules;
+    nested_rules.emplace_back(make_expr(&route::port, classified_by_small, 0));
+    nested_rules.emplace_back(make_expr(&route::port, op::equals, 443));
+    rule_classifier<route> nested(std::move(nested_rules));
+
+    for(int port : { 0, 1, 22, 80, 150, 255, 256, 299, 300, 443, 8080 }) {
+        for(bool internal : { false, true }) {
+            const route r { port, 9, internal, "" };
+            assert(large.classify(r) == classify_naively(naive, r));
+            assert(small.classify(r) == classify_naively(make_rules(), r));
+            assert(nested.classify(r) == (port == 22 ? 0 : (port == 443 ? 1 : rule_classifier<route>::no_match)));
+        }
+    }
+}
+
+struct sample {
+    double x;
+};
+
+void test_nan_comparison_value() {
+    // NaN is not equivalent to any value, so x > nan (never satisfied) is not merged with x > 5.0
+    std::vector<expression_tree<sample>> rules;
+    rules.emplace_back(make_expr(&sample::x, op::greater_than, std::numeric_limits<double>::quiet_NaN()));
+    rules.emplace_back(make_expr(&sample::x, op::greater_than, 5.0));
+    rules.emplace_back(make_expr(&sample::x, op::greater_than, std::numeric_limits<double>::quiet_NaN()));
+
+    rule_classifier<sample> classifier(std::move(rules));
+    assert(classifier.test_count() == 3);
+    assert(classifier.classify(sample { 10.0 }) == 1);
+    assert(classifier.classify(sample { 1.0 }) == rule_classifier<sample>::no_match);
+
+    std::vector<expression_tree<sample>> reversed;
+    reversed.emplace_back(make_expr(&sample::x, op::greater_than, 5.0));
+    reversed.emplace_back(make_expr(&sample::x, op::greater_than, std::numeric_limits<double>::quiet_NaN()));
+    rule_classifier<sample> reversed_classifier(std::move(reversed));
+    assert(reversed_classifier.classify(sample { 10.0 }) == 0);
+    assert(reversed_classifier.classify(sample { 1.0 }) == rule_classifier<sample>::no_match);
+}
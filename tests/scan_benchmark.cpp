@@ -0,0 +1,94 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/flat_tree.hpp>
+#include <attwoodn/expression_tree/scanner.hpp>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+/**
+ * Reports the throughput, in GB/s, of scanning a memory mapped file of packed records with mapped_record_scanner,
+ * using one thread and using every hardware thread.
+ *
+ * Usage: scan_benchmark [size in MB]
+*/
+
+struct flow_record {
+    uint32_t id;
+    uint16_t port;
+    uint8_t flags;
+    uint8_t protocol;
+    float rtt;
+    uint32_t bytes;
+};
+
+template<typename Tree>
+void report(const char* name, const mapped_record_scanner<flow_record>& scanner, const Tree& tree, unsigned threads, 
+        std::size_t expected) {
+    double best = 0;
+    for(int rep = 0; rep < 5; ++rep) {
+        const auto start = std::chrono::steady_clock::now();
+        const std::size_t matches = scanner.count(tree, threads);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if(matches != expected) {
+            std::fprintf(stderr, "%s: expected %zu matches, found %zu\n", name, expected, matches);
+            std::exit(EXIT_FAILURE);
+        }
+        if(rep == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+
+    std::printf("%-16s %3u threads %8.2f GB/s %8.1f M records/s\n", name, threads, scanner.size_bytes() / best / 1e9, 
+        scanner.record_count() / best / 1e6);
+}
+
+int main(int argc, char** argv) {
+    const std::size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+    const std::size_t count = megabytes * 1024 * 1024 / sizeof(flow_record);
+    const std::string path = "scan_benchmark_records.bin";
+
+    expression_tree<flow_record> expr {
+        make_expr(&flow_record::port, op::equals, (uint16_t) 443)
+        ->AND(make_expr(&flow_record::protocol, op::equals, (uint8_t) 6))
+        ->AND(make_expr(&flow_record::rtt, op::greater_than, 150.0f)
+            ->OR(make_expr(&flow_record::bytes, op::greater_than, (uint32_t) 1000000)))
+    };
+    const flat_expression_tree<flow_record> flat(expr);
+
+    std::size_t expected = 0;
+    {
+        std::mt19937 rng(42);
+        std::vector<flow_record> records(count);
+        for(auto& r : records) {
+            r = flow_record { static_cast<uint32_t>(rng()), static_cast<uint16_t>(rng() % 4 == 0 ? 443 : 80), 
+                static_cast<uint8_t>(rng() % 16), static_cast<uint8_t>(rng() % 2 == 0 ? 6 : 17), 
+                static_cast<float>(rng() % 300), static_cast<uint32_t>(rng() % 2000000) };
+            expected += expr.evaluate(r);
+        }
+
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if(!file || std::fwrite(records.data(), sizeof(flow_record), records.size(), file) != records.size()) {
+            std::fprintf(stderr, "could not write %s\n", path.c_str());
+            return EXIT_FAILURE;
+        }
+        std::fclose(file);
+    }
+
+    {
+        mapped_record_scanner<flow_record> scanner(path);
+        std::printf("scanning %zu records (%.1f MB)\n", scanner.record_count(), scanner.size_bytes() / 1e6);
+
+        const unsigned hardware_threads = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+        report("expression_tree", scanner, expr, 1, expected);
+        report("expression_tree", scanner, expr, hardware_threads, expected);
+        report("flat_tree", scanner, flat, 1, expected);
+        report("flat_tree", scanner, flat, hardware_threads, expected);
+    }
+
+    std::remove(path.c_str());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/flat_tree.hpp>
+#include <attwoodn/expression_tree/scanner.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <cstdio>
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+struct flow_record {
+    uint32_t id;
+    uint16_t port;
+    uint8_t flags;
+    float rtt;
+};
+
+void test_scanner_count();
+void test_scanner_offsets();
+void test_scanner_empty_file();
+void test_scanner_errors();
+
+int main() {
+    test_scanner_count();
+    test_scanner_offsets();
+    test_scanner_empty_file();
+    test_scanner_errors();
+
+    return EXIT_SUCCESS;
+}
+
+const std::string records_path = "scanner_test_records.bin";
+const std::size_t record_count = 10007;
+
+std::vector<flow_record> write_records() {
+    std::vector<flow_record> records;
+    for(std::size_t i = 0; i < record_count; ++i) {
+        records.push_back(flow_record { static_cast<uint32_t>(i), static_cast<uint16_t>(i % 3 == 0 ? 443 : 80),
+            static_cast<uint8_t>(i % 4), static_cast<float>(i % 200) });
+    }
+
+    std::FILE* file = std::fopen(records_path.c_str(), "wb");
+    assert(file);
+    assert(std::fwrite(records.data(), sizeof(flow_record), records.size(), file) == records.size());
+    std::fclose(file);
+    return records;
+}
+
+expression_tree<flow_record> make_flow_tree() {
+    return expression_tree<flow_record> {
+        make_expr(&flow_record::port, op::equals, (uint16_t) 443)
+        ->AND(make_expr(&flow_record::flags, op::not_equals, (uint8_t) 0)
+            ->OR(make_expr(&flow_record::rtt, op::greater_than, 150.0f)))
+    };
+}
+
+void test_scanner_count() {
+    const auto records = write_records();
+    const auto expr = make_flow_tree();
+
+    std::size_t expected = 0;
+    for(auto& r : records) {
+        expected += expr.evaluate(r);
+    }
+    assert(expected > 0);
+
+    {
+        mapped_record_scanner<flow_record> scanner(records_path);
+        assert(scanner.record_count() == record_count);
+        assert(scanner.size_bytes() == record_count * sizeof(flow_record));
+        assert(scanner.records()[5].id == 5);
+
+        assert(scanner.count(expr, 1) == expected);
+        assert(scanner.count(expr, 4) == expected);
+        assert(scanner.count(expr) == expected);
+
+        // compiled forms of the tree can be scanned as well
+        const flat_expression_tree<flow_record> flat(expr);
+        assert(scanner.count(flat, 3) == expected);
+    }
+
+    std::remove(records_path.c_str());
+}
+
+void test_scanner_offsets() {
+    const auto records = write_records();
+    const auto expr = make_flow_tree();
+
+    std::vector<std::size_t> expected;
+    for(std::size_t i = 0; i < records.size(); ++i) {
+        if(expr.evaluate(records[i])) {
+            expected.push_back(i * sizeof(flow_record));
+        }
+    }
+
+    {
+        mapped_record_scanner<flow_record> scanner(records_path);
+        assert(scanner.matching_offsets(expr, 1) == expected);
+        assert(scanner.matching_offsets(expr, 7) == expected);
+    }
+
+    std::remove(records_path.c_str());
+}
+
+void test_scanner_empty_file() {
+    std::FILE* file = std::fopen(records_path.c_str(), "wb");
+    assert(file);
+    std::fclose(file);
+
+    {
+        mapped_record_scanner<flow_record> scanner(records_path);
+        assert(scanner.record_count() == 0);
+        assert(scanner.size_bytes() == 0);
+        assert(scanner.count(make_flow_tree(), 4) == 0);
+        assert(scanner.count(make_flow_tree()) == 0);
+        assert(scanner.matching_offsets(make_flow_tree(), 2).empty());
+    }
+
+    std::remove(records_path.c_str());
+}
+
+void test_scanner_errors() {
+    // a file that does not hold a whole number of records is rejected
+    std::FILE* file = std::fopen(records_path.c_str(), "wb");
+    assert(file);
+    const char bytes[sizeof(flow_record) + 1] = {};
+    assert(std::fwrite(bytes, 1, sizeof(bytes), file) == sizeof(bytes));
+    std::fclose(file);
+
+    bool threw = false;
+    try {
+        mapped_record_scanner<flow_record> scanner(records_path);
+    } catch(const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    std::remove(records_path.c_str());
+
+    threw = false;
+    try {
+        mapped_record_scanner<flow_record> scanner("no_such_file.bin");
+    } catch(const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+}
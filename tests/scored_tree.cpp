@@ -0,0 +1,154 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/scored_tree.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+struct listing {
+    int price;
+    int bedrooms;
+    bool has_garden;
+    std::string city;
+};
+
+void test_score();
+void test_top_k_matches_brute_force();
+void test_top_k_prunes();
+void test_top_k_ties();
+void test_scored_tree_errors();
+
+int main() {
+    test_score();
+    test_top_k_matches_brute_force();
+    test_top_k_prunes();
+    test_top_k_ties();
+    test_scored_tree_errors();
+
+    return EXIT_SUCCESS;
+}
+
+scored_expression_tree<listing> make_listing_scorer() {
+    std::vector<scored_term<listing>> terms;
+    terms.push_back(scored_term<listing> { expression_tree<listing> { make_expr(&listing::has_garden, op::equals, true) }, 1.0 });
+    terms.push_back(scored_term<listing> { expression_tree<listing> { make_expr(&listing::price, op::less_than, 300) }, 4.0 });
+    terms.push_back(scored_term<listing> { expression_tree<listing> { 
+        make_expr(&listing::bedrooms, op::greater_than, 2)->AND(make_expr(&listing::bedrooms, op::less_than, 5)) }, 2.5 });
+    terms.push_back(scored_term<listing> { expression_tree<listing> { make_expr(&listing::city, op::equals, std::string("Oslo")) }, 0.5 });
+    return scored_expression_tree<listing>(std::move(terms));
+}
+
+std::vector<listing> make_listings(std::size_t count) {
+    std::mt19937 rng(11);
+    std::vector<listing> listings;
+    for(std::size_t i = 0; i < count; ++i) {
+        listings.push_back(listing { static_cast<int>(rng() % 1000), static_cast<int>(rng() % 7), rng() % 3 == 0, 
+            rng() % 4 == 0 ? "Oslo" : "Bergen" });
+    }
+    return listings;
+}
+
+void test_score() {
+    const auto scorer = make_listing_scorer();
+    assert(scorer.term_count() == 4);
+    assert(scorer.max_score() == 8.0);
+
+    // terms are kept in descending order of weight
+    assert(scorer.term(0).weight == 4.0);
+    assert(scorer.term(3).weight == 0.5);
+
+    assert(scorer.score(listing { 250, 3, true, "Oslo" }) == 8.0);
+    assert(scorer.score(listing { 250, 1, false, "Bergen" }) == 4.0);
+    assert(scorer.score(listing { 900, 4, true, "Bergen" }) == 3.5);
+    assert(scorer.score(listing { 900, 0, false, "Bergen" }) == 0.0);
+}
+
+void test_top_k_matches_brute_force() {
+    const auto scorer = make_listing_scorer();
+    const auto listings = make_listings(500);
+
+    // the expected ranking: descending score, then ascending position
+    std::vector<std::size_t> order(listings.size());
+    for(std::size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return scorer.score(listings[a]) > scorer.score(listings[b]);
+    });
+
+    for(std::size_t k : { 1, 5, 20, 499, 500, 600 }) {
+        const auto matches = scorer.top_k(listings, k);
+        assert(matches.size() == std::min(k, listings.size()));
+        for(std::size_t i = 0; i < matches.size(); ++i) {
+            assert(matches[i].index == order[i]);
+            assert(matches[i].obj == &listings[order[i]]);
+            assert(matches[i].score == scorer.score(listings[order[i]]));
+        }
+    }
+
+    assert(scorer.top_k(listings, 0).empty());
+    assert(scorer.top_k(std::vector<listing>(), 5).empty());
+}
+
+void test_top_k_prunes() {
+    const auto scorer = make_listing_scorer();
+    const auto listings = make_listings(10000);
+
+    top_k_report report;
+    const auto matches = scorer.top_k(listings.begin(), listings.end(), 10, &report);
+    assert(matches.size() == 10);
+    assert(matches.front().score == scorer.max_score());
+
+    // once the top 10 all have the maximum score, no later candidate can enter it
+    assert(report.candidates == listings.size());
+    assert(report.pruned > listings.size() / 2);
+    assert(report.terms_evaluated + report.terms_skipped == listings.size() * scorer.term_count());
+    assert(report.terms_evaluated < listings.size() * scorer.term_count() / 2);
+}
+
+void test_top_k_ties() {
+    std::vector<scored_term<listing>> terms;
+    terms.push_back(scored_term<listing> { expression_tree<listing> { make_expr(&listing::has_garden, op::equals, true) }, 1.0 });
+    scored_expression_tree<listing> scorer(std::move(terms));
+
+    // equal scores keep the earliest objects
+    std::vector<listing> listings(6, listing { 0, 0, true, "" });
+    listings[1].has_garden = false;
+    const auto matches = scorer.top_k(listings, 3);
+    assert(matches.size() == 3);
+    assert(matches[0].index == 0);
+    assert(matches[1].index == 2);
+    assert(matches[2].index == 3);
+}
+
+void test_scored_tree_errors() {
+    std::vector<scored_term<listing>> terms;
+    terms.push_back(scored_term<listing> { expression_tree<listing> { make_expr(&listing::has_garden, op::equals, true) }, -1.0 });
+
+    bool invalid = false;
+    try {
+        scored_expression_tree<listing> scorer(std::move(terms));
+    } catch(std::invalid_argument& e) {
+        invalid = true;
+    }
+    assert(invalid);
+
+    const auto scorer = make_listing_scorer();
+    bool out_of_range = false;
+    try {
+        scorer.term(4);
+    } catch(std::out_of_range& e) {
+        out_of_range = true;
+    }
+    assert(out_of_range);
+
+    // a scorer with no terms scores every object zero
+    scored_expression_tree<listing> empty { std::vector<scored_term<listing>>() };
+    assert(empty.max_score() == 0);
+    assert(empty.top_k(make_listings(3), 2).size() == 2);
+}
@@ -0,0 +1,236 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/parser.hpp>
+#include <attwoodn/expression_tree/serialize.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <cstddef>
+#include <cstdio>
+
+using namespace attwoodn::expression_tree;
+
+void test_serialized_round_trip();
+void test_serialized_strings();
+void test_serialized_constants();
+void test_mapped_expression_tree();
+void test_serialize_errors();
+void test_load_errors();
+
+int main() {
+    test_serialized_round_trip();
+    test_serialized_strings();
+    test_serialized_constants();
+    test_mapped_expression_tree();
+    test_serialize_errors();
+    test_load_errors();
+
+    return EXIT_SUCCESS;
+}
+
+field_registry<my_type> make_my_type_registry() {
+    field_registry<my_type> registry;
+    registry.add("my_int", &my_type::my_int)
+            .add("my_bool", &my_type::my_bool)
+            .add("get_my_int", &my_type::get_my_int);
+    return registry;
+}
+
+void test_serialized_round_trip() {
+    auto registry = make_my_type_registry();
+
+    expression_tree<my_type> expr {
+        make_expr(&my_type::my_bool, op::equals, true)
+        ->OR((make_expr(&my_type::get_my_int, op::greater_than, 0)
+            ->AND(make_expr(&my_type::my_int, op::less_than, 10))
+            )
+        )
+    };
+
+    const std::string bytes = serialize(expr, registry);
+    serialized_expression_tree<my_type> serialized(bytes.data(), bytes.size(), registry);
+
+    my_type obj;
+    for(obj.my_int = -20; obj.my_int < 20; ++obj.my_int) {
+        obj.my_bool = true;
+        assert(serialized.evaluate(obj) == expr.evaluate(obj));
+        obj.my_bool = false;
+        assert(serialized.evaluate(obj) == expr.evaluate(obj));
+    }
+}
+
+void test_serialized_strings() {
+    field_registry<test_fixture> registry;
+    registry.add("some_string", &test_fixture::some_string)
+            .add("some_uint", &test_fixture::some_uint);
+
+    expression_tree<test_fixture> expr {
+        make_expr(&test_fixture::some_string, op::greater_than, std::string("a"))
+        ->AND(make_expr(&test_fixture::some_string, op::less_than, std::string("z")))
+        ->OR(make_expr(&test_fixture::some_string, op::equals, std::string("hello, world!"))
+            ->AND(make_expr(&test_fixture::some_uint, op::not_equals, (uint16_t) 500)))
+    };
+
+    const std::string bytes = serialize(expr, registry);
+    serialized_expression_tree<test_fixture> serialized(bytes.data(), bytes.size(), registry);
+
+    test_fixture fixture;
+    fixture.some_uint = 500;
+    for(auto str : { "", "a", "aa", "hello", "hello, world!", "z", "zz", "A", "Z", "hello, world" }) {
+        fixture.some_string = str;
+        assert(serialized.evaluate(fixture) == expr.evaluate(fixture));
+        fixture.some_uint = 1;
+        assert(serialized.evaluate(fixture) == expr.evaluate(fixture));
+        fixture.some_uint = 500;
+    }
+}
+
+void test_serialized_constants() {
+    auto registry = make_my_type_registry();
+
+    expression_tree<my_type> always {
+        new node::expression_tree_constant_node<my_type>(true)
+    };
+
+    const std::string bytes = serialize(always, registry);
+    assert(bytes.size() == sizeof(detail::serial_header));
+
+    serialized_expression_tree<my_type> serialized(bytes.data(), bytes.size(), registry);
+    assert(serialized.evaluate(my_type { 0, false }));
+}
+
+void test_mapped_expression_tree() {
+    auto registry = make_my_type_registry();
+
+    expression_tree<my_type> expr {
+        parse_expr(registry, "my_bool == true || (get_my_int() > 0 && my_int < 10)")
+    };
+
+    const std::string path = "serialize_test_mapped_expression_tree.bin";
+    serialize_to_file(path, expr, registry);
+
+    {
+        mapped_expression_tree<my_type> mapped(path, registry);
+        assert(mapped.evaluate(my_type { 4, false }));
+        assert(mapped.evaluate(my_type { 12, true }));
+        assert(!mapped.evaluate(my_type { 0, false }));
+        assert(!mapped.evaluate(my_type { 10, false }));
+    }
+
+    std::remove(path.c_str());
+}
+
+void test_serialize_errors() {
+    auto registry = make_my_type_registry();
+
+    auto throws = [&](const expression_tree<my_type>& expr) {
+        try {
+            serialize(expr, registry);
+        } catch(const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+
+    // user-defined operators cannot be serialized
+    auto is_even = [](int a, int) -> bool {
+        return a % 2 == 0;
+    };
+    assert(throws(expression_tree<my_type> { make_expr(&my_type::my_int, is_even, 0) }));
+
+    // members must be registered
+    field_registry<my_type> partial;
+    partial.add("my_int", &my_type::my_int);
+
+    bool threw = false;
+    try {
+        serialize(expression_tree<my_type> { make_expr(&my_type::my_bool, op::equals, true) }, partial);
+    } catch(const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void test_load_errors() {
+    auto registry = make_my_type_registry();
+
+    expression_tree<my_type> expr {
+        make_expr(&my_type::my_int, op::equals, 5)
+    };
+    const std::string bytes = serialize(expr, registry);
+
+    auto load_fails = [&](std::string corrupted, const field_registry<my_type>& with) {
+        try {
+            serialized_expression_tree<my_type>(corrupted.data(), corrupted.size(), with);
+        } catch(const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+
+    assert(!load_fails(bytes, registry));
+
+    // truncated
+    assert(load_fails(bytes.substr(0, bytes.size() - 1), registry));
+
+    // bad magic
+    {
+        std::string corrupted = bytes;
+        corrupted[0] = 'X';
+        assert(load_fails(corrupted, registry));
+    }
+
+    // unsupported version
+    {
+        std::string corrupted = bytes;
+        corrupted[4] = 99;
+        assert(load_fails(corrupted, registry));
+    }
+
+    // registry whose field 0 has a different type
+    {
+        field_registry<my_type> mismatched;
+        mismatched.add("my_bool", &my_type::my_bool);
+        assert(load_fails(bytes, mismatched));
+    }
+
+    // registry whose fields have the same types, in another order
+    {
+        field_registry<my_type> reordered;
+        reordered.add("get_my_int", &my_type::get_my_int)
+                 .add("my_bool", &my_type::my_bool)
+                 .add("my_int", &my_type::my_int);
+        assert(load_fails(bytes, reordered));
+    }
+
+    // registry with a differently named field at the same id
+    {
+        field_registry<my_type> renamed;
+        renamed.add("my_integer", &my_type::my_int);
+        assert(load_fails(bytes, renamed));
+    }
+
+    // fields that the tree does not read may be added, or differ
+    {
+        field_registry<my_type> extended;
+        extended.add("my_int", &my_type::my_int)
+                .add("get_my_int", &my_type::get_my_int)
+                .add("my_bool", &my_type::my_bool);
+        assert(!load_fails(bytes, extended));
+    }
+
+    // corrupted field names hash
+    {
+        std::string corrupted = bytes;
+        corrupted[offsetof(detail::serial_header, field_names_hash)] ^= 1;
+        assert(load_fails(corrupted, registry));
+    }
+
+    // backwards jump
+    {
+        std::string corrupted = bytes;
+        detail::serial_branch b;
+        std::memcpy(&b, &corrupted[sizeof(detail::serial_header)], sizeof(b));
+        b.on_true = 0;
+        std::memcpy(&corrupted[sizeof(detail::serial_header)], &b, sizeof(b));
+        assert(load_fails(corrupted, registry));
+    }
+}
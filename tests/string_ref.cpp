@@ -0,0 +1,343 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/canonical.hpp>
+#include <attwoodn/expression_tree/dictionary.hpp>
+#include <attwoodn/expression_tree/flat_tree.hpp>
+#include <attwoodn/expression_tree/serialize.hpp>
+#include <attwoodn/expression_tree/zone_map.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+using namespace attwoodn::expression_tree;
+
+struct user {
+    std::string name;
+    const char* nickname;
+    int age;
+
+    std::string get_name() const {
+        return name;
+    }
+
+    const std::string& get_name_ref() const {
+        return name;
+    }
+};
+
+void test_string_ref();
+void test_operators();
+void test_literal_leaves();
+void test_member_function_leaves();
+void test_c_string_members();
+void test_string_view();
+void test_flat_and_serialized_trees();
+void test_canonical_forms();
+void test_zone_maps_and_dictionaries();
+
+int main() {
+    test_string_ref();
+    test_operators();
+    test_literal_leaves();
+    test_member_function_leaves();
+    test_c_string_members();
+    test_string_view();
+    test_flat_and_serialized_trees();
+    test_canonical_forms();
+    test_zone_maps_and_dictionaries();
+
+    return EXIT_SUCCESS;
+}
+
+std::vector<user> make_users() {
+    static const char* nicknames[] = { "Jimmy", "Jim", nullptr, "Al" };
+    const char* names[] = { "Jim", "Jimmy", "Alice", "Bob", "" };
+
+    std::vector<user> users;
+    for(int i = 0; i < 200; ++i) {
+        users.push_back(user { names[i % 5], nicknames[i % 4], 18 + i % 50 });
+    }
+    return users;
+}
+
+void test_string_ref() {
+    const std::string jim = "Jim";
+    const string_ref from_literal = "Jim";
+    const string_ref from_string = jim;
+    const string_ref null_ref;
+    const string_ref from_null = static_cast<const char*>(nullptr);
+
+    assert(from_literal.size() == 3);
+    assert(from_string.data() == jim.data());
+    assert(!from_literal.is_null());
+    assert(null_ref.is_null() && null_ref.size() == 0);
+    assert(from_null.is_null());
+
+    assert(from_literal == from_string);
+    assert(from_literal.compare(from_string) == 0);
+    assert(string_ref("Jim") < string_ref("Jimmy"));
+    assert(string_ref("Jimmy") > string_ref("Jim"));
+    assert(string_ref("Bob") < string_ref("Jim"));
+    assert(string_ref("Jim") != string_ref("Jin"));
+
+    // characters are compared as unsigned, as std::string does, and embedded null characters are compared
+    assert(string_ref("\xff") > string_ref("a"));
+    assert(string_ref("a\0b", 3) != string_ref("a\0c", 3));
+    assert(string_ref("a\0b", 3) == std::string("a\0b", 3));
+
+    // the comparison operators of string_ref treat null as empty
+    assert(null_ref == string_ref(""));
+
+    assert(std::hash<string_ref>()(from_literal) == std::hash<string_ref>()(from_string));
+    assert(std::hash<string_ref>()(from_literal) != std::hash<string_ref>()(string_ref("Jin")));
+}
+
+void test_operators() {
+    const std::string jim = "Jim";
+    const char* jimmy = "Jimmy";
+
+    assert(op::equals(jim, "Jim"));
+    assert(op::equals(jim, string_ref("Jim")));
+    assert(!op::equals(jim, jimmy));
+    assert(op::not_equals(jim, jimmy));
+    assert(op::less_than(jim, jimmy));
+    assert(op::greater_than(string_ref(jimmy), jim));
+
+    // std::string comparisons are unchanged
+    assert(op::equals(jim, std::string("Jim")));
+    assert(op::less_than(std::string("Bob"), jim));
+
+    // null strings follow the rules of the pointer overloads
+    const string_ref null_ref;
+    assert(op::equals(null_ref, null_ref));
+    assert(!op::not_equals(null_ref, null_ref));
+    assert(!op::equals(std::string(), null_ref));
+    assert(op::not_equals(std::string(), null_ref));
+    assert(!op::less_than(std::string(), null_ref));
+    assert(!op::less_than(null_ref, std::string()));
+    assert(!op::greater_than(jim, null_ref));
+    assert(!op::greater_than(null_ref, jim));
+
+    // the pointer overloads still compare the first characters
+    char a = 'a';
+    char b = 'b';
+    assert(op::less_than(&a, &b));
+}
+
+void test_literal_leaves() {
+    const auto users = make_users();
+
+    std::unique_ptr<node::expression_tree_leaf_node_base<user>> literal_leaf(make_expr(&user::name, op::equals, "Jim"));
+    assert(literal_leaf->comp_value_type() == typeid(string_ref));
+    assert(literal_leaf->get_comparator() == comparator::equals);
+
+    // a std::string comparison value is still copied into the leaf
+    std::unique_ptr<node::expression_tree_leaf_node_base<user>> string_leaf(make_expr(&user::name, op::equals, std::string("Jim")));
+    assert(string_leaf->comp_value_type() == typeid(std::string));
+
+    const std::string bob = "Bob";
+    std::unique_ptr<node::expression_tree_leaf_node_base<user>> lvalue_leaf(make_expr(&user::name, op::equals, bob));
+    assert(lvalue_leaf->comp_value_type() == typeid(std::string));
+
+    std::unique_ptr<node::expression_tree_leaf_node_base<user>> ref_leaf(make_expr(&user::name, op::equals, string_ref(bob)));
+    assert(ref_leaf->comp_value_type() == typeid(string_ref));
+    assert(*static_cast<const string_ref*>(ref_leaf->comp_value_ptr())->data() == bob[0]);
+
+    for(auto& u : users) {
+        assert(literal_leaf->evaluate(u) == (u.name == "Jim"));
+        assert(literal_leaf->evaluate(u) == string_leaf->evaluate(u));
+        assert(ref_leaf->evaluate(u) == lvalue_leaf->evaluate(u));
+    }
+
+    expression_tree<user> expr {
+        make_expr(&user::name, op::greater_than, "Bob")
+        ->AND(make_expr(&user::name, op::less_than, "Jimmy"))
+        ->AND(make_expr(&user::name, op::not_equals, "Alice"))
+    };
+    for(auto& u : users) {
+        assert(expr.evaluate(u) == (u.name == "Jim"));
+    }
+
+    // an empty literal is not null
+    expression_tree<user> empty { make_expr(&user::name, op::equals, "") };
+    assert(empty.evaluate(users[4]));
+    assert(!empty.evaluate(users[0]));
+
+    // no name equals a null string, and no name is ordered against it
+    const char* null_name = nullptr;
+    expression_tree<user> null_equals { make_expr(&user::name, op::equals, null_name) };
+    expression_tree<user> null_not_equals { make_expr(&user::name, op::not_equals, null_name) };
+    expression_tree<user> null_less { make_expr(&user::name, op::less_than, null_name) };
+    for(auto& u : users) {
+        assert(!null_equals.evaluate(u));
+        assert(null_not_equals.evaluate(u));
+        assert(!null_less.evaluate(u));
+    }
+}
+
+void test_member_function_leaves() {
+    const auto users = make_users();
+
+    expression_tree<user> by_value { make_expr(&user::get_name, op::equals, "Jimmy") };
+    expression_tree<user> by_ref { make_expr(&user::get_name_ref, op::equals, "Jimmy") };
+    expression_tree<user> by_string { make_expr(&user::get_name, op::equals, std::string("Jimmy")) };
+
+    std::size_t matches = 0;
+    for(auto& u : users) {
+        assert(by_value.evaluate(u) == (u.name == "Jimmy"));
+        assert(by_ref.evaluate(u) == by_value.evaluate(u));
+        assert(by_string.evaluate(u) == by_value.evaluate(u));
+        matches += by_value.evaluate(u);
+    }
+    assert(matches == 40);
+
+    auto* leaf = make_expr(&user::get_name_ref, op::less_than, string_ref("Bob"));
+    assert(leaf->comp_value_type() == typeid(string_ref));
+    assert(leaf->evaluate(users[2]));
+    assert(!leaf->evaluate(users[0]));
+    delete leaf;
+}
+
+void test_c_string_members() {
+    const auto users = make_users();
+
+    // a string_ref comparison value compares every character of a C string member
+    expression_tree<user> nickname_is_jim { make_expr(&user::nickname, op::equals, string_ref("Jim")) };
+    expression_tree<user> nickname_is_not_jim { make_expr(&user::nickname, op::not_equals, string_ref("Jim")) };
+    expression_tree<user> nickname_before_j { make_expr(&user::nickname, op::less_than, string_ref("J")) };
+
+    for(auto& u : users) {
+        const bool is_jim = u.nickname && std::string(u.nickname) == "Jim";
+        assert(nickname_is_jim.evaluate(u) == is_jim);
+        assert(nickname_is_not_jim.evaluate(u) == !is_jim);
+        assert(nickname_before_j.evaluate(u) == (u.nickname && std::string(u.nickname) < "J"));
+    }
+
+    // a null member is only equal to a null string_ref
+    const user nameless { "", nullptr, 0 };
+    assert(!nickname_is_jim.evaluate(nameless));
+    assert(nickname_is_not_jim.evaluate(nameless));
+    assert(!nickname_before_j.evaluate(nameless));
+
+    expression_tree<user> nickname_is_null { make_expr(&user::nickname, op::equals, string_ref()) };
+    assert(nickname_is_null.evaluate(nameless));
+    assert(!nickname_is_null.evaluate(users[0]));
+
+    // a pointer comparison value still compares the first characters
+    const char* jo = "Jo";
+    expression_tree<user> first_char { make_expr(&user::nickname, op::equals, jo) };
+    assert(first_char.evaluate(users[0]));
+}
+
+void test_string_view() {
+#if __cplusplus >= 201703L
+    const auto users = make_users();
+    const std::string_view alice = "Alice and Bob";
+
+    expression_tree<user> expr { make_expr(&user::name, op::equals, alice.substr(0, 5)) };
+    std::size_t matches = 0;
+    for(auto& u : users) {
+        matches += expr.evaluate(u);
+    }
+    assert(matches == 40);
+    assert(op::equals(std::string("Bob"), alice.substr(10)));
+#endif
+}
+
+void test_flat_and_serialized_trees() {
+    const auto users = make_users();
+
+    const expression_tree<user> expr {
+        make_expr(&user::name, op::equals, "Jim")
+        ->OR(make_expr(&user::get_name, op::greater_than, "Bob")->AND(make_expr(&user::age, op::less_than, 30)))
+        ->OR(make_expr(&user::name, op::equals, static_cast<const char*>(nullptr)))
+    };
+
+    // null comparison values follow the null rules of the built-in operators, so only they are kept as generic leaves
+    const flat_expression_tree<user> flat(expr);
+    assert(flat.generic_leaf_count() == 1);
+
+    field_registry<user> registry;
+    registry.add("name", &user::name)
+            .add("age", &user::age);
+
+    const expression_tree<user> parsable {
+        make_expr(&user::name, op::equals, "Jim")->OR(make_expr(&user::name, op::less_than, "Bob"))
+    };
+    const std::string bytes = serialize(parsable, registry);
+    const serialized_expression_tree<user> serialized(bytes.data(), bytes.size(), registry);
+
+    for(auto& u : users) {
+        assert(flat.evaluate(u) == expr.evaluate(u));
+        assert(serialized.evaluate(u) == parsable.evaluate(u));
+    }
+
+    bool threw = false;
+    try {
+        serialize(expression_tree<user> { make_expr(&user::name, op::equals, string_ref()) }, registry);
+    } catch(const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void test_canonical_forms() {
+    const std::string jim = "Jim";
+    const std::string other_jim = "Jim";
+
+    // leaves are equivalent if their strings have the same characters, wherever the characters are stored
+    const expression_tree<user> a { make_expr(&user::name, op::equals, string_ref(jim))->AND(make_expr(&user::age, op::less_than, 30)) };
+    const expression_tree<user> b { make_expr(&user::age, op::less_than, 30)->AND(make_expr(&user::name, op::equals, string_ref(other_jim))) };
+    const expression_tree<user> c { make_expr(&user::age, op::less_than, 30)->AND(make_expr(&user::name, op::equals, "Jin")) };
+
+    assert(structural_hash(a) == structural_hash(b));
+    assert(structurally_equal(a, b));
+    assert(!structurally_equal(a, c));
+}
+
+void test_zone_maps_and_dictionaries() {
+    // sorted by name, so that zones can skip blocks
+    std::vector<user> users = make_users();
+    std::sort(users.begin(), users.end(), [](const user& a, const user& b) { return a.name < b.name; });
+
+    zone_map<user> zones(users.data(), users.size(), 20);
+    zones.track(&user::name);
+
+    dictionary_encoding<user> encoding(users.data(), users.size());
+    encoding.encode(&user::name);
+
+    const std::vector<expression_tree<user>> trees {
+        expression_tree<user> { make_expr(&user::name, op::equals, "Jim") },
+        expression_tree<user> { make_expr(&user::name, op::not_equals, "Jim")->AND(make_expr(&user::name, op::not_equals, "Bob")) },
+        expression_tree<user> { make_expr(&user::name, op::less_than, "Bob") },
+        expression_tree<user> { make_expr(&user::name, op::equals, static_cast<const char*>(nullptr)) },
+        expression_tree<user> { make_expr(&user::name, op::not_equals, static_cast<const char*>(nullptr)) }
+    };
+
+    // only equals and not_equals are compiled into comparisons of ids
+    const std::size_t encoded_leaves[] = { 1, 2, 0, 1, 1 };
+
+    for(std::size_t i = 0; i < trees.size(); ++i) {
+        const expression_tree<user>& expr = trees[i];
+        std::size_t expected = 0;
+        for(auto& u : users) {
+            expected += expr.evaluate(u);
+        }
+
+        zone_scan_report report;
+        assert(zones.count(expr, &report) == expected);
+        assert(report.objects_evaluated < users.size());
+
+        const encoded_expression_tree<user> encoded(expr, encoding);
+        assert(encoded.encoded_leaf_count() == encoded_leaves[i]);
+        assert(encoded.count() == expected);
+    }
+}
@@ -0,0 +1,211 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/flat_tree.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <stdexcept>
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+struct alarm_state {
+    int temperature;
+    int pressure;
+    int humidity;
+    bool door_open;
+};
+
+/**
+ * Compares like op::greater_than, while counting how many comparisons are made.
+*/
+struct counting_greater_than {
+    static int calls;
+
+    bool operator()(const int& a, const int& b) const {
+        ++calls;
+        return a > b;
+    }
+};
+
+int counting_greater_than::calls = 0;
+
+void test_k_of_n();
+void test_early_stop();
+void test_weighted_threshold();
+void test_combined_with_op_nodes();
+void test_threshold_errors();
+void test_threshold_inspection();
+
+int main() {
+    test_k_of_n();
+    test_early_stop();
+    test_weighted_threshold();
+    test_combined_with_op_nodes();
+    test_threshold_errors();
+    test_threshold_inspection();
+
+    return EXIT_SUCCESS;
+}
+
+std::vector<alarm_state> make_states() {
+    std::vector<alarm_state> states;
+    for(int bits = 0; bits < 16; ++bits) {
+        states.push_back(alarm_state { (bits & 1) ? 90 : 20, (bits & 2) ? 5 : 1, (bits & 4) ? 80 : 30, (bits & 8) != 0 });
+    }
+    return states;
+}
+
+int count_alarms(const alarm_state& s) {
+    return (s.temperature > 50) + (s.pressure > 3) + (s.humidity > 60) + s.door_open;
+}
+
+node::expression_tree_threshold_node<alarm_state>* make_alarm_threshold(std::size_t k) {
+    return make_threshold(k,
+        make_expr(&alarm_state::temperature, op::greater_than, 50),
+        make_expr(&alarm_state::pressure, op::greater_than, 3),
+        make_expr(&alarm_state::humidity, op::greater_than, 60),
+        make_expr(&alarm_state::door_open, op::equals, true));
+}
+
+void test_k_of_n() {
+    for(std::size_t k = 0; k <= 5; ++k) {
+        expression_tree<alarm_state> expr { make_alarm_threshold(k) };
+        expression_tree<alarm_state> copy(expr);
+        flat_expression_tree<alarm_state> flat(expr);
+
+        for(auto& s : make_states()) {
+            const bool expected = count_alarms(s) >= static_cast<int>(k);
+            assert(expr.evaluate(s) == expected);
+            assert(copy.evaluate(s) == expected);
+            assert(flat.evaluate(s) == expected);
+        }
+    }
+
+    // the children may also be given as a vector
+    std::vector<node::expression_tree_node<alarm_state>*> children {
+        make_expr(&alarm_state::temperature, op::greater_than, 50),
+        make_expr(&alarm_state::door_open, op::equals, true)
+    };
+    expression_tree<alarm_state> both { make_threshold(2, children) };
+    assert(both.evaluate(alarm_state { 90, 0, 0, true }));
+    assert(!both.evaluate(alarm_state { 90, 0, 0, false }));
+}
+
+void test_early_stop() {
+    auto make_counting_tree = [](std::size_t k) {
+        return expression_tree<alarm_state> { make_threshold(k,
+            make_expr(&alarm_state::temperature, counting_greater_than(), 50),
+            make_expr(&alarm_state::pressure, counting_greater_than(), 3),
+            make_expr(&alarm_state::humidity, counting_greater_than(), 60),
+            make_expr(&alarm_state::temperature, counting_greater_than(), 100)) };
+    };
+
+    // stops as soon as k children are true
+    const auto two_of_four = make_counting_tree(2);
+    counting_greater_than::calls = 0;
+    assert(two_of_four.evaluate(alarm_state { 90, 5, 0, false }));
+    assert(counting_greater_than::calls == 2);
+
+    // stops as soon as k can no longer be reached
+    counting_greater_than::calls = 0;
+    assert(!two_of_four.evaluate(alarm_state { 20, 1, 0, false }));
+    assert(counting_greater_than::calls == 3);
+
+    const auto four_of_four = make_counting_tree(4);
+    counting_greater_than::calls = 0;
+    assert(!four_of_four.evaluate(alarm_state { 20, 5, 80, false }));
+    assert(counting_greater_than::calls == 1);
+
+    // a threshold that is always or never reached evaluates no children
+    counting_greater_than::calls = 0;
+    assert(make_counting_tree(0).evaluate(alarm_state { 20, 1, 0, false }));
+    assert(!make_counting_tree(5).evaluate(alarm_state { 90, 5, 80, false }));
+    assert(counting_greater_than::calls == 0);
+}
+
+void test_weighted_threshold() {
+    // temperature counts twice as much as the other conditions
+    expression_tree<alarm_state> expr { make_threshold(2.5, std::vector<node::expression_tree_node<alarm_state>*> {
+        make_expr(&alarm_state::temperature, op::greater_than, 50),
+        make_expr(&alarm_state::pressure, op::greater_than, 3),
+        make_expr(&alarm_state::humidity, op::greater_than, 60),
+        make_expr(&alarm_state::door_open, op::equals, true)
+    }, std::vector<double> { 2.0, 1.0, 0.5, 0.5 }) };
+
+    for(auto& s : make_states()) {
+        const double weight = (s.temperature > 50) * 2.0 + (s.pressure > 3) * 1.0 + (s.humidity > 60) * 0.5 + s.door_open * 0.5;
+        assert(expr.evaluate(s) == (weight >= 2.5));
+    }
+}
+
+void test_combined_with_op_nodes() {
+    // (2 of 4 alarms AND the door is open) OR the temperature is extreme
+    expression_tree<alarm_state> expr {
+        make_expr(&alarm_state::temperature, op::greater_than, 100)
+        ->OR(make_alarm_threshold(2)->AND(make_expr(&alarm_state::door_open, op::equals, true)))
+    };
+
+    for(auto& s : make_states()) {
+        assert(expr.evaluate(s) == (s.temperature > 100 || (count_alarms(s) >= 2 && s.door_open)));
+    }
+    assert(expr.evaluate(alarm_state { 120, 0, 0, false }));
+
+    // threshold nodes may be children of threshold nodes
+    expression_tree<alarm_state> nested { make_threshold(1, make_alarm_threshold(4), make_alarm_threshold(2)->OR(make_alarm_threshold(3))) };
+    for(auto& s : make_states()) {
+        assert(nested.evaluate(s) == (count_alarms(s) >= 2));
+    }
+}
+
+void test_threshold_errors() {
+    auto throws_invalid_argument = [](std::vector<node::expression_tree_node<alarm_state>*> children, std::vector<double> weights) {
+        try {
+            make_threshold(1.0, children, weights);
+        } catch(std::invalid_argument& e) {
+            return true;
+        }
+        return false;
+    };
+
+    // the children are deleted when the node cannot be constructed, so that they do not leak
+    assert(throws_invalid_argument({ make_expr(&alarm_state::pressure, op::equals, 1), nullptr }, { 1.0, 1.0 }));
+    assert(throws_invalid_argument({ make_expr(&alarm_state::pressure, op::equals, 1) }, { 1.0, 1.0 }));
+    assert(throws_invalid_argument({ make_expr(&alarm_state::pressure, op::equals, 1) }, { -1.0 }));
+
+    expression_tree<alarm_state> empty { make_threshold(0, std::vector<node::expression_tree_node<alarm_state>*> {}) };
+    assert(empty.evaluate(alarm_state { 0, 0, 0, false }));
+}
+
+void test_threshold_inspection() {
+    auto* threshold = make_threshold(2,
+        make_expr(&alarm_state::temperature, op::greater_than, 50),
+        make_expr(&alarm_state::pressure, op::greater_than, 3)->AND(make_expr(&alarm_state::humidity, op::greater_than, 60)));
+    assert(threshold->get_threshold() == 2.0);
+    assert(threshold->child_count() == 2);
+    assert(threshold->get_weight(1) == 1.0);
+    assert(threshold->get_child(0) != nullptr);
+
+    bool out_of_range = false;
+    try {
+        threshold->get_child(2);
+    } catch(std::out_of_range& e) {
+        out_of_range = true;
+    }
+    assert(out_of_range);
+
+    // the leaves under a threshold node are reported like any other leaves
+    expression_tree<alarm_state> expr { threshold };
+    auto access = expr.accessed_members();
+    assert(access.accessors().size() == 3);
+    assert(!access.has_opaque_nodes());
+    assert(access.can_skip(&alarm_state::door_open));
+    assert(!access.can_skip(&alarm_state::humidity));
+
+    // the known children of a threshold node decide it when the unknown children cannot change its result
+    const std::vector<accessor_id> temperature { accessor_of(&alarm_state::temperature) };
+    assert(expr.evaluate_partial(alarm_state { 20, 5, 80, false }, temperature) == partial_result::false_value);
+    assert(expr.evaluate_partial(alarm_state { 90, 5, 80, false }, temperature) == partial_result::unknown);
+
+    const std::vector<accessor_id> all { accessor_of(&alarm_state::temperature), accessor_of(&alarm_state::pressure),
+        accessor_of(&alarm_state::humidity) };
+    assert(expr.evaluate_partial(alarm_state { 90, 5, 80, false }, all) == partial_result::true_value);
+}
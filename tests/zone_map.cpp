@@ -0,0 +1,310 @@
+#include <attwoodn/expression_tree.hpp>
+#include <attwoodn/expression_tree/zone_map.hpp>
+#include "test_utils.hpp"
+#include "release_asserts.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace attwoodn::expression_tree;
+
+struct reading {
+    int time;
+    double value;
+    std::string sensor;
+    const int* channel;
+    bool valid;
+
+    int get_hour() const {
+        if(time < 0) {
+            throw std::runtime_error("negative time");
+        }
+        return time / 60;
+    }
+};
+
+const int channels[] = { 0, 1, 2, 3 };
+
+void test_sorted_scan();
+void test_matches_evaluate();
+void test_null_pointers();
+void test_incomplete_blocks();
+void test_nan_comparison_value();
+void test_block_statistics();
+
+int main() {
+    test_sorted_scan();
+    test_matches_evaluate();
+    test_null_pointers();
+    test_incomplete_blocks();
+    test_nan_comparison_value();
+    test_block_statistics();
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Makes time-ordered readings, whose values and channels cycle, and whose sensor names change every 500 readings.
+*/
+std::vector<reading> make_readings(std::size_t count) {
+    std::vector<reading> readings;
+    for(std::size_t i = 0; i < count; ++i) {
+        const int t = static_cast<int>(i);
+        readings.push_back(reading { t, (t % 17) * 0.5, "sensor_" + std::to_string(t / 500), 
+            t % 5 == 0 ? nullptr : &channels[t % 4], t % 3 != 0 });
+    }
+    return readings;
+}
+
+std::size_t count_by_evaluate(const expression_tree<reading>& tree, const std::vector<reading>& readings) {
+    std::size_t matches = 0;
+    for(auto& r : readings) {
+        matches += tree.evaluate(r);
+    }
+    return matches;
+}
+
+void test_sorted_scan() {
+    const auto readings = make_readings(10000);
+    zone_map<reading> zones(readings.data(), readings.size(), 100);
+    zones.track(&reading::time);
+    assert(zones.block_count() == 100);
+
+    zone_scan_report report;
+    expression_tree<reading> recent { make_expr(&reading::time, op::less_than, 250) };
+    assert(zones.count(recent, &report) == 250);
+    assert(report.blocks == 100);
+    assert(report.blocks_accepted == 2);
+    assert(report.blocks_skipped == 97);
+    assert(report.objects_evaluated == 100);
+
+    // members that are not tracked are evaluated for each object of the blocks that the tracked members cannot decide
+    expression_tree<reading> valid_window { 
+        make_expr(&reading::time, op::greater_than, 1000)
+        ->AND(make_expr(&reading::time, op::less_than, 2000))
+        ->AND(make_expr(&reading::valid, op::equals, true)) 
+    };
+    assert(zones.count(valid_window, &report) == count_by_evaluate(valid_window, readings));
+    assert(report.blocks_skipped == 90);
+    assert(report.blocks_accepted == 0);
+    assert(report.objects_evaluated == 1000);
+
+    std::vector<std::size_t> matches;
+    zones.for_each_match(recent, [&matches](std::size_t index) { matches.push_back(index); });
+    assert(matches.size() == 250);
+    for(std::size_t i = 0; i < matches.size(); ++i) {
+        assert(matches[i] == i);
+    }
+
+    // a partial last block
+    zone_map<reading> uneven(readings.data(), 1050, 100);
+    uneven.track(&reading::time);
+    assert(uneven.block_count() == 11);
+    expression_tree<reading> late { make_expr(&reading::time, op::greater_than, 1020) };
+    assert(uneven.count(late, &report) == 29);
+    assert(report.blocks_skipped == 10);
+    assert(report.blocks_accepted == 0);
+}
+
+void test_matches_evaluate() {
+    const auto readings = make_readings(3000);
+    zone_map<reading> zones(readings.data(), readings.size(), 64);
+    zones.track(&reading::time)
+         .track(&reading::value)
+         .track(&reading::sensor)
+         .track(&reading::channel)
+         .track(&reading::get_hour);
+
+    std::vector<std::function<node::expression_tree_node<reading>*()>> leaves {
+        []() { return make_expr(&reading::time, op::less_than, 700); },
+        []() { return make_expr(&reading::time, op::greater_than, 2100); },
+        []() { return make_expr(&reading::time, op::equals, 1500); },
+        []() { return make_expr(&reading::time, op::not_equals, 1500); },
+        []() { return make_expr(&reading::value, op::greater_than, 7.5); },
+        []() { return make_expr(&reading::value, op::less_than, 0.5); },
+        []() { return make_expr(&reading::sensor, op::equals, std::string("sensor_3")); },
+        []() { return make_expr(&reading::sensor, op::not_equals, std::string("sensor_1")); },
+        []() { return make_expr(&reading::channel, op::equals, &channels[2]); },
+        []() { return make_expr(&reading::get_hour, op::equals, 20); },
+        []() { return make_expr(&reading::get_hour, op::greater_than, 40); },
+        []() { return make_expr(&reading::valid, op::equals, false); },
+        []() { return make_expr(&reading::time, [](int a, int b) { return a % b == 0; }, 7); }
+    };
+
+    std::srand(48);
+    auto random_tree = [&](auto& self, int depth) -> node::expression_tree_node<reading>* {
+        if(depth == 0 || std::rand() % 3 == 0) {
+            return leaves[std::rand() % leaves.size()]();
+        }
+        if(std::rand() % 5 == 0) {
+            return make_threshold(static_cast<std::size_t>(std::rand() % 3), std::vector<node::expression_tree_node<reading>*> {
+                self(self, depth - 1), self(self, depth - 1), self(self, depth - 1) });
+        }
+        auto* op_node = new node::expression_tree_dynamic_op_node<reading>(std::rand() % 2 ? node::boolean_op::AND : node::boolean_op::OR);
+        op_node->set_left(self(self, depth - 1));
+        op_node->set_right(self(self, depth - 1));
+        return op_node;
+    };
+
+    std::size_t decided = 0;
+    for(int i = 0; i < 200; ++i) {
+        expression_tree<reading> tree { random_tree(random_tree, 4) };
+
+        zone_scan_report report;
+        std::vector<std::size_t> matches;
+        zones.for_each_match(tree, [&matches](std::size_t index) { matches.push_back(index); }, &report);
+
+        std::vector<std::size_t> expected;
+        for(std::size_t j = 0; j < readings.size(); ++j) {
+            if(tree.evaluate(readings[j])) {
+                expected.push_back(j);
+            }
+        }
+        assert(matches == expected);
+        decided += report.blocks_skipped + report.blocks_accepted;
+
+        // a decided block agrees with every one of its objects
+        for(std::size_t block = 0; block < zones.block_count(); ++block) {
+            const partial_result result = zones.check_block(tree, block);
+            if(result == partial_result::unknown) {
+                continue;
+            }
+            for(std::size_t j = block * 64; j < readings.size() && j < (block + 1) * 64; ++j) {
+                assert(tree.evaluate(readings[j]) == (result == partial_result::true_value));
+            }
+        }
+    }
+    assert(decided > 0);
+}
+
+void test_null_pointers() {
+    std::vector<reading> readings(8, reading { 0, 0, "", nullptr, true });
+    for(std::size_t i = 4; i < 8; ++i) {
+        readings[i].channel = &channels[1];
+    }
+
+    // the first block only holds null pointers, and the second block holds none
+    zone_map<reading> zones(readings.data(), readings.size(), 4);
+    zones.track(&reading::channel);
+    assert(zones.zone(&reading::channel, 0).null_count == 4);
+    assert(zones.zone(&reading::channel, 0).count == 0);
+    assert(zones.zone(&reading::channel, 1).null_count == 0);
+    assert(zones.zone(&reading::channel, 1).min == 1);
+
+    const int* no_channel = nullptr;
+    expression_tree<reading> is_null { make_expr(&reading::channel, op::equals, no_channel) };
+    expression_tree<reading> is_one { make_expr(&reading::channel, op::equals, &channels[1]) };
+    expression_tree<reading> not_one { make_expr(&reading::channel, op::not_equals, &channels[1]) };
+    expression_tree<reading> below_two { make_expr(&reading::channel, op::less_than, &channels[2]) };
+
+    assert(zones.check_block(is_null, 0) == partial_result::true_value);
+    assert(zones.check_block(is_null, 1) == partial_result::false_value);
+    assert(zones.check_block(is_one, 0) == partial_result::false_value);
+    assert(zones.check_block(is_one, 1) == partial_result::true_value);
+    assert(zones.check_block(not_one, 0) == partial_result::true_value);
+    assert(zones.check_block(not_one, 1) == partial_result::false_value);
+    assert(zones.check_block(below_two, 0) == partial_result::false_value);
+    assert(zones.check_block(below_two, 1) == partial_result::true_value);
+
+    // a block with some null pointers cannot be accepted by a comparison that null pointers fail
+    readings[5].channel = nullptr;
+    zone_map<reading> mixed(readings.data(), readings.size(), 4);
+    mixed.track(&reading::channel);
+    assert(mixed.zone(&reading::channel, 1).null_count == 1);
+    assert(mixed.check_block(is_one, 1) == partial_result::unknown);
+    assert(mixed.check_block(below_two, 1) == partial_result::unknown);
+    assert(mixed.count(is_one) == 3);
+}
+
+void test_incomplete_blocks() {
+    auto readings = make_readings(40);
+    readings[3].value = std::numeric_limits<double>::quiet_NaN();
+    readings[25].time = -1;
+
+    zone_map<reading> zones(readings.data(), readings.size(), 10);
+    zones.track(&reading::value).track(&reading::get_hour);
+
+    // NaN values cannot be ordered, and member functions that throw cannot be read, so their blocks are never decided
+    assert(!zones.zone(&reading::value, 0).complete);
+    assert(zones.zone(&reading::value, 1).complete);
+    assert(!zones.zone(&reading::get_hour, 2).complete);
+
+    expression_tree<reading> low { make_expr(&reading::value, op::less_than, -1.0) };
+    assert(zones.check_block(low, 0) == partial_result::unknown);
+    assert(zones.check_block(low, 1) == partial_result::false_value);
+    assert(zones.count(low) == 0);
+
+    expression_tree<reading> first_hour { make_expr(&reading::get_hour, op::equals, 0) };
+    assert(zones.check_block(first_hour, 1) == partial_result::true_value);
+    assert(zones.check_block(first_hour, 2) == partial_result::unknown);
+    assert(zones.count(first_hour) == count_by_evaluate(first_hour, readings));
+}
+
+void test_nan_comparison_value() {
+    std::vector<reading> readings(4, reading { 0, 1.0, "", &channels[1], true });
+    zone_map<reading> zones(readings.data(), readings.size(), 4);
+    zones.track(&reading::value);
+
+    // every value differs from NaN, and none is equal to, less than or greater than it
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    expression_tree<reading> is_nan { make_expr(&reading::value, op::equals, nan) };
+    expression_tree<reading> not_nan { make_expr(&reading::value, op::not_equals, nan) };
+    expression_tree<reading> below_nan { make_expr(&reading::value, op::less_than, nan) };
+    expression_tree<reading> above_nan { make_expr(&reading::value, op::greater_than, nan) };
+
+    assert(zones.check_block(is_nan, 0) == partial_result::false_value);
+    assert(zones.check_block(not_nan, 0) == partial_result::true_value);
+    assert(zones.check_block(below_nan, 0) == partial_result::false_value);
+    assert(zones.check_block(above_nan, 0) == partial_result::false_value);
+
+    for(auto* tree : { &is_nan, &not_nan, &below_nan, &above_nan }) {
+        assert(zones.count(*tree) == count_by_evaluate(*tree, readings));
+    }
+    assert(zones.count(is_nan) == 0);
+    assert(zones.count(not_nan) == 4);
+}
+
+void test_block_statistics() {
+    const auto readings = make_readings(1200);
+    zone_map<reading> zones(readings.data(), readings.size(), 500);
+    zones.track(&reading::sensor).track(&reading::time);
+
+    assert(zones.size() == 1200);
+    assert(zones.block_size() == 500);
+    assert(zones.tracks(accessor_of(&reading::sensor)));
+    assert(!zones.tracks(accessor_of(&reading::value)));
+
+    assert(zones.zone(&reading::sensor, 1).min == "sensor_1");
+    assert(zones.zone(&reading::sensor, 1).max == "sensor_1");
+    assert(zones.zone(&reading::time, 2).min == 1000);
+    assert(zones.zone(&reading::time, 2).max == 1199);
+    assert(zones.zone(&reading::time, 2).count == 200);
+
+    bool invalid_argument = false;
+    try {
+        zones.zone(&reading::value, 0);
+    } catch(std::invalid_argument& e) {
+        invalid_argument = true;
+    }
+    assert(invalid_argument);
+
+    bool out_of_range = false;
+    try {
+        zones.zone(&reading::time, 3);
+    } catch(std::out_of_range& e) {
+        out_of_range = true;
+    }
+    assert(out_of_range);
+
+    invalid_argument = false;
+    try {
+        zone_map<reading>(readings.data(), readings.size(), 0);
+    } catch(std::invalid_argument& e) {
+        invalid_argument = true;
+    }
+    assert(invalid_argument);
+}